@@ -0,0 +1,200 @@
+#include "vuk/Allocator.hpp"
+#include "vuk/AllocatorHelpers.hpp"
+#include "vuk/Buffer.hpp"
+#include "vuk/resources/DeviceFrameResource.hpp"
+#include "vuk/resources/DeviceNestedResource.hpp"
+#include "vuk/resources/DeviceNullResource.hpp"
+#include "vuk/resources/DeviceTrackingResource.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Measures the CPU cost of allocating through an Allocator, directly over a DeviceNullResource, with a DeviceTrackingResource in between and
+// from the frames of a DeviceSuperFrameResource over a DeviceNullResource.
+// DeviceNullResource does not call into Vulkan, so this runs without a device and measures only the bookkeeping of vuk.
+// Every frame allocates what a typical frame does (semaphores, fences, command pools and buffers, host visible and device local buffers), through the
+// allocator helpers, and releases everything again. Afterwards the null resource must have no live objects left.
+// It is also checked that a DeviceTrackingResource accounts a handle handed out again by its upstream only once.
+//
+// usage: vuk_bench_allocator_overhead [--frames N] [--trace]
+//   --trace records the calls of one frame (kind, handles and create infos) and prints them
+
+using namespace vuk;
+
+namespace {
+	constexpr AllocationKind kinds[] = { AllocationKind::eSemaphore, AllocationKind::eFence,       AllocationKind::eCommandPool,
+		                                   AllocationKind::eCommandBuffer, AllocationKind::eBuffer, AllocationKind::eTimelineSemaphore };
+
+	// allocations of a single frame, returns the number of objects allocated
+	size_t run_frame(Allocator& allocator) {
+		size_t objects = 0;
+		std::vector<Unique<VkSemaphore>> semaphores;
+		for (int i = 0; i < 4; i++) {
+			semaphores.emplace_back(*allocate_semaphore(allocator));
+		}
+		auto fence = *allocate_fence(allocator);
+		auto timeline = *allocate_timeline_semaphore(allocator);
+		objects += semaphores.size() + 2;
+
+		VkCommandPoolCreateInfo cpci{ .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, .queueFamilyIndex = 0 };
+		auto pool = *allocate_command_pool(allocator, cpci);
+		std::vector<Unique<CommandBufferAllocation>> command_buffers;
+		for (int i = 0; i < 8; i++) {
+			command_buffers.emplace_back(*allocate_command_buffer(allocator, { VK_COMMAND_BUFFER_LEVEL_PRIMARY, *pool }));
+		}
+		objects += command_buffers.size() + 1;
+
+		std::vector<Unique<BufferCrossDevice>> uploads;
+		std::vector<Unique<BufferGPU>> buffers;
+		for (int i = 0; i < 16; i++) {
+			auto upload = *allocate_buffer_cross_device(allocator, BufferCreateInfo{ MemoryUsage::eCPUtoGPU, 4096ull * (i + 1), 16 });
+			// staging memory is backed by host memory, so it can be written to
+			memset(upload->mapped_ptr, i, upload->size);
+			uploads.emplace_back(std::move(upload));
+			buffers.emplace_back(*allocate_buffer_gpu(allocator, BufferCreateInfo{ MemoryUsage::eGPUonly, 65536, 256 }));
+		}
+		objects += uploads.size() + buffers.size();
+		return objects;
+	}
+
+	double measure(Allocator& allocator, size_t frames) {
+		size_t objects = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t f = 0; f < frames; f++) {
+			objects += run_frame(allocator);
+		}
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		return std::chrono::duration<double, std::nano>(elapsed).count() / objects;
+	}
+
+	// every frame is recycled before it is allocated from, as by a renderer with 3 frames in flight
+	double measure_frames(DeviceSuperFrameResource& super_frame, size_t frames) {
+		size_t objects = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t f = 0; f < frames; f++) {
+			Allocator frame_allocator(super_frame.get_next_frame());
+			objects += run_frame(frame_allocator);
+		}
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		return std::chrono::duration<double, std::nano>(elapsed).count() / objects;
+	}
+
+	bool check_no_live_objects(DeviceNullResource& null_resource) {
+		bool ok = true;
+		for (auto kind : kinds) {
+			if (auto live = null_resource.get_live_count(kind); live != 0) {
+				fprintf(stderr, "%llu %s(s) were not deallocated\n", (unsigned long long)live, std::string(to_string(kind)).c_str());
+				ok = false;
+			}
+		}
+		return ok;
+	}
+
+	// hands out the same fence for every allocation, as an upstream that releases its objects implicitly (eg. with their pool) and recycles them
+	struct RecyclingResource : DeviceNestedResource {
+		using DeviceNestedResource::DeviceNestedResource;
+
+		VkFence fence = VK_NULL_HANDLE;
+
+		Result<void, AllocateException> allocate_fences(std::span<VkFence> dst, SourceLocationAtFrame loc) override {
+			if (fence == VK_NULL_HANDLE) {
+				VUK_DO_OR_RETURN(upstream->allocate_fences(std::span{ &fence, 1 }, loc));
+			}
+			for (auto& v : dst) {
+				v = fence;
+			}
+			return { expected_value };
+		}
+
+		void deallocate_fences(std::span<const VkFence> src) override {}
+
+		~RecyclingResource() {
+			if (fence != VK_NULL_HANDLE) {
+				upstream->deallocate_fences(std::span{ &fence, 1 });
+			}
+		}
+	};
+
+	// the fence is allocated again without being deallocated in between, it must stay a single live allocation of its call site
+	bool check_handle_reuse(DeviceNullResource& null_resource) {
+		RecyclingResource recycling(&null_resource);
+		DeviceTrackingResource tracking(&recycling);
+		VkFence fence;
+		for (int i = 0; i < 2; i++) {
+			if (auto res = tracking.allocate_fences(std::span{ &fence, 1 }, VUK_HERE_AND_NOW()); !res) {
+				fprintf(stderr, "fence allocation failed: %s\n", res.error().what());
+				return false;
+			}
+		}
+		auto sites = tracking.get_call_sites();
+		bool ok = sites.size() == 1 && sites[0].live_count == 1 && sites[0].total_count == 2;
+		if (!ok) {
+			fprintf(stderr, "a reused handle was not accounted once\n");
+		}
+		tracking.deallocate_fences(std::span{ &fence, 1 });
+		return ok;
+	}
+} // namespace
+
+int main(int argc, char** argv) {
+	size_t frames = 10000;
+	bool trace = false;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			frames = std::stoull(argv[++i]);
+		} else if (strcmp(argv[i], "--trace") == 0) {
+			trace = true;
+		} else {
+			fprintf(stderr, "usage: %s [--frames N] [--trace]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	DeviceNullResource null_resource;
+	Allocator direct(null_resource);
+	DeviceTrackingResource tracking(&null_resource);
+	Allocator tracked(tracking);
+
+	// warm up
+	measure(direct, frames / 10 + 1);
+	measure(tracked, frames / 10 + 1);
+
+	printf("direct:  %.1f ns per object\n", measure(direct, frames));
+	printf("tracked: %.1f ns per object\n", measure(tracked, frames));
+	// the objects of the frames are only released to the null resource when the super frame resource is destroyed
+	DeviceNullResource frame_null_resource;
+	{
+		DeviceSuperFrameResource super_frame(frame_null_resource, 3);
+		measure_frames(super_frame, frames / 10 + 1);
+		printf("frame:   %.1f ns per object\n", measure_frames(super_frame, frames));
+	}
+	for (auto kind : kinds) {
+		printf("  %-20s %llu allocated\n", std::string(to_string(kind)).c_str(), (unsigned long long)null_resource.get_allocation_count(kind));
+	}
+
+	if (trace) {
+		null_resource.set_call_recording(true);
+		run_frame(direct);
+		null_resource.set_call_recording(false);
+		for (auto& call : null_resource.get_calls()) {
+			printf("%s %s", call.allocation ? "allocate" : "deallocate", std::string(to_string(call.kind)).c_str());
+			for (auto& h : call.handles) {
+				printf(" %llu", (unsigned long long)h);
+			}
+			if (call.file) {
+				printf(" (%s:%u)", call.file, call.line);
+			}
+			printf("\n%s", call.arguments.c_str());
+		}
+	}
+
+	bool ok = check_no_live_objects(null_resource);
+	ok &= check_no_live_objects(frame_null_resource);
+	DeviceNullResource reuse_null_resource;
+	ok &= check_handle_reuse(reuse_null_resource);
+	ok &= check_no_live_objects(reuse_null_resource);
+	return ok ? 0 : 1;
+}
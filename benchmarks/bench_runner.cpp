@@ -1,6 +1,8 @@
 #include "bench_runner.hpp"
 #include "../src/RenderGraphUtil.hpp"
 
+#include <chrono>
+
 std::vector<std::string> chosen_resource;
 
 vuk::BenchRunner::BenchRunner() {
@@ -62,11 +64,31 @@ vuk::BenchRunner::BenchRunner() {
 	swapchain = context->add_swapchain(util::make_swapchain(vkbdevice));
 }
 
-constexpr unsigned stage_wait = 0;
-constexpr unsigned stage_warmup = 1;
-constexpr unsigned stage_variance = 2;
-constexpr unsigned stage_live = 3;
-constexpr unsigned stage_complete = 4;
+void vuk::BenchRunner::setup() {
+	// Setup Dear ImGui context
+	IMGUI_CHECKVERSION();
+	ImGui::CreateContext();
+	// Setup Dear ImGui style
+	ImGui::StyleColorsDark();
+	// Setup Platform/Renderer bindings
+	ImGui_ImplGlfw_InitForVulkan(window, true);
+
+	start = context->create_timestamp_query();
+	end = context->create_timestamp_query();
+	{ imgui_data = util::ImGui_ImplVuk_Init(*global); }
+	bench->setup(*this, *global);
+}
+
+vuk::BenchRunner::~BenchRunner() {
+	imgui_data.font_texture.view.reset();
+	imgui_data.font_texture.image.reset();
+	xdev_rf_alloc.reset();
+	context.reset();
+	vkDestroySurfaceKHR(vkbinstance.instance, surface, nullptr);
+	destroy_window_glfw(window);
+	vkb::destroy_device(vkbdevice);
+	vkb::destroy_instance(vkbinstance);
+}
 
 void vuk::BenchRunner::render() {
 	while (!glfwWindowShouldClose(window)) {
@@ -154,106 +176,23 @@ void vuk::BenchRunner::render() {
 
 		auto& bench_case = bench->get_case(current_case);
 		auto& subcase = bench_case.subcases[current_subcase];
+		auto cpu_start = std::chrono::steady_clock::now();
 		auto rg = subcase(*this, frame_allocator, start, end);
 		ImGui::Render();
 
 		vuk::Name attachment_name = "_final";
 		util::ImGui_ImplVuk_Render(frame_allocator, rg, attachment_name.append("+"), "SWAPCHAIN", imgui_data, ImGui::GetDrawData(), sampled_images);
 		rg.attach_swapchain(attachment_name, swapchain, vuk::ClearColor{ 0.3f, 0.5f, 0.3f, 1.0f });
-		execute_submit_and_present_to_one(frame_allocator, std::move(rg).link(*context, vuk::RenderGraph::CompileOptions{}), swapchain);
+		auto erg = std::move(rg).link(*context, vuk::RenderGraph::CompileOptions{});
+		auto cpu_end = std::chrono::steady_clock::now();
+		execute_submit_and_present_to_one(frame_allocator, std::move(erg), swapchain);
 		sampled_images.clear();
 
 		std::optional<double> duration = context->retrieve_duration(start, end);
-		auto& bcase = bench->get_case(current_case);
 		if (!duration) {
 			continue;
 		} else if (current_stage != stage_complete && current_stage != stage_wait) {
-			bcase.timings[current_subcase].push_back(*duration);
-
-			num_runs++;
-		}
-		// transition between stages
-		if (current_stage == stage_warmup && num_runs >= 50) {
-			current_stage++;
-			bcase.last_stage_ran[current_subcase]++;
-			bcase.last_stage_ran[current_subcase]++;
-
-			double& mean = bcase.est_mean[current_subcase];
-			mean = 0;
-			for (auto& t : bcase.timings[current_subcase]) {
-				mean += t;
-			}
-			num_runs = 0;
-			bcase.timings[current_subcase].clear();
-		} else if (current_stage == stage_variance && num_runs >= 50) {
-			double& mean = bcase.est_mean[current_subcase];
-			mean = 0;
-			for (auto& t : bcase.timings[current_subcase]) {
-				mean += t;
-			}
-			mean /= num_runs;
-
-			double& variance = bcase.est_variance[current_subcase];
-			variance = 0;
-			for (auto& t : bcase.timings[current_subcase]) {
-				variance += (t - mean) * (t - mean);
-			}
-			variance *= 1.0 / (num_runs - 1);
-
-			const auto Z = 1.96; // 95% confidence
-			bcase.runs_required[current_subcase] = (uint32_t)std::ceil(4 * Z * Z * variance / ((0.1 * mean) * (0.1 * mean)));
-			// run at least 128 iterations
-			bcase.runs_required[current_subcase] = std::max(bcase.runs_required[current_subcase], 128u);
-
-			current_stage++;
-			bcase.last_stage_ran[current_subcase]++;
-			// reuse timings for subsequent live
-		} else if (current_stage == stage_live && num_runs >= bcase.runs_required[current_subcase]) {
-			double& mean = bcase.mean[current_subcase];
-			mean = 0;
-			double& min = bcase.min_max[current_subcase].first;
-			min = DBL_MAX;
-			double& max = bcase.min_max[current_subcase].second;
-			max = 0;
-			for (auto& t : bcase.timings[current_subcase]) {
-				mean += t;
-				min = std::min(min, t);
-				max = std::max(max, t);
-			}
-			mean /= num_runs;
-
-			auto& bins = bcase.binned[current_subcase];
-			bins.resize(64);
-
-			double& variance = bcase.variance[current_subcase];
-			variance = 0;
-			for (auto& t : bcase.timings[current_subcase]) {
-				variance += (t - mean) * (t - mean);
-				auto bin_index = (uint32_t)std::floor((bins.size() - 1) * (t - min) / (max - min));
-				bins[bin_index]++;
-			}
-			variance *= 1.0 / (num_runs - 1);
-
-			bcase.last_stage_ran[current_subcase]++;
-
-			//TODO: https://en.wikipedia.org/wiki/Jarque%E2%80%93Bera_test
-
-			if (bcase.subcases.size() > current_subcase + 1) {
-				current_subcase++;
-				current_stage = 1;
-				num_runs = 0;
-				continue;
-			}
-			if (bench->num_cases > current_case + 1) {
-				current_case++;
-				current_subcase = 0;
-				current_stage = 1;
-				num_runs = 0;
-				continue;
-			}
-			current_stage = 0;
-			current_case = 0;
-			current_subcase = 0;
+			add_sample(*duration, std::chrono::duration<double>(cpu_end - cpu_start).count());
 		}
 	}
 }
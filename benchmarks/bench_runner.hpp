@@ -1,6 +1,9 @@
 #pragma once
 
+// VUK_BENCH_HEADLESS builds the runner without a window: the benchmark renders offscreen and results are written as JSON
+#ifndef VUK_BENCH_HEADLESS
 #include "../examples/glfw.hpp"
+#endif
 #include "../examples/utils.hpp"
 #include "vuk/AllocatorHelpers.hpp"
 #include "vuk/CommandBuffer.hpp"
@@ -9,7 +12,9 @@
 #include "vuk/SampledImage.hpp"
 #include "vuk/resources/DeviceFrameResource.hpp"
 #include <VkBootstrap.h>
+#ifndef VUK_BENCH_HEADLESS
 #include <backends/imgui_impl_glfw.h>
+#endif
 #include <functional>
 #include <optional>
 #include <stdio.h>
@@ -25,6 +30,8 @@ namespace vuk {
 		std::vector<std::string_view> subcase_labels;
 		std::vector<std::function<RenderGraph(BenchRunner&, vuk::Allocator&, Query, Query)>> subcases;
 		std::vector<std::vector<double>> timings;
+		/// CPU time spent building and linking the rendergraph in the runs the timings were taken in
+		std::vector<std::vector<double>> cpu_timings;
 		std::vector<std::vector<float>> binned;
 		std::vector<uint32_t> last_stage_ran;
 		std::vector<uint32_t> runs_required;
@@ -60,6 +67,7 @@ namespace vuk {
 					     ...);
 					    (subcase_labels.emplace_back(ts.description), ...);
 					    timings.resize(sizeof...(Args));
+					    cpu_timings.resize(sizeof...(Args));
 					    runs_required.resize(sizeof...(Args));
 					    mean.resize(sizeof...(Args));
 					    variance.resize(sizeof...(Args));
@@ -78,6 +86,11 @@ namespace vuk {
 } // namespace vuk
 
 namespace vuk {
+	constexpr unsigned stage_wait = 0;
+	constexpr unsigned stage_warmup = 1;
+	constexpr unsigned stage_variance = 2;
+	constexpr unsigned stage_live = 3;
+	constexpr unsigned stage_complete = 4;
 
 	struct BenchRunner {
 		VkDevice device;
@@ -86,9 +99,11 @@ namespace vuk {
 		std::optional<Context> context;
 		std::optional<DeviceSuperFrameResource> xdev_rf_alloc;
 		std::optional<Allocator> global;
+#ifndef VUK_BENCH_HEADLESS
 		vuk::SwapchainRef swapchain;
 		GLFWwindow* window;
 		VkSurfaceKHR surface;
+#endif
 		vkb::Instance vkbinstance;
 		vkb::Device vkbdevice;
 		util::ImGuiData imgui_data;
@@ -105,23 +120,14 @@ namespace vuk {
 
 		BenchRunner();
 
-		void setup() {
-			// Setup Dear ImGui context
-			IMGUI_CHECKVERSION();
-			ImGui::CreateContext();
-			// Setup Dear ImGui style
-			ImGui::StyleColorsDark();
-			// Setup Platform/Renderer bindings
-			ImGui_ImplGlfw_InitForVulkan(window, true);
-
-			start = context->create_timestamp_query();
-			end = context->create_timestamp_query();
-			{ imgui_data = util::ImGui_ImplVuk_Init(*global); }
-			bench->setup(*this, *global);
-		}
+		void setup();
 
 		void render();
 
+		/// @brief Record the GPU and CPU duration of a run of the current subcase, and move through the stages
+		/// @return true if all cases have completed
+		bool add_sample(double duration, double cpu_duration);
+
 		void cleanup() {
 			context->wait_idle();
 			if (bench->cleanup) {
@@ -129,16 +135,7 @@ namespace vuk {
 			}
 		}
 
-		~BenchRunner() {
-			imgui_data.font_texture.view.reset();
-			imgui_data.font_texture.image.reset();
-			xdev_rf_alloc.reset();
-			context.reset();
-			vkDestroySurfaceKHR(vkbinstance.instance, surface, nullptr);
-			destroy_window_glfw(window);
-			vkb::destroy_device(vkbdevice);
-			vkb::destroy_instance(vkbinstance);
-		}
+		~BenchRunner();
 
 		static BenchRunner& get_runner() {
 			static BenchRunner runner;
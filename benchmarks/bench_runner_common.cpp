@@ -0,0 +1,100 @@
+#include "bench_runner.hpp"
+
+#include <cfloat>
+#include <cmath>
+
+// stage transitions shared by the windowed and the headless runner
+
+bool vuk::BenchRunner::add_sample(double duration, double cpu_duration) {
+	auto& bcase = bench->get_case(current_case);
+	bcase.timings[current_subcase].push_back(duration);
+	bcase.cpu_timings[current_subcase].push_back(cpu_duration);
+	num_runs++;
+
+	// transition between stages
+	if (current_stage == stage_warmup && num_runs >= 50) {
+		current_stage++;
+		bcase.last_stage_ran[current_subcase]++;
+		bcase.last_stage_ran[current_subcase]++;
+
+		double& mean = bcase.est_mean[current_subcase];
+		mean = 0;
+		for (auto& t : bcase.timings[current_subcase]) {
+			mean += t;
+		}
+		num_runs = 0;
+		bcase.timings[current_subcase].clear();
+		bcase.cpu_timings[current_subcase].clear();
+	} else if (current_stage == stage_variance && num_runs >= 50) {
+		double& mean = bcase.est_mean[current_subcase];
+		mean = 0;
+		for (auto& t : bcase.timings[current_subcase]) {
+			mean += t;
+		}
+		mean /= num_runs;
+
+		double& variance = bcase.est_variance[current_subcase];
+		variance = 0;
+		for (auto& t : bcase.timings[current_subcase]) {
+			variance += (t - mean) * (t - mean);
+		}
+		variance *= 1.0 / (num_runs - 1);
+
+		const auto Z = 1.96; // 95% confidence
+		bcase.runs_required[current_subcase] = (uint32_t)std::ceil(4 * Z * Z * variance / ((0.1 * mean) * (0.1 * mean)));
+		// run at least 128 iterations
+		bcase.runs_required[current_subcase] = std::max(bcase.runs_required[current_subcase], 128u);
+
+		current_stage++;
+		bcase.last_stage_ran[current_subcase]++;
+		// reuse timings for subsequent live
+	} else if (current_stage == stage_live && num_runs >= bcase.runs_required[current_subcase]) {
+		double& mean = bcase.mean[current_subcase];
+		mean = 0;
+		double& min = bcase.min_max[current_subcase].first;
+		min = DBL_MAX;
+		double& max = bcase.min_max[current_subcase].second;
+		max = 0;
+		for (auto& t : bcase.timings[current_subcase]) {
+			mean += t;
+			min = std::min(min, t);
+			max = std::max(max, t);
+		}
+		mean /= num_runs;
+
+		auto& bins = bcase.binned[current_subcase];
+		bins.resize(64);
+
+		double& variance = bcase.variance[current_subcase];
+		variance = 0;
+		for (auto& t : bcase.timings[current_subcase]) {
+			variance += (t - mean) * (t - mean);
+			auto bin_index = max > min ? (uint32_t)std::floor((bins.size() - 1) * (t - min) / (max - min)) : 0u;
+			bins[bin_index]++;
+		}
+		variance *= 1.0 / (num_runs - 1);
+
+		bcase.last_stage_ran[current_subcase]++;
+
+		//TODO: https://en.wikipedia.org/wiki/Jarque%E2%80%93Bera_test
+
+		if (bcase.subcases.size() > current_subcase + 1) {
+			current_subcase++;
+			current_stage = 1;
+			num_runs = 0;
+			return false;
+		}
+		if (bench->num_cases > current_case + 1) {
+			current_case++;
+			current_subcase = 0;
+			current_stage = 1;
+			num_runs = 0;
+			return false;
+		}
+		current_stage = 0;
+		current_case = 0;
+		current_subcase = 0;
+		return true;
+	}
+	return false;
+}
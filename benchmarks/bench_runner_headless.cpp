@@ -0,0 +1,233 @@
+#include "bench_runner.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+// Runs the registered bench without a window: frames are rendered into an offscreen "_final" image and every subcase is taken through the
+// warmup, variance and live stages. The results are written as JSON, to be compared with compare_results.py.
+// Any device vk-bootstrap selects is accepted, so this runs on a software implementation (lavapipe) too.
+
+namespace {
+	struct Summary {
+		double mean = 0;
+		double stddev = 0;
+		double min = 0;
+		double max = 0;
+		double p50 = 0;
+		double p90 = 0;
+		double p99 = 0;
+	};
+
+	double percentile(const std::vector<double>& sorted, double p) {
+		if (sorted.empty()) {
+			return 0;
+		}
+		auto rank = p * (sorted.size() - 1);
+		auto lo = (size_t)std::floor(rank);
+		auto hi = std::min(lo + 1, sorted.size() - 1);
+		return sorted[lo] + (sorted[hi] - sorted[lo]) * (rank - lo);
+	}
+
+	Summary summarize(std::vector<double> samples) {
+		Summary s;
+		if (samples.empty()) {
+			return s;
+		}
+		std::sort(samples.begin(), samples.end());
+		for (auto& t : samples) {
+			s.mean += t;
+		}
+		s.mean /= samples.size();
+		if (samples.size() > 1) {
+			double variance = 0;
+			for (auto& t : samples) {
+				variance += (t - s.mean) * (t - s.mean);
+			}
+			s.stddev = std::sqrt(variance / (samples.size() - 1));
+		}
+		s.min = samples.front();
+		s.max = samples.back();
+		s.p50 = percentile(samples, 0.5);
+		s.p90 = percentile(samples, 0.9);
+		s.p99 = percentile(samples, 0.99);
+		return s;
+	}
+
+	void write_summary(FILE* f, const char* name, const Summary& s) {
+		// durations are written in microseconds
+		fprintf(f,
+		        "\"%s\": { \"mean\": %.4f, \"stddev\": %.4f, \"min\": %.4f, \"max\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f }",
+		        name,
+		        s.mean * 1e6,
+		        s.stddev * 1e6,
+		        s.min * 1e6,
+		        s.max * 1e6,
+		        s.p50 * 1e6,
+		        s.p90 * 1e6,
+		        s.p99 * 1e6);
+	}
+
+	void write_string(FILE* f, std::string_view s) {
+		fputc('"', f);
+		for (auto c : s) {
+			if (c == '"' || c == '\\') {
+				fputc('\\', f);
+			}
+			fputc(c, f);
+		}
+		fputc('"', f);
+	}
+} // namespace
+
+vuk::BenchRunner::BenchRunner() {
+	vkb::InstanceBuilder builder;
+	builder
+	    .set_debug_callback([](VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
+	                           VkDebugUtilsMessageTypeFlagsEXT messageType,
+	                           const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
+	                           void* pUserData) -> VkBool32 {
+		    auto ms = vkb::to_string_message_severity(messageSeverity);
+		    auto mt = vkb::to_string_message_type(messageType);
+		    fprintf(stderr, "[%s: %s](user defined)\n%s\n", ms, mt, pCallbackData->pMessage);
+		    return VK_FALSE;
+	    })
+	    .set_app_name("vuk_bench")
+	    .set_engine_name("vuk")
+	    .set_headless()
+	    .require_api_version(1, 2, 0)
+	    .set_app_version(0, 1, 0);
+	auto inst_ret = builder.build();
+	if (!inst_ret.has_value()) {
+		fprintf(stderr, "Failed to create instance: %s\n", inst_ret.error().message().c_str());
+		exit(1);
+	}
+	vkbinstance = inst_ret.value();
+	auto instance = vkbinstance.instance;
+	vkb::PhysicalDeviceSelector selector{ vkbinstance };
+	selector.set_minimum_version(1, 0).add_required_extension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+	auto phys_ret = selector.select();
+	if (!phys_ret.has_value()) {
+		fprintf(stderr, "Failed to select physical device: %s\n", phys_ret.error().message().c_str());
+		exit(1);
+	}
+	vkb::PhysicalDevice vkbphysical_device = phys_ret.value();
+	physical_device = vkbphysical_device.physical_device;
+
+	vkb::DeviceBuilder device_builder{ vkbphysical_device };
+	VkPhysicalDeviceVulkan12Features vk12features{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+	vk12features.timelineSemaphore = true;
+	vk12features.descriptorBindingPartiallyBound = true;
+	vk12features.descriptorBindingUpdateUnusedWhilePending = true;
+	vk12features.shaderSampledImageArrayNonUniformIndexing = true;
+	vk12features.runtimeDescriptorArray = true;
+	vk12features.descriptorBindingVariableDescriptorCount = true;
+	vk12features.hostQueryReset = true;
+	VkPhysicalDeviceSynchronization2FeaturesKHR sync_feat{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR, .synchronization2 = true };
+	auto dev_ret = device_builder.add_pNext(&vk12features).add_pNext(&sync_feat).build();
+	if (!dev_ret.has_value()) {
+		fprintf(stderr, "Failed to create device: %s\n", dev_ret.error().message().c_str());
+		exit(1);
+	}
+	vkbdevice = dev_ret.value();
+	graphics_queue = vkbdevice.get_queue(vkb::QueueType::graphics).value();
+	auto graphics_queue_family_index = vkbdevice.get_queue_index(vkb::QueueType::graphics).value();
+	device = vkbdevice.device;
+
+	context.emplace(ContextCreateParameters{ instance, device, physical_device, graphics_queue, graphics_queue_family_index });
+	const unsigned num_inflight_frames = 3;
+	xdev_rf_alloc.emplace(*context, num_inflight_frames);
+	global.emplace(*xdev_rf_alloc);
+}
+
+void vuk::BenchRunner::setup() {
+	start = context->create_timestamp_query();
+	end = context->create_timestamp_query();
+	bench->setup(*this, *global);
+}
+
+vuk::BenchRunner::~BenchRunner() {
+	xdev_rf_alloc.reset();
+	context.reset();
+	vkb::destroy_device(vkbdevice);
+	vkb::destroy_instance(vkbinstance);
+}
+
+void vuk::BenchRunner::render() {
+	current_stage = stage_warmup;
+	bool done = false;
+	while (!done) {
+		auto& xdev_frame_resource = xdev_rf_alloc->get_next_frame();
+		context->next_frame();
+		Allocator frame_allocator(xdev_frame_resource);
+
+		auto& bench_case = bench->get_case(current_case);
+		auto& subcase = bench_case.subcases[current_subcase];
+		auto cpu_start = std::chrono::steady_clock::now();
+		auto rg = subcase(*this, frame_allocator, start, end);
+		rg.attach_managed("_final", vuk::Format::eR8G8B8A8Unorm, vuk::Dimension2D::absolute(1920, 1080), vuk::Samples::e1, vuk::ClearColor{ 0.3f, 0.5f, 0.3f, 1.0f });
+		auto erg = std::move(rg).link(*context, vuk::RenderGraph::CompileOptions{});
+		auto cpu_end = std::chrono::steady_clock::now();
+		execute_submit_and_wait(frame_allocator, std::move(erg));
+
+		std::optional<double> duration = context->retrieve_duration(start, end);
+		if (!duration) {
+			continue;
+		}
+		auto ran_subcase = current_subcase;
+		auto ran_stage = current_stage;
+		done = add_sample(*duration, std::chrono::duration<double>(cpu_end - cpu_start).count());
+		if (ran_stage == stage_live && (done || current_stage == stage_warmup)) {
+			fprintf(stderr, "%s - %s: %.2f us\n", bench_case.label.data(), bench_case.subcase_labels[ran_subcase].data(), bench_case.mean[ran_subcase] * 1e6);
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	const char* out_path = "bench_results.json";
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+			out_path = argv[++i];
+		} else {
+			fprintf(stderr, "Usage: %s [--out results.json]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	auto& runner = vuk::BenchRunner::get_runner();
+	runner.setup();
+	runner.render();
+	runner.cleanup();
+
+	FILE* f = fopen(out_path, "w");
+	if (!f) {
+		fprintf(stderr, "Failed to open %s\n", out_path);
+		return 1;
+	}
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(runner.physical_device, &props);
+	fprintf(f, "{\n\t\"bench\": ");
+	write_string(f, runner.bench->name);
+	fprintf(f, ",\n\t\"device\": ");
+	write_string(f, props.deviceName);
+	fprintf(f, ",\n\t\"results\": [\n");
+	bool first = true;
+	for (unsigned i = 0; i < runner.bench->num_cases; i++) {
+		auto& bcase = runner.bench->get_case(i);
+		for (unsigned j = 0; j < bcase.subcases.size(); j++) {
+			fprintf(f, "%s\t\t{ \"case\": ", first ? "" : ",\n");
+			first = false;
+			write_string(f, bcase.label);
+			fprintf(f, ", \"subcase\": ");
+			write_string(f, bcase.subcase_labels[j]);
+			fprintf(f, ", \"runs\": %zu, ", bcase.timings[j].size());
+			write_summary(f, "gpu_us", summarize(bcase.timings[j]));
+			fprintf(f, ", ");
+			write_summary(f, "cpu_us", summarize(bcase.cpu_timings[j]));
+			fprintf(f, " }");
+		}
+	}
+	fprintf(f, "\n\t]\n}\n");
+	fclose(f);
+}
@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+"""Compare two result files written by the headless benchmark runners.
+
+A subcase is flagged as a regression if its mean grew by more than the threshold
+and by more than the combined standard error of the two runs.
+Exits with 1 if any regression was found.
+
+usage: compare_results.py baseline.json current.json [--threshold 0.05] [--metric gpu_us|cpu_us]
+"""
+import argparse
+import json
+import math
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    return {(data["bench"], r["case"], r["subcase"]): r for r in data["results"]}
+
+
+def sem(result, metric):
+    runs = max(result["runs"], 1)
+    return result[metric]["stddev"] / math.sqrt(runs)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare two vuk benchmark result files")
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=0.05, help="relative increase of the mean that is considered a regression")
+    parser.add_argument("--metric", default="gpu_us", choices=["gpu_us", "cpu_us"])
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+
+    regressions = 0
+    print(f"{'case':<60} {'baseline':>12} {'current':>12} {'change':>9}")
+    for key, cur in current.items():
+        name = " / ".join(key)
+        base = baseline.get(key)
+        if base is None:
+            print(f"{name:<60} {'-':>12} {cur[args.metric]['mean']:>12.2f} {'new':>9}")
+            continue
+        b = base[args.metric]["mean"]
+        c = cur[args.metric]["mean"]
+        change = (c - b) / b if b > 0 else 0.0
+        noise = 2 * math.sqrt(sem(base, args.metric) ** 2 + sem(cur, args.metric) ** 2)
+        regressed = change > args.threshold and (c - b) > noise
+        regressions += regressed
+        print(f"{name:<60} {b:>12.2f} {c:>12.2f} {change * 100:>8.1f}%{'  REGRESSION' if regressed else ''}")
+    for key in baseline.keys() - current.keys():
+        print(f"{' / '.join(key):<60} missing from {args.current}")
+
+    if regressions:
+        print(f"{regressions} regression(s) over {args.threshold * 100:.1f}%")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
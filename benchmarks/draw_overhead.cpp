@@ -10,6 +10,9 @@
  */
 
 namespace {
+	// statistics of the last recorded case, shown in the gui
+	vuk::CommandBufferStatistics last_statistics;
+
 	struct V1 {
 		std::string_view description = "1 iter";
 		static constexpr unsigned n_iters = 1;
@@ -36,10 +39,15 @@ namespace {
 		              },
 		          .gui =
 		              [](vuk::BenchRunner& runner, vuk::Allocator& frame_allocator) {
+		                auto print = [](const char* label, const vuk::CommandBufferStatistics::Counter& c) {
+			                ImGui::Text("%s: %llu emitted, %llu elided", label, (unsigned long long)c.emitted, (unsigned long long)c.elided);
+		                };
+		                print("Viewports", last_statistics.viewports);
+		                print("Scissors", last_statistics.scissors);
+		                print("Pipelines", last_statistics.pipelines);
 		              } },
 		.cases = { { "Dependent, small image",
 		             [](vuk::BenchRunner& runner, vuk::Allocator& frame_allocator, vuk::Query start, vuk::Query end, auto&& parameters) {
-		               auto ptc = ifc.begin();
 		               vuk::RenderGraph rg;
 		               rg.add_pass({ .resources = { "_final"_image(vuk::eColorWrite) }, .execute = [start, end, parameters](vuk::CommandBuffer& command_buffer) {
 			                            vuk::TimedScope _{ command_buffer, start, end };
@@ -48,12 +56,12 @@ namespace {
 			                                .set_scissor(0, vuk::Rect2D::framebuffer()) // Set the scissor area to cover the entire framebuffer
 			                                .bind_graphics_pipeline("triangle")         // Recall pipeline for "triangle" and bind
 			                                .draw(3 * parameters.n_iters, 1, 0, 0);     // Draw 3 vertices
+			                            last_statistics = command_buffer.get_statistics();
 		                            } });
 		               return rg;
 		             } },
 		           { "Non-dependent, small image",
 		             [](vuk::BenchRunner& runner, vuk::Allocator& frame_allocator, vuk::Query start, vuk::Query end, auto&& parameters) {
-		               auto ptc = ifc.begin();
 		               vuk::RenderGraph rg;
 		               rg.add_pass({ .resources = { "_final"_image(vuk::eColorWrite) }, .execute = [start, end, parameters](vuk::CommandBuffer& command_buffer) {
 			                            vuk::TimedScope _{ command_buffer, start, end };
@@ -62,6 +70,24 @@ namespace {
 			                            for (auto i = 0; i < parameters.n_iters; i++) {
 				                            command_buffer.draw(3, 1, 0, 0);
 			                            }
+			                            last_statistics = command_buffer.get_statistics();
+		                            } });
+		               return rg;
+		             } },
+		           { "Redundant state per draw, small image",
+		             [](vuk::BenchRunner& runner, vuk::Allocator& frame_allocator, vuk::Query start, vuk::Query end, auto&& parameters) {
+		               vuk::RenderGraph rg;
+		               rg.add_pass({ .resources = { "_final"_image(vuk::eColorWrite) }, .execute = [start, end, parameters](vuk::CommandBuffer& command_buffer) {
+			                            vuk::TimedScope _{ command_buffer, start, end };
+			                            command_buffer.set_dynamic_state(vuk::DynamicStateFlagBits::eViewport | vuk::DynamicStateFlagBits::eScissor);
+			                            for (auto i = 0; i < parameters.n_iters; i++) {
+				                            // the scene renderer pattern: every draw re-specifies its full state, most of which is already bound
+				                            command_buffer.set_viewport(0, vuk::Rect2D::framebuffer())
+				                                .set_scissor(0, vuk::Rect2D::framebuffer())
+				                                .bind_graphics_pipeline("triangle")
+				                                .draw(3, 1, 0, 0);
+			                            }
+			                            last_statistics = command_buffer.get_statistics();
 		                            } });
 		               return rg;
 		             } } }
@@ -0,0 +1,137 @@
+#include "../src/AppendList.hpp"
+#include "vuk/Allocator.hpp"
+#include "vuk/resources/DeviceFrameResource.hpp"
+#include "vuk/resources/DeviceNullResource.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Compares the bookkeeping of DeviceFrameResource: every allocation from a recording thread records its handles for deallocation when the frame
+// is recycled. Measures recording handles from 1-16 threads into a mutex guarded vector (the previous scheme) and into an AppendList, followed by the
+// recycle (reading all handles and clearing), over several frames so that the containers are warm.
+// The same is measured through DeviceFrameResource: fences are allocated from and deallocated to the frames of a DeviceSuperFrameResource over a
+// DeviceNullResource, and every frame is recycled before it is recorded again. This includes taking the fences from the pool of the super frame
+// resource, so it runs without a device and measures only the bookkeeping of vuk.
+
+namespace {
+	constexpr size_t frames = 64;
+	constexpr size_t allocations_per_thread = 1 << 14;
+
+	using Handle = uint64_t;
+
+	struct MutexVector {
+		std::mutex mutex;
+		std::vector<Handle> handles;
+
+		void push(std::span<const Handle> src) {
+			std::unique_lock _(mutex);
+			handles.insert(handles.end(), src.begin(), src.end());
+		}
+
+		uint64_t recycle() {
+			uint64_t sum = 0;
+			for (auto& h : handles) {
+				sum += h;
+			}
+			handles.clear();
+			return sum;
+		}
+	};
+
+	struct LockFree {
+		vuk::AppendList<Handle> handles;
+
+		void push(std::span<const Handle> src) {
+			handles.push(src);
+		}
+
+		uint64_t recycle() {
+			uint64_t sum = 0;
+			handles.for_each_chunk([&](std::span<Handle> chunk) {
+				for (auto& h : chunk) {
+					sum += h;
+				}
+			});
+			handles.clear();
+			return sum;
+		}
+	};
+
+	volatile uint64_t sink;
+
+	// returns ns per allocation
+	template<class Container>
+	double measure(size_t thread_count, size_t batch_size) {
+		Container container;
+		double total = 0;
+		for (size_t frame = 0; frame < frames; frame++) {
+			auto start = std::chrono::steady_clock::now();
+			std::vector<std::thread> threads;
+			for (size_t t = 0; t < thread_count; t++) {
+				threads.emplace_back([&container, t, batch_size]() {
+					std::vector<Handle> batch(batch_size);
+					for (size_t i = 0; i < allocations_per_thread; i += batch_size) {
+						for (size_t j = 0; j < batch_size; j++) {
+							batch[j] = (t << 32) | (i + j);
+						}
+						container.push(std::span<const Handle>(batch));
+					}
+				});
+			}
+			for (auto& t : threads) {
+				t.join();
+			}
+			sink = container.recycle();
+			auto end = std::chrono::steady_clock::now();
+			total += std::chrono::duration<double, std::nano>(end - start).count();
+		}
+		return total / (frames * thread_count * allocations_per_thread);
+	}
+
+	// returns ns per allocation
+	double measure_frame_resource(size_t thread_count, size_t batch_size) {
+		vuk::DeviceNullResource null_resource;
+		vuk::DeviceSuperFrameResource super_frame(null_resource, 3);
+		double total = 0;
+		for (size_t frame = 0; frame < frames; frame++) {
+			auto start = std::chrono::steady_clock::now();
+			auto& frame_resource = super_frame.get_next_frame();
+			std::vector<std::thread> threads;
+			for (size_t t = 0; t < thread_count; t++) {
+				threads.emplace_back([&frame_resource, batch_size]() {
+					std::vector<VkFence> batch(batch_size);
+					for (size_t i = 0; i < allocations_per_thread; i += batch_size) {
+						if (auto res = frame_resource.allocate_fences(std::span{ batch }, VUK_HERE_AND_NOW()); !res) {
+							std::fprintf(stderr, "fence allocation failed: %s\n", res.error().what());
+							std::terminate();
+						}
+						frame_resource.deallocate_fences(std::span<const VkFence>(batch));
+					}
+				});
+			}
+			for (auto& t : threads) {
+				t.join();
+			}
+			auto end = std::chrono::steady_clock::now();
+			total += std::chrono::duration<double, std::nano>(end - start).count();
+		}
+		return total / (frames * thread_count * allocations_per_thread);
+	}
+} // namespace
+
+int main() {
+	std::printf("%8s %8s %14s %14s %14s\n", "threads", "batch", "mutex+vector", "AppendList", "frame");
+	for (size_t batch_size : { 1, 4 }) {
+		for (size_t thread_count : { 1, 2, 4, 8, 16 }) {
+			auto locked = measure<MutexVector>(thread_count, batch_size);
+			auto lock_free = measure<LockFree>(thread_count, batch_size);
+			auto frame_resource = measure_frame_resource(thread_count, batch_size);
+			std::printf("%8zu %8zu %11.2f ns %11.2f ns %11.2f ns\n", thread_count, batch_size, locked, lock_free, frame_resource);
+		}
+	}
+}
@@ -0,0 +1,61 @@
+#include "vuk/Hash.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <robin_hood.h>
+#include <vector>
+
+// Compares the hashes used for cache keys on key sizes that occur in vuk:
+// names (~8-32 bytes), descriptor counts (~48 bytes), pipeline instance data (~100-300 bytes) and descriptor set bindings (~1KiB)
+
+namespace {
+	volatile uint64_t sink;
+
+	template<class F>
+	double measure(const std::vector<std::vector<uint8_t>>& keys, F&& f) {
+		constexpr size_t iterations = 1 << 20;
+		uint64_t acc = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < iterations; i++) {
+			auto& key = keys[i % keys.size()];
+			acc += f(key.data(), key.size());
+		}
+		auto end = std::chrono::steady_clock::now();
+		sink = acc;
+		return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+	}
+
+	// distribution of the low bits of sequential integers, which is what robin_hood and std::unordered_map index with
+	double bucket_occupancy(size_t bucket_bits) {
+		std::vector<bool> buckets(size_t(1) << bucket_bits);
+		for (uint32_t i = 0; i < buckets.size(); i++) {
+			size_t h = 0;
+			hash_combine(h, i * 64u);
+			buckets[h & (buckets.size() - 1)] = true;
+		}
+		size_t occupied = 0;
+		for (auto b : buckets) {
+			occupied += b;
+		}
+		return double(occupied) / buckets.size();
+	}
+} // namespace
+
+int main() {
+	std::mt19937 rng(42);
+	std::printf("%8s %12s %12s %12s\n", "bytes", "fnv1a", "robin_hood", "hash_bytes");
+	for (size_t size : { 8, 16, 32, 48, 128, 256, 1024 }) {
+		std::vector<std::vector<uint8_t>> keys(64, std::vector<uint8_t>(size));
+		for (auto& k : keys) {
+			for (auto& b : k) {
+				b = (uint8_t)rng();
+			}
+		}
+		auto fnv = measure(keys, [](const uint8_t* p, size_t n) { return hash::fnv1a::hash((const char*)p, n, hash::fnv1a::default_offset_basis); });
+		auto rh = measure(keys, [](const uint8_t* p, size_t n) { return robin_hood::hash_bytes(p, n); });
+		auto wy = measure(keys, [](const uint8_t* p, size_t n) { return hash::hash_bytes(p, n); });
+		std::printf("%8zu %9.2f ns %9.2f ns %9.2f ns\n", size, fnv, rh, wy);
+	}
+	std::printf("hash_combine bucket occupancy for strided integers: %.3f (random hashing gives ~0.632)\n", bucket_occupancy(16));
+}
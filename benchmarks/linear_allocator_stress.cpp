@@ -0,0 +1,238 @@
+#include "vuk/Allocator.hpp"
+#include "vuk/Buffer.hpp"
+#include "vuk/Context.hpp"
+#include "vuk/resources/DeviceFrameResource.hpp"
+
+#include <VkBootstrap.h>
+#include <algorithm>
+#include <barrier>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Stresses the linear allocators of DeviceFrameResource from many recording threads at once, and measures the cost per allocation.
+// Every thread allocates a random mix of small (from its own chunk), medium (carved from a block) and large (dedicated buffer) host visible
+// buffers, over many frames so that blocks are chained, recycled and the chunks cached by the threads go stale. After every frame all allocations
+// are checked: the requested alignment is honoured, every suballocation lies inside its allocation and no two suballocations of a buffer overlap.
+// The mapped memory of each allocation is filled with a pattern by its thread, and read back after all threads have finished.
+// Reported is the time a thread spends allocating, per allocation.
+//
+// usage: vuk_bench_linear_allocator_stress [--frames N] [--threads N] [--allocations N]
+
+using namespace vuk;
+
+namespace {
+	// optional headless device, the linear allocators allocate real memory
+	struct Device {
+		vkb::Instance instance;
+		vkb::Device device;
+		std::optional<Context> context;
+
+		bool create() {
+			vkb::InstanceBuilder builder;
+			auto inst_ret = builder.set_app_name("vuk_bench_linear_allocator_stress").set_engine_name("vuk").set_headless().require_api_version(1, 2, 0).build();
+			if (!inst_ret.has_value()) {
+				return false;
+			}
+			instance = inst_ret.value();
+			vkb::PhysicalDeviceSelector selector{ instance };
+			auto phys_ret = selector.set_minimum_version(1, 2).add_required_extension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME).select();
+			if (!phys_ret.has_value()) {
+				vkb::destroy_instance(instance);
+				return false;
+			}
+			VkPhysicalDeviceVulkan12Features vk12features{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+			vk12features.timelineSemaphore = true;
+			vk12features.hostQueryReset = true;
+			VkPhysicalDeviceSynchronization2FeaturesKHR sync_feat{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR, .synchronization2 = true };
+			vkb::DeviceBuilder device_builder{ phys_ret.value() };
+			auto dev_ret = device_builder.add_pNext(&vk12features).add_pNext(&sync_feat).build();
+			if (!dev_ret.has_value()) {
+				vkb::destroy_instance(instance);
+				return false;
+			}
+			device = dev_ret.value();
+			auto graphics_queue = device.get_queue(vkb::QueueType::graphics).value();
+			auto graphics_queue_family_index = device.get_queue_index(vkb::QueueType::graphics).value();
+			context.emplace(ContextCreateParameters{ instance.instance, device.device, phys_ret.value().physical_device, graphics_queue, graphics_queue_family_index });
+			return true;
+		}
+
+		~Device() {
+			if (context) {
+				context.reset();
+				vkb::destroy_device(device);
+				vkb::destroy_instance(instance);
+			}
+		}
+	};
+
+	struct Suballocation {
+		BufferCrossDevice buffer;
+		size_t alignment;
+		uint64_t tag;
+	};
+
+	uint8_t pattern(uint64_t tag) {
+		return (uint8_t)((tag * 0x9E3779B97F4A7C15ull) >> 56);
+	}
+
+	// small allocations dominate, as in a typical frame of uniform and vertex data
+	BufferCreateInfo random_buffer(std::mt19937_64& rng) {
+		constexpr size_t alignments[] = { 1, 4, 16, 64, 256 };
+		auto roll = std::uniform_int_distribution<int>(0, 9999)(rng);
+		size_t size;
+		if (roll < 9890) {
+			size = std::uniform_int_distribution<size_t>(1, 4096)(rng);
+		} else if (roll < 9999) {
+			size = std::uniform_int_distribution<size_t>(64 * 1024, 256 * 1024)(rng);
+		} else {
+			size = std::uniform_int_distribution<size_t>(16 * 1024 * 1024 + 1, 24 * 1024 * 1024)(rng);
+		}
+		auto alignment = alignments[std::uniform_int_distribution<size_t>(0, std::size(alignments) - 1)(rng)];
+		return BufferCreateInfo{ MemoryUsage::eCPUtoGPU, size, alignment };
+	}
+
+	// returns the number of errors found
+	size_t check(std::vector<std::vector<Suballocation>>& per_thread) {
+		size_t errors = 0;
+		std::vector<const Suballocation*> all;
+		for (auto& allocations : per_thread) {
+			for (auto& s : allocations) {
+				auto& b = s.buffer;
+				if (b.offset % s.alignment != 0) {
+					fprintf(stderr, "allocation %llu: offset %zu is not aligned to %zu\n", (unsigned long long)s.tag, b.offset, s.alignment);
+					errors++;
+				}
+				if (b.offset + b.size > b.allocation_size) {
+					fprintf(stderr, "allocation %llu: [%zu, %zu) exceeds its allocation of %zu bytes\n", (unsigned long long)s.tag, b.offset, b.offset + b.size, b.allocation_size);
+					errors++;
+				}
+				auto expected = pattern(s.tag);
+				if (std::any_of(b.mapped_ptr, b.mapped_ptr + b.size, [=](std::byte v) { return (uint8_t)v != expected; })) {
+					fprintf(stderr, "allocation %llu: contents were overwritten\n", (unsigned long long)s.tag);
+					errors++;
+				}
+				all.push_back(&s);
+			}
+		}
+		std::sort(all.begin(), all.end(), [](auto* a, auto* b) {
+			return a->buffer.buffer < b->buffer.buffer || (a->buffer.buffer == b->buffer.buffer && a->buffer.offset < b->buffer.offset);
+		});
+		for (size_t i = 1; i < all.size(); i++) {
+			auto& a = all[i - 1]->buffer;
+			auto& b = all[i]->buffer;
+			if (a.buffer == b.buffer && a.offset + a.size > b.offset) {
+				fprintf(stderr, "allocations %llu and %llu overlap\n", (unsigned long long)all[i - 1]->tag, (unsigned long long)all[i]->tag);
+				errors++;
+			}
+		}
+		return errors;
+	}
+
+	struct Run {
+		double ns_per_allocation;
+		size_t errors;
+	};
+
+	Run run(DeviceSuperFrameResource& super_frame, size_t thread_count, size_t frames, size_t allocations_per_thread) {
+		std::vector<std::vector<Suballocation>> per_thread(thread_count);
+		std::vector<std::chrono::nanoseconds> allocating(thread_count);
+		std::optional<Allocator> frame_allocator;
+		size_t errors = 0;
+		size_t frame = 0;
+
+		// the threads live across frames, so the chunks they cache are invalidated by the frames being recycled
+		// the completion step runs on one thread while the others wait: it checks the frame just recorded and starts the next one
+		auto on_frame_done = [&]() noexcept {
+			if (frame > 0) {
+				errors += check(per_thread);
+				for (auto& allocations : per_thread) {
+					allocations.clear();
+				}
+			}
+			if (frame < frames) {
+				frame_allocator.emplace(super_frame.get_next_frame());
+			}
+			frame++;
+		};
+		std::barrier sync(thread_count, on_frame_done);
+		on_frame_done();
+
+		std::vector<std::thread> threads;
+		for (size_t t = 0; t < thread_count; t++) {
+			threads.emplace_back([&, t]() {
+				std::mt19937_64 rng(t);
+				for (size_t f = 0; f < frames; f++) {
+					auto& allocations = per_thread[t];
+					auto start = std::chrono::steady_clock::now();
+					for (size_t i = 0; i < allocations_per_thread; i++) {
+						auto ci = random_buffer(rng);
+						BufferCrossDevice b;
+						if (auto res = frame_allocator->allocate_buffers(std::span{ &b, 1 }, std::span{ &ci, 1 }); !res) {
+							fprintf(stderr, "allocation of %zu bytes failed: %s\n", ci.size, res.error().what());
+							std::terminate();
+						}
+						uint64_t tag = (f * thread_count + t) * allocations_per_thread + i;
+						allocations.push_back(Suballocation{ b, ci.alignment, tag });
+					}
+					allocating[t] += std::chrono::steady_clock::now() - start;
+					// written after allocating, so that only the allocations are measured
+					for (auto& s : allocations) {
+						memset(s.buffer.mapped_ptr, pattern(s.tag), s.buffer.size);
+					}
+					sync.arrive_and_wait();
+				}
+			});
+		}
+		for (auto& t : threads) {
+			t.join();
+		}
+		std::chrono::nanoseconds total{};
+		for (auto& a : allocating) {
+			total += a;
+		}
+		return { std::chrono::duration<double, std::nano>(total).count() / (frames * thread_count * allocations_per_thread), errors };
+	}
+} // namespace
+
+int main(int argc, char** argv) {
+	size_t frames = 64;
+	size_t max_threads = std::max<size_t>(std::thread::hardware_concurrency(), 2);
+	size_t allocations_per_thread = 2048;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			frames = std::stoull(argv[++i]);
+		} else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			max_threads = std::stoull(argv[++i]);
+		} else if (strcmp(argv[i], "--allocations") == 0 && i + 1 < argc) {
+			allocations_per_thread = std::stoull(argv[++i]);
+		} else {
+			fprintf(stderr, "usage: %s [--frames N] [--threads N] [--allocations N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	Device device;
+	if (!device.create()) {
+		fprintf(stderr, "no Vulkan device available\n");
+		return 1;
+	}
+
+	size_t errors = 0;
+	{
+		DeviceSuperFrameResource super_frame(*device.context, 3);
+		for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+			auto result = run(super_frame, threads, frames, allocations_per_thread);
+			printf("%2zu threads: %.1f ns per allocation, %zu errors\n", threads, result.ns_per_allocation, result.errors);
+			errors += result.errors;
+		}
+	}
+
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,191 @@
+#include "vuk/Allocator.hpp"
+#include "vuk/AllocatorHelpers.hpp"
+#include "vuk/CommandBuffer.hpp"
+#include "vuk/Context.hpp"
+#include "vuk/Partials.hpp"
+#include "vuk/RenderGraph.hpp"
+#include "vuk/resources/DeviceFrameResource.hpp"
+
+#include <VkBootstrap.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+// Compares the mips generated by generate_mips_spd with those of the blit fallback it takes for images without storage usage.
+// An RGBA8 image of noise is uploaded, its full mip chain is generated both ways and read back, and every texel of every level is compared.
+// SPD computes the levels of a workgroup from unquantized values, while every blit reads the previous, quantized level, so texels may differ by a few
+// units: the check fails if any texel differs by more than the tolerance.
+// Without shaderc (VUK_USE_SHADERC off) both ways blit, and the levels are equal.
+//
+// usage: vuk_bench_mip_generation [--size N] [--tolerance N]
+
+using namespace vuk;
+
+namespace {
+	// optional headless device
+	struct Device {
+		vkb::Instance instance;
+		vkb::Device device;
+		std::optional<Context> context;
+
+		bool create() {
+			vkb::InstanceBuilder builder;
+			auto inst_ret = builder.set_app_name("vuk_bench_mip_generation").set_engine_name("vuk").set_headless().require_api_version(1, 2, 0).build();
+			if (!inst_ret.has_value()) {
+				return false;
+			}
+			instance = inst_ret.value();
+			vkb::PhysicalDeviceSelector selector{ instance };
+			auto phys_ret = selector.set_minimum_version(1, 2).add_required_extension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME).select();
+			if (!phys_ret.has_value()) {
+				vkb::destroy_instance(instance);
+				return false;
+			}
+			VkPhysicalDeviceVulkan12Features vk12features{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+			vk12features.timelineSemaphore = true;
+			vk12features.hostQueryReset = true;
+			VkPhysicalDeviceSynchronization2FeaturesKHR sync_feat{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR, .synchronization2 = true };
+			vkb::DeviceBuilder device_builder{ phys_ret.value() };
+			auto dev_ret = device_builder.add_pNext(&vk12features).add_pNext(&sync_feat).build();
+			if (!dev_ret.has_value()) {
+				vkb::destroy_instance(instance);
+				return false;
+			}
+			device = dev_ret.value();
+			auto graphics_queue = device.get_queue(vkb::QueueType::graphics).value();
+			auto graphics_queue_family_index = device.get_queue_index(vkb::QueueType::graphics).value();
+			context.emplace(ContextCreateParameters{ instance.instance, device.device, phys_ret.value().physical_device, graphics_queue, graphics_queue_family_index });
+			return true;
+		}
+
+		~Device() {
+			if (context) {
+				context.reset();
+				vkb::destroy_device(device);
+				vkb::destroy_instance(instance);
+			}
+		}
+	};
+
+	constexpr size_t texel_size = 4;
+
+	uint32_t level_extent(uint32_t size, uint32_t level) {
+		return std::max(size >> level, 1u);
+	}
+
+	// uploads the data into a new image, generates its mips and returns all levels tightly packed
+	std::optional<std::vector<uint8_t>> generate_and_read_back(Allocator& allocator, uint32_t size, uint32_t levels, const std::vector<uint8_t>& data, bool storage) {
+		ImageCreateInfo ici;
+		ici.format = Format::eR8G8B8A8Unorm;
+		ici.extent = Extent3D{ size, size, 1 };
+		ici.samples = Samples::e1;
+		ici.tiling = ImageTiling::eOptimal;
+		ici.usage = ImageUsageFlagBits::eTransferRead | ImageUsageFlagBits::eTransferWrite | ImageUsageFlagBits::eSampled | ImageUsageFlagBits::eStorage;
+		ici.mipLevels = levels;
+		ici.arrayLayers = 1;
+		auto tex = allocator.get_context().allocate_texture(allocator, ici);
+
+		auto ia = ImageAttachment::from_texture(tex);
+		if (!storage) {
+			ia.usage = {}; // unknown usage takes the blit fallback
+		}
+		auto upload = host_data_to_image(allocator, DomainFlagBits::eGraphicsQueue, ia, data.data());
+		auto mips = generate_mips_spd(std::move(upload), 0, levels);
+
+		std::vector<BufferImageCopy> regions;
+		size_t total = 0;
+		for (uint32_t level = 0; level < levels; level++) {
+			BufferImageCopy bc;
+			bc.bufferOffset = total;
+			bc.imageSubresource = { .aspectMask = ImageAspectFlagBits::eColor, .mipLevel = level, .baseArrayLayer = 0, .layerCount = 1 };
+			bc.imageExtent = Extent3D{ level_extent(size, level), level_extent(size, level), 1 };
+			regions.push_back(bc);
+			total += (size_t)bc.imageExtent.width * bc.imageExtent.height * texel_size;
+		}
+		auto readback = *allocate_buffer_cross_device(allocator, BufferCreateInfo{ MemoryUsage::eGPUtoCPU, total, texel_size });
+
+		std::unique_ptr<RenderGraph> rgp = std::make_unique<RenderGraph>();
+		rgp->add_pass({ .name = "READBACK",
+		                .execute_on = DomainFlagBits::eGraphicsQueue,
+		                .resources = { "_src"_image >> Access::eTransferRead, "_dst"_buffer >> Access::eTransferWrite },
+		                .execute = [regions](CommandBuffer& command_buffer) {
+			                for (auto& region : regions) {
+				                command_buffer.copy_image_to_buffer("_src", "_dst", region);
+			                }
+		                } });
+		rgp->attach_in("_src", std::move(mips));
+		rgp->attach_buffer("_dst", *readback, Access::eNone, Access::eNone);
+		Future<Buffer> done{ allocator, std::move(rgp), "_dst+" };
+		auto result = done.get();
+		if (!result) {
+			fprintf(stderr, "mip generation failed: %s\n", result.error().what());
+			return {};
+		}
+		auto mapped = reinterpret_cast<const uint8_t*>(readback->mapped_ptr);
+		return std::vector<uint8_t>(mapped, mapped + total);
+	}
+} // namespace
+
+int main(int argc, char** argv) {
+	uint32_t size = 256;
+	int tolerance = 4;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+			size = (uint32_t)std::stoul(argv[++i]);
+		} else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+			tolerance = std::stoi(argv[++i]);
+		} else {
+			fprintf(stderr, "usage: %s [--size N] [--tolerance N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	Device device;
+	if (!device.create()) {
+		fprintf(stderr, "no Vulkan device available\n");
+		return 1;
+	}
+
+	uint32_t levels = (uint32_t)std::log2(size) + 1;
+	std::vector<uint8_t> data((size_t)size * size * texel_size);
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<int> texel(0, 255);
+	for (auto& v : data) {
+		v = (uint8_t)texel(rng);
+	}
+
+	bool ok = true;
+	{
+		DeviceSuperFrameResource super_frame(*device.context, 3);
+		Allocator allocator(super_frame.get_next_frame());
+		auto spd = generate_and_read_back(allocator, size, levels, data, true);
+		auto blit = generate_and_read_back(allocator, size, levels, data, false);
+		if (!spd || !blit) {
+			return 1;
+		}
+
+		size_t offset = 0;
+		for (uint32_t level = 0; level < levels; level++) {
+			auto extent = level_extent(size, level);
+			size_t bytes = (size_t)extent * extent * texel_size;
+			int max_difference = 0;
+			for (size_t i = offset; i < offset + bytes; i++) {
+				max_difference = std::max(max_difference, std::abs((int)(*spd)[i] - (int)(*blit)[i]));
+			}
+			printf("level %2u (%ux%u): max difference %d\n", level, extent, extent, max_difference);
+			if (max_difference > tolerance) {
+				fprintf(stderr, "level %u differs by more than %d\n", level, tolerance);
+				ok = false;
+			}
+			offset += bytes;
+		}
+	}
+
+	return ok ? 0 : 1;
+}
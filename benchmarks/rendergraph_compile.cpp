@@ -0,0 +1,434 @@
+#include "vuk/Allocator.hpp"
+#include "vuk/Context.hpp"
+#include "vuk/Exception.hpp"
+#include "vuk/RenderGraph.hpp"
+#include "vuk/resources/DeviceFrameResource.hpp"
+
+#include <VkBootstrap.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+// Measures the CPU cost of RenderGraph::compile and link on synthetic graphs of 10 to 10000 passes, without a window.
+// Results are written as JSON, with the time spent in every phase of compile and link (see RenderGraph::CompileStatistics).
+// link needs a Context to acquire renderpasses, so if no Vulkan device is available (or --compile-only is given), only compile is measured.
+// With --execute, graphs of up to 100 passes are also recorded with ExecutableRenderGraph::execute (without submitting).
+// No GPU is needed for link and execute: any device is accepted, so they also run on the mock ICD of Vulkan-Tools, which implements every
+// entry point as a no-op (point VK_ICD_FILENAMES or VK_DRIVER_FILES to VkICD_mock_icd.json).
+//
+// Before measuring, the placement decisions of compile are checked on small graphs, the benchmark fails if they are wrong.
+//
+// usage: vuk_bench_rendergraph_compile [--compile-only] [--execute] [--max-passes N] [--out file.json]
+
+using namespace vuk;
+
+namespace {
+	constexpr Format color_format = Format::eR8G8B8A8Unorm;
+	constexpr Format depth_format = Format::eD32Sfloat;
+
+	// tracks the current name of every resource, as writes rename resources
+	struct Versions {
+		std::vector<uint32_t> version;
+		std::string prefix;
+
+		Name current(size_t r) const {
+			return name(r, version[r]);
+		}
+
+		Name next(size_t r) {
+			return name(r, ++version[r]);
+		}
+
+		Name name(size_t r, uint32_t v) const {
+			return Name(prefix + std::to_string(r) + "_" + std::to_string(v));
+		}
+	};
+
+	Resource read(Name n, Access a = Access::eComputeRead) {
+		return Resource{ n, Resource::Type::eImage, a };
+	}
+
+	Resource write(Versions& versions, size_t r, Access a = Access::eComputeRW) {
+		auto in = versions.current(r);
+		return Resource{ in, Resource::Type::eImage, a, versions.next(r) };
+	}
+
+	// single resource, every pass reads and writes it
+	RenderGraph long_chain(size_t passes, std::mt19937&) {
+		RenderGraph rg("chain");
+		Versions v{ { 0 }, "chain" };
+		rg.attach_managed(v.current(0), color_format, Dimension2D::absolute(1024, 1024), Samples::e1, Clear{});
+		for (size_t i = 0; i < passes; i++) {
+			rg.add_pass({ .name = Name("p" + std::to_string(i)), .resources = { write(v, 0) } });
+		}
+		return rg;
+	}
+
+	// one producer, passes - 2 independent consumers that each write their own resource, one pass consuming all of them
+	RenderGraph fan_out_fan_in(size_t passes, std::mt19937&) {
+		RenderGraph rg("fan");
+		size_t leaves = std::max<size_t>(passes, 3) - 2;
+		Versions v{ std::vector<uint32_t>(leaves + 2), "fan" };
+		for (size_t r = 0; r < leaves + 2; r++) {
+			rg.attach_managed(v.current(r), color_format, Dimension2D::absolute(1024, 1024), Samples::e1, Clear{});
+		}
+		size_t src = leaves, dst = leaves + 1;
+		rg.add_pass({ .name = "producer", .resources = { write(v, src, Access::eComputeWrite) } });
+		for (size_t i = 0; i < leaves; i++) {
+			rg.add_pass({ .name = Name("leaf" + std::to_string(i)), .resources = { read(v.current(src)), write(v, i, Access::eComputeWrite) } });
+		}
+		Pass gather{ .name = "gather" };
+		for (size_t i = 0; i < leaves; i++) {
+			gather.resources.push_back(read(v.current(i)));
+		}
+		gather.resources.push_back(write(v, dst, Access::eComputeWrite));
+		rg.add_pass(std::move(gather));
+		return rg;
+	}
+
+	// every pass writes one resource and reads up to three resources written before
+	RenderGraph random_dag(size_t passes, std::mt19937& rng) {
+		RenderGraph rg("dag");
+		size_t resources = std::max<size_t>(4, passes / 4);
+		Versions v{ std::vector<uint32_t>(resources), "dag" };
+		for (size_t r = 0; r < resources; r++) {
+			rg.attach_managed(v.current(r), color_format, Dimension2D::absolute(512, 512), Samples::e1, Clear{});
+		}
+		std::vector<size_t> written;
+		std::vector<bool> is_written(resources);
+		for (size_t i = 0; i < passes; i++) {
+			size_t target = std::uniform_int_distribution<size_t>(0, resources - 1)(rng);
+			Pass p{ .name = Name("p" + std::to_string(i)) };
+			if (!written.empty()) {
+				size_t reads = std::uniform_int_distribution<size_t>(0, std::min<size_t>(3, written.size()))(rng);
+				std::vector<size_t> picked;
+				for (size_t j = 0; j < reads; j++) {
+					size_t r = written[std::uniform_int_distribution<size_t>(0, written.size() - 1)(rng)];
+					if (r != target && std::find(picked.begin(), picked.end(), r) == picked.end()) {
+						picked.push_back(r);
+						p.resources.push_back(read(v.current(r)));
+					}
+				}
+			}
+			p.resources.push_back(write(v, target, is_written[target] ? Access::eComputeRW : Access::eComputeWrite));
+			if (!is_written[target]) {
+				is_written[target] = true;
+				written.push_back(target);
+			}
+			rg.add_pass(std::move(p));
+		}
+		return rg;
+	}
+
+	// a view of a deferred renderer: gbuffer, ssao, lighting, forward passes, bloom and tonemap, at least 8 passes
+	void add_deferred_view(RenderGraph& rg, size_t passes, const std::string& prefix) {
+		enum { albedo, normal, material, depth, ao, hdr, bloom, ldr, count };
+		Versions v{ std::vector<uint32_t>(count), prefix };
+		for (size_t r = 0; r < count; r++) {
+			rg.attach_managed(v.current(r), r == depth ? depth_format : color_format, Dimension2D::absolute(1920, 1080), Samples::e1, Clear{});
+		}
+		rg.add_pass({ .name = Name(prefix + "gbuffer"),
+		              .resources = { write(v, albedo, Access::eColorWrite),
+		                             write(v, normal, Access::eColorWrite),
+		                             write(v, material, Access::eColorWrite),
+		                             write(v, depth, Access::eDepthStencilRW) } });
+		rg.add_pass({ .name = Name(prefix + "ssao"),
+		              .resources = { read(v.current(depth)), read(v.current(normal)), write(v, ao, Access::eComputeWrite) } });
+		rg.add_pass({ .name = Name(prefix + "lighting"),
+		              .resources = { read(v.current(albedo), Access::eFragmentSampled),
+		                             read(v.current(normal), Access::eFragmentSampled),
+		                             read(v.current(material), Access::eFragmentSampled),
+		                             read(v.current(ao), Access::eFragmentSampled),
+		                             write(v, hdr, Access::eColorWrite) } });
+		size_t forward = std::max<size_t>(passes, 8) - 7;
+		for (size_t i = 0; i < forward; i++) {
+			rg.add_pass({ .name = Name(prefix + "forward" + std::to_string(i)),
+			              .resources = { write(v, hdr, Access::eColorRW), read(v.current(depth), Access::eDepthStencilRead) } });
+		}
+		rg.add_pass({ .name = Name(prefix + "bloom_down"), .resources = { read(v.current(hdr)), write(v, bloom, Access::eComputeWrite) } });
+		rg.add_pass({ .name = Name(prefix + "bloom_up"), .resources = { write(v, bloom) } });
+		rg.add_pass({ .name = Name(prefix + "composite"), .resources = { read(v.current(bloom)), write(v, hdr) } });
+		rg.add_pass({ .name = Name(prefix + "tonemap"),
+		              .resources = { read(v.current(hdr), Access::eFragmentSampled), write(v, ldr, Access::eColorWrite) } });
+	}
+
+	// deferred views of 8 passes each, side by side in one graph
+	RenderGraph deferred(size_t passes, std::mt19937&) {
+		RenderGraph rg("deferred");
+		size_t views = std::max<size_t>(passes / 8, 1);
+		for (size_t i = 0; i < views; i++) {
+			add_deferred_view(rg, passes / views, "v" + std::to_string(i) + "_");
+		}
+		return rg;
+	}
+
+	// deferred views of 8 passes each built as separate graphs, appended into one graph that composites their outputs
+	RenderGraph subgraph_append(size_t passes, std::mt19937&) {
+		RenderGraph rg("append");
+		size_t views = std::max<size_t>(passes / 8, 1);
+		Pass gather{ .name = "gather" };
+		for (size_t i = 0; i < views; i++) {
+			RenderGraph view("view");
+			add_deferred_view(view, passes / views, "");
+			auto view_name = Name("view" + std::to_string(i));
+			rg.append(view_name, std::move(view));
+			// ldr of the view, after tonemapping
+			gather.resources.push_back(read(view_name.append("::").append(Name("7_1")), Access::eFragmentSampled));
+		}
+		Versions v{ { 0 }, "swapchain" };
+		rg.attach_managed(v.current(0), color_format, Dimension2D::absolute(1920, 1080), Samples::e1, Clear{});
+		gather.resources.push_back(write(v, 0, Access::eColorWrite));
+		rg.add_pass(std::move(gather));
+		return rg;
+	}
+
+	struct Scenario {
+		const char* name;
+		RenderGraph (*generate)(size_t, std::mt19937&);
+	};
+
+	struct Totals {
+		RenderGraph::CompileStatistics sum;
+		std::chrono::nanoseconds build{};
+		std::chrono::nanoseconds compile{};
+		std::chrono::nanoseconds link{};
+		std::chrono::nanoseconds execute{};
+		size_t iterations = 0;
+
+		void add(const RenderGraph::CompileStatistics& s) {
+			sum.build_io += s.build_io;
+			sum.scheduling += s.scheduling;
+			sum.use_chains += s.use_chains;
+			sum.renderpass_grouping += s.renderpass_grouping;
+			sum.barrier_emission += s.barrier_emission;
+			sum.batching += s.batching;
+			sum.renderpass_building += s.renderpass_building;
+			sum.pass_count = s.pass_count;
+			sum.use_chain_count = s.use_chain_count;
+			sum.renderpass_count = s.renderpass_count;
+			sum.barrier_count = s.barrier_count;
+		}
+	};
+
+	double us(std::chrono::nanoseconds ns, size_t iterations) {
+		return std::chrono::duration<double, std::micro>(ns).count() / iterations;
+	}
+
+	// a chain of passes pinned to the graphics queue, and an independent pass that would finish the graph earlier on the compute queue
+	// returns the number of passes compile moved to the compute queue
+	size_t async_compute_moves(Access independent_access) {
+		RenderGraph rg("async");
+		Versions v{ { 0, 0 }, "async" };
+		rg.attach_managed(v.current(0), color_format, Dimension2D::absolute(1024, 1024), Samples::e1, Clear{});
+		rg.attach_managed(v.current(1), color_format, Dimension2D::absolute(1024, 1024), Samples::e1, Clear{});
+		for (size_t i = 0; i < 4; i++) {
+			rg.add_pass({ .name = Name("graphics" + std::to_string(i)),
+			              .execute_on = DomainFlagBits::eGraphicsQueue,
+			              .resources = { write(v, 0) },
+			              .execute = [](CommandBuffer&) {} });
+		}
+		rg.add_pass({ .name = "independent", .resources = { write(v, 1, independent_access) }, .execute = [](CommandBuffer&) {} });
+		RenderGraph::CompileStatistics stats;
+		rg.compile({ .statistics = &stats, .async_compute = true });
+		return stats.async_compute_pass_count;
+	}
+
+	bool check_placement() {
+		bool ok = true;
+		if (async_compute_moves(Access::eComputeWrite) != 1) {
+			fprintf(stderr, "check failed: an independent compute pass was not moved to the compute queue\n");
+			ok = false;
+		}
+		// blits, resolves and depth/stencil clears need a graphics queue
+		if (async_compute_moves(Access::eTransferWrite) != 0) {
+			fprintf(stderr, "check failed: a blit pass was moved to the compute queue\n");
+			ok = false;
+		}
+		return ok;
+	}
+
+	// optional headless device, to be able to link
+	struct Device {
+		vkb::Instance instance;
+		vkb::Device device;
+		std::optional<Context> context;
+
+		bool create() {
+			vkb::InstanceBuilder builder;
+			auto inst_ret = builder.set_app_name("vuk_bench_rendergraph_compile").set_engine_name("vuk").set_headless().require_api_version(1, 2, 0).build();
+			if (!inst_ret.has_value()) {
+				return false;
+			}
+			instance = inst_ret.value();
+			vkb::PhysicalDeviceSelector selector{ instance };
+			auto phys_ret = selector.set_minimum_version(1, 2).add_required_extension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME).select();
+			if (!phys_ret.has_value()) {
+				vkb::destroy_instance(instance);
+				return false;
+			}
+			VkPhysicalDeviceVulkan12Features vk12features{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+			vk12features.timelineSemaphore = true;
+			vk12features.hostQueryReset = true;
+			VkPhysicalDeviceSynchronization2FeaturesKHR sync_feat{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR, .synchronization2 = true };
+			vkb::DeviceBuilder device_builder{ phys_ret.value() };
+			auto dev_ret = device_builder.add_pNext(&vk12features).add_pNext(&sync_feat).build();
+			if (!dev_ret.has_value()) {
+				vkb::destroy_instance(instance);
+				return false;
+			}
+			device = dev_ret.value();
+			auto graphics_queue = device.get_queue(vkb::QueueType::graphics).value();
+			auto graphics_queue_family_index = device.get_queue_index(vkb::QueueType::graphics).value();
+			context.emplace(ContextCreateParameters{ instance.instance, device.device, phys_ret.value().physical_device, graphics_queue, graphics_queue_family_index });
+			return true;
+		}
+
+		~Device() {
+			if (context) {
+				context.reset();
+				vkb::destroy_device(device);
+				vkb::destroy_instance(instance);
+			}
+		}
+	};
+} // namespace
+
+int main(int argc, char** argv) {
+	bool compile_only = false;
+	bool execute = false;
+	size_t max_passes = 10000;
+	const char* out_path = nullptr;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--compile-only") == 0) {
+			compile_only = true;
+		} else if (strcmp(argv[i], "--execute") == 0) {
+			execute = true;
+		} else if (strcmp(argv[i], "--max-passes") == 0 && i + 1 < argc) {
+			max_passes = std::stoull(argv[++i]);
+		} else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+			out_path = argv[++i];
+		} else {
+			fprintf(stderr, "usage: %s [--compile-only] [--execute] [--max-passes N] [--out file.json]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (!check_placement()) {
+		return 1;
+	}
+
+	Device device;
+	bool link = !compile_only && device.create();
+	if (!compile_only && !link) {
+		fprintf(stderr, "no Vulkan device available, measuring compile only\n");
+	}
+	// managed images are allocated for real, so only small graphs are executed
+	constexpr size_t max_execute_passes = 100;
+	std::optional<DeviceSuperFrameResource> super_frame;
+	if (link && execute) {
+		super_frame.emplace(*device.context, 3);
+	}
+
+	FILE* out = out_path ? fopen(out_path, "w") : stdout;
+	if (!out) {
+		fprintf(stderr, "could not open %s\n", out_path);
+		return 1;
+	}
+
+	const Scenario scenarios[] = {
+		{ "long_chain", long_chain }, { "fan_out_fan_in", fan_out_fan_in }, { "random_dag", random_dag }, { "deferred", deferred }, { "subgraph_append", subgraph_append },
+	};
+	constexpr auto min_time = std::chrono::milliseconds(200);
+	constexpr size_t min_iterations = 3, max_iterations = 100;
+
+	fprintf(out, "{\n  \"linked\": %s,\n  \"executed\": %s,\n  \"results\": [", link ? "true" : "false", super_frame ? "true" : "false");
+	bool first = true;
+	for (auto& scenario : scenarios) {
+		for (size_t passes = 10; passes <= max_passes; passes *= 10) {
+			Totals totals;
+			std::string error;
+			bool executed = super_frame && passes <= max_execute_passes;
+			std::mt19937 rng(42);
+			auto start = std::chrono::steady_clock::now();
+			while (totals.iterations < max_iterations && (totals.iterations < min_iterations || std::chrono::steady_clock::now() - start < min_time)) {
+				RenderGraph::CompileStatistics stats;
+				RenderGraph::CompileOptions options{ .statistics = &stats };
+				try {
+					auto t0 = std::chrono::steady_clock::now();
+					auto rg = scenario.generate(passes, rng);
+					auto t1 = std::chrono::steady_clock::now();
+					if (link) {
+						device.context->next_frame();
+						auto erg = std::move(rg).link(*device.context, options);
+						auto t2 = std::chrono::steady_clock::now();
+						totals.link += t2 - t1;
+						if (executed) {
+							Allocator frame_allocator(super_frame->get_next_frame());
+							auto result = erg.execute(frame_allocator, {});
+							if (!result) {
+								error = result.error().what();
+								break;
+							}
+							totals.execute += std::chrono::steady_clock::now() - t2;
+						}
+					} else {
+						rg.compile(options);
+					}
+					totals.build += t1 - t0;
+					totals.compile += stats.build_io + stats.scheduling + stats.use_chains + stats.renderpass_grouping;
+				} catch (RenderGraphException& e) {
+					error = e.what();
+					break;
+				}
+				totals.add(stats);
+				totals.iterations++;
+			}
+
+			auto n = std::max<size_t>(totals.iterations, 1);
+			auto& s = totals.sum;
+			fprintf(out, "%s\n    {\"scenario\": \"%s\", \"passes\": %zu, \"iterations\": %zu", first ? "" : ",", scenario.name, passes, totals.iterations);
+			if (!error.empty()) {
+				fprintf(out, ", \"error\": \"%s\"", error.c_str());
+			}
+			fprintf(out,
+			        ",\n     \"counts\": {\"passes\": %zu, \"use_chains\": %zu, \"renderpasses\": %zu, \"barriers\": %zu}",
+			        s.pass_count,
+			        s.use_chain_count,
+			        s.renderpass_count,
+			        s.barrier_count);
+			fprintf(out,
+			        ",\n     \"mean_us\": {\"build_graph\": %.3f, \"compile\": %.3f, \"build_io\": %.3f, \"scheduling\": %.3f, \"use_chains\": %.3f, "
+			        "\"renderpass_grouping\": %.3f",
+			        us(totals.build, n),
+			        us(totals.compile, n),
+			        us(s.build_io, n),
+			        us(s.scheduling, n),
+			        us(s.use_chains, n),
+			        us(s.renderpass_grouping, n));
+			if (link) {
+				fprintf(out,
+				        ", \"link\": %.3f, \"barrier_emission\": %.3f, \"batching\": %.3f, \"renderpass_building\": %.3f",
+				        us(totals.link, n),
+				        us(s.barrier_emission, n),
+				        us(s.batching, n),
+				        us(s.renderpass_building, n));
+			}
+			if (executed) {
+				fprintf(out, ", \"execute\": %.3f", us(totals.execute, n));
+			}
+			fprintf(out, "}}");
+			fflush(out);
+			first = false;
+		}
+	}
+	fprintf(out, "\n  ]\n}\n");
+	if (out != stdout) {
+		fclose(out);
+	}
+}
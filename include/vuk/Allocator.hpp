@@ -2,6 +2,7 @@
 
 #include "vuk/Config.hpp"
 #include "vuk/Image.hpp"
+#include "vuk/MemoryStatistics.hpp"
 #include "vuk/Result.hpp"
 #include "vuk/vuk_fwd.hpp"
 
@@ -30,6 +31,19 @@ namespace vuk {
 			_Result._Function = _Function_;
 			return _Result;
 		}
+
+		[[nodiscard]] constexpr uint_least32_t line() const noexcept {
+			return _Line;
+		}
+		[[nodiscard]] constexpr uint_least32_t column() const noexcept {
+			return _Column;
+		}
+		[[nodiscard]] constexpr const char* file_name() const noexcept {
+			return _File;
+		}
+		[[nodiscard]] constexpr const char* function_name() const noexcept {
+			return _Function;
+		}
 	};
 
 	struct SourceLocationAtFrame {
@@ -72,8 +86,6 @@ namespace vuk {
 	/// A DeviceResource must prevent reuse of cross-device resources after deallocation until CPU-GPU timelines are synchronized. GPU-only resources may be
 	/// reused immediately.
 	struct DeviceResource {
-		// missing here: Events (gpu only)
-
 		// gpu only
 		virtual Result<void, AllocateException> allocate_semaphores(std::span<VkSemaphore> dst, SourceLocationAtFrame loc) = 0;
 		virtual void deallocate_semaphores(std::span<const VkSemaphore> src) = 0;
@@ -81,6 +93,10 @@ namespace vuk {
 		virtual Result<void, AllocateException> allocate_fences(std::span<VkFence> dst, SourceLocationAtFrame loc) = 0;
 		virtual void deallocate_fences(std::span<const VkFence> dst) = 0;
 
+		// gpu only
+		virtual Result<void, AllocateException> allocate_events(std::span<VkEvent> dst, SourceLocationAtFrame loc) = 0;
+		virtual void deallocate_events(std::span<const VkEvent> dst) = 0;
+
 		virtual Result<void, AllocateException>
 		allocate_command_buffers(std::span<CommandBufferAllocation> dst, std::span<const CommandBufferAllocationCreateInfo> cis, SourceLocationAtFrame loc) = 0;
 		virtual void deallocate_command_buffers(std::span<const CommandBufferAllocation> dst) = 0;
@@ -131,6 +147,18 @@ namespace vuk {
 
 		virtual void deallocate_swapchains(std::span<const VkSwapchainKHR> src) = 0;
 
+		/// @brief Track a queue submission that signals the timeline semaphore to the value when it completes
+		/// Resources that track submissions keep their allocations alive until the value is reached, so the submission does not need a fence
+		/// @return true if the submission is tracked, false if the submission needs a fence allocated from this resource instead
+		virtual bool track_submission(VkSemaphore timeline_semaphore, uint64_t value) {
+			return false;
+		}
+
+		/// @brief Get the device memory held by this resource, not including the memory held by its upstream resources
+		virtual ResourceMemoryStatistics get_memory_statistics() {
+			return {};
+		}
+
 		virtual Context& get_context() = 0;
 	};
 
@@ -145,7 +173,7 @@ namespace vuk {
 	public:
 		/// @brief Create new Allocator that wraps a DeviceResource
 		/// @param device_resource The DeviceResource to allocate from
-		explicit Allocator(DeviceResource& device_resource) : ctx(&device_resource.get_context()), device_resource(&device_resource) {}
+		explicit Allocator(DeviceResource& device_resource) : device_resource(&device_resource) {}
 		explicit Allocator(DeviceVkResource& device_resource) = delete; // this resource is unsuitable for direct allocation
 
 		/// @brief Allocate semaphores from this Allocator
@@ -180,6 +208,22 @@ namespace vuk {
 		/// @param src Span of fences to be deallocated
 		void deallocate(std::span<const VkFence> src);
 
+		/// @brief Allocate events from this Allocator
+		/// @param dst Destination span to place allocated events into
+		/// @param loc Source location information
+		/// @return Result<void, AllocateException> : void or AllocateException if the allocation could not be performed.
+		Result<void, AllocateException> allocate(std::span<VkEvent> dst, SourceLocationAtFrame loc = VUK_HERE_AND_NOW());
+
+		/// @brief Allocate events from this Allocator
+		/// @param dst Destination span to place allocated events into
+		/// @param loc Source location information
+		/// @return Result<void, AllocateException> : void or AllocateException if the allocation could not be performed.
+		Result<void, AllocateException> allocate_events(std::span<VkEvent> dst, SourceLocationAtFrame loc = VUK_HERE_AND_NOW());
+
+		/// @brief Deallocate events previously allocated from this Allocator
+		/// @param src Span of events to be deallocated
+		void deallocate(std::span<const VkEvent> src);
+
 		/// @brief Allocate command pools from this Allocator
 		/// @param dst Destination span to place allocated command pools into
 		/// @param cis Per-element construction info
@@ -424,6 +468,12 @@ namespace vuk {
 		/// @param src Span of swapchains to be deallocated
 		void deallocate(std::span<const VkSwapchainKHR> src);
 
+		/// @brief Track a queue submission that signals the timeline semaphore to the value when it completes
+		/// @param timeline_semaphore Timeline semaphore signalled by the submission
+		/// @param value Value signalled by the submission
+		/// @return true if the submission is tracked, false if the submission needs a fence allocated from this Allocator instead
+		bool track_submission(VkSemaphore timeline_semaphore, uint64_t value);
+
 		/// @brief Get the underlying DeviceResource
 		/// @return the underlying DeviceResource
 		DeviceResource& get_device_resource() {
@@ -433,11 +483,10 @@ namespace vuk {
 		/// @brief Get the parent Context
 		/// @return the parent Context
 		Context& get_context() {
-			return *ctx;
+			return device_resource->get_context();
 		}
 
 	private:
-		Context* ctx;
 		DeviceResource* device_resource;
 	};
 
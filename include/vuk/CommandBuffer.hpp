@@ -152,12 +152,43 @@ namespace vuk {
 	struct Query;
 	class Allocator;
 
+	/// @brief Counts of state-setting commands that were recorded into the command buffer or elided because the state was already bound
+	struct CommandBufferStatistics {
+		struct Counter {
+			uint64_t emitted = 0;
+			uint64_t elided = 0;
+
+			Counter& operator+=(const Counter& o) noexcept {
+				emitted += o.emitted;
+				elided += o.elided;
+				return *this;
+			}
+		};
+
+		Counter viewports;
+		Counter scissors;
+		Counter index_buffers;
+		Counter vertex_buffers;
+		Counter push_constants;
+		Counter pipelines;
+
+		CommandBufferStatistics& operator+=(const CommandBufferStatistics& o) noexcept {
+			viewports += o.viewports;
+			scissors += o.scissors;
+			index_buffers += o.index_buffers;
+			vertex_buffers += o.vertex_buffers;
+			push_constants += o.push_constants;
+			pipelines += o.pipelines;
+			return *this;
+		}
+	};
+
 	class CommandBuffer {
 	protected:
 		friend struct ExecutableRenderGraph;
 		ExecutableRenderGraph* rg = nullptr;
 		Context& ctx;
-		Allocator* allocator;
+		Allocator* allocator = nullptr;
 		CommandBufferAllocation command_buffer_allocation;
 		VkCommandBuffer command_buffer;
 
@@ -214,6 +245,36 @@ namespace vuk {
 		std::array<unsigned char, 128> push_constant_buffer;
 		fixed_vector<VkPushConstantRange, VUK_MAX_PUSHCONSTANT_RANGES> pcrs;
 
+		// Shadow state - what has been recorded into the command buffer, used to elide redundant commands
+		Bitset<VUK_MAX_VIEWPORTS> bound_viewports = {};
+		Bitset<VUK_MAX_SCISSORS> bound_scissors = {};
+		struct BoundIndexBuffer {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceSize offset = 0;
+			IndexType type = {};
+		} bound_index_buffer;
+		Bitset<VUK_MAX_ATTRIBUTES> set_bound_vertex_buffers = {};
+		std::array<std::pair<VkBuffer, VkDeviceSize>, VUK_MAX_ATTRIBUTES> bound_vertex_buffers;
+		VkPipelineLayout bound_push_constant_layout = VK_NULL_HANDLE;
+		std::array<unsigned char, 128> bound_push_constant_buffer;
+		fixed_vector<VkPushConstantRange, VUK_MAX_PUSHCONSTANT_RANGES> bound_pcrs;
+		struct BoundExtendedDynamicState {
+			DynamicStateFlags set = {};
+			CullModeFlags cull_mode = {};
+			FrontFace front_face = {};
+			PrimitiveTopology topology = {};
+			bool depth_test_enable = false;
+			bool depth_write_enable = false;
+			CompareOp depth_compare_op = {};
+			bool rasterizer_discard_enable = false;
+			bool depth_bias_enable = false;
+			bool primitive_restart_enable = false;
+			PolygonMode polygon_mode = {};
+			bool depth_clamp_enable = false;
+		} bound_extended_dynamic_state;
+
+		CommandBufferStatistics statistics;
+
 		// Descriptor sets
 		std::bitset<VUK_MAX_SETS> sets_used = {};
 		std::array<VkDescriptorSetLayout, VUK_MAX_SETS> set_layouts_used = {};
@@ -248,8 +309,18 @@ namespace vuk {
 			return ctx;
 		}
 
+		/// @brief Retrieve the Allocator used for the temporary allocations of this CommandBuffer
+		Allocator& get_allocator() {
+			assert(allocator);
+			return *allocator;
+		}
+
 		/// @brief Retrieve information about the current renderpass
 		const RenderPassInfo& get_ongoing_renderpass() const;
+		/// @brief Retrieve the number of state-setting commands emitted and elided so far by this CommandBuffer
+		const CommandBufferStatistics& get_statistics() const {
+			return statistics;
+		}
 		/// @brief Retrieve Buffer attached to given name
 		/// @return the attached Buffer or RenderGraphException
 		Result<Buffer> get_resource_buffer(Name resource_name) const;
@@ -267,6 +338,7 @@ namespace vuk {
 		// when a state is set it is persistent for a pass (similar to Vulkan dynamic state) - see documentation
 
 		/// @brief Set mask of dynamic state in CommandBuffer
+		/// Extended dynamic states (the *EXT flags) cannot be set here - they are dynamic whenever the device supports them
 		/// @param dynamic_state_flags Mask of states (flag set = dynamic, flag clear = static)
 		CommandBuffer& set_dynamic_state(DynamicStateFlags dynamic_state_flags);
 
@@ -500,6 +572,11 @@ namespace vuk {
 		/// @param dst the Name of the destination Resource
 		/// @param copy_params parameters of the copy
 		CommandBuffer& copy_buffer_to_image(Name src, Name dst, BufferImageCopy copy_params);
+		/// @brief Copy a buffer resource into an image resource, with multiple regions in a single command
+		/// @param src the Name of the source Resource
+		/// @param dst the Name of the destination Resource
+		/// @param regions parameters of the copies, bufferOffsets are relative to the source Resource
+		CommandBuffer& copy_buffer_to_image(Name src, Name dst, std::span<const BufferImageCopy> regions);
 		/// @brief Copy an image resource into a buffer resource
 		/// @param src the Name of the source Resource
 		/// @param dst the Name of the destination Resource
@@ -544,6 +621,9 @@ namespace vuk {
 		[[nodiscard]] bool _bind_state(bool graphics);
 		[[nodiscard]] bool _bind_compute_pipeline_state();
 		[[nodiscard]] bool _bind_graphics_pipeline_state();
+		void _push_constants(VkPipelineLayout layout, const VkPushConstantRange& pcr);
+		void _bind_vertex_buffer(unsigned binding, const Buffer& buffer);
+		void _set_extended_dynamic_state();
 
 		CommandBuffer& specialize_constants(uint32_t constant_id, void* data, size_t size);
 	};
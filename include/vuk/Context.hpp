@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <functional>
 #include <optional>
 #include <span>
 #include <string_view>
@@ -9,6 +10,8 @@
 #include "vuk/Allocator.hpp"
 #include "vuk/Buffer.hpp"
 #include "vuk/Image.hpp"
+#include "vuk/PipelineTypes.hpp"
+#include "vuk/Query.hpp"
 #include "vuk/Swapchain.hpp"
 #include "vuk_fwd.hpp"
 
@@ -38,6 +41,26 @@ namespace vuk {
 		VkQueue transfer_queue = VK_NULL_HANDLE;
 		/// @brief Optional transfer queue family index
 		uint32_t transfer_queue_family_index = VK_QUEUE_FAMILY_IGNORED;
+		/// @brief Build graphics pipelines from cached pipeline library parts (requires VK_EXT_graphics_pipeline_library to be enabled on the device)
+		bool graphics_pipeline_library = false;
+		/// @brief Query heap budgets from the driver (requires VK_EXT_memory_budget to be enabled on the device), otherwise budgets are estimated
+		bool memory_budget = false;
+		/// @brief When building pipelines from libraries, compile link-time optimized pipelines in the background and replace the fast-linked ones
+		bool background_optimized_pipeline_link = true;
+		/// @brief Create buffers in exclusive sharing mode even if there are multiple queue families
+		/// Rendergraphs transfer the queue family ownership of buffers used on multiple queues, including buffers passed between rendergraphs
+		/// with Futures released to a specific queue. Buffers shared between queues otherwise must be transferred by the application.
+		bool exclusive_buffers = false;
+		/// @brief The extendedDynamicState feature (VK_EXT_extended_dynamic_state or Vulkan 1.3) was enabled on the device
+		bool extended_dynamic_state = false;
+		/// @brief The extendedDynamicState2 feature (VK_EXT_extended_dynamic_state2 or Vulkan 1.3) was enabled on the device
+		bool extended_dynamic_state2 = false;
+		/// @brief The extendedDynamicState3PolygonMode feature of VK_EXT_extended_dynamic_state3 was enabled on the device
+		bool extended_dynamic_state3_polygon_mode = false;
+		/// @brief The extendedDynamicState3DepthClampEnable feature of VK_EXT_extended_dynamic_state3 was enabled on the device
+		bool extended_dynamic_state3_depth_clamp_enable = false;
+		/// @brief The pipelineStatisticsQuery feature was enabled on the device, needed for RenderGraph::CompileOptions::pass_pipeline_statistics
+		bool pipeline_statistics_query = false;
 	};
 
 	/// @brief Abstraction of a device queue in Vulkan
@@ -97,6 +120,32 @@ namespace vuk {
 			void end_region(const VkCommandBuffer&);
 		} debug;
 
+		/// @brief Entry points for VK_EXT_extended_dynamic_state, VK_EXT_extended_dynamic_state2 and VK_EXT_extended_dynamic_state3
+		/// These are loaded only for the features that the ContextCreateParameters declare enabled on the device. Supported states are kept out of the pipeline
+		/// cache key and are set on the command buffer instead.
+		struct ExtendedDynamicState {
+			PFN_vkCmdSetCullModeEXT cmdSetCullModeEXT = nullptr;
+			PFN_vkCmdSetFrontFaceEXT cmdSetFrontFaceEXT = nullptr;
+			PFN_vkCmdSetPrimitiveTopologyEXT cmdSetPrimitiveTopologyEXT = nullptr;
+			PFN_vkCmdSetDepthTestEnableEXT cmdSetDepthTestEnableEXT = nullptr;
+			PFN_vkCmdSetDepthWriteEnableEXT cmdSetDepthWriteEnableEXT = nullptr;
+			PFN_vkCmdSetDepthCompareOpEXT cmdSetDepthCompareOpEXT = nullptr;
+
+			PFN_vkCmdSetRasterizerDiscardEnableEXT cmdSetRasterizerDiscardEnableEXT = nullptr;
+			PFN_vkCmdSetDepthBiasEnableEXT cmdSetDepthBiasEnableEXT = nullptr;
+			PFN_vkCmdSetPrimitiveRestartEnableEXT cmdSetPrimitiveRestartEnableEXT = nullptr;
+
+#ifdef VK_EXT_extended_dynamic_state3
+			PFN_vkCmdSetPolygonModeEXT cmdSetPolygonModeEXT = nullptr;
+			PFN_vkCmdSetDepthClampEnableEXT cmdSetDepthClampEnableEXT = nullptr;
+#endif
+
+			/// @brief Mask of extended dynamic states enabled on the device
+			DynamicStateFlags supported_states = {};
+
+			ExtendedDynamicState(Context& ctx, const ContextCreateParameters& params);
+		} extended_dynamic_state;
+
 		void create_named_pipeline(Name name, PipelineBaseCreateInfo pbci);
 
 		PipelineBaseInfo* get_named_pipeline(Name name);
@@ -133,8 +182,20 @@ namespace vuk {
 		void remove_swapchain(SwapchainRef);
 
 		/// @brief Advance internal counter used for caching and garbage collect caches
+		/// Heap usage is checked against the memory budget threshold, and caches are trimmed while a heap is above it
 		void next_frame();
 
+		/// @brief Query the budget and usage of the device memory heaps, and the memory held by the caches and the DeviceVkResource of the Context
+		MemoryStatistics get_memory_statistics();
+
+		/// @brief Set the fraction of the heap budgets above which vuk trims caches and pools proactively (0.9 by default)
+		/// @param threshold Fraction of the budget of a heap
+		/// @param callback Invoked from next_frame() when the usage of a heap crosses the threshold
+		void set_memory_budget_threshold(float threshold, std::function<void(const MemoryStatistics&, uint32_t heap_index)> callback = {});
+
+		/// @brief Check if any heap was above the memory budget threshold in the last next_frame()
+		bool is_under_memory_pressure();
+
 		/// @brief Wait for the device to become idle. Useful for only a few synchronisation events, like resizing or shutting down.
 		void wait_idle();
 
@@ -174,12 +235,32 @@ namespace vuk {
 		/// @brief Retrieve results from `TimestampQueryPool`s and make them available to retrieve_timestamp and retrieve_duration
 		Result<void> make_timestamp_results_available(std::span<const TimestampQueryPool> pools);
 
+		/// @brief Retrieve the results of the first queries.size() queries of a timestamp query pool with a single vkGetQueryPoolResults, and make them
+		/// available to retrieve_timestamp and retrieve_duration
+		/// Does not wait: queries that have not been written yet are skipped, so this should be called once the submissions writing them have completed
+		/// Results are kept for a bounded number of queries: results that are not retrieved are eventually overwritten by those of newer queries
+		/// @param pool the query pool
+		/// @param queries the Query written to each slot of the pool
+		Result<void> make_timestamp_results_available(VkQueryPool pool, std::span<const Query> queries);
+
+		/// @brief Retrieve the pass timings of the most recent frame whose results are available
+		/// Rendergraphs linked with CompileOptions::pass_timestamps write timestamps around their passes, which are read back in next_frame() once the GPU
+		/// has finished the frame
+		/// @return the report, or null optional if no frame with pass timings has finished yet
+		std::optional<PassTimingReport> get_pass_timings();
+
+		/// @brief Query pools used for pass timings
+		struct PassProfiler& get_pass_profiler();
+
 		// Caches
 
 		/// @brief Acquire a cached rendertarget
 		RGImage acquire_rendertarget(const struct RGCI& ci, uint64_t absolute_frame);
-		/// @brief Acquire a cached sampler
+		/// @brief Acquire a cached sampler, which is never collected
 		Sampler acquire_sampler(const SamplerCreateInfo& cu, uint64_t absolute_frame);
+		/// @brief Acquire a cached sampler, which is collected if it is not acquired again for a number of frames
+		/// Only use this for samplers that are not kept beyond the frames in flight (eg. samplers bound on a CommandBuffer)
+		Sampler acquire_collectable_sampler(const SamplerCreateInfo& cu, uint64_t absolute_frame);
 		/// @brief Acquire a cached VkRenderPass
 		VkRenderPass acquire_renderpass(const struct RenderPassCreateInfo& ci, uint64_t absolute_frame);
 		/// @brief Acquire a cached pipeline
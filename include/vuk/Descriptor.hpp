@@ -251,8 +251,7 @@ namespace std {
 			size_t h = 0;
 			// TODO: should use vuk::DescriptorSetLayout here
 			hash_combine(h,
-			             ::hash::fnv1a::hash(
-			                 (const char*)&x.descriptor_counts[0], x.descriptor_counts.size() * sizeof(x.descriptor_counts[0]), ::hash::fnv1a::default_offset_basis),
+			             ::hash::hash_bytes(&x.descriptor_counts[0], x.descriptor_counts.size() * sizeof(x.descriptor_counts[0])),
 			             (VkDescriptorSetLayout)x.layout);
 			return h;
 		}
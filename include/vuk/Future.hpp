@@ -68,6 +68,11 @@ namespace vuk {
 		/// @param rg
 		/// @param output_binding
 		Future(Allocator& allocator, std::unique_ptr<struct RenderGraph> rg, Name output_binding, DomainFlags dst_domain = DomainFlagBits::eDevice);
+		/// @brief Create a Future sharing ownership of a RenderGraph with other Futures and bind to an output
+		/// @param allocator
+		/// @param rg
+		/// @param output_binding
+		Future(Allocator& allocator, std::shared_ptr<struct RenderGraph> rg, Name output_binding, DomainFlags dst_domain = DomainFlagBits::eDevice);
 		/// @brief Create a Future without ownership of a RenderGraph and bind to an output
 		/// @param allocator
 		/// @param rg
@@ -104,7 +109,7 @@ namespace vuk {
 	private:
 		Name output_binding;
 
-		std::unique_ptr<RenderGraph> owned_rg;
+		std::shared_ptr<RenderGraph> owned_rg;
 		RenderGraph* rg = nullptr;
 
 		std::unique_ptr<FutureBase> control;
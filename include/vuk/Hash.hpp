@@ -1,6 +1,12 @@
 #pragma once
-#include <stdint.h>
 #include <functional>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#pragma intrinsic(_umul128)
+#endif
 
 // https://gist.github.com/filsinger/1255697/21762ea83a2d3c17561c8e6a29f44249a4626f9e
 
@@ -28,6 +34,97 @@ namespace hash {
 	};
 
 	using fnv1a = fnv1a_tpl<uint32_t>;
+
+	// runtime hashing, based on wyhash (https://github.com/wangyi-fudan/wyhash, public domain)
+	// fnv1a is kept for compile-time hashing, for keys only known at runtime this is several times faster and distributes better
+	namespace detail {
+		static constexpr uint64_t secret[4] = { 0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull };
+
+		inline void mum(uint64_t& a, uint64_t& b) noexcept {
+#if defined(__SIZEOF_INT128__)
+			__uint128_t r = a;
+			r *= b;
+			a = (uint64_t)r;
+			b = (uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+			a = _umul128(a, b, &b);
+#else
+			uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t)a, lb = (uint32_t)b;
+			uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32);
+			uint64_t c = t < rl;
+			uint64_t lo = t + (rm1 << 32);
+			c += lo < t;
+			uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+			a = lo;
+			b = hi;
+#endif
+		}
+
+		inline uint64_t read8(const uint8_t* p) noexcept {
+			uint64_t v;
+			memcpy(&v, p, 8);
+			return v;
+		}
+
+		inline uint64_t read4(const uint8_t* p) noexcept {
+			uint32_t v;
+			memcpy(&v, p, 4);
+			return v;
+		}
+
+		inline uint64_t read3(const uint8_t* p, size_t k) noexcept {
+			return (((uint64_t)p[0]) << 16) | (((uint64_t)p[k >> 1]) << 8) | p[k - 1];
+		}
+	} // namespace detail
+
+	/// @brief Mix two 64-bit values into one, with full avalanche
+	inline uint64_t mix(uint64_t a, uint64_t b) noexcept {
+		detail::mum(a, b);
+		return a ^ b;
+	}
+
+	/// @brief Hash a contiguous range of bytes
+	inline uint64_t hash_bytes(const void* data, size_t len, uint64_t seed = 0) noexcept {
+		using namespace detail;
+		auto p = static_cast<const uint8_t*>(data);
+		seed ^= mix(seed ^ secret[0], secret[1]);
+		uint64_t a, b;
+		if (len <= 16) {
+			if (len >= 4) {
+				a = (read4(p) << 32) | read4(p + ((len >> 3) << 2));
+				b = (read4(p + len - 4) << 32) | read4(p + len - 4 - ((len >> 3) << 2));
+			} else if (len > 0) {
+				a = read3(p, len);
+				b = 0;
+			} else {
+				a = b = 0;
+			}
+		} else {
+			size_t i = len;
+			if (i > 48) {
+				uint64_t see1 = seed, see2 = seed;
+				do {
+					seed = mix(read8(p) ^ secret[1], read8(p + 8) ^ seed);
+					see1 = mix(read8(p + 16) ^ secret[2], read8(p + 24) ^ see1);
+					see2 = mix(read8(p + 32) ^ secret[3], read8(p + 40) ^ see2);
+					p += 48;
+					i -= 48;
+				} while (i > 48);
+				seed ^= see1 ^ see2;
+			}
+			while (i > 16) {
+				seed = mix(read8(p) ^ secret[1], read8(p + 8) ^ seed);
+				i -= 16;
+				p += 16;
+			}
+			a = read8(p + i - 16);
+			b = read8(p + i - 8);
+		}
+		a ^= secret[1];
+		b ^= seed;
+		mum(a, b);
+		return mix(a ^ secret[0] ^ len, b ^ secret[1]);
+	}
 } // namespace hash
 
 inline constexpr uint32_t operator"" _fnv1a(const char* aString, const size_t aStrlen) {
@@ -35,18 +132,18 @@ inline constexpr uint32_t operator"" _fnv1a(const char* aString, const size_t aS
 	return hash_type::hash(aString, aStrlen, hash_type::default_offset_basis);
 }
 
+// std::hash of integers and pointers is the identity on common implementations, so the combined value is mixed fully
 template<typename T>
 inline void hash_combine(size_t& seed, const T& v) {
 	std::hash<T> hasher;
-	seed ^= hasher(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	seed = (size_t)::hash::mix((uint64_t)seed ^ ::hash::detail::secret[0], (uint64_t)hasher(v) ^ ::hash::detail::secret[1]);
 }
 
 #define FWD(x) (static_cast<decltype(x)&&>(x))
 
 template<typename T, typename... Rest>
 inline void hash_combine(size_t& seed, const T& v, Rest&&... rest) {
-	std::hash<T> hasher;
-	seed ^= hasher(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	hash_combine(seed, v);
 	hash_combine(seed, FWD(rest)...);
 }
 
@@ -505,6 +505,7 @@ namespace vuk {
 		Extent3D extent;
 		Format format;
 		Samples sample_count;
+		ImageUsageFlags usage;
 	};
 
 	ImageAspectFlags format_to_aspect(Format format) noexcept;
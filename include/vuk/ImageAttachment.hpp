@@ -12,6 +12,8 @@ namespace vuk {
 		vuk::Dimension2D extent;
 		vuk::Format format;
 		vuk::Samples sample_count = vuk::Samples::e1;
+		/// @brief Usage the image was created with, if known (empty = unknown)
+		vuk::ImageUsageFlags usage = {};
 		Clear clear_value;
 
 		uint32_t base_level = 0;
@@ -26,6 +28,7 @@ namespace vuk {
 				                      .extent = { Sizing::eAbsolute, { t.extent.width, t.extent.height } },
 				                      .format = t.format,
 				                      .sample_count = { t.sample_count },
+				                      .usage = t.usage,
 				                      .clear_value = clear_value };
 		}
 		static ImageAttachment from_texture(const vuk::Texture& t) {
@@ -34,6 +37,7 @@ namespace vuk {
 				                      .extent = { Sizing::eAbsolute, { t.extent.width, t.extent.height } },
 				                      .format = t.format,
 				                      .sample_count = { t.sample_count },
+				                      .usage = t.usage,
 				                      .layer_count = t.view->layer_count };
 		}
 	};
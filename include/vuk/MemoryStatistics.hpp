@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace vuk {
+	/// @brief Device memory held by a DeviceResource
+	struct ResourceMemoryStatistics {
+		/// @brief Bytes currently held
+		uint64_t bytes = 0;
+		/// @brief Most bytes held at any point
+		uint64_t peak_bytes = 0;
+	};
+
+	/// @brief Budget and usage of a device memory heap
+	struct HeapStatistics {
+		/// @brief Size of the heap in bytes
+		uint64_t size = 0;
+		bool device_local = false;
+		/// @brief Estimated number of bytes this process can use from the heap (reported by VK_EXT_memory_budget when enabled, otherwise estimated from the size)
+		uint64_t budget = 0;
+		/// @brief Estimated number of bytes used by this process from the heap
+		uint64_t usage = 0;
+		/// @brief Bytes of device memory blocks allocated by vuk from the heap
+		uint64_t block_bytes = 0;
+		/// @brief Bytes of the allocations placed in those blocks
+		uint64_t allocation_bytes = 0;
+		/// @brief Highest usage observed, updated whenever the statistics are queried
+		uint64_t peak_usage = 0;
+	};
+
+	/// @brief Memory budget of the device, and memory held by vuk
+	struct MemoryStatistics {
+		std::vector<HeapStatistics> heaps;
+		/// @brief Memory held by the DeviceVkResource of the Context
+		ResourceMemoryStatistics device_resource;
+		/// @brief Estimated memory held by the cache of transient images
+		uint64_t transient_images = 0;
+	};
+} // namespace vuk
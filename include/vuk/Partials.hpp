@@ -4,7 +4,9 @@
 #include "vuk/RenderGraph.hpp"
 #include "vuk/Future.hpp"
 #include <math.h>
+#include <numeric>
 #include <span>
+#include <vector>
 
 namespace vuk {
 	/// @brief Fill a buffer with host data
@@ -45,18 +47,115 @@ namespace vuk {
 		return host_data_to_buffer(allocator, copy_domain, dst, data.data(), data.size_bytes());
 	}
 
-	/// @brief Fill an image with host data
+	/// @brief Order of the levels and layers in packed image data
+	enum class PackedLayout {
+		/// @brief Levels follow each other from the base level, the layers of a level are consecutive
+		eLevelMajor,
+		/// @brief Layers follow each other, each holding its levels from the base level (the layout of DDS files)
+		eLayerMajor,
+		/// @brief Levels follow each other from the last level to the base level, the layers of a level are consecutive, and each level starts at a
+		/// multiple of the texel block size and 4 bytes (the layout of the level data of uncompressed KTX2 files)
+		eKTX2
+	};
+
+	/// @brief Compute the regions of a packed mip chain with given layout
+	/// @param format Format of the image
+	/// @param extent Extent3D of the 0th level of the image
+	/// @param base_level first level to upload
+	/// @param level_count number of levels to upload
+	/// @param base_layer first layer to upload
+	/// @param layer_count number of layers to upload
+	/// @param regions output regions, one per level (or per level and layer for PackedLayout::eLayerMajor)
+	/// @param layout order of the levels and layers in the data, offsets are relative to the first byte of the packed data
+	/// @return the total size of the packed data
+	inline size_t compute_packed_regions(Format format,
+	                                     Extent3D extent,
+	                                     uint32_t base_level,
+	                                     uint32_t level_count,
+	                                     uint32_t base_layer,
+	                                     uint32_t layer_count,
+	                                     std::vector<BufferImageCopy>& regions,
+	                                     PackedLayout layout = PackedLayout::eLevelMajor) {
+		auto level_extent = [&](uint32_t level) {
+			return Extent3D{ std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u), std::max(extent.depth >> level, 1u) };
+		};
+		auto region = [&](size_t offset, uint32_t level, uint32_t layer, uint32_t count) {
+			BufferImageCopy bc;
+			bc.bufferOffset = offset;
+			bc.imageOffset = { 0, 0, 0 };
+			bc.imageExtent = level_extent(level);
+			bc.imageSubresource.aspectMask = format_to_aspect(format);
+			bc.imageSubresource.mipLevel = level;
+			bc.imageSubresource.baseArrayLayer = layer;
+			bc.imageSubresource.layerCount = count;
+			regions.push_back(bc);
+			return (size_t)compute_image_size(format, bc.imageExtent) * count;
+		};
+
+		size_t offset = 0;
+		switch (layout) {
+		case PackedLayout::eLevelMajor:
+			for (uint32_t level = base_level; level < base_level + level_count; level++) {
+				offset += region(offset, level, base_layer, layer_count);
+			}
+			break;
+		case PackedLayout::eLayerMajor:
+			for (uint32_t layer = base_layer; layer < base_layer + layer_count; layer++) {
+				for (uint32_t level = base_level; level < base_level + level_count; level++) {
+					offset += region(offset, level, layer, 1);
+				}
+			}
+			break;
+		case PackedLayout::eKTX2: {
+			size_t alignment = std::lcm((size_t)format_to_texel_block_size(format), (size_t)4);
+			for (uint32_t level = base_level + level_count; level-- > base_level;) {
+				offset = align_up(offset, alignment);
+				offset += region(offset, level, base_layer, layer_count);
+			}
+			break;
+		}
+		}
+		return offset;
+	}
+
+	/// @brief Fill regions of an image with host data, with a single copy command
 	/// @param allocator Allocator to use for temporary allocations
-	/// @param copy_domain The domain where the copy should happen (when dst is mapped, the copy happens on host)
-	/// @param image ImageAttachment to fill
+	/// @param copy_domain The domain where the copy should happen
+	/// @param image ImageAttachment to fill, must contain all the levels and layers referenced by the regions
 	/// @param src_data pointer to source data
-	inline Future<ImageAttachment> host_data_to_image(Allocator& allocator, DomainFlagBits copy_domain, ImageAttachment image, const void* src_data) {
+	/// @param size size of source data
+	/// @param regions regions to copy, bufferOffsets are relative to src_data
+	inline Future<ImageAttachment> host_data_to_image(Allocator& allocator,
+	                                                  DomainFlagBits copy_domain,
+	                                                  ImageAttachment image,
+	                                                  const void* src_data,
+	                                                  size_t size,
+	                                                  std::span<const BufferImageCopy> regions) {
+		assert(regions.size() > 0);
 		size_t alignment = format_to_texel_block_size(image.format);
-		assert(image.extent.sizing == Sizing::eAbsolute);
-		size_t size = compute_image_size(image.format, static_cast<Extent3D>(image.extent.extent));
 		auto src = *allocate_buffer_cross_device(allocator, BufferCreateInfo{ MemoryUsage::eCPUonly, size, alignment });
 		::memcpy(src->mapped_ptr, src_data, size);
 
+		std::unique_ptr<RenderGraph> rgp = std::make_unique<RenderGraph>();
+		rgp->add_pass({ .name = "IMAGE UPLOAD",
+		                .execute_on = copy_domain,
+		                .resources = { "_dst"_image >> vuk::Access::eTransferWrite, "_src"_buffer >> vuk::Access::eTransferRead },
+		                .execute = [regions = std::vector<BufferImageCopy>(regions.begin(), regions.end())](vuk::CommandBuffer& command_buffer) {
+			                command_buffer.copy_buffer_to_image("_src", "_dst", std::span<const BufferImageCopy>(regions));
+		                } });
+		rgp->attach_buffer("_src", *src, vuk::Access::eNone, vuk::Access::eNone);
+		rgp->attach_image("_dst", image, vuk::Access::eNone, vuk::Access::eNone);
+		return { allocator, std::move(rgp), "_dst+" };
+	}
+
+	/// @brief Fill the base level of an image with host data
+	/// @param allocator Allocator to use for temporary allocations
+	/// @param copy_domain The domain where the copy should happen (when dst is mapped, the copy happens on host)
+	/// @param image ImageAttachment to fill, all of its layers are filled
+	/// @param src_data pointer to source data, with the layers tightly packed
+	inline Future<ImageAttachment> host_data_to_image(Allocator& allocator, DomainFlagBits copy_domain, ImageAttachment image, const void* src_data) {
+		assert(image.extent.sizing == Sizing::eAbsolute);
+		assert(image.layer_count != VK_REMAINING_ARRAY_LAYERS); // the number of layers must be known to size the staging buffer
 		BufferImageCopy bc;
 		bc.imageOffset = { 0, 0, 0 };
 		bc.bufferRowLength = 0;
@@ -65,19 +164,9 @@ namespace vuk {
 		bc.imageSubresource.aspectMask = format_to_aspect(image.format);
 		bc.imageSubresource.mipLevel = image.base_level;
 		bc.imageSubresource.baseArrayLayer = image.base_layer;
-		assert(image.layer_count == 1); // unsupported yet
 		bc.imageSubresource.layerCount = image.layer_count;
-
-		std::unique_ptr<RenderGraph> rgp = std::make_unique<RenderGraph>();
-		rgp->add_pass({ .name = "IMAGE UPLOAD",
-		                .execute_on = copy_domain,
-		                .resources = { "_dst"_image >> vuk::Access::eTransferWrite, "_src"_buffer >> vuk::Access::eTransferRead },
-		                .execute = [bc](vuk::CommandBuffer& command_buffer) {
-			                command_buffer.copy_buffer_to_image("_src", "_dst", bc);
-		                } });
-		rgp->attach_buffer("_src", *src, vuk::Access::eNone, vuk::Access::eNone);
-		rgp->attach_image("_dst", image, vuk::Access::eNone, vuk::Access::eNone);
-		return { allocator, std::move(rgp), "_dst+" };
+		size_t size = (size_t)compute_image_size(image.format, static_cast<Extent3D>(image.extent.extent)) * image.layer_count;
+		return host_data_to_image(allocator, copy_domain, image, src_data, size, std::span{ &bc, 1 });
 	}
 
 	/// @brief Transition image for given access - useful to force certain access across different RenderGraphs linked by Futures
@@ -144,6 +233,14 @@ namespace vuk {
 		return { allocator, std::move(rgp), "_src+" };
 	}
 
+	/// @brief Generate mips for given ImageAttachment in a single compute pass, with a single pass downsampler
+	/// Images without storage usage in ImageAttachment::usage (eg. attached without filling it in), formats without storage image support or a GLSL image
+	/// format, and more than 12 generated levels fall back to blits within the same pass.
+	/// @param image input Future of ImageAttachment
+	/// @param base_mip source mip level
+	/// @param num_mips number of mip levels, including the source level
+	Future<ImageAttachment> generate_mips_spd(Future<ImageAttachment> image, uint32_t base_mip, uint32_t num_mips);
+
 	/// @brief Allocates & fills a buffer with explicitly managed lifetime (cross-device scope)
 	/// @param allocator Allocator to allocate this Buffer from
 	/// @param mem_usage Where to allocate the buffer (host visible buffers will be automatically mapped)
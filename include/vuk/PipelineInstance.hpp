@@ -114,7 +114,9 @@ namespace vuk {
 #pragma pack(pop)
 
 		bool operator==(const PipelineInstanceCreateInfo& o) const noexcept {
-			return base == o.base && render_pass == o.render_pass && extended_size == o.extended_size &&
+			return base == o.base && render_pass == o.render_pass && dynamic_state_flags == o.dynamic_state_flags && extended_size == o.extended_size &&
+			       memcmp(&records, &o.records, sizeof(RecordsExist)) == 0 && attachmentCount == o.attachmentCount && topology == o.topology &&
+			       primitive_restart_enable == o.primitive_restart_enable && cullMode == o.cullMode &&
 			       (is_inline() ? (memcmp(inline_data, o.inline_data, extended_size) == 0) : (memcmp(extended_data, o.extended_data, extended_size) == 0));
 		}
 
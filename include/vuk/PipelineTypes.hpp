@@ -315,25 +315,31 @@ namespace vuk {
 		eViewportCoarseSampleOrderNV = 1 << 14,
 		eExclusiveScissorNV = 1 << 15,
 		eFragmentShadingRateKHR = 1 << 16,
-		eLineStippleEXT = 1 << 17,
+		eLineStippleEXT = 1 << 17,*/
+		// extended dynamic state - these are managed by vuk: when the device supports them, they are always dynamic
+		// VK_EXT_extended_dynamic_state
 		eCullModeEXT = 1 << 18,
 		eFrontFaceEXT = 1 << 19,
 		ePrimitiveTopologyEXT = 1 << 20,
-		eViewportWithCountEXT = 1 << 21,
+		/*eViewportWithCountEXT = 1 << 21,
 		eScissorWithCountEXT = 1 << 22,
-		eVertexInputBindingStrideEXT = 1 << 23,
+		eVertexInputBindingStrideEXT = 1 << 23,*/
 		eDepthTestEnableEXT = 1 << 24,
 		eDepthWriteEnableEXT = 1 << 25,
 		eDepthCompareOpEXT = 1 << 26,
-		eStencilTestEnableEXT = 1 << 27,
+		/*eStencilTestEnableEXT = 1 << 27,
 		eStencilOpEXT = 1 << 28,
 		eVertexInputEXT = 1 << 29,
-		ePatchControlPointsEXT = 1 << 30,
-		eRasterizerDiscardEnableEXT = 1 << 31,
-		eDepthBiasEnableEXT = 1Ui64 << 32,
-		eLogicOpEXT = 1Ui64 << 33,
-		ePrimitiveRestartEnableEXT = 1Ui64 << 34,
-		eColorWriteEnableEXT = 1Ui64 << 35*/
+		ePatchControlPointsEXT = 1 << 30,*/
+		// VK_EXT_extended_dynamic_state2
+		eRasterizerDiscardEnableEXT = 1ULL << 31,
+		eDepthBiasEnableEXT = 1ULL << 32,
+		/*eLogicOpEXT = 1ULL << 33,*/
+		ePrimitiveRestartEnableEXT = 1ULL << 34,
+		/*eColorWriteEnableEXT = 1ULL << 35,*/
+		// VK_EXT_extended_dynamic_state3
+		ePolygonModeEXT = 1ULL << 36,
+		eDepthClampEnableEXT = 1ULL << 37
 	};
 
 	using DynamicStateFlags = Flags<DynamicStateFlagBits>;
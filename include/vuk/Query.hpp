@@ -1,6 +1,12 @@
 #pragma once
 
+#include "vuk/Name.hpp"
+#include "vuk/Types.hpp"
+
+#include <optional>
 #include <stdint.h>
+#include <unordered_map>
+#include <vector>
 
 namespace vuk {
 	/// @brief Handle to a query result
@@ -12,6 +18,8 @@ namespace vuk {
 		}
 	};
 
+	/// @brief Pool for explicitly allocated timestamp queries
+	/// Queries allocated without a pool from a DeviceFrameResource come from pools sized for the whole frame instead
 	struct TimestampQueryPool {
 		static constexpr uint32_t num_queries = 32;
 
@@ -29,6 +37,47 @@ namespace vuk {
 		TimestampQueryPool* pool = nullptr;
 		Query query;
 	};
+
+	/// @brief Pipeline statistics counters collected for a pass
+	struct PipelineStatistics {
+		uint64_t input_assembly_vertices = 0;
+		uint64_t input_assembly_primitives = 0;
+		uint64_t vertex_shader_invocations = 0;
+		uint64_t clipping_invocations = 0;
+		uint64_t clipping_primitives = 0;
+		uint64_t fragment_shader_invocations = 0;
+		uint64_t compute_shader_invocations = 0;
+	};
+
+	/// @brief GPU time taken by a pass, or by a renderpass containing multiple passes
+	struct PassTiming {
+		/// @brief Name of the pass, or the names of the passes in the renderpass joined by '|'
+		Name name;
+		DomainFlagBits domain;
+		/// @brief true if this covers a whole renderpass (including load and store operations)
+		bool renderpass = false;
+		/// @brief Duration in seconds
+		double duration = 0;
+		/// @brief Pipeline statistics of the pass, if they were requested and the pass was executed on the graphics queue
+		std::optional<PipelineStatistics> pipeline_statistics;
+	};
+
+	/// @brief Timings of the passes of all rendergraphs executed in a frame with timestamps enabled
+	struct PassTimingReport {
+		/// @brief Absolute frame (Context::get_frame_count()) the rendergraphs were executed in
+		uint64_t frame = 0;
+		/// @brief Timings in execution order
+		std::vector<PassTiming> timings;
+		/// @brief Index into timings by name
+		std::unordered_map<Name, size_t> index;
+
+		/// @brief Find the timing of a pass or renderpass by name
+		/// @return pointer to the timing or nullptr if there was no pass with this name
+		const PassTiming* find(Name name) const {
+			auto it = index.find(name);
+			return it != index.end() ? &timings[it->second] : nullptr;
+		}
+	};
 } // namespace vuk
 
 namespace std {
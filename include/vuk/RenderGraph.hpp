@@ -10,15 +10,18 @@
 #include "vuk/Swapchain.hpp"
 #include "vuk/vuk_fwd.hpp"
 
+#include <chrono>
 #include <functional>
 #include <optional>
 #include <span>
+#include <string>
 #include <string_view>
 #include <vector>
 
 namespace vuk {
 	struct FutureBase;
 	struct Resource;
+	struct PassTimingReport;
 
 	namespace detail {
 		struct BufferResourceInputOnly;
@@ -230,12 +233,64 @@ namespace vuk {
 		/// @param name Name of the resource to attach to
 		void attach_managed(Name name, Format format, Dimension2D dimension, Samples samples, Clear clear_value);
 
+		/// @brief Time spent in the phases of compiling and linking the rendergraph, and the size of the result
+		struct CompileStatistics {
+			// compile
+			std::chrono::nanoseconds build_io{};
+			std::chrono::nanoseconds scheduling{};
+			/// @brief building use chains and inferring queues
+			std::chrono::nanoseconds use_chains{};
+			/// @brief partitioning passes into queues, renderpasses and subpasses
+			std::chrono::nanoseconds renderpass_grouping{};
+			// link
+			/// @brief validation and emitting barriers along the use chains
+			std::chrono::nanoseconds barrier_emission{};
+			/// @brief assigning renderpasses to batches and building waits
+			std::chrono::nanoseconds batching{};
+			/// @brief building attachment references and subpass descriptions, and acquiring the renderpasses
+			std::chrono::nanoseconds renderpass_building{};
+
+			size_t pass_count = 0;
+			size_t use_chain_count = 0;
+			size_t renderpass_count = 0;
+			/// @brief number of image and memory barriers emitted (only filled in by link)
+			size_t barrier_count = 0;
+			/// @brief number of passes moved to the compute queue by CompileOptions::async_compute
+			size_t async_compute_pass_count = 0;
+			/// @brief number of barriers recorded as a wait on an event by CompileOptions::split_barriers (only filled in by link)
+			size_t split_barrier_count = 0;
+		};
+
 		/// @brief Control compilation options when compiling the rendergraph
 		struct CompileOptions {
 			/// @brief reorder passes according to dependencies
 			bool reorder_passes = true;
 			/// @brief check that pass ordering does not violate resource constraints (not needed when reordering passes)
 			bool check_pass_ordering = false;
+			/// @brief if set, the phases of compile and link are timed into this
+			CompileStatistics* statistics = nullptr;
+			/// @brief write timestamps around every named pass (and every renderpass with multiple passes) when executing
+			/// The timings are reported per frame by Context::get_pass_timings()
+			bool pass_timestamps = false;
+			/// @brief together with pass_timestamps, collect pipeline statistics for passes executed on the graphics queue
+			/// Ignored unless the pipelineStatisticsQuery feature is enabled on the device (see ContextCreateParameters::pipeline_statistics_query)
+			bool pass_pipeline_statistics = false;
+			/// @brief move compute passes that did not request a queue to the compute queue, if this shortens the estimated critical path of the graph
+			/// Only passes whose resource accesses are all compute (or indirect) accesses are considered, passes with transfer accesses are never moved.
+			/// link only applies this when the Context has a dedicated compute queue. The waits and queue family ownership transfers are emitted by link.
+			bool async_compute = false;
+			/// @brief estimated cost of a dependency between queues (semaphore wait and ownership transfer) in seconds, weighed against the gained overlap
+			double async_compute_sync_cost = 50e-6;
+			/// @brief split barriers between passes on the same queue into setting an event after the producing pass and waiting on it before the consuming
+			/// pass, so that the independent passes recorded in between can overlap with the producer
+			/// Only dependencies whose consuming pass is recorded outside of a VkRenderPass are split.
+			bool split_barriers = false;
+			/// @brief estimated extra cost of waiting on an event over a pipeline barrier in seconds, a dependency is split if the independent work in between is
+			/// estimated to take longer
+			double split_barrier_cost = 20e-6;
+			/// @brief pass timings of a previous frame (e.g. from Context::get_pass_timings()) to estimate the critical path and the overlap of split barriers with
+			/// Passes without timings (or all passes, if not set) are assumed to take 100us.
+			const PassTimingReport* pass_timings = nullptr;
 		};
 
 		/// @brief Consume this RenderGraph and create an ExecutableRenderGraph
@@ -273,6 +328,9 @@ namespace vuk {
 
 		void schedule_intra_queue(std::span<struct PassInfo> passes, const RenderGraph::CompileOptions& compile_options);
 
+		// move eligible passes from the graphics queue to the compute queue, if this is estimated to finish the graph earlier
+		size_t schedule_async_compute(const RenderGraph::CompileOptions& compile_options);
+
 		// future support functions
 		friend class Future<ImageAttachment>;
 		friend class Future<Buffer>;
@@ -315,6 +373,15 @@ namespace vuk {
 
 		Name resolve_name(Name, struct PassInfo*) const noexcept;
 
+		/// @brief Describe the compiled graph in the Graphviz DOT format
+		/// Passes are clustered by queue, batch and renderpass and labelled with their barriers; edges are resource dependencies and cross-queue waits.
+		/// Resources created by the graph only have sizes and handles after execute().
+		std::string dump_graphviz() const;
+		/// @brief Describe the compiled graph as JSON
+		/// Contains the passes in recording order with their queue, batch, renderpass and subpass, the renderpasses with every barrier (stage, access and
+		/// layout masks), the resources with their lifetime, size and memory, and the resources sharing an image or overlapping memory.
+		std::string dump_json() const;
+
 	private:
 		struct RGImpl* impl;
 
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// VUK_TRACING is set by the VUK_TRACING CMake option: when it is off, the trace macros expand to nothing
+#ifndef VUK_TRACING
+#define VUK_TRACING 0
+#endif
+
+namespace vuk {
+	/// @brief Receives CPU trace events from vuk
+	/// Zones are nested per thread: end_zone() ends the innermost zone begun on the calling thread. Zone and counter names are static strings (or interned
+	/// Names), so they can be stored without copying. Implementations must be thread-safe.
+	struct Tracer {
+		virtual ~Tracer() = default;
+
+		/// @brief A zone was entered on the calling thread
+		virtual void begin_zone(const char* name) = 0;
+		/// @brief The innermost zone of the calling thread was left
+		virtual void end_zone() = 0;
+		/// @brief A counter changed its value
+		virtual void counter(const char* name, int64_t value) = 0;
+	};
+
+	/// @brief Set the Tracer receiving the trace events of vuk, or nullptr to stop tracing
+	/// Events are only emitted if vuk was built with VUK_TRACING. The tracer must outlive its use by vuk.
+	void set_tracer(Tracer* tracer);
+	/// @brief Get the Tracer receiving the trace events of vuk, if any
+	Tracer* get_tracer();
+
+	/// @brief Tracer collecting events in memory, to be written in the Chrome trace event format (viewable in chrome://tracing or Perfetto)
+	struct ChromeTraceWriter : Tracer {
+		ChromeTraceWriter();
+		~ChromeTraceWriter();
+
+		void begin_zone(const char* name) override;
+		void end_zone() override;
+		void counter(const char* name, int64_t value) override;
+
+		/// @brief Format the events collected so far as Chrome trace JSON
+		std::string to_json();
+		/// @brief Write the events collected so far as Chrome trace JSON
+		/// @return true if the file could be written
+		bool write(const char* path);
+		/// @brief Discard the events collected so far
+		void clear();
+
+	private:
+		std::unique_ptr<struct ChromeTraceWriterImpl> impl;
+	};
+
+	namespace detail {
+		struct TraceZone {
+			Tracer* tracer;
+
+			TraceZone(const char* name) : tracer(get_tracer()) {
+				if (tracer) {
+					tracer->begin_zone(name);
+				}
+			}
+
+			~TraceZone() {
+				if (tracer) {
+					tracer->end_zone();
+				}
+			}
+
+			TraceZone(const TraceZone&) = delete;
+			TraceZone& operator=(const TraceZone&) = delete;
+		};
+
+		inline void trace_counter(const char* name, int64_t value) {
+			if (auto tracer = get_tracer()) {
+				tracer->counter(name, value);
+			}
+		}
+	} // namespace detail
+} // namespace vuk
+
+#if VUK_TRACING
+#define VUK_TRACE_CONCAT_IMPL(x, y)     x##y
+#define VUK_TRACE_CONCAT(x, y)          VUK_TRACE_CONCAT_IMPL(x, y)
+#define VUK_TRACE_ZONE(name)            ::vuk::detail::TraceZone VUK_TRACE_CONCAT(_vuk_trace_zone_, __LINE__)(name)
+#define VUK_TRACE_COUNTER(name, value) ::vuk::detail::trace_counter(name, (int64_t)(value))
+#else
+#define VUK_TRACE_ZONE(name)
+#define VUK_TRACE_COUNTER(name, value)
+#endif
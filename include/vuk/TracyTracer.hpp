@@ -0,0 +1,52 @@
+#pragma once
+
+// Tracer forwarding the trace events of vuk to Tracy (https://github.com/wolfpld/tracy)
+// Include this from a translation unit of your application that is built with TRACY_ENABLE, and pass an instance to vuk::set_tracer()
+
+#include "vuk/Tracing.hpp"
+
+#include <memory>
+#include <mutex>
+#include <tracy/TracyC.h>
+#include <unordered_map>
+#include <vector>
+
+namespace vuk {
+	struct TracyTracer : Tracer {
+		void begin_zone(const char* name) override {
+			zones().push_back(___tracy_emit_zone_begin(source_location(name), 1));
+		}
+
+		void end_zone() override {
+			auto& stack = zones();
+			if (stack.empty()) {
+				return;
+			}
+			___tracy_emit_zone_end(stack.back());
+			stack.pop_back();
+		}
+
+		void counter(const char* name, int64_t value) override {
+			___tracy_emit_plot(name, (double)value);
+		}
+
+	private:
+		// Tracy keeps pointers to source locations, so one is kept for every zone name
+		std::mutex mutex;
+		std::unordered_map<const char*, std::unique_ptr<___tracy_source_location_data>> source_locations;
+
+		const ___tracy_source_location_data* source_location(const char* name) {
+			std::lock_guard _(mutex);
+			auto& loc = source_locations[name];
+			if (!loc) {
+				loc.reset(new ___tracy_source_location_data{ name, name, "vuk", 0, 0 });
+			}
+			return loc.get();
+		}
+
+		static std::vector<TracyCZoneCtx>& zones() {
+			thread_local std::vector<TracyCZoneCtx> stack;
+			return stack;
+		}
+	};
+} // namespace vuk
@@ -1005,6 +1005,7 @@ namespace vuk {
 	struct CommandPool {
 		VkCommandPool command_pool;
 		uint32_t queue_family_index;
+		VkCommandPoolCreateFlags flags = {};
 
 		constexpr bool operator==(const CommandPool& other) const noexcept {
 			return command_pool == other.command_pool;
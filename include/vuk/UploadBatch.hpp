@@ -0,0 +1,100 @@
+#pragma once
+
+#include "vuk/Allocator.hpp"
+#include "vuk/Buffer.hpp"
+#include "vuk/Future.hpp"
+#include "vuk/Image.hpp"
+#include "vuk/ImageAttachment.hpp"
+#include "vuk/Result.hpp"
+#include "vuk/Types.hpp"
+
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace vuk {
+	class UploadRing;
+
+	/// @brief Accumulates host to device uploads, and performs all of them with a single transfer pass in a single submission
+	///
+	/// Every upload returns a Future, sharing ownership of the RenderGraph of the batch. The Futures become available when the batch is submitted, and all of
+	/// them share the same timeline value. The batch must be submitted via submit() while the Futures are alive - submitting or attaching the Futures of a
+	/// batch before that is not supported.
+	class UploadBatch {
+	public:
+		/// @brief Create an empty batch
+		/// @param allocator Allocator to use for the staging allocations
+		/// @param copy_domain The domain where the copies should happen
+		UploadBatch(Allocator& allocator, DomainFlagBits copy_domain = DomainFlagBits::eTransferQueue);
+		/// @brief Create an empty batch that stages uploads in an UploadRing
+		/// @param allocator Allocator to use for temporary allocations
+		/// @param copy_domain The domain where the copies should happen
+		/// @param ring UploadRing to stage the uploads in, allocations are retired when the batch is submitted
+		/// If the ring is full of allocations that have not been submitted yet, uploads are staged in memory from the allocator instead
+		UploadBatch(Allocator& allocator, DomainFlagBits copy_domain, UploadRing& ring);
+		UploadBatch(const UploadBatch&) = delete;
+		UploadBatch& operator=(const UploadBatch&) = delete;
+		~UploadBatch();
+
+		/// @brief Fill a buffer with host data (when dst is mapped, the copy happens on host immediately)
+		/// @param dst Buffer to fill
+		/// @param src_data pointer to source data, copied before returning
+		/// @param size size of source data
+		/// @return Future of the filled buffer, or AllocateException if the staging memory could not be allocated
+		Result<Future<Buffer>, AllocateException> upload(Buffer dst, const void* src_data, size_t size);
+
+		/// @brief Fill a buffer with host data (when dst is mapped, the copy happens on host immediately)
+		/// @param dst Buffer to fill
+		/// @param data source data, copied before returning
+		/// @return Future of the filled buffer, or AllocateException if the staging memory could not be allocated
+		template<class T>
+		Result<Future<Buffer>, AllocateException> upload(Buffer dst, std::span<T> data) {
+			return upload(dst, data.data(), data.size_bytes());
+		}
+
+		/// @brief Fill the base level of an image with host data
+		/// @param dst ImageAttachment to fill, all of its layers are filled
+		/// @param src_data pointer to source data with the layers tightly packed, copied before returning
+		/// @return Future of the filled image, or AllocateException if the staging memory could not be allocated
+		Result<Future<ImageAttachment>, AllocateException> upload(ImageAttachment dst, const void* src_data);
+
+		/// @brief Fill regions of an image with host data, with a single copy command
+		/// @param dst ImageAttachment to fill
+		/// @param src_data pointer to source data, copied before returning
+		/// @param size size of source data
+		/// @param regions regions to copy, bufferOffsets are relative to src_data and must be multiples of 4 and of the texel block size of the format
+		/// @return Future of the filled image, or AllocateException if the staging memory could not be allocated
+		Result<Future<ImageAttachment>, AllocateException>
+		upload(ImageAttachment dst, const void* src_data, size_t size, std::span<const BufferImageCopy> regions);
+
+		/// @brief Record the transfer pass for all the uploads and submit it
+		/// If no uploads needed a device copy, nothing is submitted. The batch can be reused afterwards.
+		Result<void> submit();
+
+		/// @brief Get the number of uploads waiting for submission
+		size_t size() const {
+			return items.size();
+		}
+
+	private:
+		struct Item {
+			Name src;
+			Name dst;
+			size_t size;                          // for buffers
+			std::vector<BufferImageCopy> regions; // for images
+		};
+
+		Allocator* allocator;
+		DomainFlagBits copy_domain;
+		UploadRing* ring = nullptr;
+
+		std::shared_ptr<RenderGraph> rg;
+		std::vector<Item> items;
+		uint64_t next_id = 0;
+		std::vector<Unique<BufferCrossDevice>> staging;
+		// signalled by the transfer pass, used to retire the ring allocations
+		FutureBase completion;
+
+		Result<Buffer, AllocateException> allocate_staging(const void* src_data, size_t size, size_t alignment);
+	};
+} // namespace vuk
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "vuk/Allocator.hpp"
+#include "vuk/Buffer.hpp"
+#include "vuk/Exception.hpp"
+#include "vuk/Result.hpp"
+#include "vuk/Types.hpp"
+
+#include <deque>
+#include <mutex>
+
+namespace vuk {
+	struct FutureBase;
+
+	/// @brief Persistently mapped ring buffer for streaming host data to the device
+	///
+	/// Allocations are bump allocated from the ring, wrapping around at the end. Once the commands reading an allocation have been submitted, the
+	/// allocation is retired with the timeline value of that submission, and its space is reused when the queue reaches the value. When the ring is full,
+	/// allocating waits for the oldest retired allocations to complete, instead of growing the ring.
+	class UploadRing {
+	public:
+		/// @brief Create a ring buffer
+		/// @param allocator Allocator to allocate the backing buffer from. The buffer lives as long as the ring, so this should not be a per-frame allocator
+		/// @param size Size of the ring in bytes
+		UploadRing(Allocator& allocator, size_t size);
+		UploadRing(const UploadRing&) = delete;
+		UploadRing& operator=(const UploadRing&) = delete;
+
+		/// @brief Allocate host-mapped memory from the ring
+		/// @param size Size of the allocation in bytes, at most the size of the ring
+		/// @param alignment Alignment of the allocation
+		/// @param wait If the ring is full, wait for retired allocations to complete - otherwise fail immediately
+		/// @return Buffer pointing into the ring, or AllocateException if the space can't be made available
+		Result<Buffer, AllocateException> allocate(size_t size, size_t alignment = 1, bool wait = true);
+
+		/// @brief Make host writes to the allocations made since the last flush available to the device, with at most two flushes
+		/// Does nothing for host coherent memory. Called by retire().
+		void flush();
+
+		/// @brief Retire all allocations made since the previous retire, their space can be reused once the queue of the domain reaches the value
+		void retire(DomainFlagBits domain, uint64_t value);
+		/// @brief Retire all allocations made since the previous retire, once a Future that reads them has been submitted
+		void retire(const FutureBase& future);
+
+		/// @brief Release the space of retired allocations whose submissions have completed, without waiting
+		void reclaim();
+
+		/// @brief Get the backing buffer of the ring
+		const Buffer& get_buffer() const {
+			return buffer.get();
+		}
+
+		/// @brief Get the number of bytes currently in use (allocated, but not yet released)
+		size_t get_used_size();
+
+	private:
+		struct Retirement {
+			uint64_t end;
+			DomainFlagBits domain;
+			uint64_t value;
+		};
+
+		Allocator* allocator;
+		Unique<BufferCrossDevice> buffer;
+		size_t size;
+
+		std::mutex lock;
+		// offsets grow monotonically, the position in the ring is offset % size
+		uint64_t head = 0;
+		uint64_t tail = 0;
+		uint64_t retired_head = 0;
+		uint64_t flushed_head = 0;
+		std::deque<Retirement> retirements;
+
+		bool _reclaim(bool wait);
+		void _flush();
+	};
+} // namespace vuk
@@ -4,6 +4,8 @@
 #include "vuk/resources/DeviceNestedResource.hpp"
 #include "vuk/resources/DeviceVkResource.hpp"
 
+#include <memory>
+
 namespace vuk {
 	struct DeviceSuperFrameResource;
 	
@@ -21,17 +23,23 @@ namespace vuk {
 		Result<void, AllocateException> allocate_fences(std::span<VkFence> dst, SourceLocationAtFrame loc) override;
 
 		void deallocate_fences(std::span<const VkFence> src) override; // noop
+
+		Result<void, AllocateException> allocate_events(std::span<VkEvent> dst, SourceLocationAtFrame loc) override;
+
+		void deallocate_events(std::span<const VkEvent> src) override; // noop
 		
 		Result<void, AllocateException> allocate_command_buffers(std::span<CommandBufferAllocation> dst,
 		                                                         std::span<const CommandBufferAllocationCreateInfo> cis,
 		                                                         SourceLocationAtFrame loc) override;
 
-		void deallocate_command_buffers(std::span<const CommandBufferAllocation> src) override; // no-op, deallocated with pools
+		void deallocate_command_buffers(std::span<const CommandBufferAllocation> src) override; // no-op, reused after the pools are reset
 
+		/// @brief Hands out the command pool of the calling thread for the queue family, the pool is reset when this frame is recycled
+		/// Command buffers allocated from these pools are reused across the frames, instead of being reallocated.
 		Result<void, AllocateException>
 		allocate_command_pools(std::span<CommandPool> dst, std::span<const VkCommandPoolCreateInfo> cis, SourceLocationAtFrame loc) override;
 
-		void deallocate_command_pools(std::span<const CommandPool> dst) override; // no-op
+		void deallocate_command_pools(std::span<const CommandPool> dst) override; // no-op, owned by the frame
 
 		// buffers are lockless
 		Result<void, AllocateException>
@@ -89,6 +97,13 @@ namespace vuk {
 
 		void deallocate_swapchains(std::span<const VkSwapchainKHR> src) override;
 
+		/// @brief Record a submission made with this frame, the frame waits for the value before it is recycled
+		/// @return true, unless more timelines than there are queues were tracked already
+		bool track_submission(VkSemaphore timeline_semaphore, uint64_t value) override;
+
+		/// @brief Get the memory of the linear allocators of this frame, which is kept when the frame is recycled
+		ResourceMemoryStatistics get_memory_statistics() override;
+
 		/// @brief Wait for the fences / timeline semaphores referencing this frame to complete
 		///
 		/// Called automatically when recycled
@@ -118,8 +133,15 @@ namespace vuk {
 	/// Allocation of these resources are persistent, and they can be deallocated at any time - they will be recycled when the current frame is recycled
 	/// This resource also hands out DeviceFrameResources in a round-robin fashion.
 	/// The lifetime of resources allocated from those allocators is frames_in_flight number of frames (until the DeviceFrameResource is recycled).
+	/// Fences, events, semaphores and timeline semaphores are not destroyed when their frame is recycled, but kept in pools and handed out again.
+	/// While the Context is under memory pressure, recycled frames also release the spare blocks of their linear allocators.
 	struct DeviceSuperFrameResource : DeviceResource {
 		DeviceSuperFrameResource(Context& ctx, uint64_t frames_in_flight);
+		/// @brief Create a DeviceSuperFrameResource allocating from the given resource instead of the device, eg. a DeviceNullResource to run frames without a device
+		///
+		/// The handles of such a resource are not assumed to be real: frames do not wait on or reset the objects they own, and frame buffers are
+		/// allocated one by one from the direct resource instead of from linear allocators.
+		DeviceSuperFrameResource(DeviceResource& upstream, uint64_t frames_in_flight);
 
 		Result<void, AllocateException> allocate_semaphores(std::span<VkSemaphore> dst, SourceLocationAtFrame loc) override;
 
@@ -129,6 +151,10 @@ namespace vuk {
 
 		void deallocate_fences(std::span<const VkFence> src) override;
 
+		Result<void, AllocateException> allocate_events(std::span<VkEvent> dst, SourceLocationAtFrame loc) override;
+
+		void deallocate_events(std::span<const VkEvent> src) override;
+
 		Result<void, AllocateException> allocate_command_buffers(std::span<CommandBufferAllocation> dst,
 		                                                         std::span<const CommandBufferAllocationCreateInfo> cis,
 		                                                         SourceLocationAtFrame loc) override;
@@ -189,6 +215,13 @@ namespace vuk {
 
 		void deallocate_swapchains(std::span<const VkSwapchainKHR> src) override;
 
+		/// @brief Record a submission with the current frame, the frame waits for the value before it is recycled
+		/// @return true, unless more timelines than there are queues were tracked already
+		bool track_submission(VkSemaphore timeline_semaphore, uint64_t value) override;
+
+		/// @brief Get the memory held by this resource and all of its frames
+		ResourceMemoryStatistics get_memory_statistics() override;
+
 		/// @brief Recycle the least-recently-used frame and return it to be used again
 		/// @return DeviceFrameResource for use
 		DeviceFrameResource& get_next_frame();
@@ -196,15 +229,24 @@ namespace vuk {
 		virtual ~DeviceSuperFrameResource();
 
 		Context& get_context() override {
-			return *direct.ctx;
+			return direct->get_context();
 		}
 
 		const uint64_t frames_in_flight;
-		DeviceVkResource direct;
+		/// @brief The resource objects are allocated from and deallocated to, a DeviceVkResource unless one was given on construction
+		DeviceResource* direct;
 	private:
 		DeviceFrameResource& get_last_frame();
 		void deallocate_frame(DeviceFrameResource& f);
 
+		std::unique_ptr<DeviceVkResource> owned_direct;
+		// null for a given direct resource
+		VkDevice device = VK_NULL_HANDLE;
+		LegacyGPUAllocator* legacy_gpu_allocator = nullptr;
+
 		struct DeviceSuperFrameResourceImpl* impl;
+
+		friend struct DeviceFrameResource;
+		friend struct DeviceFrameResourceImpl;
 	};
 } // namespace vuk
\ No newline at end of file
@@ -17,6 +17,10 @@ namespace vuk {
 
 		void deallocate_fences(std::span<const VkFence> dst) override;
 
+		Result<void, AllocateException> allocate_events(std::span<VkEvent> dst, SourceLocationAtFrame loc) override;
+
+		void deallocate_events(std::span<const VkEvent> dst) override;
+
 		Result<void, AllocateException> allocate_command_buffers(std::span<CommandBufferAllocation> dst,
 		                                                         std::span<const CommandBufferAllocationCreateInfo> cis,
 		                                                         SourceLocationAtFrame loc) override;
@@ -77,6 +81,8 @@ namespace vuk {
 
 		void deallocate_swapchains(std::span<const VkSwapchainKHR> src) override;
 
+		bool track_submission(VkSemaphore timeline_semaphore, uint64_t value) override;
+
 		DeviceResource* upstream = nullptr;
 	};
 } // namespace vuk
\ No newline at end of file
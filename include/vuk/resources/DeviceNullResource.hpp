@@ -0,0 +1,156 @@
+#pragma once
+
+#include "vuk/Allocator.hpp"
+#include "vuk/resources/DeviceTrackingResource.hpp"
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace vuk {
+	/// @brief A call made to a DeviceNullResource
+	struct NullResourceCall {
+		AllocationKind kind;
+		/// @brief true for allocations, false for deallocations
+		bool allocation;
+		/// @brief The (fake) handles allocated or deallocated by the call
+		std::vector<uint64_t> handles;
+		/// @brief The create infos of an allocation, formatted as text (one line per object)
+		std::string arguments;
+		/// @brief Source location of an allocation
+		const char* file = nullptr;
+		uint32_t line = 0;
+		uint64_t absolute_frame = 0;
+	};
+
+	/// @brief Device resource that does not talk to Vulkan, and hands out fake handles instead.
+	///
+	/// Every allocation and deallocation is counted per kind, and can optionally be recorded with its arguments. This makes it possible to exercise and
+	/// measure the CPU side of allocators without a device. Buffers in host visible memory are backed by host memory, so they can be written to. The handles
+	/// must never reach Vulkan.
+	struct DeviceNullResource final : DeviceResource {
+		/// @param ctx Context returned from get_context(), if any. An Allocator over this resource only needs one for the APIs that use the Context.
+		DeviceNullResource(Context* ctx = nullptr);
+
+		Result<void, AllocateException> allocate_semaphores(std::span<VkSemaphore> dst, SourceLocationAtFrame loc) override;
+
+		void deallocate_semaphores(std::span<const VkSemaphore> src) override;
+
+		Result<void, AllocateException> allocate_fences(std::span<VkFence> dst, SourceLocationAtFrame loc) override;
+
+		void deallocate_fences(std::span<const VkFence> src) override;
+
+		Result<void, AllocateException> allocate_events(std::span<VkEvent> dst, SourceLocationAtFrame loc) override;
+
+		void deallocate_events(std::span<const VkEvent> src) override;
+
+		Result<void, AllocateException> allocate_command_buffers(std::span<CommandBufferAllocation> dst,
+		                                                         std::span<const CommandBufferAllocationCreateInfo> cis,
+		                                                         SourceLocationAtFrame loc) override;
+
+		void deallocate_command_buffers(std::span<const CommandBufferAllocation> dst) override;
+
+		Result<void, AllocateException>
+		allocate_command_pools(std::span<CommandPool> dst, std::span<const VkCommandPoolCreateInfo> cis, SourceLocationAtFrame loc) override;
+
+		void deallocate_command_pools(std::span<const CommandPool> src) override;
+
+		Result<void, AllocateException>
+		allocate_buffers(std::span<BufferCrossDevice> dst, std::span<const BufferCreateInfo> cis, SourceLocationAtFrame loc) override;
+
+		void deallocate_buffers(std::span<const BufferCrossDevice> src) override;
+
+		Result<void, AllocateException> allocate_buffers(std::span<BufferGPU> dst, std::span<const BufferCreateInfo> cis, SourceLocationAtFrame loc) override;
+
+		void deallocate_buffers(std::span<const BufferGPU> src) override;
+
+		Result<void, AllocateException>
+		allocate_framebuffers(std::span<VkFramebuffer> dst, std::span<const FramebufferCreateInfo> cis, SourceLocationAtFrame loc) override;
+
+		void deallocate_framebuffers(std::span<const VkFramebuffer> src) override;
+
+		Result<void, AllocateException> allocate_images(std::span<Image> dst, std::span<const ImageCreateInfo> cis, SourceLocationAtFrame loc) override;
+
+		void deallocate_images(std::span<const Image> src) override;
+
+		Result<void, AllocateException>
+		allocate_image_views(std::span<ImageView> dst, std::span<const ImageViewCreateInfo> cis, SourceLocationAtFrame loc) override;
+
+		void deallocate_image_views(std::span<const ImageView> src) override;
+
+		Result<void, AllocateException> allocate_persistent_descriptor_sets(std::span<PersistentDescriptorSet> dst,
+		                                                                    std::span<const PersistentDescriptorSetCreateInfo> cis,
+		                                                                    SourceLocationAtFrame loc) override;
+
+		void deallocate_persistent_descriptor_sets(std::span<const PersistentDescriptorSet> src) override;
+
+		Result<void, AllocateException> allocate_descriptor_sets(std::span<DescriptorSet> dst, std::span<const SetBinding> cis, SourceLocationAtFrame loc) override;
+
+		void deallocate_descriptor_sets(std::span<const DescriptorSet> src) override;
+
+		Result<void, AllocateException>
+		allocate_timestamp_query_pools(std::span<TimestampQueryPool> dst, std::span<const VkQueryPoolCreateInfo> cis, SourceLocationAtFrame loc) override;
+
+		void deallocate_timestamp_query_pools(std::span<const TimestampQueryPool> src) override;
+
+		Result<void, AllocateException>
+		allocate_timestamp_queries(std::span<TimestampQuery> dst, std::span<const TimestampQueryCreateInfo> cis, SourceLocationAtFrame loc) override;
+
+		void deallocate_timestamp_queries(std::span<const TimestampQuery> src) override;
+
+		Result<void, AllocateException> allocate_timeline_semaphores(std::span<TimelineSemaphore> dst, SourceLocationAtFrame loc) override;
+
+		void deallocate_timeline_semaphores(std::span<const TimelineSemaphore> src) override;
+
+		void deallocate_swapchains(std::span<const VkSwapchainKHR> src) override;
+
+		/// @brief Number of objects of a kind allocated so far
+		uint64_t get_allocation_count(AllocationKind kind) const;
+		/// @brief Number of objects of a kind deallocated so far
+		uint64_t get_deallocation_count(AllocationKind kind) const;
+		/// @brief Number of objects of a kind currently allocated
+		uint64_t get_live_count(AllocationKind kind) const;
+		/// @brief Reset all counts to zero
+		void reset_counts();
+
+		/// @brief Start or stop recording calls (recording is off by default, as formatting the arguments has a cost)
+		void set_call_recording(bool enabled);
+		/// @brief Get the calls recorded so far, in the order they were made
+		std::vector<NullResourceCall> get_calls();
+		/// @brief Forget the calls recorded so far
+		void clear_calls();
+
+		/// @brief Get the memory of the buffers allocated from this resource
+		ResourceMemoryStatistics get_memory_statistics() override;
+
+		Context& get_context() override {
+			assert(ctx && "DeviceNullResource was created without a Context");
+			return *ctx;
+		}
+
+		Context* ctx;
+
+	private:
+		static constexpr size_t kind_count = (size_t)AllocationKind::eSwapchain + 1;
+
+		std::atomic<uint64_t> next_handle = 1;
+		std::array<std::atomic<uint64_t>, kind_count> allocation_counts = {};
+		std::array<std::atomic<uint64_t>, kind_count> deallocation_counts = {};
+		std::atomic<uint64_t> allocated_bytes = 0;
+		std::atomic<uint64_t> peak_bytes = 0;
+
+		std::atomic<bool> recording = false;
+		std::mutex calls_lock;
+		std::vector<NullResourceCall> calls;
+
+		template<class T>
+		T make_handle();
+		void count(AllocationKind kind, size_t allocations, size_t deallocations);
+		template<class T, class CI = std::nullptr_t>
+		void record(AllocationKind kind, bool allocation, std::span<T> objects, std::span<const CI> cis = {}, const SourceLocationAtFrame* loc = nullptr);
+		void add_allocated_bytes(uint64_t bytes);
+	};
+} // namespace vuk
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "vuk/resources/DeviceNestedResource.hpp"
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vuk {
+	enum class AllocationKind {
+		eSemaphore,
+		eFence,
+		eEvent,
+		eCommandBuffer,
+		eCommandPool,
+		eBuffer,
+		eFramebuffer,
+		eImage,
+		eImageView,
+		ePersistentDescriptorSet,
+		eDescriptorSet,
+		eTimestampQueryPool,
+		eTimestampQuery,
+		eTimelineSemaphore,
+		eSwapchain
+	};
+
+	std::string_view to_string(AllocationKind kind);
+
+	/// @brief Allocations made from a single source location
+	struct CallSiteStatistics {
+		const char* file;
+		const char* function;
+		uint32_t line;
+		uint32_t column;
+		AllocationKind kind;
+
+		/// @brief Number of allocations that have not been deallocated
+		uint64_t live_count = 0;
+		/// @brief Bytes of the allocations that have not been deallocated (buffers and images only, images are estimated from their create info)
+		uint64_t live_bytes = 0;
+		/// @brief Most live bytes at any point
+		uint64_t peak_live_bytes = 0;
+		/// @brief Number of allocations ever made
+		uint64_t total_count = 0;
+		/// @brief Bytes of the allocations ever made
+		uint64_t total_bytes = 0;
+	};
+
+	/// @brief DeviceResource that records the source location of every allocation made through it, and forwards the allocations upstream
+	///
+	/// Allocations are aggregated per call site, and per call site and frame for the last history_frames frames.
+	/// Allocations that are still live when the resource is destroyed are reported as leaks.
+	/// Tracking takes a lock for every allocation and deallocation, so this is meant to be enabled on demand, by allocating through this resource.
+	///
+	/// Some upstream resources release allocations implicitly, for example a DeviceFrameResource when it is recycled. When tracking those, switch the
+	/// upstream to the new frame and call release_all() to not report the allocations of the previous frame as live.
+	struct DeviceTrackingResource : DeviceNestedResource {
+		/// @param upstream DeviceResource to forward allocations to
+		/// @param history_frames Number of frames per-frame statistics are kept for
+		/// @param leak_report Receives the table of leaked allocations on destruction, if there are any. If not provided, the table is written to stderr.
+		DeviceTrackingResource(DeviceResource* upstream, uint64_t history_frames = 16, std::function<void(std::string_view)> leak_report = {});
+		~DeviceTrackingResource();
+
+		Result<void, AllocateException> allocate_semaphores(std::span<VkSemaphore> dst, SourceLocationAtFrame loc) override;
+
+		void deallocate_semaphores(std::span<const VkSemaphore> src) override;
+
+		Result<void, AllocateException> allocate_fences(std::span<VkFence> dst, SourceLocationAtFrame loc) override;
+
+		void deallocate_fences(std::span<const VkFence> src) override;
+
+		Result<void, AllocateException> allocate_events(std::span<VkEvent> dst, SourceLocationAtFrame loc) override;
+
+		void deallocate_events(std::span<const VkEvent> src) override;
+
+		Result<void, AllocateException> allocate_command_buffers(std::span<CommandBufferAllocation> dst,
+		                                                         std::span<const CommandBufferAllocationCreateInfo> cis,
+		                                                         SourceLocationAtFrame loc) override;
+
+		void deallocate_command_buffers(std::span<const CommandBufferAllocation> src) override;
+
+		Result<void, AllocateException>
+		allocate_command_pools(std::span<CommandPool> dst, std::span<const VkCommandPoolCreateInfo> cis, SourceLocationAtFrame loc) override;
+
+		void deallocate_command_pools(std::span<const CommandPool> src) override;
+
+		Result<void, AllocateException>
+		allocate_buffers(std::span<BufferCrossDevice> dst, std::span<const BufferCreateInfo> cis, SourceLocationAtFrame loc) override;
+
+		void deallocate_buffers(std::span<const BufferCrossDevice> src) override;
+
+		Result<void, AllocateException> allocate_buffers(std::span<BufferGPU> dst, std::span<const BufferCreateInfo> cis, SourceLocationAtFrame loc) override;
+
+		void deallocate_buffers(std::span<const BufferGPU> src) override;
+
+		Result<void, AllocateException>
+		allocate_framebuffers(std::span<VkFramebuffer> dst, std::span<const FramebufferCreateInfo> cis, SourceLocationAtFrame loc) override;
+
+		void deallocate_framebuffers(std::span<const VkFramebuffer> src) override;
+
+		Result<void, AllocateException> allocate_images(std::span<Image> dst, std::span<const ImageCreateInfo> cis, SourceLocationAtFrame loc) override;
+
+		void deallocate_images(std::span<const Image> src) override;
+
+		Result<void, AllocateException>
+		allocate_image_views(std::span<ImageView> dst, std::span<const ImageViewCreateInfo> cis, SourceLocationAtFrame loc) override;
+
+		void deallocate_image_views(std::span<const ImageView> src) override;
+
+		Result<void, AllocateException> allocate_persistent_descriptor_sets(std::span<PersistentDescriptorSet> dst,
+		                                                                    std::span<const PersistentDescriptorSetCreateInfo> cis,
+		                                                                    SourceLocationAtFrame loc) override;
+
+		void deallocate_persistent_descriptor_sets(std::span<const PersistentDescriptorSet> src) override;
+
+		Result<void, AllocateException> allocate_descriptor_sets(std::span<DescriptorSet> dst, std::span<const SetBinding> cis, SourceLocationAtFrame loc) override;
+
+		void deallocate_descriptor_sets(std::span<const DescriptorSet> src) override;
+
+		Result<void, AllocateException>
+		allocate_timestamp_query_pools(std::span<TimestampQueryPool> dst, std::span<const VkQueryPoolCreateInfo> cis, SourceLocationAtFrame loc) override;
+
+		void deallocate_timestamp_query_pools(std::span<const TimestampQueryPool> src) override;
+
+		Result<void, AllocateException>
+		allocate_timestamp_queries(std::span<TimestampQuery> dst, std::span<const TimestampQueryCreateInfo> cis, SourceLocationAtFrame loc) override;
+
+		void deallocate_timestamp_queries(std::span<const TimestampQuery> src) override;
+
+		Result<void, AllocateException> allocate_timeline_semaphores(std::span<TimelineSemaphore> dst, SourceLocationAtFrame loc) override;
+
+		void deallocate_timeline_semaphores(std::span<const TimelineSemaphore> src) override;
+
+		/// @brief Get the statistics of every call site, sorted by live bytes, then by live count
+		std::vector<CallSiteStatistics> get_call_sites();
+
+		/// @brief Get the statistics of the allocations made in a frame, sorted by total bytes, then by total count
+		/// Live counts and bytes refer to the allocations of the frame that are still live. Frames older than history_frames are not available.
+		std::vector<CallSiteStatistics> get_call_sites(uint64_t frame);
+
+		/// @brief Format the statistics of every call site (or of a single frame) as a table
+		std::string dump(std::optional<uint64_t> frame = {});
+
+		/// @brief Consider all live allocations deallocated, without deallocating them
+		void release_all();
+
+	private:
+		struct DeviceTrackingResourceImpl* impl;
+	};
+} // namespace vuk
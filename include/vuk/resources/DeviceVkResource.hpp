@@ -2,6 +2,8 @@
 
 #include "vuk/Allocator.hpp"
 
+#include <atomic>
+
 namespace vuk {
 	/// @brief Device resource that performs direct allocation from the resources from the Vulkan runtime.
 	struct DeviceVkResource final : DeviceResource {
@@ -15,6 +17,10 @@ namespace vuk {
 
 		void deallocate_fences(std::span<const VkFence> src) override;
 
+		Result<void, AllocateException> allocate_events(std::span<VkEvent> dst, SourceLocationAtFrame loc) override;
+
+		void deallocate_events(std::span<const VkEvent> src) override;
+
 		Result<void, AllocateException> allocate_command_buffers(std::span<CommandBufferAllocation> dst,
 		                                                         std::span<const CommandBufferAllocationCreateInfo> cis,
 		                                                         SourceLocationAtFrame loc) override;
@@ -75,6 +81,9 @@ namespace vuk {
 
 		void deallocate_swapchains(std::span<const VkSwapchainKHR> src) override;
 
+		/// @brief Get the memory of the buffers and images allocated from this resource
+		ResourceMemoryStatistics get_memory_statistics() override;
+
 		Context& get_context() override {
 			return *ctx;
 		}
@@ -82,5 +91,11 @@ namespace vuk {
 		Context* ctx;
 		LegacyGPUAllocator* legacy_gpu_allocator;
 		VkDevice device;
+
+	private:
+		std::atomic<uint64_t> allocated_bytes = 0;
+		std::atomic<uint64_t> peak_bytes = 0;
+
+		void add_allocated_bytes(uint64_t bytes);
 	};
 } // namespace vuk
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "vuk/Context.hpp"
 #include "vuk/Exception.hpp"
 #include "vuk/Query.hpp"
+#include "vuk/Tracing.hpp"
 #include "vuk/resources/DeviceFrameResource.hpp"
 #include "vuk/resources/DeviceVkResource.hpp"
 
@@ -38,6 +39,18 @@ namespace vuk {
 		device_resource->deallocate_fences(src);
 	}
 
+	Result<void, AllocateException> Allocator::allocate(std::span<VkEvent> dst, SourceLocationAtFrame loc) {
+		return device_resource->allocate_events(dst, loc);
+	}
+
+	Result<void, AllocateException> Allocator::allocate_events(std::span<VkEvent> dst, SourceLocationAtFrame loc) {
+		return device_resource->allocate_events(dst, loc);
+	}
+
+	void Allocator::deallocate(std::span<const VkEvent> src) {
+		device_resource->deallocate_events(src);
+	}
+
 	Result<void, AllocateException> Allocator::allocate(std::span<CommandPool> dst, std::span<const VkCommandPoolCreateInfo> cis, SourceLocationAtFrame loc) {
 		return device_resource->allocate_command_pools(dst, cis, loc);
 	}
@@ -196,6 +209,10 @@ namespace vuk {
 		device_resource->deallocate_timeline_semaphores(src);
 	}
 
+	bool Allocator::track_submission(VkSemaphore timeline_semaphore, uint64_t value) {
+		return device_resource->track_submission(timeline_semaphore, value);
+	}
+
 	PFN_vmaAllocateDeviceMemoryFunction LegacyGPUAllocator::real_alloc_callback = nullptr;
 
 	std::string to_string(BufferUsageFlags value) {
@@ -297,13 +314,18 @@ namespace vuk {
 	                                       VkPhysicalDevice phys_dev,
 	                                       uint32_t graphics_queue_family,
 	                                       uint32_t compute_queue_family,
-	                                       uint32_t transfer_queue_family) :
+	                                       uint32_t transfer_queue_family,
+	                                       bool memory_budget,
+	                                       bool exclusive_buffers) :
 	    device(device) {
 		VmaAllocatorCreateInfo allocatorInfo = {};
 		allocatorInfo.instance = instance;
 		allocatorInfo.physicalDevice = phys_dev;
 		allocatorInfo.device = device;
 		allocatorInfo.flags = VMA_ALLOCATOR_CREATE_EXTERNALLY_SYNCHRONIZED_BIT;
+		if (memory_budget) {
+			allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+		}
 
 		VmaVulkanFunctions vulkanFunctions = {};
 		vulkanFunctions.vkGetPhysicalDeviceProperties = vkGetPhysicalDeviceProperties;
@@ -323,6 +345,9 @@ namespace vuk {
 		vulkanFunctions.vkCreateImage = vkCreateImage;
 		vulkanFunctions.vkDestroyImage = vkDestroyImage;
 		vulkanFunctions.vkCmdCopyBuffer = vkCmdCopyBuffer;
+#if VMA_MEMORY_BUDGET
+		vulkanFunctions.vkGetPhysicalDeviceMemoryProperties2KHR = vkGetPhysicalDeviceMemoryProperties2;
+#endif
 		allocatorInfo.pVulkanFunctions = &vulkanFunctions;
 
 		VmaDeviceMemoryCallbacks cbs;
@@ -349,6 +374,7 @@ namespace vuk {
 			all_queue_families = { graphics_queue_family };
 		}
 		queue_family_count = (uint32_t)all_queue_families.size();
+		buffer_sharing_mode = queue_family_count > 1 && !exclusive_buffers ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
 	}
 
 	// not locked, must be called from a locked fn
@@ -359,7 +385,7 @@ namespace vuk {
 		bci.size = 1024; // Whatever.
 		bci.usage = (VkBufferUsageFlags)buffer_usage;
 		bci.queueFamilyIndexCount = queue_family_count;
-		bci.sharingMode = bci.queueFamilyIndexCount > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+		bci.sharingMode = buffer_sharing_mode;
 		bci.pQueueFamilyIndices = all_queue_families.data();
 
 		VmaAllocationCreateInfo allocCreateInfo = {};
@@ -391,7 +417,64 @@ namespace vuk {
 		return (val + align - 1) / align * align;
 	}
 
-	// lock-free bump allocation if there is still space
+	namespace {
+		// a range of a linear allocator block owned by a single thread
+		struct ThreadChunk {
+			uint64_t epoch = 0;
+			LegacyLinearAllocator::Block block;
+			size_t needle;
+			size_t end;
+		};
+		// threads typically record into a handful of linear allocators at a time
+		thread_local std::array<ThreadChunk, 16> thread_chunks;
+		thread_local size_t thread_chunk_victim = 0;
+	} // namespace
+
+	LegacyLinearAllocator::Block LegacyGPUAllocator::_create_linear_block(LegacyLinearAllocator& pool, size_t size, bool create_mapped) {
+		VUK_TRACE_ZONE("vuk::LegacyGPUAllocator::create_linear_block");
+		VkBufferCreateInfo bci{ .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+		bci.size = size;
+		bci.usage = (VkBufferUsageFlags)pool.usage;
+		bci.queueFamilyIndexCount = queue_family_count;
+		bci.sharingMode = buffer_sharing_mode;
+		bci.pQueueFamilyIndices = all_queue_families.data();
+
+		VmaAllocationCreateInfo vaci = {};
+		if (create_mapped)
+			vaci.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+		vaci.usage = pool.mem_usage;
+
+		VmaAllocation res;
+		VmaAllocationInfo vai;
+		VkBuffer vkbuffer;
+
+		std::lock_guard _(mutex);
+		auto result = vmaCreateBuffer(allocator, &bci, &vaci, &vkbuffer, &res, &vai);
+		assert(result == VK_SUCCESS);
+		return { res, vai.deviceMemory, vkbuffer, (std::byte*)vai.pMappedData, size };
+	}
+
+	std::pair<LegacyLinearAllocator::Block, size_t>
+	LegacyGPUAllocator::_carve(LegacyLinearAllocator& pool, size_t size, size_t alignment, bool create_mapped) {
+		assert(size <= pool.block_size);
+		while (true) {
+			if (pool.current_block < pool.blocks.size()) {
+				auto offset = VmaAlignUp(pool.needle, alignment);
+				if (offset + size <= pool.block_size) {
+					pool.needle = offset + size;
+					return { pool.blocks[pool.current_block], offset };
+				}
+				// the rest of this block is wasted, move to the next one
+				pool.current_block++;
+				pool.needle = 0;
+			}
+			if (pool.current_block == pool.blocks.size()) {
+				pool.blocks.push_back(_create_linear_block(pool, pool.block_size, create_mapped));
+			}
+		}
+	}
+
+	// small allocations are bump allocated from a chunk owned by the calling thread, so only refilling the chunk synchronizes
 	Buffer LegacyGPUAllocator::_allocate_buffer(LegacyLinearAllocator& pool, size_t size, size_t alignment, bool create_mapped) {
 		if (size == 0) {
 			return { .buffer = VK_NULL_HANDLE, .size = 0 };
@@ -404,64 +487,53 @@ namespace vuk {
 			alignment = std::lcm(alignment, properties.limits.minStorageBufferOffsetAlignment);
 		}
 
-		if ((size + alignment) > pool.block_size) {
-			// we are not handling sizes bigger than the block_size
-			// we could allocate a buffer that is multiple block_sizes big
-			// and fake the entries, but for now this is too much complexity
-			return allocate_buffer((vuk::MemoryUsage)pool.mem_usage, pool.usage, size, alignment, create_mapped);
-		}
-
-		auto new_needle = pool.needle.fetch_add(size + alignment) + size + alignment;
-		auto base_addr = new_needle - size - alignment;
-
-		size_t buffer = new_needle / pool.block_size;
-		bool needs_to_create = base_addr == 0 || (base_addr / pool.block_size != new_needle / pool.block_size);
-		if (needs_to_create) {
-			VkBufferCreateInfo bci{ .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
-			bci.size = pool.block_size;
-			bci.usage = (VkBufferUsageFlags)pool.usage;
-			bci.queueFamilyIndexCount = queue_family_count;
-			bci.sharingMode = bci.queueFamilyIndexCount > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
-			bci.pQueueFamilyIndices = all_queue_families.data();
-
-			VmaAllocationCreateInfo vaci = {};
-			if (create_mapped)
-				vaci.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
-			vaci.usage = pool.mem_usage;
-
-			VmaAllocation res;
-			VmaAllocationInfo vai;
-
-			auto mem_reqs = pool.mem_reqs;
-			mem_reqs.size = size;
-			VkBuffer vkbuffer;
-
-			auto next_index = pool.current_buffer.load() + 1;
-			if (std::get<VkBuffer>(pool.allocations[next_index]) == VK_NULL_HANDLE) {
-				std::lock_guard _(mutex);
-				auto result = vmaCreateBuffer(allocator, &bci, &vaci, &vkbuffer, &res, &vai);
-				assert(result == VK_SUCCESS);
-				pool.allocations[next_index] = std::tuple(res, vai.deviceMemory, vai.offset, vkbuffer, (std::byte*)vai.pMappedData);
-				buffers.emplace(reinterpret_cast<uint64_t>(vai.deviceMemory), std::pair(vkbuffer, bci.size));
+		LegacyLinearAllocator::Block block;
+		size_t offset;
+		size_t allocation_size = pool.block_size;
+		if (size > pool.block_size) {
+			// too big for a block: give it a dedicated buffer that lives until the pool is reset
+			block = _create_linear_block(pool, size, create_mapped);
+			offset = 0;
+			allocation_size = size;
+			std::lock_guard _(pool.lock);
+			pool.dedicated.push_back(block);
+		} else if (size + alignment > pool.chunk_size / 4) {
+			// medium allocations would waste most of a thread chunk, carve them from the block directly
+			std::lock_guard _(pool.lock);
+			std::tie(block, offset) = _carve(pool, size, alignment, create_mapped);
+		} else {
+			auto epoch = pool.epoch.load(std::memory_order_acquire);
+			ThreadChunk* chunk = nullptr;
+			for (auto& tc : thread_chunks) {
+				if (tc.epoch == epoch) {
+					chunk = &tc;
+					break;
+				}
+			}
+			if (!chunk) {
+				chunk = &thread_chunks[thread_chunk_victim++ % thread_chunks.size()];
+				chunk->epoch = 0;
 			}
-			pool.current_buffer++;
-			if (base_addr > 0) {
-				// there is no space in the beginning of this allocation, so we just retry
-				return _allocate_buffer(pool, size, alignment, create_mapped);
+			offset = VmaAlignUp(chunk->needle, alignment);
+			if (chunk->epoch != epoch || offset + size > chunk->end) {
+				std::lock_guard _(pool.lock);
+				auto [chunk_block, chunk_offset] = _carve(pool, pool.chunk_size, alignment, create_mapped);
+				*chunk = ThreadChunk{ epoch, chunk_block, chunk_offset, chunk_offset + pool.chunk_size };
+				offset = chunk_offset;
 			}
+			chunk->needle = offset + size;
+			block = chunk->block;
 		}
-		// wait for the buffer to be allocated
-		while (pool.current_buffer.load() < buffer) {
-		};
-		auto offset = VmaAlignDown(new_needle - size, alignment) % pool.block_size;
-		auto& current_alloc = pool.allocations[buffer];
+		assert(offset % alignment == 0);
+		assert(offset + size <= block.size);
+
 		Buffer b;
-		b.buffer = std::get<VkBuffer>(current_alloc);
-		b.device_memory = std::get<VkDeviceMemory>(current_alloc);
+		b.buffer = block.buffer;
+		b.device_memory = block.device_memory;
 		b.offset = offset;
 		b.size = size;
-		b.mapped_ptr = std::get<std::byte*>(current_alloc) != nullptr ? std::get<std::byte*>(current_alloc) + offset : nullptr;
-		b.allocation_size = pool.block_size;
+		b.mapped_ptr = block.mapped_ptr != nullptr ? block.mapped_ptr + offset : nullptr;
+		b.allocation_size = allocation_size;
 
 		return b;
 	}
@@ -474,7 +546,7 @@ namespace vuk {
 		bci.size = 1024; // ignored
 		bci.usage = (VkBufferUsageFlags)pool.usage;
 		bci.queueFamilyIndexCount = queue_family_count;
-		bci.sharingMode = bci.queueFamilyIndexCount > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+		bci.sharingMode = buffer_sharing_mode;
 		bci.pQueueFamilyIndices = all_queue_families.data();
 
 		VmaAllocationCreateInfo vaci = {};
@@ -530,7 +602,7 @@ namespace vuk {
 		bci.size = 1024; // ignored
 		bci.usage = (VkBufferUsageFlags)buffer_usage;
 		bci.queueFamilyIndexCount = queue_family_count;
-		bci.sharingMode = bci.queueFamilyIndexCount > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+		bci.sharingMode = buffer_sharing_mode;
 		bci.pQueueFamilyIndices = all_queue_families.data();
 
 		LegacyPoolAllocator pi;
@@ -547,7 +619,7 @@ namespace vuk {
 		bci.size = 1024; // ignored
 		bci.usage = (VkBufferUsageFlags)buffer_usage;
 		bci.queueFamilyIndexCount = queue_family_count;
-		bci.sharingMode = bci.queueFamilyIndexCount > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+		bci.sharingMode = buffer_sharing_mode;
 		bci.pQueueFamilyIndices = all_queue_families.data();
 
 		return LegacyLinearAllocator{ get_memory_requirements(bci), VmaMemoryUsage(to_integral(mem_usage)), buffer_usage };
@@ -561,7 +633,7 @@ namespace vuk {
 		bci.size = 1024; // ignored
 		bci.usage = (VkBufferUsageFlags)buffer_usage;
 		bci.queueFamilyIndexCount = queue_family_count;
-		bci.sharingMode = bci.queueFamilyIndexCount > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+		bci.sharingMode = buffer_sharing_mode;
 		bci.pQueueFamilyIndices = all_queue_families.data();
 
 		auto pool_it = pools.find(PoolSelect{ mem_usage, buffer_usage });
@@ -592,15 +664,73 @@ namespace vuk {
 		return b.allocation_size;
 	}
 
+	size_t LegacyGPUAllocator::get_allocation_size(vuk::Image image) {
+		std::lock_guard _(mutex);
+		VmaAllocationInfo vai;
+		vmaGetAllocationInfo(allocator, images.at(reinterpret_cast<uint64_t>((VkImage)image)), &vai);
+		return vai.size;
+	}
+
+	size_t LegacyGPUAllocator::get_footprint(LegacyLinearAllocator& pool) {
+		std::lock_guard _(pool.lock);
+		size_t size = 0;
+		for (auto& block : pool.blocks) {
+			size += block.size;
+		}
+		for (auto& block : pool.dedicated) {
+			size += block.size;
+		}
+		return size;
+	}
+
+	std::vector<HeapStatistics> LegacyGPUAllocator::get_heap_statistics() {
+		const VkPhysicalDeviceMemoryProperties* memory_properties;
+		std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets;
+		{
+			std::lock_guard _(mutex);
+			vmaGetMemoryProperties(allocator, &memory_properties);
+			vmaGetHeapBudgets(allocator, budgets.data());
+		}
+		std::vector<HeapStatistics> heaps(memory_properties->memoryHeapCount);
+		for (uint32_t i = 0; i < memory_properties->memoryHeapCount; i++) {
+			auto& heap = memory_properties->memoryHeaps[i];
+			heaps[i].size = heap.size;
+			heaps[i].device_local = heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+			heaps[i].budget = budgets[i].budget;
+			heaps[i].usage = budgets[i].usage;
+			heaps[i].block_bytes = budgets[i].statistics.blockBytes;
+			heaps[i].allocation_bytes = budgets[i].statistics.allocationBytes;
+		}
+		return heaps;
+	}
+
 	void LegacyGPUAllocator::reset_pool(LegacyPoolAllocator& pool) {
 		std::lock_guard _(mutex);
 		vmaResetPool(allocator, pool.pool);
 	}
 
 	void LegacyGPUAllocator::reset_pool(LegacyLinearAllocator& pool) {
+		// same order as in allocation: pool lock, then the allocator lock
+		std::lock_guard pool_lock(pool.lock);
 		std::lock_guard _(mutex);
-		pool.current_buffer = -1;
+		pool.current_block = 0;
 		pool.needle = 0;
+		pool.epoch.store(LegacyLinearAllocator::epoch_counter++, std::memory_order_release);
+		for (auto& d : pool.dedicated) {
+			vmaDestroyBuffer(allocator, d.buffer, d.allocation);
+		}
+		pool.dedicated.clear();
+	}
+
+	void LegacyGPUAllocator::trim(LegacyLinearAllocator& pool) {
+		std::lock_guard pool_lock(pool.lock);
+		std::lock_guard _(mutex);
+		// the current block is kept, even if it is unused
+		while (pool.blocks.size() > pool.current_block + 1) {
+			auto& block = pool.blocks.back();
+			vmaDestroyBuffer(allocator, block.buffer, block.allocation);
+			pool.blocks.pop_back();
+		}
 	}
 
 	void LegacyGPUAllocator::free_buffer(const Buffer& b) {
@@ -610,6 +740,12 @@ namespace vuk {
 		buffer_allocations.erase(bufid);
 	}
 
+	void LegacyGPUAllocator::flush_buffer(const Buffer& b, size_t offset, size_t size) {
+		std::lock_guard _(mutex);
+		vuk::BufferID bufid{ reinterpret_cast<uint64_t>(b.buffer), b.offset };
+		vmaFlushAllocation(allocator, buffer_allocations.at(bufid), offset, size);
+	}
+
 	void LegacyGPUAllocator::destroy(const LegacyPoolAllocator& pool) {
 		std::lock_guard _(mutex);
 		vmaResetPool(allocator, pool.pool);
@@ -622,8 +758,11 @@ namespace vuk {
 
 	void LegacyGPUAllocator::destroy(const LegacyLinearAllocator& pool) {
 		std::lock_guard _(mutex);
-		for (auto& [va, mem, offset, buffer, map] : pool.allocations) {
-			vmaDestroyBuffer(allocator, buffer, va);
+		for (auto& block : pool.blocks) {
+			vmaDestroyBuffer(allocator, block.buffer, block.allocation);
+		}
+		for (auto& block : pool.dedicated) {
+			vmaDestroyBuffer(allocator, block.buffer, block.allocation);
 		}
 	}
 
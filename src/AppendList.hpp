@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <span>
+
+namespace vuk {
+	/// @brief Append-only list that multiple threads can push into without locking
+	///
+	/// Elements are stored in a chain of fixed size chunks. Pushing reserves a range in the current chunk with an atomic add, and moves on to the next chunk
+	/// when the current one is full. Chunks are only freed on destruction, clear() keeps them for reuse, so after warming up pushing does not allocate.
+	/// Reading the elements and clear() must not happen concurrently with push().
+	template<class T, size_t ChunkSize = 64>
+	class AppendList {
+		struct Chunk {
+			std::atomic<size_t> reserved = 0; // may go past ChunkSize, when pushes overflow into the next chunk
+			std::atomic<Chunk*> next = nullptr;
+			T items[ChunkSize];
+		};
+
+	public:
+		AppendList() : first(new Chunk), current(first) {}
+		AppendList(const AppendList&) = delete;
+		AppendList& operator=(const AppendList&) = delete;
+
+		~AppendList() {
+			for (Chunk* c = first; c;) {
+				Chunk* next = c->next.load(std::memory_order_relaxed);
+				delete c;
+				c = next;
+			}
+		}
+
+		void push(std::span<const T> src) {
+			while (!src.empty()) {
+				Chunk* c = current.load(std::memory_order_acquire);
+				size_t start = c->reserved.fetch_add(src.size(), std::memory_order_relaxed);
+				if (start < ChunkSize) {
+					size_t count = std::min(src.size(), ChunkSize - start);
+					std::copy(src.begin(), src.begin() + count, c->items + start);
+					src = src.subspan(count);
+				}
+				if (!src.empty()) {
+					advance(c);
+				}
+			}
+		}
+
+		void push(const T& value) {
+			push(std::span{ &value, 1 });
+		}
+
+		/// @brief Call f with a span of elements for every non-empty chunk
+		template<class F>
+		void for_each_chunk(F&& f) {
+			for (Chunk* c = first; c; c = c->next.load(std::memory_order_acquire)) {
+				size_t count = std::min(c->reserved.load(std::memory_order_acquire), ChunkSize);
+				if (count == 0) {
+					break;
+				}
+				f(std::span<T>(c->items, count));
+			}
+		}
+
+		size_t size() {
+			size_t size = 0;
+			for_each_chunk([&](std::span<T> items) { size += items.size(); });
+			return size;
+		}
+
+		bool empty() {
+			return first->reserved.load(std::memory_order_acquire) == 0;
+		}
+
+		void clear() {
+			for (Chunk* c = first; c; c = c->next.load(std::memory_order_relaxed)) {
+				c->reserved.store(0, std::memory_order_relaxed);
+			}
+			current.store(first, std::memory_order_release);
+		}
+
+	private:
+		Chunk* first;
+		std::atomic<Chunk*> current;
+
+		// move current past the full chunk c, linking in a new chunk if there is no spare one
+		void advance(Chunk* c) {
+			Chunk* next = c->next.load(std::memory_order_acquire);
+			if (!next) {
+				Chunk* fresh = new Chunk;
+				if (c->next.compare_exchange_strong(next, fresh, std::memory_order_acq_rel)) {
+					next = fresh;
+				} else { // another thread linked one in first
+					delete fresh;
+				}
+			}
+			current.compare_exchange_strong(c, next, std::memory_order_acq_rel);
+		}
+	};
+} // namespace vuk
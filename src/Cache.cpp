@@ -2,7 +2,9 @@
 #include "LegacyGPUAllocator.hpp"
 #include "vuk/Context.hpp"
 #include "vuk/PipelineInstance.hpp"
+#include "vuk/Tracing.hpp"
 
+#include <algorithm>
 #include <plf_colony.h>
 #include <robin_hood.h>
 #include <shared_mutex>
@@ -10,11 +12,45 @@
 namespace vuk {
 	template<class T>
 	struct CacheImpl {
+		using map_t = robin_hood::unordered_node_map<create_info_t<T>, typename Cache<T>::LRUEntry>;
+
 		plf::colony<T> pool;
-		robin_hood::unordered_node_map<create_info_t<T>, typename Cache<T>::LRUEntry> lru_map;
+		map_t lru_map;
 		std::shared_mutex cache_mtx;
+
+		CacheCollectionPolicy policy;
+		uint64_t footprint = 0;
+		// key of the next entry collect inspects - nodes don't move on rehashing, so this stays valid until that entry is erased,
+		// which advances the cursor (nullptr = start from the beginning)
+		const create_info_t<T>* cursor = nullptr;
+
+		// remove the entry from the map, moving the cursor off it - the cache lock must be held
+		typename map_t::iterator erase(typename map_t::iterator it) {
+			bool at_cursor = &it->first == cursor;
+			auto next = lru_map.erase(it);
+			if (at_cursor) {
+				cursor = next == lru_map.end() ? nullptr : &next->first;
+			}
+			return next;
+		}
 	};
 
+	// entries pinned with this value are never collected
+	static constexpr size_t pinned_frame = INT64_MAX;
+
+	template<class T>
+	uint64_t estimate_footprint(const create_info_t<T>& ci) {
+		if constexpr (std::is_same_v<T, RGImage>) {
+			auto& ici = ci.ici;
+			uint64_t texels = (uint64_t)ici.extent.width * ici.extent.height * ici.extent.depth * ici.arrayLayers * (uint64_t)ici.samples;
+			uint64_t size = texels * format_to_texel_block_size(ici.format);
+			// a full mip chain adds about a third
+			return ici.mipLevels > 1 ? size + size / 3 : size;
+		} else {
+			return 0;
+		}
+	}
+
 	template<class T>
 	Cache<T>::Cache(Context& ctx) : ctx(ctx), impl(new CacheImpl<T>()) {}
 
@@ -29,27 +65,125 @@ namespace vuk {
 	T& Cache<T>::acquire(const create_info_t<T>& ci, uint64_t current_frame) {
 		std::shared_lock _(impl->cache_mtx);
 		if (auto it = impl->lru_map.find(ci); it != impl->lru_map.end()) {
-			it->second.last_use_frame = current_frame;
+			if (it->second.last_use_frame < current_frame) { // don't unpin
+				it->second.last_use_frame = current_frame;
+			}
 			return *it->second.ptr;
 		} else {
 			_.unlock();
+			VUK_TRACE_ZONE("vuk::Cache::acquire miss");
 			std::unique_lock ulock(impl->cache_mtx);
 			auto pit = impl->pool.emplace(ctx.create(ci));
 			typename Cache::LRUEntry entry{ &*pit, current_frame };
 			it = impl->lru_map.emplace(ci, entry).first;
+			impl->footprint += estimate_footprint<T>(ci);
 			return *it->second.ptr;
 		}
 	}
 
 	template<class T>
-	void Cache<T>::collect(uint64_t current_frame, size_t threshold) {
+	void Cache<T>::set_collection_policy(const CacheCollectionPolicy& policy) {
 		std::unique_lock _(impl->cache_mtx);
-		for (auto it = impl->lru_map.begin(); it != impl->lru_map.end();) {
-			auto last_use_frame = it->second.last_use_frame;
-			if ((int64_t)current_frame - (int64_t)last_use_frame > (int64_t)threshold) {
-				ctx.destroy(*it->second.ptr);
-				impl->pool.erase(impl->pool.get_iterator(it->second.ptr));
-				it = impl->lru_map.erase(it);
+		impl->policy = policy;
+	}
+
+	template<class T>
+	uint64_t Cache<T>::get_footprint() {
+		std::shared_lock _(impl->cache_mtx);
+		return impl->footprint;
+	}
+
+	// destroy the object of an entry and remove the entry - the cache lock must be held
+	template<class T>
+	typename CacheImpl<T>::map_t::iterator erase_entry(Context& ctx, CacheImpl<T>& impl, typename CacheImpl<T>::map_t::iterator it) {
+		ctx.destroy(*it->second.ptr);
+		if constexpr (std::is_same_v<T, PipelineInfo>) {
+			if (!it->first.is_inline()) {
+				delete[] it->first.extended_data;
+			}
+		}
+		impl.footprint -= estimate_footprint<T>(it->first);
+		impl.pool.erase(impl.pool.get_iterator(it->second.ptr));
+		return impl.erase(it);
+	}
+
+	template<class T>
+	void Cache<T>::collect(uint64_t current_frame, const std::function<bool(const T&)>& is_referenced) {
+		auto start = std::chrono::steady_clock::now();
+		std::unique_lock _(impl->cache_mtx);
+		auto& map = impl->lru_map;
+		auto& policy = impl->policy;
+		if (map.empty()) {
+			return;
+		}
+
+		auto erase = [&](typename CacheImpl<T>::map_t::iterator it) {
+			return erase_entry(ctx, *impl, it);
+		};
+		auto unused_for = [&](const LRUEntry& entry, size_t threshold) {
+			return (int64_t)current_frame - (int64_t)entry.last_use_frame > (int64_t)threshold;
+		};
+
+		// continue where the previous collection stopped
+		auto it = map.begin();
+		if (impl->cursor) {
+			it = map.find(*impl->cursor);
+			assert(it != map.end());
+		}
+
+		bool over_memory_budget = policy.memory_budget > 0 && impl->footprint > policy.memory_budget;
+		std::vector<std::pair<uint64_t, create_info_t<T>>> memory_candidates;
+
+		size_t to_inspect = policy.entries_per_collect == 0 ? map.size() : std::min(policy.entries_per_collect, map.size());
+		for (size_t inspected = 0; inspected < to_inspect; inspected++) {
+			if (it == map.end()) {
+				if (map.empty()) {
+					break;
+				}
+				it = map.begin();
+			}
+			// checking the clock has a cost too, so only do it periodically
+			if (policy.time_budget.count() > 0 && inspected % 16 == 15 && std::chrono::steady_clock::now() - start > policy.time_budget) {
+				break;
+			}
+
+			auto& entry = it->second;
+			// entries that are still being created have no object yet
+			bool keep = entry.ptr == nullptr || (is_referenced && is_referenced(*entry.ptr));
+			if (!keep && unused_for(entry, policy.threshold)) {
+				it = erase(it);
+				continue;
+			}
+			if (!keep && over_memory_budget && unused_for(entry, policy.min_threshold)) {
+				memory_candidates.emplace_back(estimate_footprint<T>(it->first), it->first);
+			}
+			++it;
+		}
+		impl->cursor = it == map.end() ? nullptr : &it->first;
+
+		// evict largest first, until we are within budget
+		// only the entries inspected by this collection are ranked, so with entries_per_collect or time_budget set the largest entries of the window
+		// are evicted rather than the largest in the cache - successive collections walk the whole cache
+		std::sort(memory_candidates.begin(), memory_candidates.end(), [](auto& a, auto& b) { return a.first > b.first; });
+		for (auto& [size, ci] : memory_candidates) {
+			if (impl->footprint <= policy.memory_budget) {
+				break;
+			}
+			if (auto cit = map.find(ci); cit != map.end()) {
+				erase(cit);
+			}
+		}
+	}
+
+	template<class T>
+	void Cache<T>::trim(uint64_t current_frame) {
+		std::unique_lock _(impl->cache_mtx);
+		auto& map = impl->lru_map;
+		for (auto it = map.begin(); it != map.end();) {
+			auto& entry = it->second;
+			// pinned entries have a last use in the future
+			if (entry.ptr != nullptr && (int64_t)current_frame - (int64_t)entry.last_use_frame > (int64_t)impl->policy.min_threshold) {
+				it = erase_entry(ctx, *impl, it);
 			} else {
 				++it;
 			}
@@ -66,8 +200,9 @@ namespace vuk {
 			return *it->second.ptr;
 		} else {
 			_.unlock();
+			VUK_TRACE_ZONE("vuk::Cache::acquire miss");
 			std::unique_lock ulock(impl->cache_mtx);
-			typename Cache::LRUEntry entry{ nullptr, INT64_MAX };
+			typename Cache::LRUEntry entry{ nullptr, pinned_frame };
 			it = impl->lru_map.emplace(ci, entry).first;
 			ulock.unlock();
 			auto pit = impl->pool.emplace(ctx.create(ci));
@@ -81,12 +216,32 @@ namespace vuk {
 	PipelineBaseInfo& Cache<PipelineBaseInfo>::acquire(const create_info_t<PipelineBaseInfo>& ci) {
 		std::shared_lock _(impl->cache_mtx);
 		if (auto it = impl->lru_map.find(ci); it != impl->lru_map.end()) {
+			// the pointer is handed out, so it must stay alive
+			it->second.last_use_frame = pinned_frame;
+			return *it->second.ptr;
+		} else {
+			_.unlock();
+			VUK_TRACE_ZONE("vuk::Cache::acquire miss");
+			std::unique_lock ulock(impl->cache_mtx);
+			auto pit = impl->pool.emplace(ctx.create(ci));
+			typename Cache::LRUEntry entry{ &*pit, pinned_frame };
+			it = impl->lru_map.emplace(ci, entry).first;
+			return *it->second.ptr;
+		}
+	}
+
+	template<>
+	Sampler& Cache<Sampler>::acquire(const create_info_t<Sampler>& ci) {
+		std::shared_lock _(impl->cache_mtx);
+		if (auto it = impl->lru_map.find(ci); it != impl->lru_map.end()) {
+			it->second.last_use_frame = pinned_frame;
 			return *it->second.ptr;
 		} else {
 			_.unlock();
+			VUK_TRACE_ZONE("vuk::Cache::acquire miss");
 			std::unique_lock ulock(impl->cache_mtx);
 			auto pit = impl->pool.emplace(ctx.create(ci));
-			typename Cache::LRUEntry entry{ &*pit, INT64_MAX };
+			typename Cache::LRUEntry entry{ &*pit, pinned_frame };
 			it = impl->lru_map.emplace(ci, entry).first;
 			return *it->second.ptr;
 		}
@@ -99,9 +254,10 @@ namespace vuk {
 			return *it->second.ptr;
 		} else {
 			_.unlock();
+			VUK_TRACE_ZONE("vuk::Cache::acquire miss");
 			std::unique_lock ulock(impl->cache_mtx);
 			auto pit = impl->pool.emplace(ctx.create(ci));
-			typename Cache::LRUEntry entry{ &*pit, INT64_MAX };
+			typename Cache::LRUEntry entry{ &*pit, pinned_frame };
 			it = impl->lru_map.emplace(ci, entry).first;
 			return *it->second.ptr;
 		}
@@ -114,9 +270,10 @@ namespace vuk {
 			return *it->second.ptr;
 		} else {
 			_.unlock();
+			VUK_TRACE_ZONE("vuk::Cache::acquire miss");
 			std::unique_lock ulock(impl->cache_mtx);
 			auto pit = impl->pool.emplace(ctx.create(ci));
-			typename Cache::LRUEntry entry{ &*pit, INT64_MAX };
+			typename Cache::LRUEntry entry{ &*pit, pinned_frame };
 			it = impl->lru_map.emplace(ci, entry).first;
 			return *it->second.ptr;
 		}
@@ -126,13 +283,16 @@ namespace vuk {
 	PipelineInfo& Cache<PipelineInfo>::acquire(const create_info_t<PipelineInfo>& ci, uint64_t current_frame) {
 		std::shared_lock _(impl->cache_mtx);
 		if (auto it = impl->lru_map.find(ci); it != impl->lru_map.end()) {
-			it->second.last_use_frame = current_frame;
+			if (it->second.last_use_frame < current_frame) {
+				it->second.last_use_frame = current_frame;
+			}
 			if (it->second.load_cnt.load(std::memory_order_relaxed) == 0) { // perform a relaxed load to skip the atomic_wait path
 				std::atomic_wait(&it->second.load_cnt, 0);
 			}
 			return *it->second.ptr;
 		} else {
 			_.unlock();
+			VUK_TRACE_ZONE("vuk::Cache::acquire miss");
 			auto ci_copy = ci;
 			if (!ci_copy.is_inline()) {
 				ci_copy.extended_data = new std::byte[ci_copy.extended_size];
@@ -149,32 +309,15 @@ namespace vuk {
 		}
 	}
 
-	template<>
-	void Cache<PipelineInfo>::collect(uint64_t current_frame, size_t threshold) {
-		std::unique_lock _(impl->cache_mtx);
-		for (auto it = impl->lru_map.begin(); it != impl->lru_map.end();) {
-			auto last_use_frame = it->second.last_use_frame;
-			if ((int64_t)current_frame - (int64_t)last_use_frame > (int64_t)threshold) {
-				ctx.destroy(*it->second.ptr);
-				if (!it->first.is_inline()) {
-					delete it->first.extended_data;
-				}
-				impl->pool.erase(impl->pool.get_iterator(it->second.ptr));
-				it = impl->lru_map.erase(it);
-			} else {
-				++it;
-			}
-		}
-	}
-
 	template<class T>
 	std::optional<T> Cache<T>::remove(const create_info_t<T>& ci) {
 		std::unique_lock _(impl->cache_mtx);
 		auto it = impl->lru_map.find(ci);
 		if (it != impl->lru_map.end()) {
 			auto res = std::move(*it->second.ptr);
+			impl->footprint -= estimate_footprint<T>(it->first);
 			impl->pool.erase(impl->pool.get_iterator(it->second.ptr));
-			impl->lru_map.erase(it);
+			impl->erase(it);
 			return res;
 		}
 		return {};
@@ -185,13 +328,22 @@ namespace vuk {
 		std::unique_lock _(impl->cache_mtx);
 		for (auto it = impl->lru_map.begin(); it != impl->lru_map.end(); ++it) {
 			if (ptr == it->second.ptr) {
+				impl->footprint -= estimate_footprint<T>(it->first);
 				impl->pool.erase(impl->pool.get_iterator(it->second.ptr));
-				impl->lru_map.erase(it);
+				impl->erase(it);
 				return;
 			}
 		}
 	}
 
+	template<class T>
+	void Cache<T>::for_each(const std::function<void(T&)>& fn) {
+		std::unique_lock _(impl->cache_mtx);
+		for (auto& v : impl->pool) {
+			fn(v);
+		}
+	}
+
 	template<class T>
 	Cache<T>::~Cache() {
 		for (auto& v : impl->pool) {
@@ -9,6 +9,8 @@
 #include "vuk/Types.hpp"
 
 #include <atomic>
+#include <chrono>
+#include <functional>
 #include <optional>
 #include <span>
 #include <unordered_map>
@@ -220,6 +222,22 @@ namespace vuk {
 	template<class U>
 	struct CacheImpl;
 
+	/// @brief Controls how much work a single Cache::collect call performs, and which entries it evicts
+	struct CacheCollectionPolicy {
+		/// @brief Number of frames an entry must go unused before it is evicted
+		size_t threshold = 16;
+		/// @brief Maximum number of entries inspected per collection, the next collection continues where this one stopped (0 = inspect all entries)
+		size_t entries_per_collect = 0;
+		/// @brief Maximum time spent inspecting entries per collection (0 = unlimited)
+		std::chrono::microseconds time_budget{ 0 };
+		/// @brief If the estimated memory footprint of the cached objects exceeds this many bytes, entries unused for min_threshold frames are evicted too,
+		/// largest first, until the footprint is within budget (0 = no budget). Only the entries inspected by a collection are ranked, so with
+		/// entries_per_collect or time_budget set, the largest entries of that window are evicted first
+		uint64_t memory_budget = 0;
+		/// @brief Number of frames an entry must go unused before it can be evicted to satisfy the memory budget
+		size_t min_threshold = 0;
+	};
+
 	template<class T>
 	class Cache {
 	private:
@@ -246,6 +264,15 @@ namespace vuk {
 
 		T& acquire(const create_info_t<T>& ci);
 		T& acquire(const create_info_t<T>& ci, uint64_t current_frame);
-		void collect(uint64_t current_frame, size_t threshold);
+
+		void set_collection_policy(const CacheCollectionPolicy& policy);
+		/// @brief Incrementally evict entries according to the collection policy
+		/// @param is_referenced if provided, entries for which it returns true are kept regardless of their age
+		void collect(uint64_t current_frame, const std::function<bool(const T&)>& is_referenced = {});
+		/// @brief Evict every entry that has not been used for min_threshold frames of the collection policy, without any limit on the work done
+		void trim(uint64_t current_frame);
+		void for_each(const std::function<void(T&)>& fn);
+		/// @brief Estimated memory footprint of the cached objects, in bytes
+		uint64_t get_footprint();
 	};
 } // namespace vuk
@@ -61,15 +61,25 @@ namespace vuk {
 
 	CommandBuffer& CommandBuffer::set_dynamic_state(DynamicStateFlags flags) {
 		VUK_EARLY_RET();
+		// extended dynamic state is enabled automatically based on device support
+		flags = flags & DynamicStateFlags{ ((uint64_t)DynamicStateFlagBits::eDepthBounds << 1) - 1 };
 
 		// determine which states change to dynamic now - those states need to be flushed into the command buffer
 		DynamicStateFlags not_enabled = DynamicStateFlags{ ~dynamic_state_flags.m_mask }; // has invalid bits, but doesn't matter
 		auto to_dynamic = not_enabled & flags;
 		if (to_dynamic & DynamicStateFlagBits::eViewport && viewports.size() > 0) {
 			vkCmdSetViewport(command_buffer, 0, (uint32_t)viewports.size(), viewports.data());
+			for (unsigned i = 0; i < viewports.size(); i++) {
+				bound_viewports.set(i);
+			}
+			statistics.viewports.emitted++;
 		}
 		if (to_dynamic & DynamicStateFlagBits::eScissor && scissors.size() > 0) {
 			vkCmdSetScissor(command_buffer, 0, (uint32_t)scissors.size(), scissors.data());
+			for (unsigned i = 0; i < scissors.size(); i++) {
+				bound_scissors.set(i);
+			}
+			statistics.scissors.emitted++;
 		}
 		if (to_dynamic & DynamicStateFlagBits::eLineWidth) {
 			vkCmdSetLineWidth(command_buffer, line_width);
@@ -84,6 +94,14 @@ namespace vuk {
 		if (to_dynamic & DynamicStateFlagBits::eDepthBounds && depth_stencil_state) {
 			vkCmdSetDepthBounds(command_buffer, depth_stencil_state->minDepthBounds, depth_stencil_state->maxDepthBounds);
 		}
+		// states that become static are invalidated by the next pipeline bind, so we forget their shadow state
+		auto to_static = dynamic_state_flags & DynamicStateFlags{ ~flags.m_mask };
+		if (to_static & DynamicStateFlagBits::eViewport) {
+			bound_viewports = {};
+		}
+		if (to_static & DynamicStateFlagBits::eScissor) {
+			bound_scissors = {};
+		}
 		dynamic_state_flags = flags;
 		return *this;
 	}
@@ -94,10 +112,17 @@ namespace vuk {
 			assert(index + 1 <= VUK_MAX_VIEWPORTS);
 			viewports.resize(index + 1);
 		}
+		bool unchanged = memcmp(&viewports[index], &vp, sizeof(VkViewport)) == 0;
 		viewports[index] = vp;
 
 		if (dynamic_state_flags & DynamicStateFlagBits::eViewport) {
+			if (unchanged && bound_viewports.test(index)) {
+				statistics.viewports.elided++;
+				return *this;
+			}
 			vkCmdSetViewport(command_buffer, index, 1, &viewports[index]);
+			bound_viewports.set(index);
+			statistics.viewports.emitted++;
 		}
 		return *this;
 	}
@@ -142,9 +167,16 @@ namespace vuk {
 			assert(index + 1 <= VUK_MAX_SCISSORS);
 			scissors.resize(index + 1);
 		}
+		bool unchanged = memcmp(&scissors[index], &vp, sizeof(VkRect2D)) == 0;
 		scissors[index] = vp;
 		if (dynamic_state_flags & DynamicStateFlagBits::eScissor) {
+			if (unchanged && bound_scissors.test(index)) {
+				statistics.scissors.elided++;
+				return *this;
+			}
 			vkCmdSetScissor(command_buffer, index, 1, &scissors[index]);
+			bound_scissors.set(index);
+			statistics.scissors.emitted++;
 		}
 		return *this;
 	}
@@ -285,7 +317,7 @@ namespace vuk {
 		set_binding_descriptions.set(binding, true);
 
 		if (buf.buffer) {
-			vkCmdBindVertexBuffers(command_buffer, binding, 1, &buf.buffer, &buf.offset);
+			_bind_vertex_buffer(binding, buf);
 		}
 		return *this;
 	}
@@ -306,14 +338,32 @@ namespace vuk {
 		set_binding_descriptions.set(binding, true);
 
 		if (buf.buffer) {
-			vkCmdBindVertexBuffers(command_buffer, binding, 1, &buf.buffer, &buf.offset);
+			_bind_vertex_buffer(binding, buf);
 		}
 		return *this;
 	}
 
+	void CommandBuffer::_bind_vertex_buffer(unsigned binding, const Buffer& buf) {
+		auto& bound = bound_vertex_buffers[binding];
+		if (set_bound_vertex_buffers.test(binding) && bound.first == buf.buffer && bound.second == buf.offset) {
+			statistics.vertex_buffers.elided++;
+			return;
+		}
+		vkCmdBindVertexBuffers(command_buffer, binding, 1, &buf.buffer, &buf.offset);
+		bound = { buf.buffer, buf.offset };
+		set_bound_vertex_buffers.set(binding);
+		statistics.vertex_buffers.emitted++;
+	}
+
 	CommandBuffer& CommandBuffer::bind_index_buffer(const Buffer& buf, IndexType type) {
 		VUK_EARLY_RET();
+		if (bound_index_buffer.buffer == buf.buffer && bound_index_buffer.offset == buf.offset && bound_index_buffer.type == type) {
+			statistics.index_buffers.elided++;
+			return *this;
+		}
 		vkCmdBindIndexBuffer(command_buffer, buf.buffer, buf.offset, (VkIndexType)type);
+		bound_index_buffer = { buf.buffer, buf.offset, type };
+		statistics.index_buffers.emitted++;
 		return *this;
 	}
 
@@ -408,7 +458,7 @@ namespace vuk {
 		    db.type != DescriptorType::eCombinedImageSampler) {
 			db.image = { {}, {}, {} };
 		}
-		db.image.set_sampler(ctx.acquire_sampler(sci, ctx.get_frame_count()));
+		db.image.set_sampler(ctx.acquire_collectable_sampler(sci, ctx.get_frame_count()));
 		// if it was just an image, we upgrade to combined (has both image and sampler) - otherwise just sampler
 		db.type = db.type == DescriptorType::eSampledImage ? DescriptorType::eCombinedImageSampler : DescriptorType::eSampler;
 		set_bindings[set].used.set(binding);
@@ -677,6 +727,39 @@ namespace vuk {
 		return *this;
 	}
 
+	CommandBuffer& CommandBuffer::copy_buffer_to_image(Name src, Name dst, std::span<const BufferImageCopy> regions) {
+		VUK_EARLY_RET();
+		assert(rg);
+		auto src_res = rg->get_resource_buffer(src, current_pass);
+		if (!src_res) {
+			current_error = std::move(src_res);
+			return *this;
+		}
+		auto src_bbuf = src_res->buffer;
+
+		auto dst_res = rg->get_resource_image(dst, current_pass);
+		if (!dst_res) {
+			current_error = std::move(dst_res);
+			return *this;
+		}
+		auto dst_image = dst_res->attachment.image;
+
+		auto res_gl = rg->is_resource_image_in_general_layout(dst, current_pass);
+		if (!res_gl) {
+			current_error = std::move(res_gl);
+			return *this;
+		}
+		auto dst_layout = *res_gl ? ImageLayout::eGeneral : ImageLayout::eTransferDstOptimal;
+
+		std::vector<BufferImageCopy> bics(regions.begin(), regions.end());
+		for (auto& bic : bics) {
+			bic.bufferOffset += src_bbuf.offset;
+		}
+		vkCmdCopyBufferToImage(command_buffer, src_bbuf.buffer, dst_image, (VkImageLayout)dst_layout, (uint32_t)bics.size(), (VkBufferImageCopy*)bics.data());
+
+		return *this;
+	}
+
 	CommandBuffer& CommandBuffer::copy_image_to_buffer(Name src, Name dst, BufferImageCopy bic) {
 		VUK_EARLY_RET();
 		assert(rg);
@@ -825,11 +908,46 @@ namespace vuk {
 		return std::move(current_error);
 	}
 
+	void CommandBuffer::_push_constants(VkPipelineLayout layout, const VkPushConstantRange& pcr) {
+		// push constants are only preserved across pipeline binds with compatible layouts - be conservative and forget everything on layout change
+		if (layout != bound_push_constant_layout) {
+			bound_push_constant_layout = layout;
+			bound_pcrs.clear();
+		}
+
+		auto pcr_end = pcr.offset + pcr.size;
+		void* data = push_constant_buffer.data() + pcr.offset;
+		for (auto& bpcr : bound_pcrs) {
+			if (bpcr.stageFlags == pcr.stageFlags && bpcr.offset <= pcr.offset && pcr_end <= bpcr.offset + bpcr.size &&
+			    memcmp(bound_push_constant_buffer.data() + pcr.offset, data, pcr.size) == 0) {
+				statistics.push_constants.elided++;
+				return;
+			}
+		}
+
+		vkCmdPushConstants(command_buffer, layout, pcr.stageFlags, pcr.offset, pcr.size, data);
+		statistics.push_constants.emitted++;
+		memcpy(bound_push_constant_buffer.data() + pcr.offset, data, pcr.size);
+		// the shadow bytes now hold this push - ranges for other stages overlapping it are no longer known
+		for (size_t i = 0; i < bound_pcrs.size();) {
+			auto& bpcr = bound_pcrs[i];
+			bool overlaps = bpcr.offset < pcr_end && pcr.offset < bpcr.offset + bpcr.size;
+			if (overlaps && bpcr.stageFlags != pcr.stageFlags) {
+				bpcr = bound_pcrs.back();
+				bound_pcrs.pop_back();
+			} else {
+				i++;
+			}
+		}
+		if (bound_pcrs.size() == bound_pcrs.capacity()) {
+			bound_pcrs.clear();
+		}
+		bound_pcrs.push_back(pcr);
+	}
+
 	bool CommandBuffer::_bind_state(bool graphics) {
 		for (auto& pcr : pcrs) {
-			void* data = push_constant_buffer.data() + pcr.offset;
-			vkCmdPushConstants(
-			    command_buffer, graphics ? current_pipeline->pipeline_layout : current_compute_pipeline->pipeline_layout, pcr.stageFlags, pcr.offset, pcr.size, data);
+			_push_constants(graphics ? current_pipeline->pipeline_layout : current_compute_pipeline->pipeline_layout, pcr);
 		}
 		pcrs.clear();
 
@@ -984,15 +1102,38 @@ namespace vuk {
 				pi.base->psscis[0].pSpecializationInfo = &pi.specialization_info;
 			}
 
+			VkPipeline previous_pipeline = current_compute_pipeline ? current_compute_pipeline->pipeline : VK_NULL_HANDLE;
 			current_compute_pipeline = ctx.acquire_pipeline(pi, ctx.get_frame_count());
 
-			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, current_compute_pipeline->pipeline);
+			if (current_compute_pipeline->pipeline != previous_pipeline) {
+				vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, current_compute_pipeline->pipeline);
+				statistics.pipelines.emitted++;
+			} else {
+				statistics.pipelines.elided++;
+			}
 			next_compute_pipeline = nullptr;
 		}
 
 		return _bind_state(false);
 	}
 
+	// pipelines created with dynamic topology may be used with any topology of the same class
+	static VkPrimitiveTopology topology_class_representative(VkPrimitiveTopology topology) {
+		switch (topology) {
+		case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+			return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+		case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+		case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+		case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+		case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+			return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+		case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+			return VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
+		default:
+			return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		}
+	}
+
 	template<class T>
 	void write(std::byte*& data_ptr, const T& data) {
 		memcpy(data_ptr, &data, sizeof(T));
@@ -1004,13 +1145,17 @@ namespace vuk {
 			PipelineInstanceCreateInfo pi;
 			pi.base = next_pipeline;
 			pi.render_pass = ongoing_renderpass->renderpass;
-			pi.dynamic_state_flags = dynamic_state_flags;
+			// extended dynamic state supported by the device is always dynamic, and is kept out of the key
+			auto eds = ctx.extended_dynamic_state.supported_states;
+			pi.dynamic_state_flags = dynamic_state_flags | eds;
 			auto& records = pi.records;
 			if (ongoing_renderpass->subpass > 0) {
 				records.nonzero_subpass = true;
 				pi.extended_size += sizeof(uint8_t);
 			}
-			pi.topology = (VkPrimitiveTopology)topology;
+			// with dynamic topology, the pipeline only needs to match the topology class
+			pi.topology = (eds & DynamicStateFlagBits::ePrimitiveTopologyEXT) ? topology_class_representative((VkPrimitiveTopology)topology)
+			                                                                   : (VkPrimitiveTopology)topology;
 			pi.primitive_restart_enable = false;
 
 			// VERTEX INPUT
@@ -1074,11 +1219,29 @@ namespace vuk {
 				pi.extended_size += (uint16_t)spec_const_size;
 			}
 
+			PipelineRasterizationStateCreateInfo keyed_rasterization_state;
 			if (rasterization) {
 				assert(rasterization_state && "If a pass has a depth/stencil or color attachment, you must set the rasterization state.");
 
-				pi.cullMode = (VkCullModeFlags)rasterization_state->cullMode;
+				pi.cullMode = (eds & DynamicStateFlagBits::eCullModeEXT) ? 0 : (VkCullModeFlags)rasterization_state->cullMode;
 				PipelineRasterizationStateCreateInfo def{ .cullMode = rasterization_state->cullMode };
+				// reset the states that are set dynamically to defaults, so they don't create pipeline permutations
+				keyed_rasterization_state = *rasterization_state;
+				if (eds & DynamicStateFlagBits::eFrontFaceEXT) {
+					keyed_rasterization_state.frontFace = def.frontFace;
+				}
+				if (eds & DynamicStateFlagBits::eRasterizerDiscardEnableEXT) {
+					keyed_rasterization_state.rasterizerDiscardEnable = def.rasterizerDiscardEnable;
+				}
+				if (eds & DynamicStateFlagBits::eDepthBiasEnableEXT) {
+					keyed_rasterization_state.depthBiasEnable = def.depthBiasEnable;
+				}
+				if (eds & DynamicStateFlagBits::ePolygonModeEXT) {
+					keyed_rasterization_state.polygonMode = def.polygonMode;
+				}
+				if (eds & DynamicStateFlagBits::eDepthClampEnableEXT) {
+					keyed_rasterization_state.depthClampEnable = def.depthClampEnable;
+				}
 				if (dynamic_state_flags & DynamicStateFlagBits::eDepthBias) {
 					def.depthBiasConstantFactor = rasterization_state->depthBiasConstantFactor;
 					def.depthBiasClamp = rasterization_state->depthBiasClamp;
@@ -1089,8 +1252,8 @@ namespace vuk {
 					assert(rasterization_state->depthBiasClamp == def.depthBiasClamp);
 					assert(rasterization_state->depthBiasSlopeFactor == def.depthBiasSlopeFactor);
 				}
-				records.depth_bias_enable = rasterization_state->depthBiasEnable; // the enable itself is not dynamic state in core
-				if (*rasterization_state != def) {
+				records.depth_bias_enable = keyed_rasterization_state.depthBiasEnable; // the enable itself is not dynamic state in core
+				if (keyed_rasterization_state != def) {
 					records.non_trivial_raster_state = true;
 					pi.extended_size += sizeof(PipelineInstanceCreateInfo::RasterizationState);
 				}
@@ -1205,10 +1368,10 @@ namespace vuk {
 			}
 
 			if (records.non_trivial_raster_state) {
-				PipelineInstanceCreateInfo::RasterizationState rs{ .depthClampEnable = (bool)rasterization_state->depthClampEnable,
-					                                                 .rasterizerDiscardEnable = (bool)rasterization_state->rasterizerDiscardEnable,
-					                                                 .polygonMode = (uint8_t)rasterization_state->polygonMode,
-					                                                 .frontFace = (uint8_t)rasterization_state->frontFace };
+				PipelineInstanceCreateInfo::RasterizationState rs{ .depthClampEnable = (bool)keyed_rasterization_state.depthClampEnable,
+					                                                 .rasterizerDiscardEnable = (bool)keyed_rasterization_state.rasterizerDiscardEnable,
+					                                                 .polygonMode = (uint8_t)keyed_rasterization_state.polygonMode,
+					                                                 .frontFace = (uint8_t)keyed_rasterization_state.frontFace };
 				write(data_ptr, rs);
 				// TODO: support depth bias
 			}
@@ -1217,6 +1380,15 @@ namespace vuk {
 				PipelineInstanceCreateInfo::Depth ds = { .depthTestEnable = (bool)depth_stencil_state->depthTestEnable,
 					                                       .depthWriteEnable = (bool)depth_stencil_state->depthWriteEnable,
 					                                       .depthCompareOp = (uint8_t)depth_stencil_state->depthCompareOp };
+				if (eds & DynamicStateFlagBits::eDepthTestEnableEXT) {
+					ds.depthTestEnable = false;
+				}
+				if (eds & DynamicStateFlagBits::eDepthWriteEnableEXT) {
+					ds.depthWriteEnable = false;
+				}
+				if (eds & DynamicStateFlagBits::eDepthCompareOpEXT) {
+					ds.depthCompareOp = 0;
+				}
 				write(data_ptr, ds);
 				// TODO: support stencil
 				// TODO: support depth bounds
@@ -1247,15 +1419,80 @@ namespace vuk {
 
 			assert(data_ptr - data_start_ptr == pi.extended_size); // sanity check: we wrote all the data we wanted to
 			// acquire_pipeline makes copy of extended_data if it needs to
+			VkPipeline previous_pipeline = current_pipeline ? current_pipeline->pipeline : VK_NULL_HANDLE;
 			current_pipeline = ctx.acquire_pipeline(pi, ctx.get_frame_count());
 			if (!pi.is_inline()) {
-				delete pi.extended_data;
+				delete[] pi.extended_data;
 			}
 
-			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, current_pipeline->pipeline);
+			if (current_pipeline->pipeline != previous_pipeline) {
+				vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, current_pipeline->pipeline);
+				statistics.pipelines.emitted++;
+			} else {
+				statistics.pipelines.elided++;
+			}
 			next_pipeline = nullptr;
 		}
+		if (ctx.extended_dynamic_state.supported_states) {
+			_set_extended_dynamic_state();
+		}
 		return _bind_state(true);
 	}
 
+	void CommandBuffer::_set_extended_dynamic_state() {
+		auto& eds = ctx.extended_dynamic_state;
+		auto& bound = bound_extended_dynamic_state;
+		// pipelines are created with all the supported extended states dynamic, so these must be set even if the pass doesn't use them
+		auto rs = rasterization_state.value_or(PipelineRasterizationStateCreateInfo{});
+		auto ds = depth_stencil_state.value_or(PipelineDepthStencilStateCreateInfo{});
+
+		auto update = [&](DynamicStateFlagBits bit, auto& shadow, auto value, auto&& set_fn) {
+			if (!(eds.supported_states & bit)) {
+				return;
+			}
+			if ((bound.set & bit) && shadow == value) {
+				return;
+			}
+			set_fn(value);
+			shadow = value;
+			bound.set |= bit;
+		};
+
+		update(DynamicStateFlagBits::eCullModeEXT, bound.cull_mode, rs.cullMode, [&](CullModeFlags v) {
+			eds.cmdSetCullModeEXT(command_buffer, (VkCullModeFlags)v);
+		});
+		update(DynamicStateFlagBits::eFrontFaceEXT, bound.front_face, rs.frontFace, [&](FrontFace v) {
+			eds.cmdSetFrontFaceEXT(command_buffer, (VkFrontFace)v);
+		});
+		update(DynamicStateFlagBits::ePrimitiveTopologyEXT, bound.topology, topology, [&](PrimitiveTopology v) {
+			eds.cmdSetPrimitiveTopologyEXT(command_buffer, (VkPrimitiveTopology)v);
+		});
+		update(DynamicStateFlagBits::eDepthTestEnableEXT, bound.depth_test_enable, (bool)ds.depthTestEnable, [&](bool v) {
+			eds.cmdSetDepthTestEnableEXT(command_buffer, v);
+		});
+		update(DynamicStateFlagBits::eDepthWriteEnableEXT, bound.depth_write_enable, (bool)ds.depthWriteEnable, [&](bool v) {
+			eds.cmdSetDepthWriteEnableEXT(command_buffer, v);
+		});
+		update(DynamicStateFlagBits::eDepthCompareOpEXT, bound.depth_compare_op, ds.depthCompareOp, [&](CompareOp v) {
+			eds.cmdSetDepthCompareOpEXT(command_buffer, (VkCompareOp)v);
+		});
+		update(DynamicStateFlagBits::eRasterizerDiscardEnableEXT, bound.rasterizer_discard_enable, (bool)rs.rasterizerDiscardEnable, [&](bool v) {
+			eds.cmdSetRasterizerDiscardEnableEXT(command_buffer, v);
+		});
+		update(DynamicStateFlagBits::eDepthBiasEnableEXT, bound.depth_bias_enable, (bool)rs.depthBiasEnable, [&](bool v) {
+			eds.cmdSetDepthBiasEnableEXT(command_buffer, v);
+		});
+		update(DynamicStateFlagBits::ePrimitiveRestartEnableEXT, bound.primitive_restart_enable, false, [&](bool v) {
+			eds.cmdSetPrimitiveRestartEnableEXT(command_buffer, v);
+		});
+#ifdef VK_EXT_extended_dynamic_state3
+		update(DynamicStateFlagBits::ePolygonModeEXT, bound.polygon_mode, rs.polygonMode, [&](PolygonMode v) {
+			eds.cmdSetPolygonModeEXT(command_buffer, (VkPolygonMode)v);
+		});
+		update(DynamicStateFlagBits::eDepthClampEnableEXT, bound.depth_clamp_enable, (bool)rs.depthClampEnable, [&](bool v) {
+			eds.cmdSetDepthClampEnableEXT(command_buffer, v);
+		});
+#endif
+	}
+
 } // namespace vuk
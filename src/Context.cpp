@@ -26,6 +26,7 @@
 #include "vuk/Program.hpp"
 #include "vuk/Query.hpp"
 #include "vuk/RenderGraph.hpp"
+#include "vuk/Tracing.hpp"
 
 namespace vuk {
 	Context::Context(ContextCreateParameters params) :
@@ -35,7 +36,8 @@ namespace vuk {
 	    graphics_queue_family_index(params.graphics_queue_family_index),
 	    compute_queue_family_index(params.compute_queue_family_index),
 	    transfer_queue_family_index(params.transfer_queue_family_index),
-	    debug(*this) {
+	    debug(*this),
+	    extended_dynamic_state(*this, params) {
 
 		auto queueSubmit2KHR = (PFN_vkQueueSubmit2KHR)vkGetDeviceProcAddr(device, "vkQueueSubmit2KHR");
 		assert(queueSubmit2KHR != nullptr);
@@ -59,7 +61,7 @@ namespace vuk {
 		} else {
 			transfer_queue_family_index = compute_queue ? params.compute_queue_family_index : params.graphics_queue_family_index;
 		}
-		impl = new ContextImpl(*this);
+		impl = new ContextImpl(*this, params);
 
 		{
 			TimelineSemaphore ts;
@@ -95,6 +97,55 @@ namespace vuk {
 		cmdEndDebugUtilsLabelEXT = (PFN_vkCmdEndDebugUtilsLabelEXT)vkGetDeviceProcAddr(ctx.device, "vkCmdEndDebugUtilsLabelEXT");
 	}
 
+	Context::ExtendedDynamicState::ExtendedDynamicState(Context& ctx, const ContextCreateParameters& params) {
+		// the entry points can be present without the features being enabled (eg. the core 1.3 ones), so only the enabled features are used
+		// prefer the EXT entry points, but fall back to the core 1.3 names, which are the same functions
+		auto load = [&ctx](const char* ext_name, const char* core_name) {
+			auto fn = vkGetDeviceProcAddr(ctx.device, ext_name);
+			return fn ? fn : vkGetDeviceProcAddr(ctx.device, core_name);
+		};
+
+		if (params.extended_dynamic_state) {
+			cmdSetCullModeEXT = (PFN_vkCmdSetCullModeEXT)load("vkCmdSetCullModeEXT", "vkCmdSetCullMode");
+			cmdSetFrontFaceEXT = (PFN_vkCmdSetFrontFaceEXT)load("vkCmdSetFrontFaceEXT", "vkCmdSetFrontFace");
+			cmdSetPrimitiveTopologyEXT = (PFN_vkCmdSetPrimitiveTopologyEXT)load("vkCmdSetPrimitiveTopologyEXT", "vkCmdSetPrimitiveTopology");
+			cmdSetDepthTestEnableEXT = (PFN_vkCmdSetDepthTestEnableEXT)load("vkCmdSetDepthTestEnableEXT", "vkCmdSetDepthTestEnable");
+			cmdSetDepthWriteEnableEXT = (PFN_vkCmdSetDepthWriteEnableEXT)load("vkCmdSetDepthWriteEnableEXT", "vkCmdSetDepthWriteEnable");
+			cmdSetDepthCompareOpEXT = (PFN_vkCmdSetDepthCompareOpEXT)load("vkCmdSetDepthCompareOpEXT", "vkCmdSetDepthCompareOp");
+			if (cmdSetCullModeEXT && cmdSetFrontFaceEXT && cmdSetPrimitiveTopologyEXT && cmdSetDepthTestEnableEXT && cmdSetDepthWriteEnableEXT &&
+			    cmdSetDepthCompareOpEXT) {
+				supported_states |= DynamicStateFlagBits::eCullModeEXT | DynamicStateFlagBits::eFrontFaceEXT | DynamicStateFlagBits::ePrimitiveTopologyEXT |
+				                    DynamicStateFlagBits::eDepthTestEnableEXT | DynamicStateFlagBits::eDepthWriteEnableEXT | DynamicStateFlagBits::eDepthCompareOpEXT;
+			}
+		}
+
+		if (params.extended_dynamic_state2) {
+			cmdSetRasterizerDiscardEnableEXT =
+			    (PFN_vkCmdSetRasterizerDiscardEnableEXT)load("vkCmdSetRasterizerDiscardEnableEXT", "vkCmdSetRasterizerDiscardEnable");
+			cmdSetDepthBiasEnableEXT = (PFN_vkCmdSetDepthBiasEnableEXT)load("vkCmdSetDepthBiasEnableEXT", "vkCmdSetDepthBiasEnable");
+			cmdSetPrimitiveRestartEnableEXT = (PFN_vkCmdSetPrimitiveRestartEnableEXT)load("vkCmdSetPrimitiveRestartEnableEXT", "vkCmdSetPrimitiveRestartEnable");
+			if (cmdSetRasterizerDiscardEnableEXT && cmdSetDepthBiasEnableEXT && cmdSetPrimitiveRestartEnableEXT) {
+				supported_states |=
+				    DynamicStateFlagBits::eRasterizerDiscardEnableEXT | DynamicStateFlagBits::eDepthBiasEnableEXT | DynamicStateFlagBits::ePrimitiveRestartEnableEXT;
+			}
+		}
+
+#ifdef VK_EXT_extended_dynamic_state3
+		if (params.extended_dynamic_state3_polygon_mode) {
+			cmdSetPolygonModeEXT = (PFN_vkCmdSetPolygonModeEXT)vkGetDeviceProcAddr(ctx.device, "vkCmdSetPolygonModeEXT");
+			if (cmdSetPolygonModeEXT) {
+				supported_states |= DynamicStateFlagBits::ePolygonModeEXT;
+			}
+		}
+		if (params.extended_dynamic_state3_depth_clamp_enable) {
+			cmdSetDepthClampEnableEXT = (PFN_vkCmdSetDepthClampEnableEXT)vkGetDeviceProcAddr(ctx.device, "vkCmdSetDepthClampEnableEXT");
+			if (cmdSetDepthClampEnableEXT) {
+				supported_states |= DynamicStateFlagBits::eDepthClampEnableEXT;
+			}
+		}
+#endif
+	}
+
 	void Context::DebugUtils::set_name(const Texture& tex, Name name) {
 		if (!enabled())
 			return;
@@ -137,6 +188,10 @@ namespace vuk {
 		return impl->legacy_gpu_allocator;
 	}
 
+	PassProfiler& Context::get_pass_profiler() {
+		return impl->pass_profiler;
+	}
+
 	void PersistentDescriptorSet::update_combined_image_sampler(Context& ctx,
 	                                                            unsigned binding,
 	                                                            unsigned array_index,
@@ -479,7 +534,14 @@ namespace vuk {
 
 	void Context::create_named_pipeline(Name name, PipelineBaseCreateInfo ci) {
 		std::lock_guard _(impl->named_pipelines_lock);
-		impl->named_pipelines.insert_or_assign(name, &impl->pipelinebase_cache.acquire(std::move(ci)));
+		// named pipelines are kept alive by the name, bases that are no longer named can be collected
+		auto* base = &impl->pipelinebase_cache.acquire(std::move(ci), impl->frame_counter);
+		impl->reference_base(base);
+		auto [it, inserted] = impl->named_pipelines.try_emplace(name, base);
+		if (!inserted) {
+			impl->release_base(it->second);
+			it->second = base;
+		}
 	}
 
 	PipelineBaseInfo* Context::get_named_pipeline(Name name) {
@@ -492,7 +554,7 @@ namespace vuk {
 	}
 
 	Program Context::get_pipeline_reflection_info(const PipelineBaseCreateInfo& pci) {
-		auto& res = impl->pipelinebase_cache.acquire(pci);
+		auto& res = impl->pipelinebase_cache.acquire(pci, impl->frame_counter);
 		return res.reflection_info;
 	}
 
@@ -523,6 +585,7 @@ namespace vuk {
 		tex.extent = ici.extent;
 		tex.format = ici.format;
 		tex.sample_count = ici.samples;
+		tex.usage = ici.usage;
 		return tex;
 	}
 
@@ -544,11 +607,14 @@ namespace vuk {
 	}
 
 	void Context::destroy(const PipelineInfo& pi) {
+		impl->pipeline_libraries.forget(pi.pipeline);
 		vkDestroyPipeline(device, pi.pipeline, nullptr);
+		impl->release_base(pi.base);
 	}
 
 	void Context::destroy(const ComputePipelineInfo& pi) {
 		vkDestroyPipeline(device, pi.pipeline, nullptr);
+		impl->release_base(pi.base);
 	}
 
 	void Context::destroy(const ShaderModule& sm) {
@@ -564,6 +630,8 @@ namespace vuk {
 	}
 
 	void Context::destroy(const VkRenderPass& rp) {
+		// the handle might be recycled for an incompatible render pass
+		impl->pipeline_libraries.forget_render_pass(rp);
 		vkDestroyRenderPass(device, rp, nullptr);
 	}
 
@@ -580,12 +648,17 @@ namespace vuk {
 	}
 
 	void Context::destroy(const PipelineBaseInfo& pbi) {
-		// no-op, we don't own device objects
+		// we don't own device objects, but pipeline library parts were built from the shaders
+		impl->pipeline_libraries.forget_base(&pbi);
+		std::lock_guard _(impl->base_references_lock);
+		impl->base_references.erase(&pbi);
 	}
 
 	Context::~Context() {
 		vkDeviceWaitIdle(device);
 
+		impl->pipeline_libraries.shutdown();
+
 		for (auto& s : impl->swapchains) {
 			for (auto& swiv : s.image_views) {
 				vkDestroyImageView(device, swiv.payload, nullptr);
@@ -615,8 +688,75 @@ namespace vuk {
 	}
 
 	void Context::next_frame() {
+		VUK_TRACE_ZONE("vuk::Context::next_frame");
 		impl->frame_counter++;
+
+		auto stats = get_memory_statistics();
+		float threshold;
+		std::function<void(const MemoryStatistics&, uint32_t)> callback;
+		{
+			std::lock_guard _(impl->memory_budget_lock);
+			threshold = impl->memory_budget_threshold;
+			callback = impl->memory_budget_callback;
+		}
+		uint32_t under_pressure = 0;
+		for (uint32_t i = 0; i < (uint32_t)stats.heaps.size(); i++) {
+			auto& heap = stats.heaps[i];
+			if (heap.budget > 0 && heap.usage > (uint64_t)(heap.budget * (double)threshold)) {
+				under_pressure |= 1u << i;
+			}
+		}
+		auto crossed = under_pressure & ~impl->heaps_under_pressure.exchange(under_pressure);
+#if VUK_TRACING
+		uint64_t device_local_usage = 0;
+		for (auto& heap : stats.heaps) {
+			if (heap.device_local) {
+				device_local_usage += heap.usage;
+			}
+		}
+		VUK_TRACE_COUNTER("vuk::device_local_usage", device_local_usage);
+		VUK_TRACE_COUNTER("vuk::transient_images", stats.transient_images);
+#endif
+
 		collect(impl->frame_counter);
+		impl->pass_profiler.poll(impl->frame_counter);
+		// trim before the heaps run out, instead of waiting for the caches to age out the entries
+		if (under_pressure) {
+			impl->transient_images.trim(impl->frame_counter);
+		}
+		if (callback) {
+			for (uint32_t i = 0; i < (uint32_t)stats.heaps.size(); i++) {
+				if (crossed & (1u << i)) {
+					callback(stats, i);
+				}
+			}
+		}
+	}
+
+	MemoryStatistics Context::get_memory_statistics() {
+		MemoryStatistics stats;
+		stats.heaps = impl->legacy_gpu_allocator.get_heap_statistics();
+		{
+			std::lock_guard _(impl->memory_budget_lock);
+			for (uint32_t i = 0; i < (uint32_t)stats.heaps.size(); i++) {
+				auto& peak = impl->heap_peak_usage[i];
+				peak = std::max(peak, stats.heaps[i].usage);
+				stats.heaps[i].peak_usage = peak;
+			}
+		}
+		stats.device_resource = impl->device_vk_resource.get_memory_statistics();
+		stats.transient_images = impl->transient_images.get_footprint();
+		return stats;
+	}
+
+	void Context::set_memory_budget_threshold(float threshold, std::function<void(const MemoryStatistics&, uint32_t heap_index)> callback) {
+		std::lock_guard _(impl->memory_budget_lock);
+		impl->memory_budget_threshold = threshold;
+		impl->memory_budget_callback = std::move(callback);
+	}
+
+	bool Context::is_under_memory_pressure() {
+		return impl->heaps_under_pressure.load() != 0;
 	}
 
 	void Context::wait_idle() {
@@ -735,6 +875,39 @@ namespace vuk {
 		return t;
 	};
 
+	static VkDynamicState to_vk_dynamic_state(DynamicStateFlagBits bit) {
+		switch (bit) {
+		case DynamicStateFlagBits::eCullModeEXT:
+			return VK_DYNAMIC_STATE_CULL_MODE_EXT;
+		case DynamicStateFlagBits::eFrontFaceEXT:
+			return VK_DYNAMIC_STATE_FRONT_FACE_EXT;
+		case DynamicStateFlagBits::ePrimitiveTopologyEXT:
+			return VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT;
+		case DynamicStateFlagBits::eDepthTestEnableEXT:
+			return VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT;
+		case DynamicStateFlagBits::eDepthWriteEnableEXT:
+			return VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT;
+		case DynamicStateFlagBits::eDepthCompareOpEXT:
+			return VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT;
+		case DynamicStateFlagBits::eRasterizerDiscardEnableEXT:
+			return VK_DYNAMIC_STATE_RASTERIZER_DISCARD_ENABLE_EXT;
+		case DynamicStateFlagBits::eDepthBiasEnableEXT:
+			return VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE_EXT;
+		case DynamicStateFlagBits::ePrimitiveRestartEnableEXT:
+			return VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE_EXT;
+#ifdef VK_EXT_extended_dynamic_state3
+		case DynamicStateFlagBits::ePolygonModeEXT:
+			return VK_DYNAMIC_STATE_POLYGON_MODE_EXT;
+		case DynamicStateFlagBits::eDepthClampEnableEXT:
+			return VK_DYNAMIC_STATE_DEPTH_CLAMP_ENABLE_EXT;
+#endif
+		default:
+			// the core states are numbered the same as their bit index
+			assert((uint64_t)bit <= (uint64_t)DynamicStateFlagBits::eDepthBounds);
+			return (VkDynamicState)std::countr_zero((uint64_t)bit);
+		}
+	}
+
 	PipelineInfo Context::create(const create_info_t<PipelineInfo>& cinfo) {
 		// create gfx pipeline
 		VkGraphicsPipelineCreateInfo gpci{ .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
@@ -971,25 +1144,30 @@ namespace vuk {
 		gpci.pViewportState = &viewport_state;
 
 		VkPipelineDynamicStateCreateInfo dynamic_state{ .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
-		dynamic_state.dynamicStateCount = std::popcount(cinfo.dynamic_state_flags.m_mask);
-		fixed_vector<VkDynamicState, VkDynamicState::VK_DYNAMIC_STATE_DEPTH_BOUNDS> dyn_states;
+		fixed_vector<VkDynamicState, 64> dyn_states;
 		uint64_t dyn_state_cnt = 0;
 		uint64_t mask = cinfo.dynamic_state_flags.m_mask;
 		while (mask > 0) {
 			bool set = mask & 0x1;
 			if (set) {
-				dyn_states.push_back((VkDynamicState)dyn_state_cnt); // TODO: we will need a switch here instead of a cast when handling EXT
+				dyn_states.push_back(to_vk_dynamic_state((DynamicStateFlagBits)(1ULL << dyn_state_cnt)));
 			}
 			mask >>= 1;
 			dyn_state_cnt++;
 		}
+		dynamic_state.dynamicStateCount = (uint32_t)dyn_states.size();
 		dynamic_state.pDynamicStates = dyn_states.data();
 		gpci.pDynamicState = &dynamic_state;
 
 		VkPipeline pipeline;
-		VkResult res = vkCreateGraphicsPipelines(device, impl->vk_pipeline_cache, 1, &gpci, nullptr, &pipeline);
-		assert(res == VK_SUCCESS);
+		if (impl->pipeline_libraries.enabled()) {
+			pipeline = impl->pipeline_libraries.create(gpci, cinfo.base);
+		} else {
+			VkResult res = vkCreateGraphicsPipelines(device, impl->vk_pipeline_cache, 1, &gpci, nullptr, &pipeline);
+			assert(res == VK_SUCCESS);
+		}
 		debug.set_name(pipeline, cinfo.base->pipeline_name);
+		impl->reference_base(cinfo.base);
 		return { cinfo.base, pipeline, gpci.layout, cinfo.base->layout_info };
 	}
 
@@ -1003,6 +1181,7 @@ namespace vuk {
 		VkResult res = vkCreateComputePipelines(device, impl->vk_pipeline_cache, 1, &cpci, nullptr, &pipeline);
 		assert(res == VK_SUCCESS);
 		debug.set_name(pipeline, cinfo.base->pipeline_name);
+		impl->reference_base(cinfo.base);
 		return { { cinfo.base, pipeline, cpci.layout, cinfo.base->layout_info }, cinfo.base->reflection_info.local_size };
 	}
 
@@ -1025,6 +1204,11 @@ namespace vuk {
 	}
 
 	Sampler Context::acquire_sampler(const SamplerCreateInfo& sci, uint64_t absolute_frame) {
+		// samplers handed out here may be kept indefinitely (eg. in persistent descriptor sets), so they are pinned
+		return impl->sampler_cache.acquire(sci);
+	}
+
+	Sampler Context::acquire_collectable_sampler(const SamplerCreateInfo& sci, uint64_t absolute_frame) {
 		return impl->sampler_cache.acquire(sci, absolute_frame);
 	}
 
@@ -1033,7 +1217,9 @@ namespace vuk {
 	}
 
 	PipelineInfo Context::acquire_pipeline(const PipelineInstanceCreateInfo& pici, uint64_t absolute_frame) {
-		return impl->pipeline_cache.acquire(pici, absolute_frame);
+		auto& pi = impl->pipeline_cache.acquire(pici, absolute_frame);
+		// the pipeline might be replaced with an optimized one concurrently
+		return { pi.base, std::atomic_ref(pi.pipeline).load(std::memory_order_acquire), pi.pipeline_layout, pi.layout_info };
 	}
 
 	ComputePipelineInfo Context::acquire_pipeline(const ComputePipelineInstanceCreateInfo& pici, uint64_t absolute_frame) {
@@ -1042,57 +1228,73 @@ namespace vuk {
 
 	bool Context::is_timestamp_available(Query q) {
 		std::scoped_lock _(impl->query_lock);
-		auto it = impl->timestamp_result_map.find(q);
-		return (it != impl->timestamp_result_map.end());
+		return impl->find_timestamp_result(q) != nullptr;
 	}
 
 	std::optional<uint64_t> Context::retrieve_timestamp(Query q) {
 		std::scoped_lock _(impl->query_lock);
-		auto it = impl->timestamp_result_map.find(q);
-		if (it != impl->timestamp_result_map.end()) {
-			uint64_t res = it->second;
-			impl->timestamp_result_map.erase(it);
-			return res;
+		if (auto r = impl->find_timestamp_result(q)) {
+			r->available = false;
+			return r->value;
 		}
 		return {};
 	}
 
 	std::optional<double> Context::retrieve_duration(Query q1, Query q2) {
-		if (!is_timestamp_available(q1)) {
-			return {};
-		}
-		auto r1 = retrieve_timestamp(q1);
-		auto r2 = retrieve_timestamp(q2);
-		if (!r2) {
+		std::scoped_lock _(impl->query_lock);
+		auto r1 = impl->find_timestamp_result(q1);
+		auto r2 = impl->find_timestamp_result(q2);
+		if (!r1 || !r2) {
 			return {};
 		}
+		r1->available = false;
+		r2->available = false;
 
-		auto ns = impl->physical_device_properties.limits.timestampPeriod * (r2.value() - r1.value());
+		auto ns = impl->physical_device_properties.limits.timestampPeriod * (r2->value - r1->value);
 		return ns * 1e-9;
 	}
 
-	Result<void> Context::make_timestamp_results_available(std::span<const TimestampQueryPool> pools) {
-		std::scoped_lock _(impl->query_lock);
-		std::array<uint64_t, TimestampQueryPool::num_queries> host_values;
+	std::optional<PassTimingReport> Context::get_pass_timings() {
+		return impl->pass_profiler.get_report();
+	}
 
+	Result<void> Context::make_timestamp_results_available(std::span<const TimestampQueryPool> pools) {
 		for (auto& pool : pools) {
 			if (pool.count == 0) {
 				continue;
 			}
-			auto result = vkGetQueryPoolResults(device,
-			                                    pool.pool,
-			                                    0,
-			                                    pool.count,
-			                                    sizeof(uint64_t) * pool.count,
-			                                    host_values.data(),
-			                                    sizeof(uint64_t),
-			                                    VkQueryResultFlagBits::VK_QUERY_RESULT_64_BIT | VkQueryResultFlagBits::VK_QUERY_RESULT_WAIT_BIT);
-			if (result != VK_SUCCESS) {
-				return { expected_error, AllocateException{ result } };
-			}
+			VUK_DO_OR_RETURN(make_timestamp_results_available(pool.pool, std::span(pool.queries, pool.count)));
+		}
+
+		return { expected_value };
+	}
 
-			for (uint64_t i = 0; i < pool.count; i++) {
-				impl->timestamp_result_map.emplace(pool.queries[i], host_values[i]);
+	Result<void> Context::make_timestamp_results_available(VkQueryPool pool, std::span<const Query> queries) {
+		if (queries.empty()) {
+			return { expected_value };
+		}
+		// value and availability for each query
+		std::vector<uint64_t> host_values(2 * queries.size());
+		auto result = vkGetQueryPoolResults(device,
+		                                    pool,
+		                                    0,
+		                                    (uint32_t)queries.size(),
+		                                    sizeof(uint64_t) * host_values.size(),
+		                                    host_values.data(),
+		                                    2 * sizeof(uint64_t),
+		                                    VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+		if (result != VK_SUCCESS && result != VK_NOT_READY) {
+			return { expected_error, AllocateException{ result } };
+		}
+
+		std::scoped_lock _(impl->query_lock);
+		auto oldest = std::min_element(queries.begin(), queries.end(), [](const Query& a, const Query& b) { return a.id < b.id; })->id;
+		assert(oldest < impl->query_id_counter && "Query was not created by this Context");
+		impl->reserve_timestamp_results(oldest);
+		auto& results = impl->timestamp_results;
+		for (size_t i = 0; i < queries.size(); i++) {
+			if (host_values[2 * i + 1] != 0) {
+				results[queries[i].id & (results.size() - 1)] = { queries[i].id, host_values[2 * i], true };
 			}
 		}
 
@@ -1,5 +1,7 @@
 #include "Cache.hpp"
 #include "LegacyGPUAllocator.hpp"
+#include "PassProfiler.hpp"
+#include "PipelineLibrary.hpp"
 #include "RGImage.hpp"
 #include "RenderPass.hpp"
 #include "vuk/Allocator.hpp"
@@ -8,7 +10,9 @@
 #include "vuk/Query.hpp"
 #include "vuk/resources/DeviceVkResource.hpp"
 
+#include <algorithm>
 #include <atomic>
+#include <bit>
 #include <math.h>
 #include <mutex>
 #include <plf_colony.h>
@@ -22,6 +26,18 @@ namespace vuk {
 		VkDevice device;
 
 		VkPipelineCache vk_pipeline_cache = VK_NULL_HANDLE;
+		PipelineLibraryCache pipeline_libraries;
+
+		// pipeline bases are pointed to by pipeline instances and named pipelines - count those references as they are made and dropped,
+		// so that collecting bases does not need to scan the pipeline caches
+		// (declared before the caches, as destroying the pipeline caches drops references)
+		struct BaseReferences {
+			uint32_t count = 0;
+			uint64_t last_release_frame = 0;
+		};
+		std::mutex base_references_lock;
+		robin_hood::unordered_flat_map<const PipelineBaseInfo*, BaseReferences> base_references;
+
 		Cache<PipelineBaseInfo> pipelinebase_cache;
 		Cache<PipelineInfo> pipeline_cache;
 		Cache<ComputePipelineInfo> compute_pipeline_cache;
@@ -50,45 +66,125 @@ namespace vuk {
 		DeviceVkResource device_vk_resource;
 
 		std::mutex query_lock;
-		robin_hood::unordered_map<Query, uint64_t> timestamp_result_map;
+		// timestamp results in a ring indexed by Query id, sized to twice the span of ids in flight when results are published
+		// results that are not retrieved are overwritten eventually, so the storage stays bounded
+		// the ring is capped, as a long-lived Query keeps the span growing: results of ids that are that far apart expire
+		static constexpr size_t max_timestamp_results = 1 << 16;
+		struct TimestampResult {
+			uint64_t id = UINT64_MAX;
+			uint64_t value = 0;
+			bool available = false;
+		};
+		std::vector<TimestampResult> timestamp_results;
+
+		// must be called with query_lock held
+		TimestampResult* find_timestamp_result(Query q) {
+			if (timestamp_results.empty()) {
+				return nullptr;
+			}
+			auto& r = timestamp_results[q.id & (timestamp_results.size() - 1)];
+			return r.id == q.id && r.available ? &r : nullptr;
+		}
+
+		// must be called with query_lock held
+		void reserve_timestamp_results(uint64_t oldest_id) {
+			size_t needed = std::bit_ceil(std::clamp<uint64_t>(2 * (query_id_counter - oldest_id), 256, max_timestamp_results));
+			if (timestamp_results.size() >= needed) {
+				return;
+			}
+			std::vector<TimestampResult> grown(needed);
+			for (auto& r : timestamp_results) {
+				if (r.available) {
+					grown[r.id & (needed - 1)] = r;
+				}
+			}
+			timestamp_results.swap(grown);
+		}
+
+		PassProfiler pass_profiler;
+
+		std::mutex memory_budget_lock;
+		float memory_budget_threshold = 0.9f;
+		std::function<void(const MemoryStatistics&, uint32_t)> memory_budget_callback;
+		std::array<uint64_t, VK_MAX_MEMORY_HEAPS> heap_peak_usage = {};
+		// bit i is set if heap i was above the threshold in the last check
+		std::atomic<uint32_t> heaps_under_pressure = 0;
+
+		static constexpr uint32_t cache_collection_frequency = 16;
 
 		void collect(uint64_t absolute_frame) {
-			transient_images.collect(absolute_frame, 6);
-			// collect rarer resources
-			static constexpr uint32_t cache_collection_frequency = 16;
-			auto remainder = absolute_frame % cache_collection_frequency;
-			switch (remainder) {
-			case 0:
-				pipeline_cache.collect(absolute_frame, cache_collection_frequency);
-				break;
-			case 1:
-				compute_pipeline_cache.collect(absolute_frame, cache_collection_frequency);
-				break;
-			case 2:
-				renderpass_cache.collect(absolute_frame, cache_collection_frequency);
-				break;
-				/*case 3:
-				  ptc.impl->sampler_cache.collect(cache_collection_frequency); break;*/ // sampler cache can't be collected due to persistent descriptor sets
-			case 4:
-				pipeline_layouts.collect(absolute_frame, cache_collection_frequency);
-				break;
-			/* case 5:
-				pipelinebase_cache.collect(absolute_frame, cache_collection_frequency);
-				break;*/ // can't be collected since we keep the pointer around in PipelineInfos
-			case 6:
-				pool_cache.collect(absolute_frame, cache_collection_frequency);
-				break;
+			// every cache is collected every frame, but the collection policies bound the work done per frame
+			pipeline_libraries.collect(pipeline_cache, absolute_frame, cache_collection_frequency);
+			transient_images.collect(absolute_frame);
+			pipeline_cache.collect(absolute_frame);
+			compute_pipeline_cache.collect(absolute_frame);
+			renderpass_cache.collect(absolute_frame);
+			pipeline_layouts.collect(absolute_frame);
+			pool_cache.collect(absolute_frame);
+			sampler_cache.collect(absolute_frame);
+			// bases are kept while referenced, and for a while after the last reference was dropped
+			pipelinebase_cache.collect(absolute_frame, [&](const PipelineBaseInfo& pbi) { return is_base_referenced(&pbi, absolute_frame); });
+		}
+
+		void reference_base(const PipelineBaseInfo* base) {
+			std::lock_guard _(base_references_lock);
+			base_references[base].count++;
+		}
+
+		void release_base(const PipelineBaseInfo* base) {
+			std::lock_guard _(base_references_lock);
+			auto& refs = base_references[base];
+			assert(refs.count > 0);
+			refs.count--;
+			refs.last_release_frame = frame_counter;
+		}
+
+		bool is_base_referenced(const PipelineBaseInfo* base, uint64_t absolute_frame) {
+			std::lock_guard _(base_references_lock);
+			auto it = base_references.find(base);
+			if (it == base_references.end()) {
+				return false;
 			}
+			return it->second.count > 0 || absolute_frame - it->second.last_release_frame <= cache_collection_frequency;
+		}
+
+		void set_default_collection_policies() {
+			// transient images are large and churn with resolution changes: keep them for a few frames, and evict the largest first under pressure
+			CacheCollectionPolicy images;
+			images.threshold = 6;
+			images.min_threshold = 3;
+			images.entries_per_collect = 64;
+			images.memory_budget = 1024ull * 1024 * 1024;
+			transient_images.set_collection_policy(images);
+
+			CacheCollectionPolicy objects;
+			objects.threshold = cache_collection_frequency;
+			objects.entries_per_collect = 32;
+			objects.time_budget = std::chrono::microseconds(100);
+			pipeline_cache.set_collection_policy(objects);
+			compute_pipeline_cache.set_collection_policy(objects);
+			renderpass_cache.set_collection_policy(objects);
+			pipeline_layouts.set_collection_policy(objects);
+			pool_cache.set_collection_policy(objects);
+			sampler_cache.set_collection_policy(objects);
+
+			CacheCollectionPolicy bases;
+			bases.threshold = 2 * cache_collection_frequency;
+			bases.entries_per_collect = 32;
+			pipelinebase_cache.set_collection_policy(bases);
 		}
 
-		ContextImpl(Context& ctx) :
+		ContextImpl(Context& ctx, const ContextCreateParameters& params) :
 		    legacy_gpu_allocator(ctx.instance,
 		                         ctx.device,
 		                         ctx.physical_device,
 		                         ctx.graphics_queue_family_index,
 		                         ctx.compute_queue_family_index,
-		                         ctx.transfer_queue_family_index),
+		                         ctx.transfer_queue_family_index,
+		                         params.memory_budget,
+		                         params.exclusive_buffers),
 		    device(ctx.device),
+		    pipeline_libraries(ctx, vk_pipeline_cache, params.graphics_pipeline_library, params.background_optimized_pipeline_link),
 		    pipelinebase_cache(ctx),
 		    pipeline_cache(ctx),
 		    compute_pipeline_cache(ctx),
@@ -99,8 +195,10 @@ namespace vuk {
 		    shader_modules(ctx),
 		    descriptor_set_layouts(ctx),
 		    pipeline_layouts(ctx),
-		    device_vk_resource(ctx, legacy_gpu_allocator) {
+		    device_vk_resource(ctx, legacy_gpu_allocator),
+		    pass_profiler(ctx.device, ctx.physical_device, params.pipeline_statistics_query) {
 			vkGetPhysicalDeviceProperties(ctx.physical_device, &physical_device_properties);
+			set_default_collection_policies();
 		}
 	};
 } // namespace vuk
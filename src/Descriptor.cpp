@@ -92,7 +92,7 @@ namespace vuk {
 			}
 		}
 
-		final.hash = robin_hood::hash_bytes(reinterpret_cast<const char*>(&final.bindings[0]), VUK_MAX_BINDINGS * sizeof(DescriptorBinding));
+		final.hash = ::hash::hash_bytes(reinterpret_cast<const char*>(&final.bindings[0]), VUK_MAX_BINDINGS * sizeof(DescriptorBinding));
 		hash_combine(final.hash, layout_info->layout);
 		return final;
 	}
@@ -1,11 +1,16 @@
 #include "vuk/resources/DeviceFrameResource.hpp"
 #include "../src/LegacyGPUAllocator.hpp"
+#include "AppendList.hpp"
 #include "vuk/Context.hpp"
 #include "vuk/Query.hpp"
+#include "vuk/Tracing.hpp"
 #include "vuk/Descriptor.hpp"
 #include "RenderPass.hpp"
 
+#include <algorithm>
 #include <atomic>
+#include <memory>
+#include <thread>
 
 namespace vuk {
 	struct DeviceSuperFrameResourceImpl {
@@ -17,50 +22,86 @@ namespace vuk {
 		DeviceFrameResource* frames;
 
 		std::mutex command_pool_mutex;
-		std::array<std::vector<VkCommandPool>, 3> command_pools;
+		// recycled command pools, handed out again for the same queue family and create flags
+		std::vector<CommandPool> command_pools;
+
+		// sync objects of recycled frames, fences and events are reset before being put here
+		std::mutex sync_pool_mutex;
+		std::vector<VkSemaphore> semaphore_pool;
+		std::vector<VkFence> fence_pool;
+		std::vector<VkEvent> event_pool;
+		std::vector<TimelineSemaphore> timeline_semaphore_pool;
 
 		DeviceSuperFrameResourceImpl(DeviceSuperFrameResource& sfr, size_t frames_in_flight) {
 			frames_storage = std::unique_ptr<char[]>(new char[sizeof(DeviceFrameResource) * frames_in_flight]);
 			for (uint64_t i = 0; i < frames_in_flight; i++) {
-				new (frames_storage.get() + i * sizeof(DeviceFrameResource)) DeviceFrameResource(sfr.direct.device, sfr);
+				new (frames_storage.get() + i * sizeof(DeviceFrameResource)) DeviceFrameResource(sfr.device, sfr);
 			}
 			frames = reinterpret_cast<DeviceFrameResource*>(frames_storage.get());
 		}
 	};
 
+	namespace {
+		// without a legacy allocator (for a given direct resource) the linear allocators stay empty
+		LegacyLinearAllocator make_linear_allocator(LegacyGPUAllocator* legacy, MemoryUsage mem_usage) {
+			return legacy ? legacy->allocate_linear(mem_usage, LegacyGPUAllocator::all_usage) : LegacyLinearAllocator{ {}, VMA_MEMORY_USAGE_UNKNOWN, {} };
+		}
+
+		// epochs are unique across frames, so a cached pool can't be mistaken for one of a frame later constructed at the same address
+		std::atomic<uint64_t> next_command_pool_epoch = 1;
+	} // namespace
+
 	struct DeviceFrameResourceImpl {
-		std::mutex sema_mutex;
-		std::vector<VkSemaphore> semaphores;
+		// handles to deallocate when the frame is recycled, these are pushed to from all recording threads without locking
+		AppendList<VkSemaphore> semaphores;
+		AppendList<VkFence> fences;
+		AppendList<VkEvent> events;
 
-		std::mutex fence_mutex;
-		std::vector<VkFence> fences;
 		std::mutex cbuf_mutex;
 		std::vector<CommandBufferAllocation> cmdbuffers_to_free;
-		std::vector<CommandPool> cmdpools_to_free;
-		std::mutex framebuffer_mutex;
-		std::vector<VkFramebuffer> framebuffers;
-		std::mutex images_mutex;
-		std::vector<Image> images;
-		std::mutex image_views_mutex;
-		std::vector<ImageView> image_views;
+		// command pools owned by this frame, one per (thread, queue family, create flags)
+		// they are reset when the frame is recycled, and their command buffers are handed out again
+		// a pool and its command buffers are only touched by the thread owning it, so only adding pools needs cbuf_mutex
+		struct FrameCommandPool {
+			CommandPool pool;
+			std::thread::id thread;
+			std::array<std::vector<VkCommandBuffer>, 2> command_buffers = {}; // primary, secondary
+			std::array<size_t, 2> used = {};
+			bool handed_out = false;
+		};
+		std::vector<std::unique_ptr<FrameCommandPool>> command_pools;
+		// changes whenever command_pools is recycled, invalidating the pools cached by the recording threads
+		std::atomic<uint64_t> command_pool_epoch = next_command_pool_epoch++;
+		AppendList<VkFramebuffer> framebuffers;
+		AppendList<Image> images;
+		AppendList<ImageView> image_views;
 		std::mutex pds_mutex;
 		std::vector<PersistentDescriptorSet> persistent_descriptor_sets;
-		std::mutex ds_mutex;
-		std::vector<DescriptorSet> descriptor_sets;
+		AppendList<DescriptorSet> descriptor_sets;
 		// only for use via SuperframeAllocator
-		std::mutex buffers_mutex;
-		std::vector<BufferGPU> buffer_gpus;
-		std::vector<BufferCrossDevice> buffer_cross_devices;
+		AppendList<BufferGPU> buffer_gpus;
+		AppendList<BufferCrossDevice> buffer_cross_devices;
 
 		std::vector<TimestampQueryPool> ts_query_pools;
 		std::mutex query_pool_mutex;
 		std::mutex ts_query_mutex;
-		uint64_t query_index = 0;
-		uint64_t current_ts_pool = 0;
-		std::mutex tsema_mutex;
-		std::vector<TimelineSemaphore> tsemas;
-		std::mutex swapchain_mutex;
-		std::vector<VkSwapchainKHR> swapchains;
+		// timestamp queries allocated without a pool come from pools owned by the frame, which are kept across recycles
+		// when a frame needed more than one pool, they are merged on recycle, so that all queries of a frame are read back with one call
+		struct FrameQueryPool {
+			TimestampQueryPool pool; // only the VkQueryPool is used
+			uint32_t capacity;
+			std::vector<Query> queries; // the Query written to each slot
+		};
+		static constexpr uint32_t initial_query_pool_size = 256;
+		std::vector<FrameQueryPool> frame_query_pools;
+		AppendList<TimelineSemaphore> tsemas;
+		// last queue timeline value signalled by submissions made with this frame, one slot per queue
+		struct Submission {
+			std::atomic<VkSemaphore> semaphore = VK_NULL_HANDLE;
+			std::atomic<uint64_t> value = 0;
+		};
+		std::array<Submission, 3> submissions;
+		AppendList<VkSwapchainKHR> swapchains;
 
 		LegacyLinearAllocator linear_cpu_only;
 		LegacyLinearAllocator linear_cpu_gpu;
@@ -68,12 +109,49 @@ namespace vuk {
 		LegacyLinearAllocator linear_gpu_only;
 
 		DeviceFrameResourceImpl(VkDevice device, DeviceSuperFrameResource& upstream) :
-		    linear_cpu_only(upstream.direct.legacy_gpu_allocator->allocate_linear(vuk::MemoryUsage::eCPUonly, LegacyGPUAllocator::all_usage)),
-		    linear_cpu_gpu(upstream.direct.legacy_gpu_allocator->allocate_linear(vuk::MemoryUsage::eCPUtoGPU, LegacyGPUAllocator::all_usage)),
-		    linear_gpu_cpu(upstream.direct.legacy_gpu_allocator->allocate_linear(vuk::MemoryUsage::eGPUtoCPU, LegacyGPUAllocator::all_usage)),
-		    linear_gpu_only(upstream.direct.legacy_gpu_allocator->allocate_linear(vuk::MemoryUsage::eGPUonly, LegacyGPUAllocator::all_usage)) {}
+		    linear_cpu_only(make_linear_allocator(upstream.legacy_gpu_allocator, vuk::MemoryUsage::eCPUonly)),
+		    linear_cpu_gpu(make_linear_allocator(upstream.legacy_gpu_allocator, vuk::MemoryUsage::eCPUtoGPU)),
+		    linear_gpu_cpu(make_linear_allocator(upstream.legacy_gpu_allocator, vuk::MemoryUsage::eGPUtoCPU)),
+		    linear_gpu_only(make_linear_allocator(upstream.legacy_gpu_allocator, vuk::MemoryUsage::eGPUonly)) {}
 	};
 
+	namespace {
+		// the pools most recently handed out to this thread, so that a thread recording into the same frame again can skip cbuf_mutex
+		struct CachedCommandPool {
+			const DeviceFrameResourceImpl* frame = nullptr;
+			uint64_t epoch = 0;
+			DeviceFrameResourceImpl::FrameCommandPool* pool = nullptr;
+		};
+		thread_local std::array<CachedCommandPool, 4> cached_command_pools;
+		thread_local size_t next_cached_command_pool = 0;
+
+		DeviceFrameResourceImpl::FrameCommandPool* find_cached_command_pool(const DeviceFrameResourceImpl* frame, auto&& pred) {
+			auto epoch = frame->command_pool_epoch.load(std::memory_order_acquire);
+			for (auto& c : cached_command_pools) {
+				if (c.frame == frame && c.epoch == epoch && pred(*c.pool)) {
+					return c.pool;
+				}
+			}
+			return nullptr;
+		}
+
+		void cache_command_pool(const DeviceFrameResourceImpl* frame, DeviceFrameResourceImpl::FrameCommandPool* pool) {
+			auto epoch = frame->command_pool_epoch.load(std::memory_order_acquire);
+			cached_command_pools[next_cached_command_pool++ % cached_command_pools.size()] = { frame, epoch, pool };
+		}
+
+		// a device frees command buffers along with their pool, a given direct resource gets them back one by one
+		void release_command_buffers(DeviceResource& direct, DeviceFrameResourceImpl::FrameCommandPool& p) {
+			for (auto& command_buffers : p.command_buffers) {
+				for (auto& cb : command_buffers) {
+					CommandBufferAllocation cba{ cb, p.pool };
+					direct.deallocate_command_buffers(std::span{ &cba, 1 });
+				}
+				command_buffers.clear();
+			}
+		}
+	} // namespace
+
 	DeviceFrameResource::DeviceFrameResource(VkDevice device, DeviceSuperFrameResource& upstream) :
 	    DeviceNestedResource(&upstream),
 	    device(device),
@@ -85,9 +163,7 @@ namespace vuk {
 
 	Result<void, AllocateException> DeviceFrameResource::allocate_semaphores(std::span<VkSemaphore> dst, SourceLocationAtFrame loc) {
 		VUK_DO_OR_RETURN(upstream->allocate_semaphores(dst, loc));
-		std::unique_lock _(impl->sema_mutex);
-		auto& vec = impl->semaphores;
-		vec.insert(vec.end(), dst.begin(), dst.end());
+		impl->semaphores.push(dst);
 		return { expected_value };
 	}
 
@@ -95,42 +171,94 @@ namespace vuk {
 
 	Result<void, AllocateException> DeviceFrameResource::allocate_fences(std::span<VkFence> dst, SourceLocationAtFrame loc) {
 		VUK_DO_OR_RETURN(upstream->allocate_fences(dst, loc));
-		std::unique_lock _(impl->fence_mutex);
-		auto& vec = impl->fences;
-		vec.insert(vec.end(), dst.begin(), dst.end());
+		impl->fences.push(dst);
 		return { expected_value };
 	}
 
 	void DeviceFrameResource::deallocate_fences(std::span<const VkFence> src) {} // noop
 
+	Result<void, AllocateException> DeviceFrameResource::allocate_events(std::span<VkEvent> dst, SourceLocationAtFrame loc) {
+		VUK_DO_OR_RETURN(upstream->allocate_events(dst, loc));
+		impl->events.push(dst);
+		return { expected_value };
+	}
+
+	void DeviceFrameResource::deallocate_events(std::span<const VkEvent> src) {} // noop
+
 	Result<void, AllocateException> DeviceFrameResource::allocate_command_buffers(std::span<CommandBufferAllocation> dst,
 	                                                                              std::span<const CommandBufferAllocationCreateInfo> cis,
 	                                                                              SourceLocationAtFrame loc) {
-		VUK_DO_OR_RETURN(upstream->allocate_command_buffers(dst, cis, loc));
-		std::unique_lock _(impl->cbuf_mutex);
-		auto& vec = impl->cmdbuffers_to_free;
-		vec.insert(vec.end(), dst.begin(), dst.end());
+		assert(dst.size() == cis.size());
+		for (uint64_t i = 0; i < dst.size(); i++) {
+			auto& ci = cis[i];
+			auto it = find_cached_command_pool(impl, [&](auto& p) { return p.pool == ci.command_pool; });
+			if (!it) {
+				std::unique_lock _(impl->cbuf_mutex);
+				auto pit = std::find_if(impl->command_pools.begin(), impl->command_pools.end(), [&](auto& p) { return p->pool == ci.command_pool; });
+				// pool not from this frame
+				if (pit == impl->command_pools.end()) {
+					VUK_DO_OR_RETURN(upstream->allocate_command_buffers(std::span{ &dst[i], 1 }, std::span{ &ci, 1 }, loc));
+					impl->cmdbuffers_to_free.push_back(dst[i]);
+					continue;
+				}
+				it = pit->get();
+			}
+			auto level = ci.level == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? 0 : 1;
+			auto& command_buffers = it->command_buffers[level];
+			auto& used = it->used[level];
+			if (used == command_buffers.size()) {
+				CommandBufferAllocation cba;
+				VUK_DO_OR_RETURN(upstream->allocate_command_buffers(std::span{ &cba, 1 }, std::span{ &ci, 1 }, loc));
+				command_buffers.push_back(cba.command_buffer);
+			}
+			dst[i] = CommandBufferAllocation{ command_buffers[used++], it->pool };
+		}
 		return { expected_value };
 	}
 
-	void DeviceFrameResource::deallocate_command_buffers(std::span<const CommandBufferAllocation> src) {} // no-op, deallocated with pools
+	void DeviceFrameResource::deallocate_command_buffers(std::span<const CommandBufferAllocation> src) {} // no-op, reused after the pools are reset
 
 	Result<void, AllocateException>
 	DeviceFrameResource::allocate_command_pools(std::span<CommandPool> dst, std::span<const VkCommandPoolCreateInfo> cis, SourceLocationAtFrame loc) {
-		VUK_DO_OR_RETURN(upstream->allocate_command_pools(dst, cis, loc));
-		std::unique_lock _(impl->cbuf_mutex);
-		auto& vec = impl->cmdpools_to_free;
-		vec.insert(vec.end(), dst.begin(), dst.end());
+		assert(dst.size() == cis.size());
+		auto thread = std::this_thread::get_id();
+		for (uint64_t i = 0; i < dst.size(); i++) {
+			auto& ci = cis[i];
+			auto matches = [&](auto& p) {
+				return p.thread == thread && p.pool.queue_family_index == ci.queueFamilyIndex && p.pool.flags == ci.flags;
+			};
+			// a cached pool has already been handed out in this epoch
+			auto it = find_cached_command_pool(impl, matches);
+			if (!it) {
+				std::unique_lock _(impl->cbuf_mutex);
+				auto pit = std::find_if(impl->command_pools.begin(), impl->command_pools.end(), [&](auto& p) { return matches(*p); });
+				if (pit == impl->command_pools.end()) {
+					CommandPool pool;
+					VUK_DO_OR_RETURN(upstream->allocate_command_pools(std::span{ &pool, 1 }, std::span{ &ci, 1 }, loc));
+					impl->command_pools.push_back(std::unique_ptr<DeviceFrameResourceImpl::FrameCommandPool>(new DeviceFrameResourceImpl::FrameCommandPool{ pool, thread }));
+					pit = impl->command_pools.end() - 1;
+				}
+				it = pit->get();
+				it->handed_out = true;
+				cache_command_pool(impl, it);
+			}
+			dst[i] = it->pool;
+		}
 		return { expected_value };
 	}
 
-	void DeviceFrameResource::deallocate_command_pools(std::span<const CommandPool> dst) {} // no-op
+	void DeviceFrameResource::deallocate_command_pools(std::span<const CommandPool> dst) {} // no-op, owned by the frame
 
 	Result<void, AllocateException>
 	DeviceFrameResource::allocate_buffers(std::span<BufferCrossDevice> dst, std::span<const BufferCreateInfo> cis, SourceLocationAtFrame loc) {
 		assert(dst.size() == cis.size());
 		auto& rf = *static_cast<DeviceSuperFrameResource*>(upstream);
-		auto& legacy = *rf.direct.legacy_gpu_allocator;
+		if (!rf.legacy_gpu_allocator) {
+			VUK_DO_OR_RETURN(upstream->allocate_buffers(dst, cis, loc));
+			impl->buffer_cross_devices.push(dst);
+			return { expected_value };
+		}
+		auto& legacy = *rf.legacy_gpu_allocator;
 
 		// TODO: legacy allocator can't signal errors
 		// TODO: legacy linear allocators don't nest
@@ -156,7 +284,12 @@ namespace vuk {
 	DeviceFrameResource::allocate_buffers(std::span<BufferGPU> dst, std::span<const BufferCreateInfo> cis, SourceLocationAtFrame loc) {
 		assert(dst.size() == cis.size());
 		auto& rf = *static_cast<DeviceSuperFrameResource*>(upstream);
-		auto& legacy = *rf.direct.legacy_gpu_allocator;
+		if (!rf.legacy_gpu_allocator) {
+			VUK_DO_OR_RETURN(upstream->allocate_buffers(dst, cis, loc));
+			impl->buffer_gpus.push(dst);
+			return { expected_value };
+		}
+		auto& legacy = *rf.legacy_gpu_allocator;
 
 		// TODO: legacy allocator can't signal errors
 		// TODO: legacy linear allocators don't nest
@@ -177,9 +310,7 @@ namespace vuk {
 	Result<void, AllocateException>
 	DeviceFrameResource::allocate_framebuffers(std::span<VkFramebuffer> dst, std::span<const FramebufferCreateInfo> cis, SourceLocationAtFrame loc) {
 		VUK_DO_OR_RETURN(upstream->allocate_framebuffers(dst, cis, loc));
-		std::unique_lock _(impl->framebuffer_mutex);
-		auto& vec = impl->framebuffers;
-		vec.insert(vec.end(), dst.begin(), dst.end());
+		impl->framebuffers.push(dst);
 		return { expected_value };
 	}
 
@@ -187,9 +318,7 @@ namespace vuk {
 
 	Result<void, AllocateException> DeviceFrameResource::allocate_images(std::span<Image> dst, std::span<const ImageCreateInfo> cis, SourceLocationAtFrame loc) {
 		VUK_DO_OR_RETURN(upstream->allocate_images(dst, cis, loc));
-		std::unique_lock _(impl->images_mutex);
-		auto& vec = impl->images;
-		vec.insert(vec.end(), dst.begin(), dst.end());
+		impl->images.push(dst);
 		return { expected_value };
 	}
 
@@ -198,10 +327,7 @@ namespace vuk {
 	Result<void, AllocateException>
 	DeviceFrameResource::allocate_image_views(std::span<ImageView> dst, std::span<const ImageViewCreateInfo> cis, SourceLocationAtFrame loc) {
 		VUK_DO_OR_RETURN(upstream->allocate_image_views(dst, cis, loc));
-		std::unique_lock _(impl->image_views_mutex);
-
-		auto& vec = impl->image_views;
-		vec.insert(vec.end(), dst.begin(), dst.end());
+		impl->image_views.push(dst);
 		return { expected_value };
 	}
 
@@ -223,11 +349,7 @@ namespace vuk {
 	Result<void, AllocateException>
 	DeviceFrameResource::allocate_descriptor_sets(std::span<DescriptorSet> dst, std::span<const SetBinding> cis, SourceLocationAtFrame loc) {
 		VUK_DO_OR_RETURN(upstream->allocate_descriptor_sets(dst, cis, loc));
-
-		std::unique_lock _(impl->ds_mutex);
-
-		auto& vec = impl->descriptor_sets;
-		vec.insert(vec.end(), dst.begin(), dst.end());
+		impl->descriptor_sets.push(dst);
 		return { expected_value };
 	}
 
@@ -258,26 +380,23 @@ namespace vuk {
 				ci.pool->queries[ci.pool->count++] = ci.query;
 				dst[i].id = ci.pool->count;
 				dst[i].pool = ci.pool->pool;
-			} else { // allocate a pool on demand
-				std::unique_lock _(impl->query_pool_mutex);
-				if (impl->query_index % TimestampQueryPool::num_queries == 0) {
+			} else { // allocate from the pools of the frame, growing them on demand
+				auto& pools = impl->frame_query_pools;
+				if (pools.empty() || pools.back().queries.size() == pools.back().capacity) {
+					VUK_TRACE_ZONE("vuk::DeviceFrameResource::grow_query_pools");
+					auto capacity = pools.empty() ? DeviceFrameResourceImpl::initial_query_pool_size : 2 * pools.back().capacity;
 					VkQueryPoolCreateInfo qpci{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
-					qpci.queryCount = TimestampQueryPool::num_queries;
+					qpci.queryCount = capacity;
 					qpci.queryType = VK_QUERY_TYPE_TIMESTAMP;
 					TimestampQueryPool p;
 					VUK_DO_OR_RETURN(upstream->allocate_timestamp_query_pools(std::span{ &p, 1 }, std::span{ &qpci, 1 }, loc));
-
-					auto& vec = impl->ts_query_pools;
-					vec.emplace_back(p);
-					impl->current_ts_pool = vec.size() - 1;
+					pools.push_back({ p, capacity });
 				}
 
-				auto& pool = impl->ts_query_pools[impl->current_ts_pool];
-				pool.queries[pool.count++] = ci.query;
-				dst[i].id = pool.count - 1;
-				dst[i].pool = pool.pool;
-
-				impl->query_index++;
+				auto& pool = pools.back();
+				dst[i].id = (uint32_t)pool.queries.size();
+				dst[i].pool = pool.pool.pool;
+				pool.queries.push_back(ci.query);
 			}
 		}
 
@@ -288,74 +407,168 @@ namespace vuk {
 
 	Result<void, AllocateException> DeviceFrameResource::allocate_timeline_semaphores(std::span<TimelineSemaphore> dst, SourceLocationAtFrame loc) {
 		VUK_DO_OR_RETURN(upstream->allocate_timeline_semaphores(dst, loc));
-		std::unique_lock _(impl->tsema_mutex);
-
-		auto& vec = impl->tsemas;
-		vec.insert(vec.end(), dst.begin(), dst.end());
+		impl->tsemas.push(dst);
 		return { expected_value };
 	}
 
 	void DeviceFrameResource::deallocate_timeline_semaphores(std::span<const TimelineSemaphore> src) {} // noop
 
 	void DeviceFrameResource::deallocate_swapchains(std::span<const VkSwapchainKHR> src) {
-		std::scoped_lock _(impl->swapchain_mutex);
-
-		auto& vec = impl->swapchains;
-		vec.insert(vec.end(), src.begin(), src.end());
+		impl->swapchains.push(src);
 	}
 
-	void DeviceFrameResource::wait() {
-		if (impl->fences.size() > 0) {
-			vkWaitForFences(device, (uint32_t)impl->fences.size(), impl->fences.data(), true, UINT64_MAX);
+	bool DeviceFrameResource::track_submission(VkSemaphore timeline_semaphore, uint64_t value) {
+		// only the last value per queue needs to be waited on
+		for (auto& s : impl->submissions) {
+			VkSemaphore sema = s.semaphore.load(std::memory_order_acquire);
+			if (sema == VK_NULL_HANDLE && s.semaphore.compare_exchange_strong(sema, timeline_semaphore, std::memory_order_acq_rel)) {
+				sema = timeline_semaphore;
+			}
+			if (sema != timeline_semaphore) {
+				continue;
+			}
+			uint64_t last = s.value.load(std::memory_order_relaxed);
+			while (last < value && !s.value.compare_exchange_weak(last, value, std::memory_order_relaxed)) {
+			}
+			return true;
 		}
-		if (impl->tsemas.size() > 0) {
-			VkSemaphoreWaitInfo swi{ VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+		return false; // more timelines than queues
+	}
 
-			std::vector<VkSemaphore> semas(impl->tsemas.size());
-			std::vector<uint64_t> values(impl->tsemas.size());
+	ResourceMemoryStatistics DeviceFrameResource::get_memory_statistics() {
+		auto* legacy_ptr = static_cast<DeviceSuperFrameResource*>(upstream)->legacy_gpu_allocator;
+		if (!legacy_ptr) {
+			return {}; // buffers are accounted for by the direct resource
+		}
+		auto& legacy = *legacy_ptr;
+		uint64_t bytes = legacy.get_footprint(impl->linear_cpu_only) + legacy.get_footprint(impl->linear_cpu_gpu) +
+		                 legacy.get_footprint(impl->linear_gpu_cpu) + legacy.get_footprint(impl->linear_gpu_only);
+		// blocks are kept when the frame is recycled, the linear allocators only shrink when trimmed
+		return { bytes, bytes };
+	}
 
-			for (uint64_t i = 0; i < impl->tsemas.size(); i++) {
-				semas[i] = impl->tsemas[i].semaphore;
-				values[i] = *impl->tsemas[i].value;
+	void DeviceFrameResource::wait() {
+		if (device == VK_NULL_HANDLE) {
+			return; // the sync objects of a given direct resource are not real
+		}
+		impl->fences.for_each_chunk([&](std::span<VkFence> fences) { vkWaitForFences(device, (uint32_t)fences.size(), fences.data(), true, UINT64_MAX); });
+
+		// wait in batches, gathered on the stack
+		std::array<VkSemaphore, 64> semas;
+		std::array<uint64_t, 64> values;
+		uint32_t count = 0;
+		auto flush = [&]() {
+			if (count == 0) {
+				return;
 			}
+			VkSemaphoreWaitInfo swi{ VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
 			swi.pSemaphores = semas.data();
 			swi.pValues = values.data();
-			swi.semaphoreCount = (uint32_t)impl->tsemas.size();
+			swi.semaphoreCount = count;
 			vkWaitSemaphores(device, &swi, UINT64_MAX);
+			count = 0;
+		};
+		auto add = [&](VkSemaphore sema, uint64_t value) {
+			semas[count] = sema;
+			values[count] = value;
+			if (++count == semas.size()) {
+				flush();
+			}
+		};
+		impl->tsemas.for_each_chunk([&](std::span<TimelineSemaphore> tsemas) {
+			for (auto& ts : tsemas) {
+				add(ts.semaphore, *ts.value);
+			}
+		});
+		for (auto& s : impl->submissions) {
+			if (auto sema = s.semaphore.load(std::memory_order_acquire); sema != VK_NULL_HANDLE) {
+				add(sema, s.value.load(std::memory_order_relaxed));
+			}
 		}
+		flush();
 	}
 
 	DeviceSuperFrameResource::DeviceSuperFrameResource(Context& ctx, uint64_t frames_in_flight) :
 	    frames_in_flight(frames_in_flight),
-	    direct(ctx, ctx.get_legacy_gpu_allocator()),
+	    owned_direct(new DeviceVkResource(ctx, ctx.get_legacy_gpu_allocator())) {
+		direct = owned_direct.get();
+		device = owned_direct->device;
+		legacy_gpu_allocator = owned_direct->legacy_gpu_allocator;
+		impl = new DeviceSuperFrameResourceImpl(*this, frames_in_flight);
+	}
+
+	DeviceSuperFrameResource::DeviceSuperFrameResource(DeviceResource& upstream, uint64_t frames_in_flight) :
+	    frames_in_flight(frames_in_flight),
+	    direct(&upstream),
 	    impl(new DeviceSuperFrameResourceImpl(*this, frames_in_flight)) {}
 
 	Result<void, AllocateException> DeviceSuperFrameResource::allocate_semaphores(std::span<VkSemaphore> dst, SourceLocationAtFrame loc) {
-		return direct.allocate_semaphores(dst, loc);
+		std::unique_lock _(impl->sync_pool_mutex);
+		auto& pool = impl->semaphore_pool;
+		auto from_pool = std::min(pool.size(), dst.size());
+		std::copy(pool.end() - from_pool, pool.end(), dst.begin());
+		pool.resize(pool.size() - from_pool);
+		_.unlock();
+		if (from_pool < dst.size()) {
+			auto result = direct->allocate_semaphores(dst.subspan(from_pool), loc);
+			if (!result) {
+				deallocate_semaphores(dst.subspan(0, from_pool));
+				return result;
+			}
+		}
+		return { expected_value };
 	}
 
 	void DeviceSuperFrameResource::deallocate_semaphores(std::span<const VkSemaphore> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->sema_mutex);
-		auto& vec = get_last_frame().impl->semaphores;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->semaphores.push(src);
 	}
 
 	Result<void, AllocateException> DeviceSuperFrameResource::allocate_fences(std::span<VkFence> dst, SourceLocationAtFrame loc) {
-		return direct.allocate_fences(dst, loc);
+		std::unique_lock _(impl->sync_pool_mutex);
+		auto& pool = impl->fence_pool;
+		auto from_pool = std::min(pool.size(), dst.size());
+		std::copy(pool.end() - from_pool, pool.end(), dst.begin());
+		pool.resize(pool.size() - from_pool);
+		_.unlock();
+		if (from_pool < dst.size()) {
+			auto result = direct->allocate_fences(dst.subspan(from_pool), loc);
+			if (!result) {
+				deallocate_fences(dst.subspan(0, from_pool));
+				return result;
+			}
+		}
+		return { expected_value };
 	}
 
 	void DeviceSuperFrameResource::deallocate_fences(std::span<const VkFence> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->fence_mutex);
-		auto& vec = f.impl->fences;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->fences.push(src);
+	}
+
+	Result<void, AllocateException> DeviceSuperFrameResource::allocate_events(std::span<VkEvent> dst, SourceLocationAtFrame loc) {
+		std::unique_lock _(impl->sync_pool_mutex);
+		auto& pool = impl->event_pool;
+		auto from_pool = std::min(pool.size(), dst.size());
+		std::copy(pool.end() - from_pool, pool.end(), dst.begin());
+		pool.resize(pool.size() - from_pool);
+		_.unlock();
+		if (from_pool < dst.size()) {
+			auto result = direct->allocate_events(dst.subspan(from_pool), loc);
+			if (!result) {
+				deallocate_events(dst.subspan(0, from_pool));
+				return result;
+			}
+		}
+		return { expected_value };
+	}
+
+	void DeviceSuperFrameResource::deallocate_events(std::span<const VkEvent> src) {
+		get_last_frame().impl->events.push(src);
 	}
 
 	Result<void, AllocateException> DeviceSuperFrameResource::allocate_command_buffers(std::span<CommandBufferAllocation> dst,
 	                                                                                   std::span<const CommandBufferAllocationCreateInfo> cis,
 	                                                                                   SourceLocationAtFrame loc) {
-		return direct.allocate_command_buffers(dst, cis, loc);
+		return direct->allocate_command_buffers(dst, cis, loc);
 	}
 
 	void DeviceSuperFrameResource::deallocate_command_buffers(std::span<const CommandBufferAllocation> src) {
@@ -371,12 +584,14 @@ namespace vuk {
 		assert(cis.size() == dst.size());
 		for (uint64_t i = 0; i < dst.size(); i++) {
 			auto& ci = cis[i];
-			auto& source = impl->command_pools[ci.queueFamilyIndex];
-			if (source.size() > 0) {
-				dst[i] = { source.back(), ci.queueFamilyIndex };
-				source.pop_back();
+			auto it = std::find_if(impl->command_pools.rbegin(), impl->command_pools.rend(), [&](auto& p) {
+				return p.queue_family_index == ci.queueFamilyIndex && p.flags == ci.flags;
+			});
+			if (it != impl->command_pools.rend()) {
+				dst[i] = *it;
+				impl->command_pools.erase(std::next(it).base());
 			} else {
-				VUK_DO_OR_RETURN(direct.allocate_command_pools(std::span{ &dst[i], 1 }, std::span{ &ci, 1 }, loc));
+				VUK_DO_OR_RETURN(direct->allocate_command_pools(std::span{ &dst[i], 1 }, std::span{ &ci, 1 }, loc));
 			}
 		}
 		return { expected_value };
@@ -385,74 +600,59 @@ namespace vuk {
 	void DeviceSuperFrameResource::deallocate_command_pools(std::span<const CommandPool> src) {
 		std::scoped_lock _(impl->command_pool_mutex);
 		for (auto& p : src) {
-			impl->command_pools[p.queue_family_index].push_back(p.command_pool);
+			impl->command_pools.push_back(p);
 		}
 	}
 
 	Result<void, AllocateException>
 	DeviceSuperFrameResource::allocate_buffers(std::span<BufferCrossDevice> dst, std::span<const BufferCreateInfo> cis, SourceLocationAtFrame loc) {
-		return direct.allocate_buffers(dst, cis, loc);
+		return direct->allocate_buffers(dst, cis, loc);
 	}
 
 	void DeviceSuperFrameResource::deallocate_buffers(std::span<const BufferCrossDevice> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->buffers_mutex);
-		auto& vec = f.impl->buffer_cross_devices;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->buffer_cross_devices.push(src);
 	}
 
 	Result<void, AllocateException>
 	DeviceSuperFrameResource::allocate_buffers(std::span<BufferGPU> dst, std::span<const BufferCreateInfo> cis, SourceLocationAtFrame loc) {
-		return direct.allocate_buffers(dst, cis, loc);
+		return direct->allocate_buffers(dst, cis, loc);
 	}
 
 	void DeviceSuperFrameResource::deallocate_buffers(std::span<const BufferGPU> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->buffers_mutex);
-		auto& vec = f.impl->buffer_gpus;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->buffer_gpus.push(src);
 	}
 
 	Result<void, AllocateException>
 	DeviceSuperFrameResource::allocate_framebuffers(std::span<VkFramebuffer> dst, std::span<const FramebufferCreateInfo> cis, SourceLocationAtFrame loc) {
-		return direct.allocate_framebuffers(dst, cis, loc);
+		return direct->allocate_framebuffers(dst, cis, loc);
 	}
 
 	void DeviceSuperFrameResource::deallocate_framebuffers(std::span<const VkFramebuffer> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->framebuffer_mutex);
-		auto& vec = f.impl->framebuffers;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->framebuffers.push(src);
 	}
 
 	Result<void, AllocateException>
 	DeviceSuperFrameResource::allocate_images(std::span<Image> dst, std::span<const ImageCreateInfo> cis, SourceLocationAtFrame loc) {
-		return direct.allocate_images(dst, cis, loc);
+		return direct->allocate_images(dst, cis, loc);
 	}
 
 	void DeviceSuperFrameResource::deallocate_images(std::span<const Image> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->images_mutex);
-		auto& vec = f.impl->images;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->images.push(src);
 	}
 
 	Result<void, AllocateException>
 	DeviceSuperFrameResource::allocate_image_views(std::span<ImageView> dst, std::span<const ImageViewCreateInfo> cis, SourceLocationAtFrame loc) {
-		return direct.allocate_image_views(dst, cis, loc);
+		return direct->allocate_image_views(dst, cis, loc);
 	}
 
 	void DeviceSuperFrameResource::deallocate_image_views(std::span<const ImageView> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->image_views_mutex);
-		auto& vec = f.impl->image_views;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->image_views.push(src);
 	}
 
 	Result<void, AllocateException> DeviceSuperFrameResource::allocate_persistent_descriptor_sets(std::span<PersistentDescriptorSet> dst,
 	                                                                                              std::span<const PersistentDescriptorSetCreateInfo> cis,
 	                                                                                              SourceLocationAtFrame loc) {
-		return direct.allocate_persistent_descriptor_sets(dst, cis, loc);
+		return direct->allocate_persistent_descriptor_sets(dst, cis, loc);
 	}
 
 	void DeviceSuperFrameResource::deallocate_persistent_descriptor_sets(std::span<const PersistentDescriptorSet> src) {
@@ -464,20 +664,17 @@ namespace vuk {
 
 	Result<void, AllocateException>
 	DeviceSuperFrameResource::allocate_descriptor_sets(std::span<DescriptorSet> dst, std::span<const SetBinding> cis, SourceLocationAtFrame loc) {
-		return direct.allocate_descriptor_sets(dst, cis, loc);
+		return direct->allocate_descriptor_sets(dst, cis, loc);
 	}
 
 	void DeviceSuperFrameResource::deallocate_descriptor_sets(std::span<const DescriptorSet> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->ds_mutex);
-		auto& vec = f.impl->descriptor_sets;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->descriptor_sets.push(src);
 	}
 
 	Result<void, AllocateException> DeviceSuperFrameResource::allocate_timestamp_query_pools(std::span<TimestampQueryPool> dst,
 	                                                                                         std::span<const VkQueryPoolCreateInfo> cis,
 	                                                                                         SourceLocationAtFrame loc) {
-		return direct.allocate_timestamp_query_pools(dst, cis, loc);
+		return direct->allocate_timestamp_query_pools(dst, cis, loc);
 	}
 
 	void DeviceSuperFrameResource::deallocate_timestamp_query_pools(std::span<const TimestampQueryPool> src) {
@@ -490,27 +687,49 @@ namespace vuk {
 	Result<void, AllocateException> DeviceSuperFrameResource::allocate_timestamp_queries(std::span<TimestampQuery> dst,
 	                                                                                     std::span<const TimestampQueryCreateInfo> cis,
 	                                                                                     SourceLocationAtFrame loc) {
-		return direct.allocate_timestamp_queries(dst, cis, loc);
+		return direct->allocate_timestamp_queries(dst, cis, loc);
 	}
 
 	void DeviceSuperFrameResource::deallocate_timestamp_queries(std::span<const TimestampQuery> src) {} // noop
 
 	Result<void, AllocateException> DeviceSuperFrameResource::allocate_timeline_semaphores(std::span<TimelineSemaphore> dst, SourceLocationAtFrame loc) {
-		return direct.allocate_timeline_semaphores(dst, loc);
+		// recycled timeline semaphores keep counting from the last value they were signalled to
+		std::unique_lock _(impl->sync_pool_mutex);
+		auto& pool = impl->timeline_semaphore_pool;
+		auto from_pool = std::min(pool.size(), dst.size());
+		std::copy(pool.end() - from_pool, pool.end(), dst.begin());
+		pool.resize(pool.size() - from_pool);
+		_.unlock();
+		if (from_pool < dst.size()) {
+			auto result = direct->allocate_timeline_semaphores(dst.subspan(from_pool), loc);
+			if (!result) {
+				deallocate_timeline_semaphores(dst.subspan(0, from_pool));
+				return result;
+			}
+		}
+		return { expected_value };
 	}
 
 	void DeviceSuperFrameResource::deallocate_timeline_semaphores(std::span<const TimelineSemaphore> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->tsema_mutex);
-		auto& vec = f.impl->tsemas;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->tsemas.push(src);
 	}
 
 	void DeviceSuperFrameResource::deallocate_swapchains(std::span<const VkSwapchainKHR> src) {
-		auto& f = get_last_frame();
-		std::unique_lock _(f.impl->swapchain_mutex);
-		auto& vec = f.impl->swapchains;
-		vec.insert(vec.end(), src.begin(), src.end());
+		get_last_frame().impl->swapchains.push(src);
+	}
+
+	bool DeviceSuperFrameResource::track_submission(VkSemaphore timeline_semaphore, uint64_t value) {
+		return get_last_frame().track_submission(timeline_semaphore, value);
+	}
+
+	ResourceMemoryStatistics DeviceSuperFrameResource::get_memory_statistics() {
+		auto stats = direct->get_memory_statistics();
+		for (uint64_t i = 0; i < frames_in_flight; i++) {
+			auto frame_stats = impl->frames[i].get_memory_statistics();
+			stats.bytes += frame_stats.bytes;
+			stats.peak_bytes += frame_stats.peak_bytes;
+		}
+		return stats;
 	}
 
 	DeviceFrameResource& DeviceSuperFrameResource::get_last_frame() {
@@ -533,44 +752,120 @@ namespace vuk {
 
 	void DeviceSuperFrameResource::deallocate_frame(DeviceFrameResource& frame) {
 		auto& f = *frame.impl;
-		direct.deallocate_semaphores(f.semaphores);
-		direct.deallocate_fences(f.fences);
-		direct.deallocate_command_buffers(f.cmdbuffers_to_free);
-		for (auto& pool : f.cmdpools_to_free) {
-			vkResetCommandPool(direct.device, pool.command_pool, {});
-		}
-		deallocate_command_pools(f.cmdpools_to_free);
-		direct.deallocate_buffers(f.buffer_gpus);
-		direct.deallocate_buffers(f.buffer_cross_devices);
-		direct.deallocate_framebuffers(f.framebuffers);
-		direct.deallocate_images(f.images);
-		direct.deallocate_image_views(f.image_views);
-		direct.deallocate_persistent_descriptor_sets(f.persistent_descriptor_sets);
-		direct.deallocate_descriptor_sets(f.descriptor_sets);
-		direct.ctx->make_timestamp_results_available(f.ts_query_pools);
-		direct.deallocate_timestamp_query_pools(f.ts_query_pools);
-		direct.deallocate_timeline_semaphores(f.tsemas);
-		direct.deallocate_swapchains(f.swapchains);
+		// the handles of a given direct resource are not real, so only the bookkeeping is done for them
+		bool has_device = device != VK_NULL_HANDLE;
+		// the frame has been waited on, so its sync objects are no longer in use
+		if (has_device) {
+			f.fences.for_each_chunk([&](std::span<VkFence> fences) { vkResetFences(device, (uint32_t)fences.size(), fences.data()); });
+			f.events.for_each_chunk([&](std::span<VkEvent> events) {
+				for (auto& e : events) {
+					vkResetEvent(device, e);
+				}
+			});
+		}
+		{
+			std::scoped_lock _(impl->sync_pool_mutex);
+			f.semaphores.for_each_chunk([&](auto semaphores) { impl->semaphore_pool.insert(impl->semaphore_pool.end(), semaphores.begin(), semaphores.end()); });
+			f.fences.for_each_chunk([&](auto fences) { impl->fence_pool.insert(impl->fence_pool.end(), fences.begin(), fences.end()); });
+			f.events.for_each_chunk([&](auto events) { impl->event_pool.insert(impl->event_pool.end(), events.begin(), events.end()); });
+			f.tsemas.for_each_chunk(
+			    [&](auto tsemas) { impl->timeline_semaphore_pool.insert(impl->timeline_semaphore_pool.end(), tsemas.begin(), tsemas.end()); });
+		}
+		direct->deallocate_command_buffers(f.cmdbuffers_to_free);
+		// pools used during the frame keep their command buffers for reuse, idle pools (eg. of threads that stopped recording) are returned
+		f.command_pool_epoch.store(next_command_pool_epoch++, std::memory_order_release);
+		for (auto& p : f.command_pools) {
+			if (p->handed_out) {
+				if (has_device) {
+					vkResetCommandPool(device, p->pool.command_pool, {});
+				}
+			} else {
+				if (has_device) {
+					for (auto& command_buffers : p->command_buffers) {
+						if (command_buffers.size() > 0) {
+							vkFreeCommandBuffers(device, p->pool.command_pool, (uint32_t)command_buffers.size(), command_buffers.data());
+						}
+					}
+					vkResetCommandPool(device, p->pool.command_pool, VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
+				} else {
+					release_command_buffers(*direct, *p);
+				}
+				deallocate_command_pools(std::span{ &p->pool, 1 });
+			}
+		}
+		std::erase_if(f.command_pools, [](auto& p) { return !p->handed_out; });
+		for (auto& p : f.command_pools) {
+			p->used = {};
+			p->handed_out = false;
+		}
+		f.buffer_gpus.for_each_chunk([&](std::span<BufferGPU> src) { direct->deallocate_buffers(src); });
+		f.buffer_cross_devices.for_each_chunk([&](std::span<BufferCrossDevice> src) { direct->deallocate_buffers(src); });
+		f.framebuffers.for_each_chunk([&](std::span<VkFramebuffer> src) { direct->deallocate_framebuffers(src); });
+		f.images.for_each_chunk([&](std::span<Image> src) { direct->deallocate_images(src); });
+		f.image_views.for_each_chunk([&](std::span<ImageView> src) { direct->deallocate_image_views(src); });
+		direct->deallocate_persistent_descriptor_sets(f.persistent_descriptor_sets);
+		f.descriptor_sets.for_each_chunk([&](std::span<DescriptorSet> src) { direct->deallocate_descriptor_sets(src); });
+		if (has_device) {
+			get_context().make_timestamp_results_available(f.ts_query_pools);
+		}
+		direct->deallocate_timestamp_query_pools(f.ts_query_pools);
+		// the frame has been waited on, so every query of it has been written: read them back with a single call per pool
+		uint32_t query_capacity = 0;
+		for (auto& p : f.frame_query_pools) {
+			if (p.queries.size() > 0) {
+				if (has_device) {
+					get_context().make_timestamp_results_available(p.pool.pool, p.queries);
+					vkResetQueryPool(device, p.pool.pool, 0, (uint32_t)p.queries.size());
+				}
+				p.queries.clear();
+			}
+			query_capacity += p.capacity;
+		}
+		if (f.frame_query_pools.size() > 1) {
+			for (auto& p : f.frame_query_pools) {
+				direct->deallocate_timestamp_query_pools(std::span{ &p.pool, 1 });
+			}
+			f.frame_query_pools.clear();
+			VkQueryPoolCreateInfo qpci{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+			qpci.queryCount = query_capacity;
+			qpci.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			TimestampQueryPool p;
+			// if this fails, the pool is allocated again on demand
+			if (direct->allocate_timestamp_query_pools(std::span{ &p, 1 }, std::span{ &qpci, 1 }, VUK_HERE_AND_NOW())) {
+				f.frame_query_pools.push_back({ p, query_capacity });
+			}
+		}
+		f.swapchains.for_each_chunk([&](std::span<VkSwapchainKHR> src) { direct->deallocate_swapchains(src); });
 
 		f.semaphores.clear();
 		f.fences.clear();
+		f.events.clear();
 		f.buffer_cross_devices.clear();
 		f.buffer_gpus.clear();
 		f.cmdbuffers_to_free.clear();
-		f.cmdpools_to_free.clear();
-		auto& legacy = direct.legacy_gpu_allocator;
-		legacy->reset_pool(f.linear_cpu_only);
-		legacy->reset_pool(f.linear_cpu_gpu);
-		legacy->reset_pool(f.linear_gpu_cpu);
-		legacy->reset_pool(f.linear_gpu_only);
+		if (auto legacy = legacy_gpu_allocator) {
+			legacy->reset_pool(f.linear_cpu_only);
+			legacy->reset_pool(f.linear_cpu_gpu);
+			legacy->reset_pool(f.linear_gpu_cpu);
+			legacy->reset_pool(f.linear_gpu_only);
+			if (get_context().is_under_memory_pressure()) {
+				legacy->trim(f.linear_cpu_only);
+				legacy->trim(f.linear_cpu_gpu);
+				legacy->trim(f.linear_gpu_cpu);
+				legacy->trim(f.linear_gpu_only);
+			}
+		}
 		f.framebuffers.clear();
 		f.images.clear();
 		f.image_views.clear();
 		f.persistent_descriptor_sets.clear();
 		f.descriptor_sets.clear();
 		f.ts_query_pools.clear();
-		f.query_index = 0;
 		f.tsemas.clear();
+		for (auto& s : f.submissions) {
+			s.semaphore.store(VK_NULL_HANDLE, std::memory_order_relaxed);
+			s.value.store(0, std::memory_order_relaxed);
+		}
 		f.swapchains.clear();
 	}
 
@@ -580,18 +875,28 @@ namespace vuk {
 			auto& f = impl->frames[lframe];
 			f.wait();
 			deallocate_frame(f);
-			direct.legacy_gpu_allocator->destroy(f.impl->linear_cpu_only);
-			direct.legacy_gpu_allocator->destroy(f.impl->linear_cpu_gpu);
-			direct.legacy_gpu_allocator->destroy(f.impl->linear_gpu_cpu);
-			direct.legacy_gpu_allocator->destroy(f.impl->linear_gpu_only);
-			f.DeviceFrameResource::~DeviceFrameResource();
-		}
-		for (uint32_t i = 0; i < (uint32_t)impl->command_pools.size(); i++) {
-			for (auto& cpool : impl->command_pools[i]) {
-				CommandPool p{ cpool, i };
-				direct.deallocate_command_pools(std::span{ &p, 1 });
+			if (legacy_gpu_allocator) {
+				legacy_gpu_allocator->destroy(f.impl->linear_cpu_only);
+				legacy_gpu_allocator->destroy(f.impl->linear_cpu_gpu);
+				legacy_gpu_allocator->destroy(f.impl->linear_gpu_cpu);
+				legacy_gpu_allocator->destroy(f.impl->linear_gpu_only);
 			}
+			for (auto& p : f.impl->command_pools) {
+				if (device == VK_NULL_HANDLE) {
+					release_command_buffers(*direct, *p);
+				}
+				direct->deallocate_command_pools(std::span{ &p->pool, 1 });
+			}
+			for (auto& p : f.impl->frame_query_pools) {
+				direct->deallocate_timestamp_query_pools(std::span{ &p.pool, 1 });
+			}
+			f.DeviceFrameResource::~DeviceFrameResource();
 		}
+		direct->deallocate_command_pools(impl->command_pools);
+		direct->deallocate_semaphores(impl->semaphore_pool);
+		direct->deallocate_fences(impl->fence_pool);
+		direct->deallocate_events(impl->event_pool);
+		direct->deallocate_timeline_semaphores(impl->timeline_semaphore_pool);
 		delete impl;
 	}
 } // namespace vuk
\ No newline at end of file
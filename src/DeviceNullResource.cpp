@@ -0,0 +1,488 @@
+#include "vuk/resources/DeviceNullResource.hpp"
+#include "../src/RenderPass.hpp"
+#include "vuk/Buffer.hpp"
+#include "vuk/Descriptor.hpp"
+#include "vuk/Query.hpp"
+
+#include <new>
+#include <string>
+#include <type_traits>
+
+namespace vuk {
+	namespace {
+		// host memory backing cross device buffers is allocated with a fixed alignment, since a Buffer does not remember the alignment it was created with
+		constexpr size_t host_alignment = 256;
+
+		template<class T>
+		uint64_t to_u64(T handle) {
+			if constexpr (std::is_pointer_v<T>) {
+				return (uint64_t)reinterpret_cast<uintptr_t>(handle);
+			} else {
+				return (uint64_t)handle;
+			}
+		}
+
+		template<class T>
+		uint64_t handle_of(const T& v) {
+			return to_u64(v);
+		}
+		uint64_t handle_of(const CommandBufferAllocation& v) {
+			return to_u64(v.command_buffer);
+		}
+		uint64_t handle_of(const CommandPool& v) {
+			return to_u64(v.command_pool);
+		}
+		uint64_t handle_of(const BufferCrossDevice& v) {
+			return to_u64(v.buffer);
+		}
+		uint64_t handle_of(const BufferGPU& v) {
+			return to_u64(v.buffer);
+		}
+		uint64_t handle_of(const ImageView& v) {
+			return to_u64(v.payload);
+		}
+		uint64_t handle_of(const PersistentDescriptorSet& v) {
+			return to_u64(v.backing_set);
+		}
+		uint64_t handle_of(const DescriptorSet& v) {
+			return to_u64(v.descriptor_set);
+		}
+		uint64_t handle_of(const TimestampQueryPool& v) {
+			return to_u64(v.pool);
+		}
+		uint64_t handle_of(const TimestampQuery& v) {
+			return v.id;
+		}
+		uint64_t handle_of(const TimelineSemaphore& v) {
+			return to_u64(v.semaphore);
+		}
+
+		std::string describe(const CommandBufferAllocationCreateInfo& ci) {
+			return "level=" + std::to_string(ci.level) + " pool=" + std::to_string(to_u64(ci.command_pool.command_pool));
+		}
+		std::string describe(const VkCommandPoolCreateInfo& ci) {
+			return "queue_family=" + std::to_string(ci.queueFamilyIndex) + " flags=" + std::to_string(ci.flags);
+		}
+		std::string describe(const BufferCreateInfo& ci) {
+			return "mem_usage=" + std::to_string((int)ci.mem_usage) + " size=" + std::to_string(ci.size) + " alignment=" + std::to_string(ci.alignment);
+		}
+		std::string describe(const FramebufferCreateInfo& ci) {
+			return "render_pass=" + std::to_string(to_u64(ci.renderPass)) + " extent=" + std::to_string(ci.width) + "x" + std::to_string(ci.height) +
+			       " layers=" + std::to_string(ci.layers) + " attachments=" + std::to_string(ci.attachmentCount);
+		}
+		std::string describe(const ImageCreateInfo& ci) {
+			return "format=" + std::to_string((int)ci.format) + " extent=" + std::to_string(ci.extent.width) + "x" + std::to_string(ci.extent.height) + "x" +
+			       std::to_string(ci.extent.depth) + " levels=" + std::to_string(ci.mipLevels) + " layers=" + std::to_string(ci.arrayLayers) +
+			       " samples=" + std::to_string((int)ci.samples) + " usage=" + std::to_string((uint32_t)ci.usage);
+		}
+		std::string describe(const ImageViewCreateInfo& ci) {
+			auto& r = ci.subresourceRange;
+			return "image=" + std::to_string(to_u64((VkImage)ci.image)) + " format=" + std::to_string((int)ci.format) + " type=" + std::to_string((int)ci.viewType) +
+			       " levels=" + std::to_string(r.baseMipLevel) + "+" + std::to_string(r.levelCount) + " layers=" + std::to_string(r.baseArrayLayer) + "+" +
+			       std::to_string(r.layerCount);
+		}
+		std::string describe(const PersistentDescriptorSetCreateInfo& ci) {
+			return "layout=" + std::to_string(to_u64(ci.dslai.layout)) + " descriptors=" + std::to_string(ci.num_descriptors);
+		}
+		std::string describe(const SetBinding& ci) {
+			return "layout=" + std::to_string(ci.layout_info ? to_u64(ci.layout_info->layout) : 0) + " bindings=" + std::to_string(ci.used.count());
+		}
+		std::string describe(const VkQueryPoolCreateInfo& ci) {
+			return "query_type=" + std::to_string(ci.queryType) + " queries=" + std::to_string(ci.queryCount);
+		}
+		std::string describe(const TimestampQueryCreateInfo& ci) {
+			return "pool=" + std::to_string(ci.pool ? to_u64(ci.pool->pool) : 0) + " query=" + std::to_string(ci.query.id);
+		}
+		std::string describe(std::nullptr_t) {
+			return {};
+		}
+	} // namespace
+
+	DeviceNullResource::DeviceNullResource(Context* ctx) : ctx(ctx) {}
+
+	template<class T>
+	T DeviceNullResource::make_handle() {
+		auto id = next_handle.fetch_add(1, std::memory_order_relaxed);
+		if constexpr (std::is_pointer_v<T>) {
+			return reinterpret_cast<T>((uintptr_t)id);
+		} else {
+			return (T)id;
+		}
+	}
+
+	void DeviceNullResource::count(AllocationKind kind, size_t allocations, size_t deallocations) {
+		allocation_counts[(size_t)kind].fetch_add(allocations, std::memory_order_relaxed);
+		deallocation_counts[(size_t)kind].fetch_add(deallocations, std::memory_order_relaxed);
+	}
+
+	template<class T, class CI>
+	void DeviceNullResource::record(AllocationKind kind, bool allocation, std::span<T> objects, std::span<const CI> cis, const SourceLocationAtFrame* loc) {
+		if (!recording.load(std::memory_order_relaxed)) {
+			return;
+		}
+		NullResourceCall call{ kind, allocation };
+		for (auto& o : objects) {
+			call.handles.push_back(handle_of(o));
+		}
+		for (auto& ci : cis) {
+			call.arguments += describe(ci);
+			call.arguments += '\n';
+		}
+		if (loc) {
+			call.file = loc->location.file_name();
+			call.line = loc->location.line();
+			call.absolute_frame = loc->absolute_frame;
+		}
+		std::lock_guard _(calls_lock);
+		calls.push_back(std::move(call));
+	}
+
+	Result<void, AllocateException> DeviceNullResource::allocate_semaphores(std::span<VkSemaphore> dst, SourceLocationAtFrame loc) {
+		for (auto& v : dst) {
+			v = make_handle<VkSemaphore>();
+		}
+		count(AllocationKind::eSemaphore, dst.size(), 0);
+		record(AllocationKind::eSemaphore, true, dst, {}, &loc);
+		return { expected_value };
+	}
+
+	void DeviceNullResource::deallocate_semaphores(std::span<const VkSemaphore> src) {
+		count(AllocationKind::eSemaphore, 0, src.size());
+		record(AllocationKind::eSemaphore, false, src);
+	}
+
+	Result<void, AllocateException> DeviceNullResource::allocate_fences(std::span<VkFence> dst, SourceLocationAtFrame loc) {
+		for (auto& v : dst) {
+			v = make_handle<VkFence>();
+		}
+		count(AllocationKind::eFence, dst.size(), 0);
+		record(AllocationKind::eFence, true, dst, {}, &loc);
+		return { expected_value };
+	}
+
+	void DeviceNullResource::deallocate_fences(std::span<const VkFence> src) {
+		count(AllocationKind::eFence, 0, src.size());
+		record(AllocationKind::eFence, false, src);
+	}
+
+	Result<void, AllocateException> DeviceNullResource::allocate_events(std::span<VkEvent> dst, SourceLocationAtFrame loc) {
+		for (auto& v : dst) {
+			v = make_handle<VkEvent>();
+		}
+		count(AllocationKind::eEvent, dst.size(), 0);
+		record(AllocationKind::eEvent, true, dst, {}, &loc);
+		return { expected_value };
+	}
+
+	void DeviceNullResource::deallocate_events(std::span<const VkEvent> src) {
+		count(AllocationKind::eEvent, 0, src.size());
+		record(AllocationKind::eEvent, false, src);
+	}
+
+	Result<void, AllocateException> DeviceNullResource::allocate_command_buffers(std::span<CommandBufferAllocation> dst,
+	                                                                             std::span<const CommandBufferAllocationCreateInfo> cis,
+	                                                                             SourceLocationAtFrame loc) {
+		assert(dst.size() == cis.size());
+		for (uint64_t i = 0; i < dst.size(); i++) {
+			dst[i] = CommandBufferAllocation{ make_handle<VkCommandBuffer>(), cis[i].command_pool };
+		}
+		count(AllocationKind::eCommandBuffer, dst.size(), 0);
+		record(AllocationKind::eCommandBuffer, true, dst, cis, &loc);
+		return { expected_value };
+	}
+
+	void DeviceNullResource::deallocate_command_buffers(std::span<const CommandBufferAllocation> src) {
+		count(AllocationKind::eCommandBuffer, 0, src.size());
+		record(AllocationKind::eCommandBuffer, false, src);
+	}
+
+	Result<void, AllocateException>
+	DeviceNullResource::allocate_command_pools(std::span<CommandPool> dst, std::span<const VkCommandPoolCreateInfo> cis, SourceLocationAtFrame loc) {
+		assert(dst.size() == cis.size());
+		for (uint64_t i = 0; i < dst.size(); i++) {
+			dst[i] = CommandPool{ make_handle<VkCommandPool>(), cis[i].queueFamilyIndex, cis[i].flags };
+		}
+		count(AllocationKind::eCommandPool, dst.size(), 0);
+		record(AllocationKind::eCommandPool, true, dst, cis, &loc);
+		return { expected_value };
+	}
+
+	void DeviceNullResource::deallocate_command_pools(std::span<const CommandPool> src) {
+		count(AllocationKind::eCommandPool, 0, src.size());
+		record(AllocationKind::eCommandPool, false, src);
+	}
+
+	Result<void, AllocateException>
+	DeviceNullResource::allocate_buffers(std::span<BufferCrossDevice> dst, std::span<const BufferCreateInfo> cis, SourceLocationAtFrame loc) {
+		assert(dst.size() == cis.size());
+		for (int64_t i = 0; i < (int64_t)dst.size(); i++) {
+			auto& ci = cis[i];
+			if (ci.mem_usage != MemoryUsage::eCPUonly && ci.mem_usage != MemoryUsage::eCPUtoGPU && ci.mem_usage != MemoryUsage::eGPUtoCPU) {
+				deallocate_buffers(std::span{ dst.data(), (uint64_t)i });
+				return { expected_error, AllocateException{ VK_ERROR_FEATURE_NOT_PRESENT } }; // tried to allocate gpu only buffer as BufferCrossDevice
+			}
+			assert(ci.alignment <= host_alignment);
+			BufferCrossDevice buf;
+			buf.device_memory = make_handle<VkDeviceMemory>();
+			buf.buffer = make_handle<VkBuffer>();
+			buf.size = ci.size;
+			buf.allocation_size = ci.size;
+			buf.memory_usage = ci.mem_usage;
+			buf.mapped_ptr = static_cast<std::byte*>(::operator new(ci.size, std::align_val_t{ host_alignment }));
+			dst[i] = buf;
+			count(AllocationKind::eBuffer, 1, 0);
+			add_allocated_bytes(ci.size);
+		}
+		record(AllocationKind::eBuffer, true, dst, cis, &loc);
+		return { expected_value };
+	}
+
+	void DeviceNullResource::deallocate_buffers(std::span<const BufferCrossDevice> src) {
+		for (auto& v : src) {
+			if (v) {
+				allocated_bytes -= v.size;
+				::operator delete(v.mapped_ptr, std::align_val_t{ host_alignment });
+			}
+		}
+		count(AllocationKind::eBuffer, 0, src.size());
+		record(AllocationKind::eBuffer, false, src);
+	}
+
+	Result<void, AllocateException>
+	DeviceNullResource::allocate_buffers(std::span<BufferGPU> dst, std::span<const BufferCreateInfo> cis, SourceLocationAtFrame loc) {
+		assert(dst.size() == cis.size());
+		for (int64_t i = 0; i < (int64_t)dst.size(); i++) {
+			auto& ci = cis[i];
+			if (ci.mem_usage != MemoryUsage::eGPUonly) {
+				deallocate_buffers(std::span{ dst.data(), (uint64_t)i });
+				return { expected_error, AllocateException{ VK_ERROR_FEATURE_NOT_PRESENT } }; // tried to allocate cross device buffer as BufferGPU
+			}
+			BufferGPU buf;
+			buf.device_memory = make_handle<VkDeviceMemory>();
+			buf.buffer = make_handle<VkBuffer>();
+			buf.size = ci.size;
+			buf.allocation_size = ci.size;
+			buf.memory_usage = ci.mem_usage;
+			dst[i] = buf;
+			count(AllocationKind::eBuffer, 1, 0);
+			add_allocated_bytes(ci.size);
+		}
+		record(AllocationKind::eBuffer, true, dst, cis, &loc);
+		return { expected_value };
+	}
+
+	void DeviceNullResource::deallocate_buffers(std::span<const BufferGPU> src) {
+		for (auto& v : src) {
+			if (v) {
+				allocated_bytes -= v.size;
+			}
+		}
+		count(AllocationKind::eBuffer, 0, src.size());
+		record(AllocationKind::eBuffer, false, src);
+	}
+
+	Result<void, AllocateException>
+	DeviceNullResource::allocate_framebuffers(std::span<VkFramebuffer> dst, std::span<const FramebufferCreateInfo> cis, SourceLocationAtFrame loc) {
+		assert(dst.size() == cis.size());
+		for (auto& v : dst) {
+			v = make_handle<VkFramebuffer>();
+		}
+		count(AllocationKind::eFramebuffer, dst.size(), 0);
+		record(AllocationKind::eFramebuffer, true, dst, cis, &loc);
+		return { expected_value };
+	}
+
+	void DeviceNullResource::deallocate_framebuffers(std::span<const VkFramebuffer> src) {
+		count(AllocationKind::eFramebuffer, 0, src.size());
+		record(AllocationKind::eFramebuffer, false, src);
+	}
+
+	Result<void, AllocateException> DeviceNullResource::allocate_images(std::span<Image> dst, std::span<const ImageCreateInfo> cis, SourceLocationAtFrame loc) {
+		assert(dst.size() == cis.size());
+		for (auto& v : dst) {
+			v = make_handle<Image>();
+		}
+		count(AllocationKind::eImage, dst.size(), 0);
+		record(AllocationKind::eImage, true, dst, cis, &loc);
+		return { expected_value };
+	}
+
+	void DeviceNullResource::deallocate_images(std::span<const Image> src) {
+		count(AllocationKind::eImage, 0, src.size());
+		record(AllocationKind::eImage, false, src);
+	}
+
+	Result<void, AllocateException>
+	DeviceNullResource::allocate_image_views(std::span<ImageView> dst, std::span<const ImageViewCreateInfo> cis, SourceLocationAtFrame loc) {
+		assert(dst.size() == cis.size());
+		for (uint64_t i = 0; i < dst.size(); i++) {
+			auto& ivci = cis[i];
+			ImageView viv{ .payload = make_handle<VkImageView>() };
+			viv.base_layer = ivci.subresourceRange.baseArrayLayer;
+			viv.layer_count = ivci.subresourceRange.layerCount;
+			viv.base_level = ivci.subresourceRange.baseMipLevel;
+			viv.level_count = ivci.subresourceRange.levelCount;
+			viv.format = ivci.format;
+			viv.type = ivci.viewType;
+			viv.image = ivci.image;
+			viv.components = ivci.components;
+			viv.id = (uint32_t)next_handle.fetch_add(1, std::memory_order_relaxed);
+			dst[i] = viv;
+		}
+		count(AllocationKind::eImageView, dst.size(), 0);
+		record(AllocationKind::eImageView, true, dst, cis, &loc);
+		return { expected_value };
+	}
+
+	void DeviceNullResource::deallocate_image_views(std::span<const ImageView> src) {
+		count(AllocationKind::eImageView, 0, src.size());
+		record(AllocationKind::eImageView, false, src);
+	}
+
+	Result<void, AllocateException> DeviceNullResource::allocate_persistent_descriptor_sets(std::span<PersistentDescriptorSet> dst,
+	                                                                                        std::span<const PersistentDescriptorSetCreateInfo> cis,
+	                                                                                        SourceLocationAtFrame loc) {
+		assert(dst.size() == cis.size());
+		for (uint64_t i = 0; i < dst.size(); i++) {
+			auto& ci = cis[i];
+			auto& tda = dst[i];
+			tda.backing_pool = make_handle<VkDescriptorPool>();
+			tda.backing_set = make_handle<VkDescriptorSet>();
+			tda.set_layout = ci.dslai.layout;
+			for (auto& bindings : tda.descriptor_bindings) {
+				bindings.resize(1);
+			}
+			if (ci.dslai.variable_count_binding != (unsigned)-1) {
+				tda.descriptor_bindings[ci.dslai.variable_count_binding].resize(ci.num_descriptors);
+			}
+		}
+		count(AllocationKind::ePersistentDescriptorSet, dst.size(), 0);
+		record(AllocationKind::ePersistentDescriptorSet, true, dst, cis, &loc);
+		return { expected_value };
+	}
+
+	void DeviceNullResource::deallocate_persistent_descriptor_sets(std::span<const PersistentDescriptorSet> src) {
+		count(AllocationKind::ePersistentDescriptorSet, 0, src.size());
+		record(AllocationKind::ePersistentDescriptorSet, false, src);
+	}
+
+	Result<void, AllocateException>
+	DeviceNullResource::allocate_descriptor_sets(std::span<DescriptorSet> dst, std::span<const SetBinding> cis, SourceLocationAtFrame loc) {
+		assert(dst.size() == cis.size());
+		for (uint64_t i = 0; i < dst.size(); i++) {
+			dst[i] = { make_handle<VkDescriptorSet>(), *cis[i].layout_info };
+		}
+		count(AllocationKind::eDescriptorSet, dst.size(), 0);
+		record(AllocationKind::eDescriptorSet, true, dst, cis, &loc);
+		return { expected_value };
+	}
+
+	void DeviceNullResource::deallocate_descriptor_sets(std::span<const DescriptorSet> src) {
+		count(AllocationKind::eDescriptorSet, 0, src.size());
+		record(AllocationKind::eDescriptorSet, false, src);
+	}
+
+	Result<void, AllocateException>
+	DeviceNullResource::allocate_timestamp_query_pools(std::span<TimestampQueryPool> dst, std::span<const VkQueryPoolCreateInfo> cis, SourceLocationAtFrame loc) {
+		assert(dst.size() == cis.size());
+		for (auto& v : dst) {
+			v.pool = make_handle<VkQueryPool>();
+		}
+		count(AllocationKind::eTimestampQueryPool, dst.size(), 0);
+		record(AllocationKind::eTimestampQueryPool, true, dst, cis, &loc);
+		return { expected_value };
+	}
+
+	void DeviceNullResource::deallocate_timestamp_query_pools(std::span<const TimestampQueryPool> src) {
+		count(AllocationKind::eTimestampQueryPool, 0, src.size());
+		record(AllocationKind::eTimestampQueryPool, false, src);
+	}
+
+	Result<void, AllocateException>
+	DeviceNullResource::allocate_timestamp_queries(std::span<TimestampQuery> dst, std::span<const TimestampQueryCreateInfo> cis, SourceLocationAtFrame loc) {
+		assert(dst.size() == cis.size());
+		for (uint64_t i = 0; i < dst.size(); i++) {
+			auto& ci = cis[i];
+			ci.pool->queries[ci.pool->count++] = ci.query;
+			dst[i].id = ci.pool->count;
+			dst[i].pool = ci.pool->pool;
+		}
+		count(AllocationKind::eTimestampQuery, dst.size(), 0);
+		record(AllocationKind::eTimestampQuery, true, dst, cis, &loc);
+		return { expected_value };
+	}
+
+	void DeviceNullResource::deallocate_timestamp_queries(std::span<const TimestampQuery> src) {
+		count(AllocationKind::eTimestampQuery, 0, src.size());
+		record(AllocationKind::eTimestampQuery, false, src);
+	}
+
+	Result<void, AllocateException> DeviceNullResource::allocate_timeline_semaphores(std::span<TimelineSemaphore> dst, SourceLocationAtFrame loc) {
+		for (auto& v : dst) {
+			v.semaphore = make_handle<VkSemaphore>();
+			v.value = new uint64_t{ 0 };
+		}
+		count(AllocationKind::eTimelineSemaphore, dst.size(), 0);
+		record(AllocationKind::eTimelineSemaphore, true, dst, {}, &loc);
+		return { expected_value };
+	}
+
+	void DeviceNullResource::deallocate_timeline_semaphores(std::span<const TimelineSemaphore> src) {
+		for (auto& v : src) {
+			if (v.semaphore != VK_NULL_HANDLE) {
+				delete v.value;
+			}
+		}
+		count(AllocationKind::eTimelineSemaphore, 0, src.size());
+		record(AllocationKind::eTimelineSemaphore, false, src);
+	}
+
+	void DeviceNullResource::deallocate_swapchains(std::span<const VkSwapchainKHR> src) {
+		count(AllocationKind::eSwapchain, 0, src.size());
+		record(AllocationKind::eSwapchain, false, src);
+	}
+
+	uint64_t DeviceNullResource::get_allocation_count(AllocationKind kind) const {
+		return allocation_counts[(size_t)kind].load(std::memory_order_relaxed);
+	}
+
+	uint64_t DeviceNullResource::get_deallocation_count(AllocationKind kind) const {
+		return deallocation_counts[(size_t)kind].load(std::memory_order_relaxed);
+	}
+
+	uint64_t DeviceNullResource::get_live_count(AllocationKind kind) const {
+		return get_allocation_count(kind) - get_deallocation_count(kind);
+	}
+
+	void DeviceNullResource::reset_counts() {
+		for (size_t i = 0; i < kind_count; i++) {
+			allocation_counts[i].store(0, std::memory_order_relaxed);
+			deallocation_counts[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	void DeviceNullResource::set_call_recording(bool enabled) {
+		recording.store(enabled, std::memory_order_relaxed);
+	}
+
+	std::vector<NullResourceCall> DeviceNullResource::get_calls() {
+		std::lock_guard _(calls_lock);
+		return calls;
+	}
+
+	void DeviceNullResource::clear_calls() {
+		std::lock_guard _(calls_lock);
+		calls.clear();
+	}
+
+	void DeviceNullResource::add_allocated_bytes(uint64_t bytes) {
+		auto total = allocated_bytes.fetch_add(bytes) + bytes;
+		auto peak = peak_bytes.load(std::memory_order_relaxed);
+		while (peak < total && !peak_bytes.compare_exchange_weak(peak, total, std::memory_order_relaxed)) {
+		}
+	}
+
+	ResourceMemoryStatistics DeviceNullResource::get_memory_statistics() {
+		return { allocated_bytes.load(), peak_bytes.load() };
+	}
+} // namespace vuk
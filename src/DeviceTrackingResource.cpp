@@ -0,0 +1,502 @@
+#include "vuk/resources/DeviceTrackingResource.hpp"
+#include "vuk/Buffer.hpp"
+#include "vuk/Context.hpp"
+#include "vuk/Descriptor.hpp"
+#include "vuk/Hash.hpp"
+#include "vuk/Query.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+
+namespace vuk {
+	std::string_view to_string(AllocationKind kind) {
+		switch (kind) {
+		case AllocationKind::eSemaphore:
+			return "semaphore";
+		case AllocationKind::eFence:
+			return "fence";
+		case AllocationKind::eEvent:
+			return "event";
+		case AllocationKind::eCommandBuffer:
+			return "command buffer";
+		case AllocationKind::eCommandPool:
+			return "command pool";
+		case AllocationKind::eBuffer:
+			return "buffer";
+		case AllocationKind::eFramebuffer:
+			return "framebuffer";
+		case AllocationKind::eImage:
+			return "image";
+		case AllocationKind::eImageView:
+			return "image view";
+		case AllocationKind::ePersistentDescriptorSet:
+			return "persistent descriptor set";
+		case AllocationKind::eDescriptorSet:
+			return "descriptor set";
+		case AllocationKind::eTimestampQueryPool:
+			return "timestamp query pool";
+		case AllocationKind::eTimestampQuery:
+			return "timestamp query";
+		case AllocationKind::eTimelineSemaphore:
+			return "timeline semaphore";
+		case AllocationKind::eSwapchain:
+			return "swapchain";
+		}
+		return "unknown";
+	}
+
+	namespace {
+		// call sites are identified by the address of the file name string, which is unique per file in a module
+		using SiteKey = std::tuple<uintptr_t, uint32_t, uint32_t, AllocationKind>;
+
+		struct LiveKey {
+			AllocationKind kind;
+			uint64_t handle;
+			uint64_t extra;
+
+			bool operator==(const LiveKey&) const noexcept = default;
+		};
+
+		struct LiveKeyHash {
+			size_t operator()(const LiveKey& k) const noexcept {
+				using ::hash::detail::secret;
+				uint64_t h = ::hash::mix(k.handle ^ secret[0], k.extra ^ secret[1]);
+				return (size_t)::hash::mix(h ^ secret[2], (uint64_t)k.kind ^ secret[3]);
+			}
+		};
+
+		struct LiveAllocation {
+			SiteKey site;
+			uint64_t frame;
+			uint64_t bytes;
+		};
+
+		template<class T>
+		uint64_t handle_bits(T handle) {
+			if constexpr (std::is_pointer_v<T>) {
+				return (uint64_t) reinterpret_cast<uintptr_t>(handle);
+			} else {
+				return (uint64_t)handle;
+			}
+		}
+
+		uint64_t estimate_image_size(const ImageCreateInfo& ci) {
+			uint64_t size = (uint64_t)compute_image_size(ci.format, ci.extent) * ci.arrayLayers * (uint64_t)ci.samples;
+			// a full mip chain adds at most a third of the base level
+			if (ci.mipLevels > 1) {
+				size += size / 3;
+			}
+			return size;
+		}
+
+		void add(CallSiteStatistics& stats, uint64_t bytes) {
+			stats.live_count++;
+			stats.live_bytes += bytes;
+			stats.peak_live_bytes = std::max(stats.peak_live_bytes, stats.live_bytes);
+			stats.total_count++;
+			stats.total_bytes += bytes;
+		}
+
+		void remove(CallSiteStatistics& stats, uint64_t bytes) {
+			stats.live_count--;
+			stats.live_bytes -= bytes;
+		}
+
+		std::string format_call_sites(std::span<const CallSiteStatistics> sites) {
+			std::string out;
+			char line[512];
+			snprintf(line, sizeof(line), "%14s %10s %14s %14s %10s  %-26s %s\n", "live bytes", "live", "peak bytes", "total bytes", "total", "kind", "call site");
+			out += line;
+			for (auto& s : sites) {
+				auto kind = to_string(s.kind);
+				snprintf(line,
+				         sizeof(line),
+				         "%14llu %10llu %14llu %14llu %10llu  %-26.*s %s:%u:%u (%s)\n",
+				         (unsigned long long)s.live_bytes,
+				         (unsigned long long)s.live_count,
+				         (unsigned long long)s.peak_live_bytes,
+				         (unsigned long long)s.total_bytes,
+				         (unsigned long long)s.total_count,
+				         (int)kind.size(),
+				         kind.data(),
+				         s.file,
+				         s.line,
+				         s.column,
+				         s.function);
+				out += line;
+			}
+			return out;
+		}
+	} // namespace
+
+	struct DeviceTrackingResourceImpl {
+		uint64_t history_frames;
+		std::function<void(std::string_view)> leak_report;
+
+		std::mutex mutex;
+		std::map<SiteKey, CallSiteStatistics> sites;
+		std::map<uint64_t, std::map<SiteKey, CallSiteStatistics>> frames;
+		std::unordered_map<LiveKey, LiveAllocation, LiveKeyHash> live;
+
+		void record(SourceLocationAtFrame loc, uint64_t frame, AllocationKind kind, uint64_t handle, uint64_t extra, uint64_t bytes) {
+			LiveKey live_key{ kind, handle, extra };
+			auto it = live.find(live_key);
+			// the upstream hands out a handle again that was released without going through this resource (eg. freed along with its pool)
+			if (it != live.end()) {
+				forget(it->second);
+			}
+
+			SiteKey key{ reinterpret_cast<uintptr_t>(loc.location.file_name()), loc.location.line(), loc.location.column(), kind };
+			CallSiteStatistics empty{ loc.location.file_name(), loc.location.function_name(), loc.location.line(), loc.location.column(), kind };
+			add(sites.try_emplace(key, empty).first->second, bytes);
+			add(frames[frame].try_emplace(key, empty).first->second, bytes);
+			while (frames.size() > history_frames) {
+				frames.erase(frames.begin());
+			}
+
+			if (it != live.end()) {
+				it->second = LiveAllocation{ key, frame, bytes };
+			} else {
+				live.emplace(live_key, LiveAllocation{ key, frame, bytes });
+			}
+		}
+
+		void release(AllocationKind kind, uint64_t handle, uint64_t extra) {
+			auto it = live.find(LiveKey{ kind, handle, extra });
+			if (it == live.end()) { // not allocated through this resource
+				return;
+			}
+			forget(it->second);
+			live.erase(it);
+		}
+
+		// take a live allocation out of the statistics of its call site
+		void forget(const LiveAllocation& la) {
+			remove(sites.at(la.site), la.bytes);
+			if (auto fit = frames.find(la.frame); fit != frames.end()) {
+				remove(fit->second.at(la.site), la.bytes);
+			}
+		}
+	};
+
+	DeviceTrackingResource::DeviceTrackingResource(DeviceResource* upstream, uint64_t history_frames, std::function<void(std::string_view)> leak_report) :
+	    DeviceNestedResource(upstream),
+	    impl(new DeviceTrackingResourceImpl{ std::max(history_frames, (uint64_t)1), std::move(leak_report) }) {}
+
+	DeviceTrackingResource::~DeviceTrackingResource() {
+		if (!impl->live.empty()) {
+			std::string report = "vuk: " + std::to_string(impl->live.size()) + " allocation(s) not deallocated\n";
+			std::vector<CallSiteStatistics> leaks;
+			for (auto& s : get_call_sites()) {
+				if (s.live_count > 0) {
+					leaks.push_back(s);
+				}
+			}
+			report += format_call_sites(leaks);
+			if (impl->leak_report) {
+				impl->leak_report(report);
+			} else {
+				fputs(report.c_str(), stderr);
+			}
+		}
+		delete impl;
+	}
+
+	namespace {
+		struct Tracked {
+			uint64_t handle;
+			uint64_t extra = 0;
+			uint64_t bytes = 0;
+		};
+
+		// plain Vulkan handles
+		template<class T>
+		Tracked track(T v) requires(std::is_pointer_v<T> || std::is_integral_v<T>) {
+			return { handle_bits(v) };
+		}
+		Tracked track(const CommandBufferAllocation& v) {
+			return { handle_bits(v.command_buffer) };
+		}
+		Tracked track(const CommandPool& v) {
+			return { handle_bits(v.command_pool) };
+		}
+		Tracked track(const Buffer& v) {
+			return { handle_bits(v.buffer), v.offset, v.size };
+		}
+		Tracked track(const ImageView& v) {
+			return { handle_bits(v.payload) };
+		}
+		Tracked track(const PersistentDescriptorSet& v) {
+			return { handle_bits(v.backing_pool) };
+		}
+		Tracked track(const DescriptorSet& v) {
+			return { handle_bits(v.descriptor_set) };
+		}
+		Tracked track(const TimestampQueryPool& v) {
+			return { handle_bits(v.pool) };
+		}
+		Tracked track(const TimestampQuery& v) {
+			return { handle_bits(v.pool), v.id };
+		}
+		Tracked track(const TimelineSemaphore& v) {
+			return { handle_bits(v.semaphore) };
+		}
+	} // namespace
+
+	template<class T>
+	static void record_allocations(DeviceTrackingResourceImpl& impl, DeviceResource& upstream, AllocationKind kind, std::span<T> dst, SourceLocationAtFrame loc) {
+		uint64_t frame = loc.absolute_frame != (uint64_t)-1LL ? loc.absolute_frame : upstream.get_context().get_frame_count();
+		std::unique_lock _(impl.mutex);
+		for (auto& v : dst) {
+			auto t = track(v);
+			impl.record(loc, frame, kind, t.handle, t.extra, t.bytes);
+		}
+	}
+
+	template<class T>
+	static void release_allocations(DeviceTrackingResourceImpl& impl, AllocationKind kind, std::span<const T> src) {
+		std::unique_lock _(impl.mutex);
+		for (auto& v : src) {
+			auto t = track(v);
+			impl.release(kind, t.handle, t.extra);
+		}
+	}
+
+	Result<void, AllocateException> DeviceTrackingResource::allocate_semaphores(std::span<VkSemaphore> dst, SourceLocationAtFrame loc) {
+		VUK_DO_OR_RETURN(upstream->allocate_semaphores(dst, loc));
+		record_allocations(*impl, *upstream, AllocationKind::eSemaphore, dst, loc);
+		return { expected_value };
+	}
+
+	void DeviceTrackingResource::deallocate_semaphores(std::span<const VkSemaphore> src) {
+		release_allocations(*impl, AllocationKind::eSemaphore, src);
+		upstream->deallocate_semaphores(src);
+	}
+
+	Result<void, AllocateException> DeviceTrackingResource::allocate_fences(std::span<VkFence> dst, SourceLocationAtFrame loc) {
+		VUK_DO_OR_RETURN(upstream->allocate_fences(dst, loc));
+		record_allocations(*impl, *upstream, AllocationKind::eFence, dst, loc);
+		return { expected_value };
+	}
+
+	void DeviceTrackingResource::deallocate_fences(std::span<const VkFence> src) {
+		release_allocations(*impl, AllocationKind::eFence, src);
+		upstream->deallocate_fences(src);
+	}
+
+	Result<void, AllocateException> DeviceTrackingResource::allocate_events(std::span<VkEvent> dst, SourceLocationAtFrame loc) {
+		VUK_DO_OR_RETURN(upstream->allocate_events(dst, loc));
+		record_allocations(*impl, *upstream, AllocationKind::eEvent, dst, loc);
+		return { expected_value };
+	}
+
+	void DeviceTrackingResource::deallocate_events(std::span<const VkEvent> src) {
+		release_allocations(*impl, AllocationKind::eEvent, src);
+		upstream->deallocate_events(src);
+	}
+
+	Result<void, AllocateException> DeviceTrackingResource::allocate_command_buffers(std::span<CommandBufferAllocation> dst,
+	                                                                                 std::span<const CommandBufferAllocationCreateInfo> cis,
+	                                                                                 SourceLocationAtFrame loc) {
+		VUK_DO_OR_RETURN(upstream->allocate_command_buffers(dst, cis, loc));
+		record_allocations(*impl, *upstream, AllocationKind::eCommandBuffer, dst, loc);
+		return { expected_value };
+	}
+
+	void DeviceTrackingResource::deallocate_command_buffers(std::span<const CommandBufferAllocation> src) {
+		release_allocations(*impl, AllocationKind::eCommandBuffer, src);
+		upstream->deallocate_command_buffers(src);
+	}
+
+	Result<void, AllocateException>
+	DeviceTrackingResource::allocate_command_pools(std::span<CommandPool> dst, std::span<const VkCommandPoolCreateInfo> cis, SourceLocationAtFrame loc) {
+		VUK_DO_OR_RETURN(upstream->allocate_command_pools(dst, cis, loc));
+		record_allocations(*impl, *upstream, AllocationKind::eCommandPool, dst, loc);
+		return { expected_value };
+	}
+
+	void DeviceTrackingResource::deallocate_command_pools(std::span<const CommandPool> src) {
+		release_allocations(*impl, AllocationKind::eCommandPool, src);
+		upstream->deallocate_command_pools(src);
+	}
+
+	Result<void, AllocateException>
+	DeviceTrackingResource::allocate_buffers(std::span<BufferCrossDevice> dst, std::span<const BufferCreateInfo> cis, SourceLocationAtFrame loc) {
+		VUK_DO_OR_RETURN(upstream->allocate_buffers(dst, cis, loc));
+		record_allocations(*impl, *upstream, AllocationKind::eBuffer, dst, loc);
+		return { expected_value };
+	}
+
+	void DeviceTrackingResource::deallocate_buffers(std::span<const BufferCrossDevice> src) {
+		release_allocations(*impl, AllocationKind::eBuffer, src);
+		upstream->deallocate_buffers(src);
+	}
+
+	Result<void, AllocateException>
+	DeviceTrackingResource::allocate_buffers(std::span<BufferGPU> dst, std::span<const BufferCreateInfo> cis, SourceLocationAtFrame loc) {
+		VUK_DO_OR_RETURN(upstream->allocate_buffers(dst, cis, loc));
+		record_allocations(*impl, *upstream, AllocationKind::eBuffer, dst, loc);
+		return { expected_value };
+	}
+
+	void DeviceTrackingResource::deallocate_buffers(std::span<const BufferGPU> src) {
+		release_allocations(*impl, AllocationKind::eBuffer, src);
+		upstream->deallocate_buffers(src);
+	}
+
+	Result<void, AllocateException>
+	DeviceTrackingResource::allocate_framebuffers(std::span<VkFramebuffer> dst, std::span<const FramebufferCreateInfo> cis, SourceLocationAtFrame loc) {
+		VUK_DO_OR_RETURN(upstream->allocate_framebuffers(dst, cis, loc));
+		record_allocations(*impl, *upstream, AllocationKind::eFramebuffer, dst, loc);
+		return { expected_value };
+	}
+
+	void DeviceTrackingResource::deallocate_framebuffers(std::span<const VkFramebuffer> src) {
+		release_allocations(*impl, AllocationKind::eFramebuffer, src);
+		upstream->deallocate_framebuffers(src);
+	}
+
+	Result<void, AllocateException> DeviceTrackingResource::allocate_images(std::span<Image> dst, std::span<const ImageCreateInfo> cis, SourceLocationAtFrame loc) {
+		VUK_DO_OR_RETURN(upstream->allocate_images(dst, cis, loc));
+		uint64_t frame = loc.absolute_frame != (uint64_t)-1LL ? loc.absolute_frame : upstream->get_context().get_frame_count();
+		std::unique_lock _(impl->mutex);
+		for (size_t i = 0; i < dst.size(); i++) {
+			impl->record(loc, frame, AllocationKind::eImage, handle_bits(dst[i]), 0, estimate_image_size(cis[i]));
+		}
+		return { expected_value };
+	}
+
+	void DeviceTrackingResource::deallocate_images(std::span<const Image> src) {
+		{
+			std::unique_lock _(impl->mutex);
+			for (auto& v : src) {
+				impl->release(AllocationKind::eImage, handle_bits(v), 0);
+			}
+		}
+		upstream->deallocate_images(src);
+	}
+
+	Result<void, AllocateException>
+	DeviceTrackingResource::allocate_image_views(std::span<ImageView> dst, std::span<const ImageViewCreateInfo> cis, SourceLocationAtFrame loc) {
+		VUK_DO_OR_RETURN(upstream->allocate_image_views(dst, cis, loc));
+		record_allocations(*impl, *upstream, AllocationKind::eImageView, dst, loc);
+		return { expected_value };
+	}
+
+	void DeviceTrackingResource::deallocate_image_views(std::span<const ImageView> src) {
+		release_allocations(*impl, AllocationKind::eImageView, src);
+		upstream->deallocate_image_views(src);
+	}
+
+	Result<void, AllocateException> DeviceTrackingResource::allocate_persistent_descriptor_sets(std::span<PersistentDescriptorSet> dst,
+	                                                                                            std::span<const PersistentDescriptorSetCreateInfo> cis,
+	                                                                                            SourceLocationAtFrame loc) {
+		VUK_DO_OR_RETURN(upstream->allocate_persistent_descriptor_sets(dst, cis, loc));
+		record_allocations(*impl, *upstream, AllocationKind::ePersistentDescriptorSet, dst, loc);
+		return { expected_value };
+	}
+
+	void DeviceTrackingResource::deallocate_persistent_descriptor_sets(std::span<const PersistentDescriptorSet> src) {
+		release_allocations(*impl, AllocationKind::ePersistentDescriptorSet, src);
+		upstream->deallocate_persistent_descriptor_sets(src);
+	}
+
+	Result<void, AllocateException>
+	DeviceTrackingResource::allocate_descriptor_sets(std::span<DescriptorSet> dst, std::span<const SetBinding> cis, SourceLocationAtFrame loc) {
+		VUK_DO_OR_RETURN(upstream->allocate_descriptor_sets(dst, cis, loc));
+		record_allocations(*impl, *upstream, AllocationKind::eDescriptorSet, dst, loc);
+		return { expected_value };
+	}
+
+	void DeviceTrackingResource::deallocate_descriptor_sets(std::span<const DescriptorSet> src) {
+		release_allocations(*impl, AllocationKind::eDescriptorSet, src);
+		upstream->deallocate_descriptor_sets(src);
+	}
+
+	Result<void, AllocateException> DeviceTrackingResource::allocate_timestamp_query_pools(std::span<TimestampQueryPool> dst,
+	                                                                                       std::span<const VkQueryPoolCreateInfo> cis,
+	                                                                                       SourceLocationAtFrame loc) {
+		VUK_DO_OR_RETURN(upstream->allocate_timestamp_query_pools(dst, cis, loc));
+		record_allocations(*impl, *upstream, AllocationKind::eTimestampQueryPool, dst, loc);
+		return { expected_value };
+	}
+
+	void DeviceTrackingResource::deallocate_timestamp_query_pools(std::span<const TimestampQueryPool> src) {
+		release_allocations(*impl, AllocationKind::eTimestampQueryPool, src);
+		upstream->deallocate_timestamp_query_pools(src);
+	}
+
+	Result<void, AllocateException>
+	DeviceTrackingResource::allocate_timestamp_queries(std::span<TimestampQuery> dst, std::span<const TimestampQueryCreateInfo> cis, SourceLocationAtFrame loc) {
+		VUK_DO_OR_RETURN(upstream->allocate_timestamp_queries(dst, cis, loc));
+		record_allocations(*impl, *upstream, AllocationKind::eTimestampQuery, dst, loc);
+		return { expected_value };
+	}
+
+	void DeviceTrackingResource::deallocate_timestamp_queries(std::span<const TimestampQuery> src) {
+		release_allocations(*impl, AllocationKind::eTimestampQuery, src);
+		upstream->deallocate_timestamp_queries(src);
+	}
+
+	Result<void, AllocateException> DeviceTrackingResource::allocate_timeline_semaphores(std::span<TimelineSemaphore> dst, SourceLocationAtFrame loc) {
+		VUK_DO_OR_RETURN(upstream->allocate_timeline_semaphores(dst, loc));
+		record_allocations(*impl, *upstream, AllocationKind::eTimelineSemaphore, dst, loc);
+		return { expected_value };
+	}
+
+	void DeviceTrackingResource::deallocate_timeline_semaphores(std::span<const TimelineSemaphore> src) {
+		release_allocations(*impl, AllocationKind::eTimelineSemaphore, src);
+		upstream->deallocate_timeline_semaphores(src);
+	}
+
+	std::vector<CallSiteStatistics> DeviceTrackingResource::get_call_sites() {
+		std::vector<CallSiteStatistics> result;
+		{
+			std::unique_lock _(impl->mutex);
+			for (auto& [key, site] : impl->sites) {
+				result.push_back(site);
+			}
+		}
+		std::sort(result.begin(), result.end(), [](const CallSiteStatistics& a, const CallSiteStatistics& b) {
+			return std::tie(a.live_bytes, a.live_count) > std::tie(b.live_bytes, b.live_count);
+		});
+		return result;
+	}
+
+	std::vector<CallSiteStatistics> DeviceTrackingResource::get_call_sites(uint64_t frame) {
+		std::vector<CallSiteStatistics> result;
+		{
+			std::unique_lock _(impl->mutex);
+			if (auto it = impl->frames.find(frame); it != impl->frames.end()) {
+				for (auto& [key, site] : it->second) {
+					result.push_back(site);
+				}
+			}
+		}
+		std::sort(result.begin(), result.end(), [](const CallSiteStatistics& a, const CallSiteStatistics& b) {
+			return std::tie(a.total_bytes, a.total_count) > std::tie(b.total_bytes, b.total_count);
+		});
+		return result;
+	}
+
+	std::string DeviceTrackingResource::dump(std::optional<uint64_t> frame) {
+		auto sites = frame ? get_call_sites(*frame) : get_call_sites();
+		return format_call_sites(sites);
+	}
+
+	void DeviceTrackingResource::release_all() {
+		std::unique_lock _(impl->mutex);
+		for (auto& [key, la] : impl->live) {
+			remove(impl->sites.at(la.site), la.bytes);
+			if (auto fit = impl->frames.find(la.frame); fit != impl->frames.end()) {
+				remove(fit->second.at(la.site), la.bytes);
+			}
+		}
+		impl->live.clear();
+	}
+} // namespace vuk
@@ -5,6 +5,7 @@
 #include "vuk/Context.hpp"
 #include "vuk/Exception.hpp"
 #include "vuk/Query.hpp"
+#include "vuk/Tracing.hpp"
 #include "vuk/resources/DeviceNestedResource.hpp"
 
 namespace vuk {
@@ -50,6 +51,26 @@ namespace vuk {
 		}
 	}
 
+	Result<void, AllocateException> DeviceVkResource::allocate_events(std::span<VkEvent> dst, SourceLocationAtFrame loc) {
+		VkEventCreateInfo eci{ .sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO };
+		for (int64_t i = 0; i < (int64_t)dst.size(); i++) {
+			VkResult res = vkCreateEvent(device, &eci, nullptr, &dst[i]);
+			if (res != VK_SUCCESS) {
+				deallocate_events({ dst.data(), (uint64_t)i });
+				return { expected_error, AllocateException{ res } };
+			}
+		}
+		return { expected_value };
+	}
+
+	void DeviceVkResource::deallocate_events(std::span<const VkEvent> src) {
+		for (auto& v : src) {
+			if (v != VK_NULL_HANDLE) {
+				vkDestroyEvent(device, v, nullptr);
+			}
+		}
+	}
+
 	Result<void, AllocateException> DeviceVkResource::allocate_command_buffers(std::span<CommandBufferAllocation> dst,
 	                                                                           std::span<const CommandBufferAllocationCreateInfo> cis,
 	                                                                           SourceLocationAtFrame loc) {
@@ -81,10 +102,12 @@ namespace vuk {
 
 	Result<void, AllocateException>
 	DeviceVkResource::allocate_command_pools(std::span<CommandPool> dst, std::span<const VkCommandPoolCreateInfo> cis, SourceLocationAtFrame loc) {
+		VUK_TRACE_ZONE("vuk::DeviceVkResource::allocate_command_pools");
 		assert(dst.size() == cis.size());
 		for (int64_t i = 0; i < (int64_t)dst.size(); i++) {
 			VkResult res = vkCreateCommandPool(device, &cis[i], nullptr, &dst[i].command_pool);
 			dst[i].queue_family_index = cis[i].queueFamilyIndex;
+			dst[i].flags = cis[i].flags;
 			if (res != VK_SUCCESS) {
 				deallocate_command_pools({ dst.data(), (uint64_t)i });
 				return { expected_error, AllocateException{ res } };
@@ -103,6 +126,7 @@ namespace vuk {
 
 	Result<void, AllocateException>
 	DeviceVkResource::allocate_framebuffers(std::span<VkFramebuffer> dst, std::span<const FramebufferCreateInfo> cis, SourceLocationAtFrame loc) {
+		VUK_TRACE_ZONE("vuk::DeviceVkResource::allocate_framebuffers");
 		assert(dst.size() == cis.size());
 		for (int64_t i = 0; i < (int64_t)dst.size(); i++) {
 			VkResult res = vkCreateFramebuffer(device, &cis[i], nullptr, &dst[i]);
@@ -124,6 +148,7 @@ namespace vuk {
 
 	Result<void, AllocateException>
 	DeviceVkResource::allocate_buffers(std::span<BufferCrossDevice> dst, std::span<const BufferCreateInfo> cis, SourceLocationAtFrame loc) {
+		VUK_TRACE_ZONE("vuk::DeviceVkResource::allocate_buffers");
 		assert(dst.size() == cis.size());
 		for (int64_t i = 0; i < (int64_t)dst.size(); i++) {
 			auto& ci = cis[i];
@@ -133,6 +158,7 @@ namespace vuk {
 			}
 			// TODO: legacy buffer alloc can't signal errors
 			dst[i] = BufferCrossDevice{ legacy_gpu_allocator->allocate_buffer(ci.mem_usage, LegacyGPUAllocator::all_usage, ci.size, ci.alignment, true) };
+			add_allocated_bytes(dst[i].size);
 		}
 		return { expected_value };
 	}
@@ -140,6 +166,7 @@ namespace vuk {
 	void DeviceVkResource::deallocate_buffers(std::span<const BufferCrossDevice> src) {
 		for (auto& v : src) {
 			if (v) {
+				allocated_bytes -= v.size;
 				legacy_gpu_allocator->free_buffer(v);
 			}
 		}
@@ -147,6 +174,7 @@ namespace vuk {
 
 	Result<void, AllocateException>
 	DeviceVkResource::allocate_buffers(std::span<BufferGPU> dst, std::span<const BufferCreateInfo> cis, SourceLocationAtFrame loc) {
+		VUK_TRACE_ZONE("vuk::DeviceVkResource::allocate_buffers");
 		assert(dst.size() == cis.size());
 		for (int64_t i = 0; i < (int64_t)dst.size(); i++) {
 			auto& ci = cis[i];
@@ -156,6 +184,7 @@ namespace vuk {
 				return { expected_error, AllocateException{ VK_ERROR_FEATURE_NOT_PRESENT } }; // tried to allocate cross device buffer as BufferGPU
 			}
 			dst[i] = BufferGPU{ legacy_gpu_allocator->allocate_buffer(ci.mem_usage, LegacyGPUAllocator::all_usage, ci.size, ci.alignment, false) };
+			add_allocated_bytes(dst[i].size);
 		}
 		return { expected_value };
 	}
@@ -163,17 +192,20 @@ namespace vuk {
 	void DeviceVkResource::deallocate_buffers(std::span<const BufferGPU> src) {
 		for (auto& v : src) {
 			if (v) {
+				allocated_bytes -= v.size;
 				legacy_gpu_allocator->free_buffer(v);
 			}
 		}
 	}
 
 	Result<void, AllocateException> DeviceVkResource::allocate_images(std::span<Image> dst, std::span<const ImageCreateInfo> cis, SourceLocationAtFrame loc) {
+		VUK_TRACE_ZONE("vuk::DeviceVkResource::allocate_images");
 		assert(dst.size() == cis.size());
 		for (int64_t i = 0; i < (int64_t)dst.size(); i++) {
 			// TODO: legacy image alloc can't signal errors
 
 			dst[i] = legacy_gpu_allocator->create_image(cis[i]);
+			add_allocated_bytes(legacy_gpu_allocator->get_allocation_size(dst[i]));
 		}
 		return { expected_value };
 	}
@@ -181,6 +213,7 @@ namespace vuk {
 	void DeviceVkResource::deallocate_images(std::span<const Image> src) {
 		for (auto& v : src) {
 			if (v != VK_NULL_HANDLE) {
+				allocated_bytes -= legacy_gpu_allocator->get_allocation_size(v);
 				legacy_gpu_allocator->destroy_image(v);
 			}
 		}
@@ -427,6 +460,14 @@ namespace vuk {
 		upstream->deallocate_fences(dst);
 	}
 
+	Result<void, AllocateException> DeviceNestedResource::allocate_events(std::span<VkEvent> dst, SourceLocationAtFrame loc) {
+		return upstream->allocate_events(dst, loc);
+	}
+
+	void DeviceNestedResource::deallocate_events(std::span<const VkEvent> dst) {
+		upstream->deallocate_events(dst);
+	}
+
 	Result<void, AllocateException> DeviceNestedResource::allocate_command_buffers(std::span<CommandBufferAllocation> dst,
 	                                                                               std::span<const CommandBufferAllocationCreateInfo> cis,
 	                                                                               SourceLocationAtFrame loc) {
@@ -539,4 +580,19 @@ namespace vuk {
 	void DeviceNestedResource::deallocate_swapchains(std::span<const VkSwapchainKHR> src) {
 		upstream->deallocate_swapchains(src);
 	}
+
+	void DeviceVkResource::add_allocated_bytes(uint64_t bytes) {
+		auto total = allocated_bytes.fetch_add(bytes) + bytes;
+		auto peak = peak_bytes.load(std::memory_order_relaxed);
+		while (peak < total && !peak_bytes.compare_exchange_weak(peak, total, std::memory_order_relaxed)) {
+		}
+	}
+
+	ResourceMemoryStatistics DeviceVkResource::get_memory_statistics() {
+		return { allocated_bytes.load(), peak_bytes.load() };
+	}
+
+	bool DeviceNestedResource::track_submission(VkSemaphore timeline_semaphore, uint64_t value) {
+		return upstream->track_submission(timeline_semaphore, value);
+	}
 } // namespace vuk
\ No newline at end of file
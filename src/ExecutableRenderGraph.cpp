@@ -1,10 +1,14 @@
 #include "Cache.hpp"
+#include "PassProfiler.hpp"
 #include "RenderGraphImpl.hpp"
 #include "vuk/CommandBuffer.hpp"
 #include "vuk/Context.hpp"
 #include "vuk/Future.hpp"
 #include "vuk/Hash.hpp" // for create
 #include "vuk/RenderGraph.hpp"
+#include "vuk/Tracing.hpp"
+#include <algorithm>
+#include <string>
 #include <unordered_set>
 
 namespace vuk {
@@ -74,6 +78,7 @@ namespace vuk {
 			auto rg = ctx.acquire_rendertarget(rgci, ctx.get_frame_count());
 			attachment_info.attachment.image_view = rg.image_view;
 			attachment_info.attachment.image = rg.image;
+			attachment_info.attachment.usage = usage;
 		}
 	}
 
@@ -140,6 +145,129 @@ namespace vuk {
 		VkCommandBufferBeginInfo cbi{ .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT };
 		vkBeginCommandBuffer(cbuf, &cbi);
 
+		// pass timestamps
+		auto queries = impl->pass_queries;
+		if (queries && !ctx.get_pass_profiler().supports_timestamps(cpci.queueFamilyIndex)) {
+			queries = nullptr;
+		}
+		// pipeline statistics queries with graphics counters can only be used on queues supporting graphics
+		bool pipeline_statistics = impl->pass_pipeline_statistics && domain == DomainFlagBits::eGraphicsQueue;
+		auto begin_queries = [&](VkCommandBuffer cbuf, uint32_t entry) {
+			if (entry == PassQueries::no_query) {
+				return;
+			}
+			auto& e = queries->entries[entry];
+			vkCmdWriteTimestamp(cbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queries->timestamp_pool, e.timestamp_index);
+			if (e.statistics_index != PassQueries::no_query) {
+				vkCmdBeginQuery(cbuf, queries->statistics_pool, e.statistics_index, 0);
+			}
+		};
+		auto end_queries = [&](VkCommandBuffer cbuf, uint32_t entry) {
+			if (entry == PassQueries::no_query) {
+				return;
+			}
+			auto& e = queries->entries[entry];
+			if (e.statistics_index != PassQueries::no_query) {
+				vkCmdEndQuery(cbuf, queries->statistics_pool, e.statistics_index);
+			}
+			vkCmdWriteTimestamp(cbuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queries->timestamp_pool, e.timestamp_index + 1);
+		};
+
+		// consecutive barriers with the same stages are recorded with a single vkCmdPipelineBarrier (or vkCmdWaitEvents, if they wait on the same event)
+		// unless they touch memory already in the batch, as transitions within a call are unordered
+		// different names can resolve to the same resource (eg. subranges of an image), so the bound handles and ranges are compared
+		struct BarrierBatch {
+			PipelineStageFlags src, dst;
+			uint32_t event;
+			std::vector<VkImageMemoryBarrier> images;
+			std::vector<VkBufferMemoryBarrier> buffers;
+			std::vector<VkMemoryBarrier> memory;
+		};
+		std::vector<BarrierBatch> barrier_batches;
+		auto batch_for = [&](PipelineStageFlags src, PipelineStageFlags dst, uint32_t event, auto&& conflicts) -> BarrierBatch& {
+			// the source stages of a wait must be the stages the event was set with
+			if (event != no_event) {
+				src = impl->event_stages[event];
+			}
+			auto* last = barrier_batches.empty() ? nullptr : &barrier_batches.back();
+			if (!last || last->src != src || last->dst != dst || last->event != event || conflicts(*last)) {
+				last = &barrier_batches.emplace_back(BarrierBatch{ src, dst, event });
+			}
+			return *last;
+		};
+		// [base, base + count) intervals, where a count of VK_REMAINING_* / VK_WHOLE_SIZE extends to the end
+		auto intervals_overlap = [](uint64_t base_a, uint64_t count_a, uint64_t base_b, uint64_t count_b, uint64_t remaining) {
+			uint64_t end_a = count_a == remaining ? UINT64_MAX : base_a + count_a;
+			uint64_t end_b = count_b == remaining ? UINT64_MAX : base_b + count_b;
+			return base_a < end_b && base_b < end_a;
+		};
+		auto image_barriers_overlap = [&](const VkImageMemoryBarrier& a, const VkImageMemoryBarrier& b) {
+			auto& ra = a.subresourceRange;
+			auto& rb = b.subresourceRange;
+			return a.image == b.image && (ra.aspectMask & rb.aspectMask) != 0 &&
+			       intervals_overlap(ra.baseMipLevel, ra.levelCount, rb.baseMipLevel, rb.levelCount, VK_REMAINING_MIP_LEVELS) &&
+			       intervals_overlap(ra.baseArrayLayer, ra.layerCount, rb.baseArrayLayer, rb.layerCount, VK_REMAINING_ARRAY_LAYERS);
+		};
+		auto buffer_barriers_overlap = [&](const VkBufferMemoryBarrier& a, const VkBufferMemoryBarrier& b) {
+			return a.buffer == b.buffer && intervals_overlap(a.offset, a.size, b.offset, b.size, VK_WHOLE_SIZE);
+		};
+		auto emit_barriers = [&](VkCommandBuffer cbuf,
+		                         std::span<const ImageBarrier> image_barriers,
+		                         std::span<const MemoryBarrier> memory_barriers,
+		                         std::span<const BufferBarrier> buffer_barriers) {
+			barrier_batches.clear();
+			for (auto dep : image_barriers) {
+				auto& bound = impl->bound_attachments[dep.image];
+				dep.barrier.image = bound.attachment.image;
+				// turn base_{layer, level} into absolute values wrt the image
+				dep.barrier.subresourceRange.baseArrayLayer += bound.attachment.base_layer;
+				dep.barrier.subresourceRange.baseMipLevel += bound.attachment.base_level;
+				auto conflicts = [&](const BarrierBatch& b) {
+					return std::any_of(b.images.begin(), b.images.end(), [&](auto& other) { return image_barriers_overlap(other, dep.barrier); });
+				};
+				batch_for(dep.src, dep.dst, dep.event, conflicts).images.push_back(dep.barrier);
+			}
+			for (const auto& dep : memory_barriers) {
+				batch_for(dep.src, dep.dst, dep.event, [](const BarrierBatch&) { return false; }).memory.push_back(dep.barrier);
+			}
+			for (auto dep : buffer_barriers) {
+				auto& bound = impl->bound_buffers[dep.buffer].buffer;
+				dep.barrier.buffer = bound.buffer;
+				dep.barrier.offset = bound.offset;
+				dep.barrier.size = bound.size;
+				auto conflicts = [&](const BarrierBatch& b) {
+					return std::any_of(b.buffers.begin(), b.buffers.end(), [&](auto& other) { return buffer_barriers_overlap(other, dep.barrier); });
+				};
+				batch_for(dep.src, dep.dst, no_event, conflicts).buffers.push_back(dep.barrier);
+			}
+			for (auto& b : barrier_batches) {
+				if (b.event != no_event) {
+					vkCmdWaitEvents(cbuf,
+					                1,
+					                &impl->events[b.event],
+					                (VkPipelineStageFlags)b.src,
+					                (VkPipelineStageFlags)b.dst,
+					                (uint32_t)b.memory.size(),
+					                b.memory.data(),
+					                (uint32_t)b.buffers.size(),
+					                b.buffers.data(),
+					                (uint32_t)b.images.size(),
+					                b.images.data());
+					continue;
+				}
+				vkCmdPipelineBarrier(cbuf,
+				                     (VkPipelineStageFlags)b.src,
+				                     (VkPipelineStageFlags)b.dst,
+				                     0,
+				                     (uint32_t)b.memory.size(),
+				                     b.memory.data(),
+				                     (uint32_t)b.buffers.size(),
+				                     b.buffers.data(),
+				                     (uint32_t)b.images.size(),
+				                     b.images.data());
+			}
+		};
+
 		uint64_t command_buffer_index = rpis[0].command_buffer_index;
 		for (auto& rpass : rpis) {
 			if (rpass.command_buffer_index != command_buffer_index) { // end old cb and start new one
@@ -162,16 +290,24 @@ namespace vuk {
 				ctx.debug.begin_region(cbuf, rpass.subpasses[0].passes[0]->pass.name);
 			}
 
-			for (auto dep : rpass.pre_barriers) {
-				auto& bound = impl->bound_attachments[dep.image];
-				dep.barrier.image = bound.attachment.image;
-				// turn base_{layer, level} into absolute values wrt the image
-				dep.barrier.subresourceRange.baseArrayLayer += bound.attachment.base_layer;
-				dep.barrier.subresourceRange.baseMipLevel += bound.attachment.base_level;
-				vkCmdPipelineBarrier(cbuf, (VkPipelineStageFlags)dep.src, (VkPipelineStageFlags)dep.dst, 0, 0, nullptr, 0, nullptr, 1, &dep.barrier);
-			}
-			for (const auto& dep : rpass.pre_mem_barriers) {
-				vkCmdPipelineBarrier(cbuf, (VkPipelineStageFlags)dep.src, (VkPipelineStageFlags)dep.dst, 0, 1, &dep.barrier, 0, nullptr, 0, nullptr);
+			emit_barriers(cbuf, rpass.pre_barriers, rpass.pre_mem_barriers, rpass.pre_buffer_barriers);
+
+			// renderpasses of a single pass are covered by the timestamps of the pass
+			uint32_t rpass_entry = PassQueries::no_query;
+			if (queries && rpass.handle != VK_NULL_HANDLE && !is_single_pass) {
+				std::string name;
+				for (auto& sp : rpass.subpasses) {
+					for (auto& p : sp.passes) {
+						if (!p->pass.name.is_invalid()) {
+							name += name.empty() ? "" : "|";
+							name += p->pass.name.to_sv();
+						}
+					}
+				}
+				if (!name.empty()) {
+					rpass_entry = queries->add(Name(name), domain, true, false);
+					begin_queries(cbuf, rpass_entry);
+				}
 			}
 
 			if (rpass.handle != VK_NULL_HANDLE) {
@@ -192,13 +328,7 @@ namespace vuk {
 				auto& sp = rpass.subpasses[i];
 				// insert image pre-barriers
 				if (rpass.handle == VK_NULL_HANDLE) {
-					for (auto dep : sp.pre_barriers) {
-						dep.barrier.image = impl->bound_attachments[dep.image].attachment.image;
-						vkCmdPipelineBarrier(cbuf, (VkPipelineStageFlags)dep.src, (VkPipelineStageFlags)dep.dst, 0, 0, nullptr, 0, nullptr, 1, &dep.barrier);
-					}
-					for (const auto& dep : sp.pre_mem_barriers) {
-						vkCmdPipelineBarrier(cbuf, (VkPipelineStageFlags)dep.src, (VkPipelineStageFlags)dep.dst, 0, 1, &dep.barrier, 0, nullptr, 0, nullptr);
-					}
+					emit_barriers(cbuf, sp.pre_barriers, sp.pre_mem_barriers, {});
 				}
 				for (auto& p : sp.passes) {
 					CommandBuffer cobuf(*this, ctx, alloc, cbuf);
@@ -209,7 +339,14 @@ namespace vuk {
 					}
 
 					if (p->pass.execute) {
+						VUK_TRACE_ZONE(p->pass.name.is_invalid() ? "vuk::unnamed_pass" : p->pass.name.c_str());
 						cobuf.current_pass = p;
+						// only vkCmdExecuteCommands is allowed in subpasses recorded with secondary command buffers
+						uint32_t pass_entry = PassQueries::no_query;
+						if (queries && !p->pass.name.is_invalid() && !(rpass.handle != VK_NULL_HANDLE && sp.use_secondary_command_buffers)) {
+							pass_entry = queries->add(p->pass.name, domain, false, pipeline_statistics);
+						}
+						begin_queries(cobuf.command_buffer, pass_entry);
 						if (!p->pass.name.is_invalid() && !is_single_pass) {
 							ctx.debug.begin_region(cobuf.command_buffer, p->pass.name);
 							p->pass.execute(cobuf);
@@ -217,6 +354,7 @@ namespace vuk {
 						} else {
 							p->pass.execute(cobuf);
 						}
+						end_queries(cobuf.command_buffer, pass_entry);
 					}
 
 					if (auto res = cobuf.result(); !res) {
@@ -230,16 +368,9 @@ namespace vuk {
 
 				// insert image post-barriers
 				if (rpass.handle == VK_NULL_HANDLE) {
-					for (auto dep : sp.post_barriers) {
-						auto& bound = impl->bound_attachments[dep.image];
-						dep.barrier.image = bound.attachment.image;
-						// turn base_{layer, level} into absolute values wrt the image
-						dep.barrier.subresourceRange.baseArrayLayer += bound.attachment.base_layer;
-						dep.barrier.subresourceRange.baseMipLevel += bound.attachment.base_level;
-						vkCmdPipelineBarrier(cbuf, (VkPipelineStageFlags)dep.src, (VkPipelineStageFlags)dep.dst, 0, 0, nullptr, 0, nullptr, 1, &dep.barrier);
-					}
-					for (const auto& dep : sp.post_mem_barriers) {
-						vkCmdPipelineBarrier(cbuf, (VkPipelineStageFlags)dep.src, (VkPipelineStageFlags)dep.dst, 0, 1, &dep.barrier, 0, nullptr, 0, nullptr);
+					emit_barriers(cbuf, sp.post_barriers, sp.post_mem_barriers, {});
+					if (sp.signal_event != no_event) {
+						vkCmdSetEvent(cbuf, impl->events[sp.signal_event], (VkPipelineStageFlags)impl->event_stages[sp.signal_event]);
 					}
 				}
 			}
@@ -249,16 +380,10 @@ namespace vuk {
 			if (rpass.handle != VK_NULL_HANDLE) {
 				vkCmdEndRenderPass(cbuf);
 			}
-			for (auto dep : rpass.post_barriers) {
-				auto& bound = impl->bound_attachments[dep.image];
-				dep.barrier.image = bound.attachment.image;
-				// turn base_{layer, level} into absolute values wrt the image
-				dep.barrier.subresourceRange.baseArrayLayer += bound.attachment.base_layer;
-				dep.barrier.subresourceRange.baseMipLevel += bound.attachment.base_level;
-				vkCmdPipelineBarrier(cbuf, (VkPipelineStageFlags)dep.src, (VkPipelineStageFlags)dep.dst, 0, 0, nullptr, 0, nullptr, 1, &dep.barrier);
-			}
-			for (const auto& dep : rpass.post_mem_barriers) {
-				vkCmdPipelineBarrier(cbuf, (VkPipelineStageFlags)dep.src, (VkPipelineStageFlags)dep.dst, 0, 1, &dep.barrier, 0, nullptr, 0, nullptr);
+			end_queries(cbuf, rpass_entry);
+			emit_barriers(cbuf, rpass.post_barriers, rpass.post_mem_barriers, rpass.post_buffer_barriers);
+			if (rpass.signal_event != no_event) {
+				vkCmdSetEvent(cbuf, impl->events[rpass.signal_event], (VkPipelineStageFlags)impl->event_stages[rpass.signal_event]);
 			}
 		}
 
@@ -272,6 +397,7 @@ namespace vuk {
 	}
 
 	Result<SubmitBundle> ExecutableRenderGraph::execute(Allocator& alloc, std::vector<std::pair<SwapchainRef, size_t>> swp_with_index) {
+		VUK_TRACE_ZONE("vuk::ExecutableRenderGraph::execute");
 		Context& ctx = alloc.get_context();
 		// bind swapchain attachment images & ivs
 		for (auto& [name, bound] : impl->bound_attachments) {
@@ -387,6 +513,27 @@ namespace vuk {
 
 		SubmitBundle sbundle;
 
+		// events of split barriers, recycled by the allocator once the frame completes
+		// allocated before the query pools are taken, so that failing here does not leak them
+		impl->events.resize(impl->event_stages.size());
+		if (impl->events.size() > 0) {
+			VUK_DO_OR_RETURN(alloc.allocate_events(impl->events));
+		}
+
+		// take query pools with room for every pass and renderpass of the graph
+		PassQueries pass_queries;
+		if (impl->pass_timestamps) {
+			uint32_t pass_count = 0;
+			for (auto& rp : impl->rpis) {
+				for (auto& sp : rp.subpasses) {
+					pass_count += (uint32_t)sp.passes.size();
+				}
+			}
+			auto statistics_count = impl->pass_pipeline_statistics ? pass_count : 0;
+			pass_queries = ctx.get_pass_profiler().acquire(ctx.get_frame_count(), 2 * (pass_count + (uint32_t)impl->rpis.size()), statistics_count);
+			impl->pass_queries = &pass_queries;
+		}
+
 		auto record_batch = [&alloc, this](std::span<RenderPassInfo> rpis, DomainFlagBits domain) {
 			SubmitBatch sbatch{ .domain = domain };
 			auto partition_it = rpis.begin();
@@ -420,6 +567,15 @@ namespace vuk {
 			sbundle.batches.emplace_back(record_batch(transfer_rpis, DomainFlagBits::eTransferQueue));
 		}
 
+		if (impl->pass_queries) {
+			ctx.get_pass_profiler().submit(std::move(pass_queries));
+			impl->pass_queries = nullptr;
+		}
+
+		if (impl->events.size() > 0) {
+			alloc.deallocate(std::span<const VkEvent>(impl->events)); // queue events for recycling
+		}
+
 		return { expected_value, std::move(sbundle) };
 	}
 
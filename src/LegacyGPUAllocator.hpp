@@ -6,11 +6,13 @@
 #include "vuk/Buffer.hpp"
 #include "vuk/Hash.hpp"
 #include "vuk/Image.hpp"
+#include "vuk/MemoryStatistics.hpp"
 #include "vuk/Types.hpp"
 
 #include <string.h>
 #include <array>
 #include <atomic>
+#include <deque>
 #include <mutex>
 #include <unordered_map>
 #include <utility>
@@ -67,28 +69,50 @@ namespace vuk {
 	};
 
 	struct LegacyLinearAllocator {
-		std::atomic<int> current_buffer = -1;
-		std::atomic<size_t> needle = 0;
+		struct Block {
+			VmaAllocation allocation;
+			VkDeviceMemory device_memory;
+			VkBuffer buffer;
+			std::byte* mapped_ptr;
+			size_t size;
+		};
+
 		VkMemoryRequirements mem_reqs;
 		VmaMemoryUsage mem_usage;
 		vuk::BufferUsageFlags usage;
-		std::array<std::tuple<VmaAllocation, VkDeviceMemory, size_t, VkBuffer, std::byte*>, 32> allocations;
+
+		// threads carve chunks out of the blocks under this lock, and then allocate from their chunk without synchronization
+		std::mutex lock;
+		// blocks are kept across resets and reused, when they run out a new block is chained
+		std::deque<Block> blocks;
+		size_t current_block = 0;
+		size_t needle = 0;
+		// allocations that don't fit into a block, destroyed on reset
+		std::vector<Block> dedicated;
+		// chunks cached by threads are only valid while the epoch is unchanged, it is globally unique
+		std::atomic<uint64_t> epoch;
+		static inline std::atomic<uint64_t> epoch_counter = 1;
 
 		size_t block_size = 1024 * 1024 * 16;
+		size_t chunk_size = 1024 * 256;
 
 		LegacyLinearAllocator(VkMemoryRequirements mem_reqs, VmaMemoryUsage mem_usage, vuk::BufferUsageFlags buf_usage) :
 		    mem_reqs(mem_reqs),
 		    mem_usage(mem_usage),
-		    usage(buf_usage) {}
+		    usage(buf_usage),
+		    epoch(epoch_counter++) {}
 
 		LegacyLinearAllocator(LegacyLinearAllocator&& o) noexcept {
-			current_buffer = o.current_buffer.load();
-			needle = o.needle.load();
 			mem_reqs = o.mem_reqs;
 			mem_usage = o.mem_usage;
 			usage = o.usage;
-			allocations = o.allocations;
+			blocks = std::move(o.blocks);
+			current_block = o.current_block;
+			needle = o.needle;
+			dedicated = std::move(o.dedicated);
+			epoch = epoch_counter++;
 			block_size = o.block_size;
+			chunk_size = o.chunk_size;
 		}
 	};
 
@@ -122,6 +146,7 @@ namespace vuk {
 		VkPhysicalDeviceProperties properties;
 		std::vector<uint32_t> all_queue_families;
 		uint32_t queue_family_count;
+		VkSharingMode buffer_sharing_mode;
 
 	public:
 		LegacyGPUAllocator(VkInstance instance,
@@ -129,9 +154,16 @@ namespace vuk {
 		                   VkPhysicalDevice phys_dev,
 		                   uint32_t graphics_queue_family,
 		                   uint32_t compute_queue_family,
-		                   uint32_t transfer_queue_family);
+		                   uint32_t transfer_queue_family,
+		                   bool memory_budget = false,
+		                   bool exclusive_buffers = false);
 		~LegacyGPUAllocator();
 
+		// buffers are concurrent when used from multiple queue families, unless exclusive buffers were requested
+		VkSharingMode get_buffer_sharing_mode() const {
+			return buffer_sharing_mode;
+		}
+
 		// allocate an externally managed pool
 		LegacyPoolAllocator allocate_pool(MemoryUsage mem_usage, vuk::BufferUsageFlags buffer_usage);
 		// allocate an externally managed linear pool
@@ -150,11 +182,20 @@ namespace vuk {
 		Buffer allocate_buffer(LegacyLinearAllocator& pool, size_t size, size_t alignment, bool create_mapped);
 
 		size_t get_allocation_size(const Buffer&);
+		size_t get_allocation_size(vuk::Image image);
+		// size of the blocks owned by the linear pool
+		size_t get_footprint(LegacyLinearAllocator& pool);
+		// budget and usage of each memory heap
+		std::vector<HeapStatistics> get_heap_statistics();
 
 		void reset_pool(LegacyPoolAllocator& pool);
 		void reset_pool(LegacyLinearAllocator& pool);
+		// release the blocks of the linear pool that have not been used since the last reset
+		void trim(LegacyLinearAllocator& pool);
 
 		void free_buffer(const Buffer& b);
+		// flush a range (relative to the buffer) of a mapped buffer allocated from a pool - no-op for host coherent memory
+		void flush_buffer(const Buffer& b, size_t offset, size_t size);
 		void destroy(const LegacyPoolAllocator& pool);
 		void destroy(const LegacyLinearAllocator& pool);
 
@@ -167,6 +208,9 @@ namespace vuk {
 		VmaPool _create_pool(MemoryUsage mem_usage, vuk::BufferUsageFlags buffer_usage);
 		Buffer _allocate_buffer(LegacyPoolAllocator& pool, size_t size, size_t alignment, bool create_mapped);
 		Buffer _allocate_buffer(LegacyLinearAllocator& pool, size_t size, size_t alignment, bool create_mapped);
+		LegacyLinearAllocator::Block _create_linear_block(LegacyLinearAllocator& pool, size_t size, bool create_mapped);
+		// carve a range out of the current block of the pool, chaining a new block if needed - pool.lock must be held
+		std::pair<LegacyLinearAllocator::Block, size_t> _carve(LegacyLinearAllocator& pool, size_t size, size_t alignment, bool create_mapped);
 	};
 
 	template<>
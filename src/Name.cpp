@@ -13,7 +13,7 @@ namespace {
 		static constexpr size_t arr_siz = 2048;
 
 		const char* add(std::string_view s) {
-			auto hash = hash::fnv1a::hash(s.data(), (uint32_t)s.size());
+			auto hash = hash::hash_bytes(s.data(), s.size());
 			{
 				std::shared_lock _(lock);
 				if (auto it = map.find(hash); it != map.end()) {
@@ -65,7 +65,7 @@ namespace {
 
 		// to store the strings
 		std::vector<std::pair<size_t, std::array<char, arr_siz>*>> buffers;
-		robin_hood::unordered_flat_map<uint32_t, const char*> map;
+		robin_hood::unordered_flat_map<uint64_t, const char*> map;
 		std::shared_mutex lock;
 	};
 
@@ -100,6 +100,6 @@ namespace vuk {
 
 namespace std {
 	size_t hash<vuk::Name>::operator()(vuk::Name const& s) const {
-		return hash<const char*>()(s.id);
+		return (size_t)::hash::mix(reinterpret_cast<uintptr_t>(s.id), ::hash::detail::secret[0]);
 	}
 } // namespace std
\ No newline at end of file
@@ -0,0 +1,277 @@
+#include "vuk/Partials.hpp"
+#include "vuk/CommandBuffer.hpp"
+#include "vuk/Context.hpp"
+#include "vuk/Pipeline.hpp"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace vuk {
+	namespace {
+		// single pass downsampler: every workgroup reduces a 64x64 block of the base level into levels 1-6 through shared memory
+		// the last workgroup to finish (found with an atomic counter per layer) then reduces level 6 into levels 7-12
+		constexpr const char* spd_source = R"(
+layout(local_size_x = 256) in;
+
+layout(push_constant) uniform Params {
+	uint mips;
+	uint workgroups;
+};
+
+layout(binding = 0, FORMAT) uniform readonly image2DArray src;
+layout(binding = 1, FORMAT) uniform writeonly image2DArray dst1;
+layout(binding = 2, FORMAT) uniform writeonly image2DArray dst2;
+layout(binding = 3, FORMAT) uniform writeonly image2DArray dst3;
+layout(binding = 4, FORMAT) uniform writeonly image2DArray dst4;
+layout(binding = 5, FORMAT) uniform writeonly image2DArray dst5;
+layout(binding = 6, FORMAT) uniform coherent image2DArray dst6;
+layout(binding = 7, FORMAT) uniform writeonly image2DArray dst7;
+layout(binding = 8, FORMAT) uniform writeonly image2DArray dst8;
+layout(binding = 9, FORMAT) uniform writeonly image2DArray dst9;
+layout(binding = 10, FORMAT) uniform writeonly image2DArray dst10;
+layout(binding = 11, FORMAT) uniform writeonly image2DArray dst11;
+layout(binding = 12, FORMAT) uniform writeonly image2DArray dst12;
+layout(binding = 13) coherent buffer Counters {
+	uint counters[];
+};
+
+shared vec4 tile[32 * 32];
+shared bool is_last;
+
+#define STORE(img) if (all(lessThan(p.xy, imageSize(img).xy))) { imageStore(img, p, v); } break
+
+void store(uint level, ivec3 p, vec4 v) {
+	switch (level) {
+	case 1: STORE(dst1);
+	case 2: STORE(dst2);
+	case 3: STORE(dst3);
+	case 4: STORE(dst4);
+	case 5: STORE(dst5);
+	case 6: STORE(dst6);
+	case 7: STORE(dst7);
+	case 8: STORE(dst8);
+	case 9: STORE(dst9);
+	case 10: STORE(dst10);
+	case 11: STORE(dst11);
+	case 12: STORE(dst12);
+	}
+}
+
+vec4 load(bool from_level6, ivec2 p, int layer) {
+	if (from_level6) {
+		return imageLoad(dst6, ivec3(min(p, imageSize(dst6).xy - 1), layer));
+	}
+	return imageLoad(src, ivec3(min(p, imageSize(src).xy - 1), layer));
+}
+
+// reduce the 64x64 block of the level below first_level into first_level and the following 5 levels
+void reduce(uint first_level, ivec2 block, int layer, bool from_level6) {
+	uint i = gl_LocalInvocationIndex;
+	for (uint k = 0; k < 4; k++) {
+		uint t = i + k * 256;
+		ivec2 p = block * 32 + ivec2(t % 32, t / 32);
+		vec4 v = (load(from_level6, 2 * p, layer) + load(from_level6, 2 * p + ivec2(1, 0), layer) + load(from_level6, 2 * p + ivec2(0, 1), layer) +
+		          load(from_level6, 2 * p + ivec2(1, 1), layer)) * 0.25;
+		store(first_level, ivec3(p, layer), v);
+		tile[t] = v;
+	}
+	barrier();
+	uint last_level = min(first_level + 5, mips);
+	for (uint level = first_level + 1; level <= last_level; level++) {
+		int s = 32 >> (level - first_level);
+		ivec2 local = ivec2(i % s, i / s);
+		bool active = i < s * s;
+		vec4 v;
+		if (active) {
+			v = (tile[2 * local.y * 32 + 2 * local.x] + tile[2 * local.y * 32 + 2 * local.x + 1] + tile[(2 * local.y + 1) * 32 + 2 * local.x] +
+			     tile[(2 * local.y + 1) * 32 + 2 * local.x + 1]) * 0.25;
+			store(level, ivec3(block * s + local, layer), v);
+		}
+		barrier();
+		if (active) {
+			tile[local.y * 32 + local.x] = v;
+		}
+		barrier();
+	}
+}
+
+void main() {
+	int layer = int(gl_WorkGroupID.z);
+	reduce(1, ivec2(gl_WorkGroupID.xy), layer, false);
+	if (mips > 6) {
+		memoryBarrierImage();
+		barrier();
+		if (gl_LocalInvocationIndex == 0) {
+			is_last = atomicAdd(counters[layer], 1) == workgroups - 1;
+		}
+		barrier();
+		if (is_last) {
+			if (gl_LocalInvocationIndex == 0) {
+				counters[layer] = 0;
+			}
+			reduce(7, ivec2(0), layer, true);
+		}
+	}
+}
+)";
+
+		const char* format_to_glsl_image_format(Format format) {
+			switch (format) {
+			case Format::eR8Unorm:
+				return "r8";
+			case Format::eR8G8Unorm:
+				return "rg8";
+			case Format::eR8G8B8A8Unorm:
+				return "rgba8";
+			case Format::eR8G8B8A8Snorm:
+				return "rgba8_snorm";
+			case Format::eR16Unorm:
+				return "r16";
+			case Format::eR16G16Unorm:
+				return "rg16";
+			case Format::eR16G16B16A16Unorm:
+				return "rgba16";
+			case Format::eR16Sfloat:
+				return "r16f";
+			case Format::eR16G16Sfloat:
+				return "rg16f";
+			case Format::eR16G16B16A16Sfloat:
+				return "rgba16f";
+			case Format::eR32Sfloat:
+				return "r32f";
+			case Format::eR32G32Sfloat:
+				return "rg32f";
+			case Format::eR32G32B32A32Sfloat:
+				return "rgba32f";
+			case Format::eA2B10G10R10UnormPack32:
+				return "rgb10_a2";
+			case Format::eB10G11R11UfloatPack32:
+				return "r11f_g11f_b10f";
+			default:
+				return nullptr;
+			}
+		}
+
+		constexpr uint32_t spd_max_levels = 12;
+
+		bool record_spd(CommandBuffer& command_buffer, const ImageAttachment& ia, uint32_t base_mip, uint32_t num_mips) {
+#if VUK_USE_SHADERC
+			// the levels are written as storage images, images of unknown usage are blitted
+			if (!(ia.usage & ImageUsageFlagBits::eStorage)) {
+				return false;
+			}
+			auto& ctx = command_buffer.get_context();
+			auto glsl_format = format_to_glsl_image_format(ia.format);
+			if (!glsl_format) {
+				return false;
+			}
+			VkFormatProperties props;
+			vkGetPhysicalDeviceFormatProperties(ctx.physical_device, (VkFormat)ia.format, &props);
+			if (!(props.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT)) {
+				return false;
+			}
+			uint32_t levels = num_mips - 1;
+			uint32_t width = std::max(ia.extent.extent.width >> base_mip, 1u);
+			uint32_t height = std::max(ia.extent.extent.height >> base_mip, 1u);
+			// the last workgroup can only reduce a 64x64 level 6
+			if (levels > spd_max_levels || (levels > 6 && (width > 4096 || height > 4096))) {
+				return false;
+			}
+
+			PipelineBaseCreateInfo pbci;
+			pbci.add_glsl(std::string("#version 450\n#pragma shader_stage(compute)\n#define FORMAT ") + glsl_format + "\n" + spd_source, "<spd>");
+			command_buffer.bind_compute_pipeline(ctx.get_pipeline(pbci));
+
+			auto& allocator = command_buffer.get_allocator();
+			std::vector<Unique<ImageView>> views;
+			for (uint32_t level = 0; level <= levels; level++) {
+				ImageViewCreateInfo ivci;
+				ivci.image = ia.image;
+				ivci.viewType = ImageViewType::e2DArray;
+				ivci.format = ia.format;
+				ivci.subresourceRange = { .aspectMask = ImageAspectFlagBits::eColor,
+					                        .baseMipLevel = base_mip + level,
+					                        .levelCount = 1,
+					                        .baseArrayLayer = ia.base_layer,
+					                        .layerCount = ia.layer_count };
+				auto view = allocate_image_view(allocator, ivci);
+				if (!view) {
+					return false;
+				}
+				views.emplace_back(std::move(*view));
+			}
+			for (uint32_t binding = 0; binding <= spd_max_levels; binding++) {
+				// levels past the end are not written, but still need a valid descriptor
+				auto& view = binding <= levels ? views[binding] : views[1];
+				command_buffer.bind_image(0, binding, *view, ImageLayout::eGeneral);
+			}
+
+			uint32_t groups_x = (width + 63) / 64;
+			uint32_t groups_y = (height + 63) / 64;
+			auto counters = allocate_buffer_cross_device(allocator, BufferCreateInfo{ MemoryUsage::eCPUtoGPU, sizeof(uint32_t) * ia.layer_count, 4 });
+			if (!counters) {
+				return false;
+			}
+			memset((*counters)->mapped_ptr, 0, sizeof(uint32_t) * ia.layer_count);
+			command_buffer.bind_buffer(0, 13, **counters);
+
+			struct {
+				uint32_t mips;
+				uint32_t workgroups;
+			} params = { levels, groups_x * groups_y };
+			command_buffer.push_constants(ShaderStageFlagBits::eCompute, 0, params);
+			command_buffer.dispatch(groups_x, groups_y, ia.layer_count);
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		// fallback: blit each level from the previous one, inside the same pass with the image in the general layout
+		void record_blit_mips(CommandBuffer& command_buffer, Name name, const ImageAttachment& ia, uint32_t base_mip, uint32_t num_mips) {
+			command_buffer.image_barrier(name, Access::eComputeRW, Access::eTransferRead, base_mip, 1);
+			for (uint32_t level = base_mip + 1; level < base_mip + num_mips; level++) {
+				if (level > base_mip + 1) {
+					command_buffer.image_barrier(name, Access::eTransferWrite, Access::eTransferRead, level - 1, 1);
+				}
+				ImageBlit blit;
+				blit.srcSubresource.aspectMask = format_to_aspect(ia.format);
+				blit.srcSubresource.baseArrayLayer = ia.base_layer;
+				blit.srcSubresource.layerCount = ia.layer_count;
+				blit.srcSubresource.mipLevel = level - 1;
+				blit.srcOffsets[0] = Offset3D{ 0 };
+				blit.srcOffsets[1] = Offset3D{ std::max((int32_t)ia.extent.extent.width >> (level - 1), 1), std::max((int32_t)ia.extent.extent.height >> (level - 1), 1), 1 };
+				blit.dstSubresource = blit.srcSubresource;
+				blit.dstSubresource.mipLevel = level;
+				blit.dstOffsets[0] = Offset3D{ 0 };
+				blit.dstOffsets[1] = Offset3D{ std::max((int32_t)ia.extent.extent.width >> level, 1), std::max((int32_t)ia.extent.extent.height >> level, 1), 1 };
+				command_buffer.blit_image(name, name, blit, Filter::eLinear);
+			}
+			// the rendergraph synchronizes with the compute access declared for the pass
+			command_buffer.image_barrier(name, Access::eTransferWrite, Access::eComputeRW, base_mip, num_mips);
+		}
+	} // namespace
+
+	Future<ImageAttachment> generate_mips_spd(Future<ImageAttachment> image, uint32_t base_mip, uint32_t num_mips) {
+		auto& allocator = image.get_allocator();
+
+		std::unique_ptr<RenderGraph> rgp = std::make_unique<RenderGraph>();
+		rgp->add_pass({ .name = "MIP SPD",
+		                .execute_on = DomainFlagBits::eGraphicsOnGraphics,
+		                .resources = { "_src"_image >> Access::eComputeRW },
+		                .execute = [base_mip, num_mips](CommandBuffer& command_buffer) {
+			                if (num_mips <= 1) {
+				                return;
+			                }
+			                auto ia = *command_buffer.get_resource_image_attachment("_src");
+			                assert(ia.extent.sizing == Sizing::eAbsolute);
+			                assert(ia.layer_count != VK_REMAINING_ARRAY_LAYERS);
+			                if (!record_spd(command_buffer, ia, base_mip, num_mips)) {
+				                record_blit_mips(command_buffer, "_src", ia, base_mip, num_mips);
+			                }
+		                } });
+		rgp->attach_in("_src", std::move(image));
+		return { allocator, std::move(rgp), "_src+" };
+	}
+} // namespace vuk
@@ -0,0 +1,196 @@
+#include "PassProfiler.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace vuk {
+	uint32_t PassQueries::add(Name name, DomainFlagBits domain, bool renderpass, bool statistics) {
+		if (timestamp_count + 2 > timestamp_capacity) {
+			return no_query;
+		}
+		Entry e{ name, domain, renderpass, timestamp_count, no_query };
+		timestamp_count += 2;
+		if (statistics && statistics_count < statistics_capacity) {
+			e.statistics_index = statistics_count++;
+		}
+		entries.push_back(e);
+		return (uint32_t)entries.size() - 1;
+	}
+
+	PassProfiler::PassProfiler(VkDevice device, VkPhysicalDevice physical_device, bool pipeline_statistics_query) :
+	    device(device),
+	    pipeline_statistics_query(pipeline_statistics_query) {
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physical_device, &properties);
+		timestamp_period = properties.limits.timestampPeriod;
+
+		uint32_t family_count = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+		std::vector<VkQueueFamilyProperties> families(family_count);
+		vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+		for (auto& f : families) {
+			timestamp_valid_bits.push_back(f.timestampValidBits);
+		}
+	}
+
+	PassProfiler::~PassProfiler() {
+		for (auto& q : pending) {
+			recycle(q);
+		}
+		for (auto& p : free_timestamp_pools) {
+			vkDestroyQueryPool(device, p.pool, nullptr);
+		}
+		for (auto& p : free_statistics_pools) {
+			vkDestroyQueryPool(device, p.pool, nullptr);
+		}
+	}
+
+	PassProfiler::Pool PassProfiler::take_pool(std::vector<Pool>& free_pools, VkQueryType type, uint32_t count) {
+		// take the smallest pool that fits
+		auto best = free_pools.end();
+		for (auto it = free_pools.begin(); it != free_pools.end(); ++it) {
+			if (it->capacity >= count && (best == free_pools.end() || it->capacity < best->capacity)) {
+				best = it;
+			}
+		}
+		Pool p;
+		if (best != free_pools.end()) {
+			p = *best;
+			*best = free_pools.back();
+			free_pools.pop_back();
+		} else {
+			p.capacity = std::max(256u, std::bit_ceil(count));
+			VkQueryPoolCreateInfo qpci{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+			qpci.queryType = type;
+			qpci.queryCount = p.capacity;
+			qpci.pipelineStatistics = type == VK_QUERY_TYPE_PIPELINE_STATISTICS ? statistics_flags : 0;
+			if (vkCreateQueryPool(device, &qpci, nullptr, &p.pool) != VK_SUCCESS) {
+				return { VK_NULL_HANDLE, 0 };
+			}
+		}
+		vkResetQueryPool(device, p.pool, 0, p.capacity);
+		return p;
+	}
+
+	PassQueries PassProfiler::acquire(uint64_t frame, uint32_t timestamp_count, uint32_t statistics_count) {
+		PassQueries queries;
+		queries.frame = frame;
+		std::lock_guard _(lock);
+		if (timestamp_count > 0) {
+			auto p = take_pool(free_timestamp_pools, VK_QUERY_TYPE_TIMESTAMP, timestamp_count);
+			queries.timestamp_pool = p.pool;
+			queries.timestamp_capacity = p.capacity;
+		}
+		if (statistics_count > 0 && pipeline_statistics_query && queries.timestamp_pool != VK_NULL_HANDLE) {
+			auto p = take_pool(free_statistics_pools, VK_QUERY_TYPE_PIPELINE_STATISTICS, statistics_count);
+			queries.statistics_pool = p.pool;
+			queries.statistics_capacity = p.capacity;
+		}
+		return queries;
+	}
+
+	void PassProfiler::submit(PassQueries&& queries) {
+		std::lock_guard _(lock);
+		if (queries.entries.empty()) {
+			recycle(queries);
+			return;
+		}
+		pending.emplace_back(std::move(queries));
+	}
+
+	void PassProfiler::recycle(PassQueries& queries) {
+		if (queries.timestamp_pool != VK_NULL_HANDLE) {
+			free_timestamp_pools.push_back({ queries.timestamp_pool, queries.timestamp_capacity });
+		}
+		if (queries.statistics_pool != VK_NULL_HANDLE) {
+			free_statistics_pools.push_back({ queries.statistics_pool, queries.statistics_capacity });
+		}
+		queries.timestamp_pool = VK_NULL_HANDLE;
+		queries.statistics_pool = VK_NULL_HANDLE;
+	}
+
+	bool PassProfiler::read_back(PassQueries& queries) {
+		// without VK_QUERY_RESULT_WAIT_BIT, VK_NOT_READY is returned if any query in the range is not yet available
+		std::vector<uint64_t> timestamps(queries.timestamp_count);
+		auto result = vkGetQueryPoolResults(device,
+		                                    queries.timestamp_pool,
+		                                    0,
+		                                    queries.timestamp_count,
+		                                    timestamps.size() * sizeof(uint64_t),
+		                                    timestamps.data(),
+		                                    sizeof(uint64_t),
+		                                    VK_QUERY_RESULT_64_BIT);
+		if (result != VK_SUCCESS) {
+			return false;
+		}
+		std::vector<uint64_t> statistics(queries.statistics_count * statistics_per_query);
+		if (queries.statistics_count > 0) {
+			result = vkGetQueryPoolResults(device,
+			                               queries.statistics_pool,
+			                               0,
+			                               queries.statistics_count,
+			                               statistics.size() * sizeof(uint64_t),
+			                               statistics.data(),
+			                               statistics_per_query * sizeof(uint64_t),
+			                               VK_QUERY_RESULT_64_BIT);
+			if (result != VK_SUCCESS) {
+				return false;
+			}
+		}
+
+		if (building.frame != queries.frame) {
+			building = {};
+			building.frame = queries.frame;
+		}
+		for (auto& e : queries.entries) {
+			PassTiming timing{ .name = e.name, .domain = e.domain, .renderpass = e.renderpass };
+			auto begin = timestamps[e.timestamp_index];
+			auto end = timestamps[e.timestamp_index + 1];
+			timing.duration = end > begin ? (end - begin) * timestamp_period * 1e-9 : 0.0;
+			if (e.statistics_index != PassQueries::no_query) {
+				// results are written in the order of the bits in statistics_flags
+				auto* s = &statistics[e.statistics_index * statistics_per_query];
+				timing.pipeline_statistics = PipelineStatistics{ s[0], s[1], s[2], s[3], s[4], s[5], s[6] };
+			}
+			building.index.emplace(timing.name, building.timings.size());
+			building.timings.push_back(timing);
+		}
+		return true;
+	}
+
+	void PassProfiler::poll(uint64_t current_frame) {
+		std::lock_guard _(lock);
+		while (!pending.empty()) {
+			auto& queries = pending.front();
+			// rendergraphs of the current frame might still be executed
+			if (queries.frame >= current_frame) {
+				break;
+			}
+			if (!read_back(queries) && current_frame - queries.frame < max_latency) {
+				break;
+			}
+			auto frame = queries.frame;
+			recycle(queries);
+			pending.pop_front();
+			if (pending.empty() || pending.front().frame != frame) {
+				if (building.frame == frame && !building.timings.empty()) {
+					last_report = std::move(building);
+				}
+				building = {};
+			}
+		}
+	}
+
+	bool PassProfiler::supports_timestamps(uint32_t queue_family_index) const {
+		return queue_family_index < timestamp_valid_bits.size() && timestamp_valid_bits[queue_family_index] > 0;
+	}
+
+	bool PassProfiler::supports_pipeline_statistics() const {
+		return pipeline_statistics_query;
+	}
+
+	std::optional<PassTimingReport> PassProfiler::get_report() {
+		std::lock_guard _(lock);
+		return last_report;
+	}
+} // namespace vuk
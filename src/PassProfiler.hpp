@@ -0,0 +1,91 @@
+#pragma once
+
+#include "vuk/Config.hpp"
+#include "vuk/Query.hpp"
+
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace vuk {
+	/// @brief Timestamp and pipeline statistics queries of a single rendergraph execution
+	struct PassQueries {
+		static constexpr uint32_t no_query = ~0u;
+
+		struct Entry {
+			Name name;
+			DomainFlagBits domain;
+			bool renderpass;
+			// begin timestamp, the end timestamp follows it
+			uint32_t timestamp_index;
+			uint32_t statistics_index;
+		};
+
+		uint64_t frame = 0;
+		VkQueryPool timestamp_pool = VK_NULL_HANDLE;
+		uint32_t timestamp_capacity = 0;
+		uint32_t timestamp_count = 0;
+		VkQueryPool statistics_pool = VK_NULL_HANDLE;
+		uint32_t statistics_capacity = 0;
+		uint32_t statistics_count = 0;
+		std::vector<Entry> entries;
+
+		/// @brief Reserve a begin and end timestamp (and a pipeline statistics query) for a pass
+		/// @return the index of the entry, or no_query if the pools are exhausted
+		uint32_t add(Name name, DomainFlagBits domain, bool renderpass, bool statistics);
+	};
+
+	/// @brief Hands out query pools sized for whole rendergraphs for pass profiling, and reads them back without blocking
+	/// Pools are recycled once their results have been read back. Results are polled from Context::next_frame(), so a report becomes available once
+	/// the GPU has finished the frame, typically a frame or two later.
+	struct PassProfiler {
+		static constexpr VkQueryPipelineStatisticFlags statistics_flags =
+		    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT | VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+		    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+		    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+		    VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+		static constexpr uint32_t statistics_per_query = 7;
+		// queries that have not become available after this many frames were never submitted, their pools are recycled
+		static constexpr uint64_t max_latency = 64;
+
+		PassProfiler(VkDevice device, VkPhysicalDevice physical_device, bool pipeline_statistics_query);
+		~PassProfiler();
+
+		/// @brief Take pools with room for the given number of timestamps and pipeline statistics queries, reset on the host
+		/// No pipeline statistics pool is taken if they are not supported
+		PassQueries acquire(uint64_t frame, uint32_t timestamp_count, uint32_t statistics_count);
+		/// @brief Queue the queries of a recorded rendergraph for readback
+		void submit(PassQueries&& queries);
+		/// @brief Read back the queries of finished frames, without waiting for the GPU
+		void poll(uint64_t current_frame);
+		/// @brief Report of the last frame whose queries were all read back
+		std::optional<PassTimingReport> get_report();
+		/// @brief Check if timestamps can be written on queues of the given family
+		bool supports_timestamps(uint32_t queue_family_index) const;
+		/// @brief Check if pipeline statistics queries can be created (the pipelineStatisticsQuery feature is enabled)
+		bool supports_pipeline_statistics() const;
+
+	private:
+		struct Pool {
+			VkQueryPool pool;
+			uint32_t capacity;
+		};
+
+		VkDevice device;
+		double timestamp_period;
+		bool pipeline_statistics_query;
+		std::vector<uint32_t> timestamp_valid_bits;
+
+		std::mutex lock;
+		std::vector<Pool> free_timestamp_pools;
+		std::vector<Pool> free_statistics_pools;
+		std::deque<PassQueries> pending;
+		PassTimingReport building;
+		std::optional<PassTimingReport> last_report;
+
+		Pool take_pool(std::vector<Pool>& free_pools, VkQueryType type, uint32_t count);
+		void recycle(PassQueries& queries);
+		bool read_back(PassQueries& queries);
+	};
+} // namespace vuk
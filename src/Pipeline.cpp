@@ -133,8 +133,18 @@ namespace vuk {
 namespace std {
 	size_t hash<vuk::PipelineInstanceCreateInfo>::operator()(vuk::PipelineInstanceCreateInfo const& x) const noexcept {
 		size_t h = 0;
-		auto ext_hash = x.is_inline() ? robin_hood::hash_bytes(x.inline_data, x.extended_size) : robin_hood::hash_bytes(x.extended_data, x.extended_size);
-		hash_combine(h, x.base, reinterpret_cast<uint64_t>((VkRenderPass)x.render_pass), x.extended_size, ext_hash);
+		auto ext_hash = x.is_inline() ? ::hash::hash_bytes(x.inline_data, x.extended_size) : ::hash::hash_bytes(x.extended_data, x.extended_size);
+		uint32_t records;
+		memcpy(&records, &x.records, sizeof(records));
+		hash_combine(h,
+		             x.base,
+		             reinterpret_cast<uint64_t>((VkRenderPass)x.render_pass),
+		             x.dynamic_state_flags.m_mask,
+		             records,
+		             (uint32_t)x.topology,
+		             (uint32_t)x.cullMode,
+		             x.extended_size,
+		             ext_hash);
 		return h;
 	}
 
@@ -146,7 +156,7 @@ namespace std {
 
 	size_t hash<vuk::ComputePipelineInstanceCreateInfo>::operator()(vuk::ComputePipelineInstanceCreateInfo const& x) const noexcept {
 		size_t h = 0;
-		hash_combine(h, x.base, robin_hood::hash_bytes(x.specialization_constant_data.data(), x.specialization_info.dataSize), x.specialization_map_entries);
+		hash_combine(h, x.base, ::hash::hash_bytes(x.specialization_constant_data.data(), x.specialization_info.dataSize), x.specialization_map_entries);
 		return h;
 	}
 
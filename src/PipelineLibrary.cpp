@@ -0,0 +1,443 @@
+#include "PipelineLibrary.hpp"
+#include "vuk/Context.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+namespace std {
+	size_t hash<vuk::PipelineLibraryKey>::operator()(vuk::PipelineLibraryKey const& x) const noexcept {
+		size_t h = 0;
+		hash_combine(h, x.part, x.base, x.render_pass, ::hash::hash_bytes(x.data.data(), x.data.size()));
+		return h;
+	}
+} // namespace std
+
+namespace vuk {
+#ifdef VK_EXT_graphics_pipeline_library
+	namespace {
+		struct KeyWriter {
+			std::vector<std::byte>& data;
+
+			template<class T>
+			void operator()(const T& value) {
+				auto bytes = reinterpret_cast<const std::byte*>(&value);
+				data.insert(data.end(), bytes, bytes + sizeof(T));
+			}
+
+			template<class T>
+			void operator()(const T* values, uint32_t count) {
+				(*this)(count);
+				if (values) {
+					auto bytes = reinterpret_cast<const std::byte*>(values);
+					data.insert(data.end(), bytes, bytes + count * sizeof(T));
+				}
+			}
+		};
+
+		void write_stages(KeyWriter& w, const VkGraphicsPipelineCreateInfo& gpci, bool fragment) {
+			for (uint32_t i = 0; i < gpci.stageCount; i++) {
+				auto& pssci = gpci.pStages[i];
+				if ((pssci.stage == VK_SHADER_STAGE_FRAGMENT_BIT) != fragment) {
+					continue;
+				}
+				w(pssci.stage);
+				if (auto si = pssci.pSpecializationInfo) {
+					w(si->pMapEntries, si->mapEntryCount);
+					w(static_cast<const std::byte*>(si->pData), (uint32_t)si->dataSize);
+				}
+			}
+		}
+
+		void write_multisample(KeyWriter& w, const VkPipelineMultisampleStateCreateInfo& ms) {
+			w(ms.rasterizationSamples);
+			w(ms.sampleShadingEnable);
+			w(ms.minSampleShading);
+			w(ms.alphaToCoverageEnable);
+			w(ms.alphaToOneEnable);
+		}
+
+		void write_dynamic_state(KeyWriter& w, const VkGraphicsPipelineCreateInfo& gpci) {
+			w(gpci.pDynamicState->pDynamicStates, gpci.pDynamicState->dynamicStateCount);
+		}
+
+		// serialize the state consumed by each library part, the rest is ignored by the implementation
+		void write_key(KeyWriter& w, uint32_t part, const VkGraphicsPipelineCreateInfo& gpci) {
+			switch (part) {
+			case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT: {
+				auto& vis = *gpci.pVertexInputState;
+				w(vis.pVertexBindingDescriptions, vis.vertexBindingDescriptionCount);
+				w(vis.pVertexAttributeDescriptions, vis.vertexAttributeDescriptionCount);
+				w(gpci.pInputAssemblyState->topology);
+				w(gpci.pInputAssemblyState->primitiveRestartEnable);
+				write_dynamic_state(w, gpci);
+				break;
+			}
+			case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT: {
+				w(gpci.subpass);
+				write_stages(w, gpci, false);
+				auto& rs = *gpci.pRasterizationState;
+				w(rs.depthClampEnable);
+				w(rs.rasterizerDiscardEnable);
+				w(rs.polygonMode);
+				w(rs.cullMode);
+				w(rs.frontFace);
+				w(rs.depthBiasEnable);
+				w(rs.depthBiasConstantFactor);
+				w(rs.depthBiasClamp);
+				w(rs.depthBiasSlopeFactor);
+				w(rs.lineWidth);
+				auto& vps = *gpci.pViewportState;
+				w(vps.pViewports, vps.pViewports ? vps.viewportCount : 0);
+				w(vps.pScissors, vps.pScissors ? vps.scissorCount : 0);
+				w(vps.viewportCount);
+				w(vps.scissorCount);
+				write_dynamic_state(w, gpci);
+				break;
+			}
+			case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT: {
+				w(gpci.subpass);
+				write_stages(w, gpci, true);
+				w(gpci.pDepthStencilState != nullptr);
+				if (auto ds = gpci.pDepthStencilState) {
+					w(ds->depthTestEnable);
+					w(ds->depthWriteEnable);
+					w(ds->depthCompareOp);
+					w(ds->depthBoundsTestEnable);
+					w(ds->stencilTestEnable);
+					w(ds->front);
+					w(ds->back);
+					w(ds->minDepthBounds);
+					w(ds->maxDepthBounds);
+				}
+				write_multisample(w, *gpci.pMultisampleState);
+				write_dynamic_state(w, gpci);
+				break;
+			}
+			case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT: {
+				w(gpci.subpass);
+				auto& cbs = *gpci.pColorBlendState;
+				w(cbs.logicOpEnable);
+				w(cbs.logicOp);
+				w(cbs.pAttachments, cbs.attachmentCount);
+				w(cbs.blendConstants);
+				write_multisample(w, *gpci.pMultisampleState);
+				write_dynamic_state(w, gpci);
+				break;
+			}
+			}
+		}
+	} // namespace
+#endif
+
+	PipelineLibraryCache::PipelineLibraryCache(Context& ctx, const VkPipelineCache& vk_pipeline_cache, bool requested, bool background_optimized_link) :
+	    ctx(ctx),
+	    vk_pipeline_cache(vk_pipeline_cache) {
+#ifdef VK_EXT_graphics_pipeline_library
+		if (!requested) {
+			return;
+		}
+		VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT gplf{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT };
+		VkPhysicalDeviceFeatures2 features{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &gplf };
+		vkGetPhysicalDeviceFeatures2(ctx.physical_device, &features);
+		is_enabled = gplf.graphicsPipelineLibrary;
+		this->background_optimized_link = is_enabled && background_optimized_link;
+		if (this->background_optimized_link) {
+			worker = std::thread([this] { run_worker(); });
+		}
+#endif
+	}
+
+	PipelineLibraryCache::~PipelineLibraryCache() {
+		shutdown();
+	}
+
+	VkPipeline PipelineLibraryCache::acquire_library(uint32_t part, const VkGraphicsPipelineCreateInfo& gpci, PipelineBaseInfo* base) {
+#ifdef VK_EXT_graphics_pipeline_library
+		bool has_shaders = part == VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT || part == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT;
+		bool has_render_pass = part != VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT;
+		PipelineLibraryKey key{ part, has_shaders ? base : nullptr, has_render_pass ? gpci.renderPass : VK_NULL_HANDLE };
+		KeyWriter w{ key.data };
+		write_key(w, part, gpci);
+
+		{
+			std::lock_guard _(libraries_lock);
+			if (auto it = libraries.find(key); it != libraries.end()) {
+				library_users.at(it->second).count++;
+				return it->second;
+			}
+		}
+
+		VkGraphicsPipelineLibraryCreateInfoEXT gplci{ .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT, .flags = part };
+		VkGraphicsPipelineCreateInfo lgpci = gpci;
+		lgpci.pNext = &gplci;
+		lgpci.flags |= VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+		fixed_vector<VkPipelineShaderStageCreateInfo, graphics_stage_count> stages;
+		if (has_shaders) {
+			bool fragment = part == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT;
+			for (uint32_t i = 0; i < gpci.stageCount; i++) {
+				if ((gpci.pStages[i].stage == VK_SHADER_STAGE_FRAGMENT_BIT) == fragment) {
+					stages.push_back(gpci.pStages[i]);
+				}
+			}
+		} else {
+			lgpci.layout = VK_NULL_HANDLE;
+		}
+		lgpci.pStages = stages.data();
+		lgpci.stageCount = (uint32_t)stages.size();
+		if (part == VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT) {
+			lgpci.renderPass = VK_NULL_HANDLE;
+			lgpci.subpass = 0;
+		}
+
+		VkPipeline library;
+		VkResult res = vkCreateGraphicsPipelines(ctx.device, vk_pipeline_cache, 1, &lgpci, nullptr, &library);
+		assert(res == VK_SUCCESS);
+
+		std::lock_guard _(libraries_lock);
+		auto [it, inserted] = libraries.emplace(std::move(key), library);
+		if (inserted) {
+			library_users.emplace(library, LibraryUsers{ &it->first, 1 });
+		} else { // another thread created the same part in the meantime
+			vkDestroyPipeline(ctx.device, library, nullptr);
+			library_users.at(it->second).count++;
+		}
+		return it->second;
+#else
+		return VK_NULL_HANDLE;
+#endif
+	}
+
+	VkPipeline PipelineLibraryCache::link(std::span<const VkPipeline> libs, VkPipelineLayout layout, bool optimize) {
+#ifdef VK_EXT_graphics_pipeline_library
+		VkPipelineLibraryCreateInfoKHR plci{ .sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR,
+			                                   .libraryCount = (uint32_t)libs.size(),
+			                                   .pLibraries = libs.data() };
+		VkGraphicsPipelineCreateInfo gpci{ .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO, .pNext = &plci };
+		gpci.flags = optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+		gpci.layout = layout;
+
+		VkPipeline pipeline;
+		VkResult res = vkCreateGraphicsPipelines(ctx.device, vk_pipeline_cache, 1, &gpci, nullptr, &pipeline);
+		assert(res == VK_SUCCESS);
+		return pipeline;
+#else
+		return VK_NULL_HANDLE;
+#endif
+	}
+
+	VkPipeline PipelineLibraryCache::create(const VkGraphicsPipelineCreateInfo& gpci, PipelineBaseInfo* base) {
+#ifdef VK_EXT_graphics_pipeline_library
+		std::array<VkPipeline, 4> libs = { acquire_library(VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT, gpci, base),
+			                                 acquire_library(VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT, gpci, base),
+			                                 acquire_library(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT, gpci, base),
+			                                 acquire_library(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT, gpci, base) };
+		auto pipeline = link(libs, gpci.layout, false);
+		{
+			std::lock_guard _(libraries_lock);
+			linked.emplace(pipeline, libs);
+		}
+
+		if (background_optimized_link) {
+			std::lock_guard _(jobs_lock);
+			pending.emplace(pipeline);
+			jobs.push_back(LinkJob{ pipeline, libs, gpci.layout, base->pipeline_name });
+			jobs_cv.notify_one();
+		}
+		return pipeline;
+#else
+		assert(0 && "vuk was built without VK_EXT_graphics_pipeline_library support");
+		return VK_NULL_HANDLE;
+#endif
+	}
+
+	void PipelineLibraryCache::run_worker() {
+		while (true) {
+			std::unique_lock lock(jobs_lock);
+			jobs_cv.wait(lock, [this] { return stop || !jobs.empty(); });
+			if (stop) {
+				return;
+			}
+			auto job = jobs.front();
+			jobs.pop_front();
+			// the fast-linked pipeline might have been collected already
+			if (!pending.contains(job.fast_linked)) {
+				continue;
+			}
+			linking = job.libraries;
+			lock.unlock();
+
+			auto pipeline = link(job.libraries, job.layout, true);
+			ctx.debug.set_name(pipeline, job.name);
+
+			lock.lock();
+			linking = {};
+			if (pending.contains(job.fast_linked)) {
+				optimized.emplace_back(job.fast_linked, pipeline);
+			} else {
+				vkDestroyPipeline(ctx.device, pipeline, nullptr);
+			}
+		}
+	}
+
+	void PipelineLibraryCache::release_libraries(std::span<const VkPipeline> libs) {
+		std::vector<VkPipeline> unused;
+		{
+			std::lock_guard _(libraries_lock);
+			for (auto& l : libs) {
+				auto it = library_users.find(l);
+				if (it == library_users.end() || --it->second.count > 0) {
+					continue;
+				}
+				if (it->second.key) {
+					libraries.erase(libraries.find(*it->second.key));
+				}
+				library_users.erase(it);
+				unused.push_back(l);
+			}
+		}
+		if (unused.empty()) {
+			return;
+		}
+		// the worker might be linking with the library, so it is destroyed later
+		std::lock_guard _(jobs_lock);
+		for (auto& l : unused) {
+			retired.emplace_back(l, ctx.get_frame_count());
+		}
+	}
+
+	template<class Pred>
+	void PipelineLibraryCache::evict(Pred&& pred) {
+		// evicted libraries are not handed out again, and are retired once the pipelines linked from them are gone
+		std::lock_guard _(libraries_lock);
+		for (auto it = libraries.begin(); it != libraries.end();) {
+			if (pred(it->first)) {
+				library_users.at(it->second).key = nullptr;
+				it = libraries.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	void PipelineLibraryCache::forget(VkPipeline pipeline) {
+		if (!is_enabled) {
+			return;
+		}
+		std::array<VkPipeline, 4> libs;
+		{
+			std::lock_guard _(libraries_lock);
+			auto it = linked.find(pipeline);
+			if (it == linked.end()) {
+				return;
+			}
+			libs = it->second;
+			linked.erase(it);
+		}
+		release_libraries(libs);
+
+		if (!background_optimized_link) {
+			return;
+		}
+		std::lock_guard _(jobs_lock);
+		if (pending.erase(pipeline) == 0) {
+			return;
+		}
+		auto it = std::find_if(optimized.begin(), optimized.end(), [=](auto& p) { return p.first == pipeline; });
+		if (it != optimized.end()) {
+			vkDestroyPipeline(ctx.device, it->second, nullptr);
+			optimized.erase(it);
+		}
+	}
+
+	void PipelineLibraryCache::forget_base(const PipelineBaseInfo* base) {
+		if (!is_enabled) {
+			return;
+		}
+		evict([=](const PipelineLibraryKey& key) { return key.base == base; });
+	}
+
+	void PipelineLibraryCache::forget_render_pass(VkRenderPass render_pass) {
+		if (!is_enabled) {
+			return;
+		}
+		evict([=](const PipelineLibraryKey& key) { return key.render_pass == render_pass; });
+	}
+
+	void PipelineLibraryCache::collect(Cache<PipelineInfo>& pipeline_cache, uint64_t absolute_frame, uint64_t threshold) {
+		if (!is_enabled) {
+			return;
+		}
+		// pipelines that were replaced might still be used by command buffers in flight, and libraries by the worker
+		std::unique_lock lock(jobs_lock);
+		std::erase_if(retired, [&](auto& r) {
+			if (absolute_frame - r.second > threshold && std::find(linking.begin(), linking.end(), r.first) == linking.end()) {
+				vkDestroyPipeline(ctx.device, r.first, nullptr);
+				return true;
+			}
+			return false;
+		});
+
+		std::vector<std::pair<VkPipeline, VkPipeline>> ready;
+		ready.swap(optimized);
+		for (auto& [fast, opt] : ready) {
+			pending.erase(fast);
+		}
+		lock.unlock();
+		if (ready.empty()) {
+			return;
+		}
+
+		std::vector<std::pair<VkPipeline, uint64_t>> replaced;
+		// the swap happens under the cache lock, but the cached pipeline is read after acquire released it, so it is published atomically
+		pipeline_cache.for_each([&](PipelineInfo& pi) {
+			auto it = std::find_if(ready.begin(), ready.end(), [&](auto& p) { return p.first == pi.pipeline; });
+			if (it != ready.end()) {
+				{
+					std::lock_guard _(libraries_lock);
+					auto lit = linked.find(pi.pipeline);
+					auto libs = lit->second;
+					linked.erase(lit);
+					linked.emplace(it->second, libs);
+				}
+				replaced.emplace_back(pi.pipeline, absolute_frame);
+				std::atomic_ref(pi.pipeline).store(it->second, std::memory_order_release);
+				it->second = VK_NULL_HANDLE;
+			}
+		});
+		lock.lock();
+		retired.insert(retired.end(), replaced.begin(), replaced.end());
+		lock.unlock();
+		// the cache entry is gone - the optimized pipeline is not needed
+		for (auto& [fast, opt] : ready) {
+			if (opt != VK_NULL_HANDLE) {
+				vkDestroyPipeline(ctx.device, opt, nullptr);
+			}
+		}
+	}
+
+	void PipelineLibraryCache::shutdown() {
+		{
+			std::lock_guard _(jobs_lock);
+			stop = true;
+			jobs_cv.notify_all();
+		}
+		if (worker.joinable()) {
+			worker.join();
+		}
+		for (auto& [fast, opt] : optimized) {
+			vkDestroyPipeline(ctx.device, opt, nullptr);
+		}
+		optimized.clear();
+		for (auto& [p, frame] : retired) {
+			vkDestroyPipeline(ctx.device, p, nullptr);
+		}
+		retired.clear();
+		for (auto& [l, users] : library_users) {
+			vkDestroyPipeline(ctx.device, l, nullptr);
+		}
+		library_users.clear();
+		libraries.clear();
+		linked.clear();
+	}
+} // namespace vuk
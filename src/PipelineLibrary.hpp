@@ -0,0 +1,110 @@
+#pragma once
+
+#include "Cache.hpp"
+#include "vuk/Config.hpp"
+#include "vuk/PipelineInstance.hpp"
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <robin_hood.h>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace vuk {
+	/// @brief Key of a single graphics pipeline library part: the subset of the pipeline state that the part consumes
+	struct PipelineLibraryKey {
+		uint32_t part; // VkGraphicsPipelineLibraryFlagsEXT
+		const PipelineBaseInfo* base; // for the shader parts
+		VkRenderPass render_pass; // for all parts but the vertex input
+		std::vector<std::byte> data;
+
+		bool operator==(const PipelineLibraryKey&) const = default;
+	};
+} // namespace vuk
+
+namespace std {
+	template<>
+	struct hash<vuk::PipelineLibraryKey> {
+		size_t operator()(vuk::PipelineLibraryKey const& x) const noexcept;
+	};
+}; // namespace std
+
+namespace vuk {
+	/// @brief Builds graphics pipelines out of cached VK_EXT_graphics_pipeline_library parts
+	///
+	/// Every pipeline is split into the vertex input, pre-rasterization shader, fragment shader and fragment output parts. The parts are cached separately, so
+	/// pipeline variants that only differ in some state reuse the others and only need a fast link. Optionally, a link-time optimized pipeline is compiled on a
+	/// background thread, and swapped into the pipeline cache once it is ready.
+	struct PipelineLibraryCache {
+		PipelineLibraryCache(Context& ctx, const VkPipelineCache& vk_pipeline_cache, bool requested, bool background_optimized_link);
+		~PipelineLibraryCache();
+
+		/// @brief Returns true if pipelines are built from libraries
+		bool enabled() const {
+			return is_enabled;
+		}
+
+		/// @brief Create a fast-linked pipeline for a complete graphics pipeline create info
+		VkPipeline create(const VkGraphicsPipelineCreateInfo& gpci, PipelineBaseInfo* base);
+		/// @brief Notify that a pipeline returned from create() has been destroyed, libraries no longer used by any pipeline are destroyed after the collection
+		/// threshold
+		void forget(VkPipeline pipeline);
+		/// @brief Notify that a pipeline base has been destroyed, its shader parts are no longer reused
+		void forget_base(const PipelineBaseInfo* base);
+		/// @brief Notify that a render pass has been destroyed, the parts built against it are no longer reused (the handle might be recycled)
+		void forget_render_pass(VkRenderPass render_pass);
+		/// @brief Swap optimized pipelines into the pipeline cache, and destroy the pipelines and libraries retired after threshold frames
+		void collect(Cache<PipelineInfo>& pipeline_cache, uint64_t absolute_frame, uint64_t threshold);
+		/// @brief Stop the background compilation and destroy all libraries
+		void shutdown();
+
+	private:
+		struct LinkJob {
+			VkPipeline fast_linked;
+			std::array<VkPipeline, 4> libraries;
+			VkPipelineLayout layout;
+			Name name;
+		};
+
+		struct LibraryUsers {
+			// key of the library in libraries, or nullptr if it can no longer be reused
+			const PipelineLibraryKey* key;
+			uint32_t count;
+		};
+
+		Context& ctx;
+		const VkPipelineCache& vk_pipeline_cache;
+		bool is_enabled = false;
+		bool background_optimized_link = false;
+
+		std::mutex libraries_lock;
+		robin_hood::unordered_node_map<PipelineLibraryKey, VkPipeline> libraries;
+		// number of live pipelines linked from each library - libraries are retired when the last one is destroyed
+		robin_hood::unordered_flat_map<VkPipeline, LibraryUsers> library_users;
+		// libraries of each live linked pipeline
+		robin_hood::unordered_flat_map<VkPipeline, std::array<VkPipeline, 4>> linked;
+
+		std::mutex jobs_lock;
+		std::condition_variable jobs_cv;
+		std::deque<LinkJob> jobs;
+		bool stop = false;
+		std::thread worker;
+
+		// fast-linked pipelines that are still alive, and the optimized pipelines that are ready to replace them
+		robin_hood::unordered_set<VkPipeline> pending;
+		std::vector<std::pair<VkPipeline, VkPipeline>> optimized;
+		std::vector<std::pair<VkPipeline, uint64_t>> retired;
+		// libraries used by the link the worker is currently performing
+		std::array<VkPipeline, 4> linking = {};
+
+		VkPipeline acquire_library(uint32_t part, const VkGraphicsPipelineCreateInfo& gpci, PipelineBaseInfo* base);
+		void release_libraries(std::span<const VkPipeline> libraries);
+		template<class Pred>
+		void evict(Pred&& pred);
+		VkPipeline link(std::span<const VkPipeline> libraries, VkPipelineLayout layout, bool optimize);
+		void run_worker();
+	};
+} // namespace vuk
@@ -1,10 +1,15 @@
 #include "vuk/RenderGraph.hpp"
+#include "LegacyGPUAllocator.hpp"
+#include "PassProfiler.hpp"
 #include "RenderGraphImpl.hpp"
 #include "RenderGraphUtil.hpp"
 #include "vuk/Context.hpp"
 #include "vuk/Exception.hpp"
 #include "vuk/Future.hpp"
+#include "vuk/Tracing.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <set>
 #include <unordered_set>
 
@@ -15,6 +20,29 @@ namespace {
 } // namespace
 
 namespace vuk {
+	namespace {
+		// records the time since the previous lap into a phase of the statistics, if statistics were requested
+		struct PhaseTimer {
+			PhaseTimer(RenderGraph::CompileStatistics* stats) : stats(stats) {
+				if (stats) {
+					last = std::chrono::steady_clock::now();
+				}
+			}
+
+			void lap(std::chrono::nanoseconds RenderGraph::CompileStatistics::*phase) {
+				if (!stats) {
+					return;
+				}
+				auto now = std::chrono::steady_clock::now();
+				stats->*phase = now - last;
+				last = now;
+			}
+
+			RenderGraph::CompileStatistics* stats;
+			std::chrono::steady_clock::time_point last;
+		};
+	} // namespace
+
 	Name Resource::Subrange::Image::combine_name(Name prefix) const {
 		std::string suffix = std::string(prefix.to_sv());
 		suffix += "[" + std::to_string(base_layer) + ":" + std::to_string(base_layer + layer_count - 1) + "]";
@@ -106,8 +134,8 @@ namespace vuk {
 					out_name = res.out_name;
 				}
 
-				auto hashed_in_name = ::hash::fnv1a::hash(in_name.to_sv().data(), res.name.to_sv().size(), hash::fnv1a::default_offset_basis);
-				auto hashed_out_name = ::hash::fnv1a::hash(out_name.to_sv().data(), res.out_name.to_sv().size(), hash::fnv1a::default_offset_basis);
+				auto hashed_in_name = (uint32_t)::hash::hash_bytes(in_name.to_sv().data(), in_name.to_sv().size());
+				auto hashed_out_name = (uint32_t)::hash::hash_bytes(out_name.to_sv().data(), out_name.to_sv().size());
 
 				pif.input_names.emplace_back(in_name);
 				pif.bloom_resolved_inputs |= hashed_in_name;
@@ -127,7 +155,8 @@ namespace vuk {
 				// for image subranges, we additionally add a dependency on the diverged original resource
 				// this resource is created by the diverged pass and consumed by the converge pass, thereby constraining all the passes who refer to these
 				if (res.type == Resource::Type::eImage && res.subrange.image != Resource::Subrange::Image{}) {
-					auto hashed_name = ::hash::fnv1a::hash(res.name.append("d").to_sv().data(), res.name.to_sv().size(), hash::fnv1a::default_offset_basis);
+					auto diverged_name = res.name.append("d").to_sv();
+					auto hashed_name = (uint32_t)::hash::hash_bytes(diverged_name.data(), diverged_name.size());
 
 					pif.input_names.emplace_back(res.name.append("d"));
 					pif.bloom_resolved_inputs |= hashed_name;
@@ -213,14 +242,145 @@ namespace vuk {
 		}
 	}
 
+	namespace {
+		// accesses that can be performed on a compute queue
+		// transfer accesses are excluded: the access does not tell a buffer copy apart from a blit, resolve or depth/stencil clear, which need a graphics
+		// queue
+		bool is_async_compute_access(Access ia) {
+			switch (ia) {
+			case eComputeRead:
+			case eComputeWrite:
+			case eComputeRW:
+			case eComputeSampled:
+			case eIndirectRead:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		bool is_graphics_or_unassigned(DomainFlags domain) {
+			return domain == DomainFlagBits::eDevice || domain == DomainFlagBits::eAny || (domain & DomainFlagBits::eQueueMask) == DomainFlagBits::eGraphicsQueue;
+		}
+
+		// estimated duration of a pass in seconds, from the timings if there are any
+		double estimate_pass_cost(const PassInfo& p, const PassTimingReport* timings) {
+			// assumed duration of passes without timings
+			constexpr double default_pass_cost = 100e-6;
+			if (p.domain == DomainFlagBits::eNone) { // not executed
+				return 0;
+			}
+			if (timings && !p.pass.name.is_invalid()) {
+				if (auto timing = timings->find(p.pass.name)) {
+					return timing->duration;
+				}
+			}
+			return default_pass_cost;
+		}
+	} // namespace
+
+	size_t RenderGraph::schedule_async_compute(const RenderGraph::CompileOptions& compile_options) {
+		auto& passes = impl->passes;
+		const size_t n = passes.size();
+
+		std::vector<double> cost(n);
+		std::vector<size_t> candidates;
+		for (size_t i = 0; i < n; i++) {
+			auto& p = passes[i];
+			cost[i] = estimate_pass_cost(p, compile_options.pass_timings);
+			if (p.domain == DomainFlagBits::eNone) {
+				continue;
+			}
+			// only passes that did not request a queue and only do compute-capable work are moved
+			if (p.pass.execute_on != DomainFlagBits::eDevice && p.pass.execute_on != DomainFlagBits::eAny) {
+				continue;
+			}
+			if (!is_graphics_or_unassigned(p.domain) || !p.pass.execute) {
+				continue;
+			}
+			bool eligible = std::all_of(p.pass.resources.begin(), p.pass.resources.end(), [this](const Resource& r) {
+				if (!is_async_compute_access(r.ia)) {
+					return false;
+				}
+				// swapchain images are presented from the graphics queue
+				auto it = impl->bound_attachments.find(impl->resolve_name(r.name));
+				return it == impl->bound_attachments.end() || it->second.type != AttachmentRPInfo::Type::eSwapchain;
+			});
+			if (eligible) {
+				candidates.push_back(i);
+			}
+		}
+		if (candidates.empty()) {
+			return 0;
+		}
+
+		// dependencies between consecutive uses - passes are already ordered, so these always point backwards
+		std::vector<std::vector<size_t>> predecessors(n);
+		for (auto& [name, chain] : impl->use_chains) {
+			for (size_t i = 0; i + 1 < chain.size(); i++) {
+				auto left = chain[i].pass;
+				auto right = chain[i + 1].pass;
+				if (left && right && left != right) {
+					predecessors[right - passes.data()].push_back(left - passes.data());
+				}
+			}
+		}
+
+		auto queue_of = [&](size_t i) -> uint32_t {
+			auto domain = passes[i].domain;
+			if (is_graphics_or_unassigned(domain)) {
+				return 0;
+			}
+			return (domain & DomainFlagBits::eComputeQueue) ? 1 : 2;
+		};
+		// simulate the queues executing their passes in order, paying sync_cost for every dependency that crosses queues
+		std::vector<double> finish(n);
+		auto estimate = [&]() {
+			double queue_free[3] = {};
+			double end = 0;
+			for (size_t i = 0; i < n; i++) {
+				auto q = queue_of(i);
+				double start = queue_free[q];
+				for (auto pred : predecessors[i]) {
+					start = std::max(start, finish[pred] + (queue_of(pred) != q ? compile_options.async_compute_sync_cost : 0.0));
+				}
+				finish[i] = start + cost[i];
+				queue_free[q] = finish[i];
+				end = std::max(end, finish[i]);
+			}
+			return end;
+		};
+
+		// greedily try moving the most expensive passes first, keeping a move only if the estimate improves
+		std::stable_sort(candidates.begin(), candidates.end(), [&](size_t a, size_t b) { return cost[a] > cost[b]; });
+		double best = estimate();
+		size_t moved = 0;
+		for (auto i : candidates) {
+			auto previous = passes[i].domain;
+			passes[i].domain = DomainFlagBits::eComputeOnCompute;
+			auto estimated = estimate();
+			if (estimated < best) {
+				best = estimated;
+				moved++;
+			} else {
+				passes[i].domain = previous;
+			}
+		}
+		return moved;
+	}
+
 	void RenderGraph::compile(const RenderGraph::CompileOptions& compile_options) {
+		VUK_TRACE_ZONE("vuk::RenderGraph::compile");
+		PhaseTimer timer(compile_options.statistics);
 		// find which reads are graph inputs (not produced by any pass) & outputs
 		// (not consumed by any pass)
 		build_io();
+		timer.lap(&CompileStatistics::build_io);
 
 		// run global pass ordering - once we split per-queue we don't see enough
 		// inputs to order within a queue
 		schedule_intra_queue(impl->passes, compile_options);
+		timer.lap(&CompileStatistics::scheduling);
 
 		// gather name alias info now - once we partition, we might encounter
 		// unresolved aliases
@@ -304,6 +464,10 @@ namespace vuk {
 			}
 		}
 
+		timer.lap(&CompileStatistics::use_chains);
+
+		size_t async_compute_pass_count = compile_options.async_compute ? schedule_async_compute(compile_options) : 0;
+
 		// queue inference failure fixup pass
 		// we also prepare for pass sorting
 		impl->ordered_passes.reserve(impl->passes.size());
@@ -431,6 +595,14 @@ namespace vuk {
 
 			impl->rpis.push_back(rpi);
 		}
+		timer.lap(&CompileStatistics::renderpass_grouping);
+
+		if (auto stats = compile_options.statistics) {
+			stats->pass_count = impl->passes.size();
+			stats->use_chain_count = impl->use_chains.size();
+			stats->renderpass_count = impl->rpis.size();
+			stats->async_compute_pass_count = async_compute_pass_count;
+		}
 	}
 
 	void RenderGraph::resolve_resource_into(Name resolved_name_src, Name resolved_name_dst, Name ms_name) {
@@ -605,13 +777,83 @@ namespace vuk {
 	}
 
 	ExecutableRenderGraph RenderGraph::link(Context& ctx, const RenderGraph::CompileOptions& compile_options) && {
-		compile(compile_options);
+		VUK_TRACE_ZONE("vuk::RenderGraph::link");
+		auto options = compile_options;
+		// without a dedicated compute queue, compute passes would be serialized with graphics anyway
+		options.async_compute &= ctx.dedicated_compute_queue.has_value();
+		compile(options);
+		VUK_TRACE_COUNTER("vuk::rendergraph_passes", impl->passes.size());
+		PhaseTimer timer(compile_options.statistics);
+		impl->pass_timestamps = compile_options.pass_timestamps;
+		// pipeline statistics queries can't be created without the pipelineStatisticsQuery feature, passes are then only timed
+		impl->pass_pipeline_statistics =
+		    compile_options.pass_timestamps && compile_options.pass_pipeline_statistics && ctx.get_pass_profiler().supports_pipeline_statistics();
 
 		// at this point the graph is built, we know of all the resources and
 		// everything should have been attached perform checking if this indeed the
 		// case
 		validate();
 
+		// a dependency on the same queue can be split into an event set after the producer and a wait on it before the consumer, letting the passes
+		// recorded in between overlap with the producer
+		// returns the event to wait on, or no_event if a pipeline barrier should be used
+		impl->event_stages.clear();
+		auto split_barrier_event = [&](PassInfo* producer, PassInfo* consumer, PipelineStageFlags src_stages) -> uint32_t {
+			if (!options.split_barriers || !producer || !consumer || src_stages == PipelineStageFlags{}) {
+				return no_event;
+			}
+			auto queue = producer->domain & DomainFlagBits::eQueueMask;
+			if (queue == DomainFlagBits::eNone || queue != (consumer->domain & DomainFlagBits::eQueueMask)) {
+				return no_event;
+			}
+			// events can't be waited on in a renderpass without a self-dependency
+			if (!impl->rpis[consumer->render_pass_index].framebufferless) {
+				return no_event;
+			}
+			// passes of a queue are recorded in renderpass and subpass order
+			auto recorded_before = [](const PassInfo* a, const PassInfo* b) {
+				return std::pair(a->render_pass_index, a->subpass) < std::pair(b->render_pass_index, b->subpass);
+			};
+			if (!recorded_before(producer, consumer)) {
+				return no_event;
+			}
+			auto touches_producer_resource = [&](const PassInfo& p) {
+				for (auto& r : p.pass.resources) {
+					auto name = impl->resolve_name(r.name);
+					for (auto& pr : producer->pass.resources) {
+						if (impl->resolve_name(pr.name) == name) {
+							return true;
+						}
+					}
+				}
+				return false;
+			};
+			// only the passes in between that don't touch the resources of the producer are expected to overlap with it
+			double overlap = 0;
+			for (auto rp_index = producer->render_pass_index; rp_index <= consumer->render_pass_index && overlap <= options.split_barrier_cost; rp_index++) {
+				for (auto& sp : impl->rpis[rp_index].subpasses) {
+					for (auto* p : sp.passes) {
+						if (recorded_before(producer, p) && recorded_before(p, consumer) && !touches_producer_resource(*p)) {
+							overlap += estimate_pass_cost(*p, options.pass_timings);
+						}
+					}
+				}
+			}
+			if (overlap <= options.split_barrier_cost) {
+				return no_event;
+			}
+			// one event per producing subpass (or renderpass), set with the stages of all the dependencies split on it
+			auto& producer_rp = impl->rpis[producer->render_pass_index];
+			auto& event = producer_rp.framebufferless ? producer_rp.subpasses[producer->subpass].signal_event : producer_rp.signal_event;
+			if (event == no_event) {
+				event = (uint32_t)impl->event_stages.size();
+				impl->event_stages.push_back(src_stages);
+			} else {
+				impl->event_stages[event] |= src_stages;
+			}
+			return event;
+		};
+
 		for (auto& [raw_name, attachment_info] : impl->bound_attachments) {
 			auto name = impl->resolve_name(raw_name);
 			auto chain_it = impl->use_chains.find(name);
@@ -1094,6 +1336,10 @@ namespace vuk {
 								barrier.dstAccessMask = {};
 							}
 							ImageBarrier ib{ .image = name, .barrier = barrier, .src = src_stages, .dst = dst_stages };
+							// acquired resources were last used in another submission, there is nothing to overlap with
+							if (!is_acquire(left->original)) {
+								ib.event = split_barrier_event(left->pass, right.pass, src_stages);
+							}
 							if (right_rp.framebufferless) {
 								right_rp.subpasses[right.pass->subpass].pre_barriers.push_back(ib);
 							} else {
@@ -1137,12 +1383,14 @@ namespace vuk {
 						barrier.subresourceRange.layerCount = subrange.layer_count;
 						barrier.subresourceRange.levelCount = subrange.level_count;
 						ImageBarrier ib{ .image = name, .barrier = barrier, .src = prev_use.stages, .dst = next_use.stages };
+						ib.event = split_barrier_event(left->pass, right.pass, prev_use.stages);
 						right_rp.subpasses[right.pass->subpass].pre_barriers.push_back(ib);
 					}
 				}
 			}
 		}
 
+		bool exclusive_buffers = ctx.get_legacy_gpu_allocator().get_buffer_sharing_mode() == VK_SHARING_MODE_EXCLUSIVE;
 		for (auto& [raw_name, buffer_info] : impl->bound_buffers) {
 			auto name = impl->resolve_name(raw_name);
 			auto chain_it = impl->use_chains.find(name);
@@ -1168,13 +1416,88 @@ namespace vuk {
 				// release - acquire pair
 				if (left.original == eRelease && right.original == eAcquire) {
 					// noop
-				} else if (right.original == eRelease && (i + 1 == (chain.size() - 2))) {
+				} else if (is_acquire(left.original) && left.pass && right.pass) {
+					// acquire without release - must be first in chain
+					DomainFlags src_domain = DomainFlagBits::eNone;
+					auto wait_fut = left.pass->pass.wait.get();
+					if (wait_fut) {
+						// we are acquiring from a future
+						left.pass->absolute_waits.emplace_back(wait_fut->initial_domain, wait_fut->initial_visibility);
+						src_domain = wait_fut->initial_domain;
+					} else {
+						// we are acquiring from a queue
+						switch (left.original) {
+						case eAcquireFromGraphics:
+							src_domain = DomainFlagBits::eGraphicsQueue;
+							break;
+						case eAcquireFromCompute:
+							src_domain = DomainFlagBits::eComputeQueue;
+							break;
+						case eAcquireFromTransfer:
+							src_domain = DomainFlagBits::eTransferQueue;
+							break;
+						default:
+							break;
+						}
+					}
+
+					// exclusive buffers -> acquire half of QFOT, the release half was recorded by the submitter
+					if (exclusive_buffers && (src_domain & DomainFlagBits::eQueueMask) != DomainFlags{} && (right_domain & DomainFlagBits::eQueueMask) != DomainFlags{} &&
+					    ctx.domain_to_queue_family_index(src_domain) != ctx.domain_to_queue_family_index(right_domain)) {
+						auto dst_stages = right.use.stages;
+						scope_to_domain(dst_stages, right_domain & DomainFlagBits::eQueueMask);
+
+						VkBufferMemoryBarrier barrier{ .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+						barrier.srcAccessMask = 0; // ignored
+						barrier.dstAccessMask = (VkAccessFlags)right.use.access;
+						barrier.srcQueueFamilyIndex = ctx.domain_to_queue_family_index(src_domain);
+						barrier.dstQueueFamilyIndex = ctx.domain_to_queue_family_index(right_domain);
+						BufferBarrier acquire_barrier{ .buffer = raw_name, .barrier = barrier };
+						acquire_barrier.src = PipelineStageFlagBits::eTopOfPipe; // NONE
+						acquire_barrier.dst = dst_stages == PipelineStageFlags{} ? PipelineStageFlagBits::eBottomOfPipe : dst_stages;
+						impl->rpis[right.pass->render_pass_index].pre_buffer_barriers.push_back(acquire_barrier);
+					}
+				} else if (is_release(right.original) && (i + 1 == (chain.size() - 2))) {
 					// release without acquire - must be last in chain
-					auto& fut = *right.pass->pass.signal;
-					fut.last_use = QueueResourceUse{
-						left.original, left.use.stages, left.use.access, left.use.layout, (DomainFlagBits)(left_domain & DomainFlagBits::eQueueMask).m_mask
-					};
-					fut.get_result<Buffer>() = buffer_info.buffer; // TODO: when we have managed buffers, then this is too soon to attach
+					if (right.pass->pass.signal) {
+						auto& fut = *right.pass->pass.signal;
+						fut.last_use = QueueResourceUse{
+							left.original, left.use.stages, left.use.access, left.use.layout, (DomainFlagBits)(left_domain & DomainFlagBits::eQueueMask).m_mask
+						};
+						fut.get_result<Buffer>() = buffer_info.buffer; // TODO: when we have managed buffers, then this is too soon to attach
+					}
+
+					DomainFlags dst_domain;
+					switch (right.original) {
+					case eReleaseToGraphics:
+						dst_domain = DomainFlagBits::eGraphicsQueue;
+						break;
+					case eReleaseToCompute:
+						dst_domain = DomainFlagBits::eComputeQueue;
+						break;
+					case eReleaseToTransfer:
+						dst_domain = DomainFlagBits::eTransferQueue;
+						break;
+					default:
+						dst_domain = left_domain & DomainFlagBits::eQueueMask; // no domain change
+					}
+
+					// exclusive buffers -> release half of QFOT, the acquire half is recorded by the rendergraph consuming the Future
+					if (exclusive_buffers && left.pass && (left_domain & DomainFlagBits::eQueueMask) != dst_domain &&
+					    ctx.domain_to_queue_family_index(left_domain) != ctx.domain_to_queue_family_index(dst_domain)) {
+						auto src_stages = left.use.stages;
+						scope_to_domain(src_stages, left_domain & DomainFlagBits::eQueueMask);
+
+						VkBufferMemoryBarrier barrier{ .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+						barrier.srcAccessMask = is_read_access(left.use) ? 0 : (VkAccessFlags)left.use.access;
+						barrier.dstAccessMask = 0; // ignored
+						barrier.srcQueueFamilyIndex = ctx.domain_to_queue_family_index(left_domain);
+						barrier.dstQueueFamilyIndex = ctx.domain_to_queue_family_index(dst_domain);
+						BufferBarrier release_barrier{ .buffer = raw_name, .barrier = barrier };
+						release_barrier.src = src_stages == PipelineStageFlags{} ? PipelineStageFlagBits::eTopOfPipe : src_stages;
+						release_barrier.dst = PipelineStageFlagBits::eBottomOfPipe; // NONE
+						impl->rpis[left.pass->render_pass_index].post_buffer_barriers.push_back(release_barrier);
+					}
 				}
 
 				bool crosses_queue = (left_domain != DomainFlagBits::eNone && right_domain != DomainFlagBits::eNone &&
@@ -1183,12 +1506,51 @@ namespace vuk {
 					left.pass->is_waited_on = true;
 					right.pass->waits.emplace_back((DomainFlagBits)(left_domain & DomainFlagBits::eQueueMask).m_mask, left.pass);
 
+					auto src_family = ctx.domain_to_queue_family_index(left_domain);
+					auto dst_family = ctx.domain_to_queue_family_index(right_domain);
+					// exclusive buffers -> QFOT
+					if (exclusive_buffers && src_family != dst_family) {
+						auto src_stages = left.use.stages;
+						auto dst_stages = right.use.stages;
+						scope_to_domain(src_stages, left_domain & DomainFlagBits::eQueueMask);
+						scope_to_domain(dst_stages, right_domain & DomainFlagBits::eQueueMask);
+
+						VkBufferMemoryBarrier barrier{ .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+						barrier.srcQueueFamilyIndex = src_family;
+						barrier.dstQueueFamilyIndex = dst_family;
+						// offset and size are filled in when recording
+						{
+							BufferBarrier release_barrier{ .buffer = raw_name, .barrier = barrier };
+							release_barrier.barrier.srcAccessMask = is_read_access(left.use) ? 0 : (VkAccessFlags)left.use.access;
+							release_barrier.barrier.dstAccessMask = 0; // ignored
+							release_barrier.src = src_stages == PipelineStageFlags{} ? PipelineStageFlagBits::eTopOfPipe : src_stages;
+							release_barrier.dst = PipelineStageFlagBits::eBottomOfPipe; // NONE
+							impl->rpis[left.pass->render_pass_index].post_buffer_barriers.push_back(release_barrier);
+						}
+						{
+							BufferBarrier acquire_barrier{ .buffer = raw_name, .barrier = barrier };
+							acquire_barrier.barrier.srcAccessMask = 0; // ignored
+							acquire_barrier.barrier.dstAccessMask = (VkAccessFlags)right.use.access;
+							acquire_barrier.src = PipelineStageFlagBits::eTopOfPipe; // NONE
+							acquire_barrier.dst = dst_stages == PipelineStageFlags{} ? PipelineStageFlagBits::eBottomOfPipe : dst_stages;
+							impl->rpis[right.pass->render_pass_index].pre_buffer_barriers.push_back(acquire_barrier);
+						}
+					}
+
 					continue;
 				}
 
 				bool crosses_rpass = (left.pass == nullptr || right.pass == nullptr || left.pass->render_pass_index != right.pass->render_pass_index);
 				if (crosses_rpass) {
-					if (left.pass && right.use.layout != ImageLayout::eUndefined && (is_write_access(left.use) || is_write_access(right.use))) { // RenderPass ->
+					// a split dependency only waits before the consumer
+					uint32_t event = no_event;
+					if (left.pass && right.pass && left.use.layout != ImageLayout::eUndefined && right.use.layout != ImageLayout::eUndefined &&
+					    (is_write_access(left.use) || is_write_access(right.use))) {
+						event = split_barrier_event(left.pass, right.pass, left.use.stages);
+					}
+
+					if (event == no_event && left.pass && right.use.layout != ImageLayout::eUndefined &&
+					    (is_write_access(left.use) || is_write_access(right.use))) { // RenderPass ->
 						auto& left_rp = impl->rpis[left.pass->render_pass_index];
 
 						VkMemoryBarrier barrier{ .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER };
@@ -1204,7 +1566,7 @@ namespace vuk {
 						VkMemoryBarrier barrier{ .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER };
 						barrier.srcAccessMask = is_read_access(left.use) ? 0 : (VkAccessFlags)left.use.access;
 						barrier.dstAccessMask = (VkAccessFlags)right.use.access;
-						MemoryBarrier mb{ .barrier = barrier, .src = left.use.stages, .dst = right.use.stages };
+						MemoryBarrier mb{ .barrier = barrier, .src = left.use.stages, .dst = right.use.stages, .event = event };
 						if (mb.src == PipelineStageFlags{}) {
 							mb.src = PipelineStageFlagBits::eTopOfPipe;
 							mb.barrier.srcAccessMask = {};
@@ -1220,12 +1582,19 @@ namespace vuk {
 						barrier.srcAccessMask = is_read_access(left.use) ? 0 : (VkAccessFlags)left.use.access;
 						barrier.dstAccessMask = (VkAccessFlags)right.use.access;
 						MemoryBarrier mb{ .barrier = barrier, .src = left.use.stages, .dst = right.use.stages };
-						left_rp.subpasses[left.pass->subpass].post_mem_barriers.push_back(mb);
+						mb.event = split_barrier_event(left.pass, right.pass, left.use.stages);
+						if (mb.event != no_event) { // same renderpass, wait before the consumer
+							left_rp.subpasses[right.pass->subpass].pre_mem_barriers.push_back(mb);
+						} else {
+							left_rp.subpasses[left.pass->subpass].post_mem_barriers.push_back(mb);
+						}
 					}
 				}
 			}
 		}
 
+		timer.lap(&CompileStatistics::barrier_emission);
+
 		for (auto& rp : impl->rpis) {
 			rp.rpci.color_ref_offsets.resize(rp.subpasses.size());
 			rp.rpci.ds_refs.resize(rp.subpasses.size());
@@ -1273,6 +1642,8 @@ namespace vuk {
 			}
 		}
 
+		timer.lap(&CompileStatistics::batching);
+
 		// we now have enough data to build VkRenderPasses and VkFramebuffers
 
 		// compile attachments
@@ -1473,6 +1844,23 @@ namespace vuk {
 
 			rp.handle = ctx.acquire_renderpass(rp.rpci, ctx.get_frame_count());
 		}
+		timer.lap(&CompileStatistics::renderpass_building);
+
+		if (auto stats = compile_options.statistics) {
+			size_t barrier_count = 0;
+			size_t split_barrier_count = 0;
+			for (auto& rp : impl->rpis) {
+				barrier_count += rp.pre_barriers.size() + rp.post_barriers.size() + rp.pre_mem_barriers.size() + rp.post_mem_barriers.size() +
+				                 rp.pre_buffer_barriers.size() + rp.post_buffer_barriers.size();
+				for (auto& sp : rp.subpasses) {
+					barrier_count += sp.pre_barriers.size() + sp.post_barriers.size() + sp.pre_mem_barriers.size() + sp.post_mem_barriers.size();
+					split_barrier_count += std::count_if(sp.pre_barriers.begin(), sp.pre_barriers.end(), [](auto& b) { return b.event != no_event; });
+					split_barrier_count += std::count_if(sp.pre_mem_barriers.begin(), sp.pre_mem_barriers.end(), [](auto& b) { return b.event != no_event; });
+				}
+			}
+			stats->barrier_count = barrier_count;
+			stats->split_barrier_count = split_barrier_count;
+		}
 
 		return { std::move(*this) };
 	}
@@ -0,0 +1,488 @@
+#include "RenderGraphImpl.hpp"
+#include "vuk/RenderGraph.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vuk {
+	namespace {
+		std::string_view queue_name(size_t rpi_index, const RGImpl& impl) {
+			if (rpi_index < impl.num_graphics_rpis) {
+				return "graphics";
+			} else if (rpi_index < impl.num_graphics_rpis + impl.num_compute_rpis) {
+				return "compute";
+			}
+			return "transfer";
+		}
+
+		std::string_view queue_name(DomainFlagBits domain) {
+			switch (domain) {
+			case DomainFlagBits::eGraphicsQueue:
+				return "graphics";
+			case DomainFlagBits::eComputeQueue:
+				return "compute";
+			case DomainFlagBits::eTransferQueue:
+				return "transfer";
+			default:
+				return "host";
+			}
+		}
+
+		std::string_view layout_name(VkImageLayout layout) {
+			switch (layout) {
+			case VK_IMAGE_LAYOUT_UNDEFINED:
+				return "Undefined";
+			case VK_IMAGE_LAYOUT_GENERAL:
+				return "General";
+			case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+				return "ColorAttachmentOptimal";
+			case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+				return "DepthStencilAttachmentOptimal";
+			case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+				return "DepthStencilReadOnlyOptimal";
+			case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+				return "ShaderReadOnlyOptimal";
+			case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+				return "TransferSrcOptimal";
+			case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+				return "TransferDstOptimal";
+			case VK_IMAGE_LAYOUT_PREINITIALIZED:
+				return "Preinitialized";
+			case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+				return "PresentSrc";
+			default:
+				return "Other";
+			}
+		}
+
+		std::string hex(uint64_t value) {
+			char buf[24];
+			snprintf(buf, sizeof(buf), "0x%llx", (unsigned long long)value);
+			return buf;
+		}
+
+		std::string quoted(std::string_view s) {
+			std::string out = "\"";
+			for (auto c : s) {
+				if (c == '"' || c == '\\') {
+					out += '\\';
+				}
+				out += c;
+			}
+			out += '"';
+			return out;
+		}
+
+		// DOT label with left-justified lines
+		std::string dot_label(std::string_view s) {
+			std::string out = "\"";
+			for (auto c : s) {
+				if (c == '\n') {
+					out += "\\l";
+					continue;
+				}
+				if (c == '"' || c == '\\') {
+					out += '\\';
+				}
+				out += c;
+			}
+			out += '"';
+			return out;
+		}
+
+		// flattened view of the compiled graph, shared by the DOT and JSON output
+		struct GraphDescription {
+			struct Barrier {
+				const char* where; // "pre" or "post"
+				const ImageBarrier* image = nullptr;
+				const MemoryBarrier* memory = nullptr;
+				const BufferBarrier* buffer = nullptr;
+			};
+
+			struct ResourceDescription {
+				Name name;
+				Resource::Type type;
+				size_t first_use = SIZE_MAX;
+				size_t last_use = 0;
+				const AttachmentRPInfo* attachment = nullptr;
+				const BufferInfo* buffer = nullptr;
+				uint64_t size = 0;
+			};
+
+			struct Alias {
+				size_t a, b;
+				const char* kind;
+			};
+
+			RGImpl& impl;
+			std::vector<PassInfo*> passes; // in recording order
+			std::unordered_map<const PassInfo*, size_t> pass_index;
+			std::vector<ResourceDescription> resources;
+			std::vector<Alias> aliases;
+
+			GraphDescription(RGImpl& impl) : impl(impl) {
+				for (auto& rp : impl.rpis) {
+					for (auto& sp : rp.subpasses) {
+						for (auto& p : sp.passes) {
+							pass_index.emplace(p, passes.size());
+							passes.push_back(p);
+						}
+					}
+				}
+
+				std::unordered_map<Name, const AttachmentRPInfo*> attachments;
+				for (auto& [raw_name, att] : impl.bound_attachments) {
+					attachments.emplace(impl.resolve_name(raw_name), &att);
+				}
+				std::unordered_map<Name, const BufferInfo*> buffers;
+				for (auto& [raw_name, buf] : impl.bound_buffers) {
+					buffers.emplace(impl.resolve_name(raw_name), &buf);
+				}
+
+				for (auto& [name, chain] : impl.use_chains) {
+					if (chain.empty()) {
+						continue;
+					}
+					ResourceDescription rd{ name, chain[0].type };
+					for (auto& use : chain) {
+						if (!use.pass) {
+							continue;
+						}
+						auto idx = index_of(use.pass);
+						if (idx == SIZE_MAX) {
+							continue;
+						}
+						rd.first_use = std::min(rd.first_use, idx);
+						rd.last_use = std::max(rd.last_use, idx);
+					}
+					if (auto it = attachments.find(name); it != attachments.end()) {
+						rd.attachment = it->second;
+						auto& ia = rd.attachment->attachment;
+						if (ia.extent.sizing == Sizing::eAbsolute && ia.format != Format::eUndefined) {
+							auto layers = ia.layer_count == VK_REMAINING_ARRAY_LAYERS ? 1 : ia.layer_count;
+							auto samples = ia.sample_count.count == SampleCountFlagBits::eInfer ? 1 : (uint64_t)ia.sample_count.count;
+							rd.size = (uint64_t)ia.extent.extent.width * ia.extent.extent.height * layers * samples * format_to_texel_block_size(ia.format);
+						}
+					} else if (auto it = buffers.find(name); it != buffers.end()) {
+						rd.buffer = it->second;
+						rd.size = rd.buffer->buffer.size;
+					}
+					resources.push_back(rd);
+				}
+				std::sort(resources.begin(), resources.end(), [](auto& a, auto& b) {
+					return a.first_use != b.first_use ? a.first_use < b.first_use : a.name.to_sv() < b.name.to_sv();
+				});
+
+				// resources sharing an image, or overlapping ranges of the same device memory
+				for (size_t i = 0; i < resources.size(); i++) {
+					for (size_t j = i + 1; j < resources.size(); j++) {
+						auto& a = resources[i];
+						auto& b = resources[j];
+						if (a.attachment && b.attachment && a.attachment->attachment.image != VK_NULL_HANDLE &&
+						    a.attachment->attachment.image == b.attachment->attachment.image) {
+							aliases.push_back({ i, j, "image" });
+						} else if (a.buffer && b.buffer && a.buffer->buffer.device_memory != VK_NULL_HANDLE &&
+						           a.buffer->buffer.device_memory == b.buffer->buffer.device_memory) {
+							auto& ba = a.buffer->buffer;
+							auto& bb = b.buffer->buffer;
+							if (ba.offset < bb.offset + bb.size && bb.offset < ba.offset + ba.size) {
+								aliases.push_back({ i, j, "memory" });
+							}
+						}
+					}
+				}
+			}
+
+			// passes that are not recorded on any queue have no index
+			size_t index_of(const PassInfo* p) const {
+				auto it = pass_index.find(p);
+				return it == pass_index.end() ? SIZE_MAX : it->second;
+			}
+
+			std::string pass_name(size_t index) const {
+				auto& name = passes[index]->pass.name;
+				return name.is_invalid() ? "pass #" + std::to_string(index) : std::string(name.to_sv());
+			}
+
+			template<class F>
+			void for_each_barrier(const RenderPassInfo& rp, F&& f) const {
+				for (auto& b : rp.pre_barriers) {
+					f(Barrier{ "pre", &b });
+				}
+				for (auto& b : rp.pre_mem_barriers) {
+					f(Barrier{ "pre", nullptr, &b });
+				}
+				for (auto& b : rp.pre_buffer_barriers) {
+					f(Barrier{ "pre", nullptr, nullptr, &b });
+				}
+				for (auto& b : rp.post_barriers) {
+					f(Barrier{ "post", &b });
+				}
+				for (auto& b : rp.post_mem_barriers) {
+					f(Barrier{ "post", nullptr, &b });
+				}
+				for (auto& b : rp.post_buffer_barriers) {
+					f(Barrier{ "post", nullptr, nullptr, &b });
+				}
+			}
+
+			template<class F>
+			void for_each_barrier(const SubpassInfo& sp, F&& f) const {
+				for (auto& b : sp.pre_barriers) {
+					f(Barrier{ "pre", &b });
+				}
+				for (auto& b : sp.pre_mem_barriers) {
+					f(Barrier{ "pre", nullptr, &b });
+				}
+				for (auto& b : sp.post_barriers) {
+					f(Barrier{ "post", &b });
+				}
+				for (auto& b : sp.post_mem_barriers) {
+					f(Barrier{ "post", nullptr, &b });
+				}
+			}
+		};
+
+		std::string barrier_label(const GraphDescription::Barrier& b) {
+			std::string out = b.where;
+			out += ' ';
+			if (b.image) {
+				auto& ib = *b.image;
+				out += std::string(ib.image.to_sv()) + ": " + hex(ib.src.m_mask) + "/" + hex(ib.barrier.srcAccessMask) + " -> " + hex(ib.dst.m_mask) + "/" +
+				       hex(ib.barrier.dstAccessMask) + ", " + std::string(layout_name(ib.barrier.oldLayout)) + " -> " + std::string(layout_name(ib.barrier.newLayout));
+				if (ib.barrier.srcQueueFamilyIndex != ib.barrier.dstQueueFamilyIndex) {
+					out += ", queue family " + std::to_string(ib.barrier.srcQueueFamilyIndex) + " -> " + std::to_string(ib.barrier.dstQueueFamilyIndex);
+				}
+				if (ib.event != no_event) {
+					out += ", waits on event " + std::to_string(ib.event);
+				}
+			} else if (b.buffer) {
+				auto& bb = *b.buffer;
+				out += std::string(bb.buffer.to_sv()) + ": " + hex(bb.src.m_mask) + "/" + hex(bb.barrier.srcAccessMask) + " -> " + hex(bb.dst.m_mask) + "/" +
+				       hex(bb.barrier.dstAccessMask) + ", queue family " + std::to_string(bb.barrier.srcQueueFamilyIndex) + " -> " +
+				       std::to_string(bb.barrier.dstQueueFamilyIndex);
+			} else {
+				auto& mb = *b.memory;
+				out += "memory: " + hex(mb.src.m_mask) + "/" + hex(mb.barrier.srcAccessMask) + " -> " + hex(mb.dst.m_mask) + "/" + hex(mb.barrier.dstAccessMask);
+				if (mb.event != no_event) {
+					out += ", waits on event " + std::to_string(mb.event);
+				}
+			}
+			return out;
+		}
+
+		std::string signal_label(uint32_t event) {
+			return "post set event " + std::to_string(event);
+		}
+
+		std::string barrier_json(const GraphDescription::Barrier& b) {
+			std::string out = "{\"when\":" + quoted(b.where);
+			if (b.image) {
+				auto& ib = *b.image;
+				auto& range = ib.barrier.subresourceRange;
+				out += ",\"kind\":\"image\",\"resource\":" + quoted(ib.image.to_sv());
+				out += ",\"src_stage\":" + quoted(hex(ib.src.m_mask)) + ",\"dst_stage\":" + quoted(hex(ib.dst.m_mask));
+				out += ",\"src_access\":" + quoted(hex(ib.barrier.srcAccessMask)) + ",\"dst_access\":" + quoted(hex(ib.barrier.dstAccessMask));
+				out += ",\"old_layout\":" + quoted(layout_name(ib.barrier.oldLayout)) + ",\"new_layout\":" + quoted(layout_name(ib.barrier.newLayout));
+				out += ",\"src_queue_family\":" + std::to_string((int32_t)ib.barrier.srcQueueFamilyIndex) +
+				       ",\"dst_queue_family\":" + std::to_string((int32_t)ib.barrier.dstQueueFamilyIndex);
+				out += ",\"base_level\":" + std::to_string(range.baseMipLevel) + ",\"level_count\":" + std::to_string((int32_t)range.levelCount);
+				out += ",\"base_layer\":" + std::to_string(range.baseArrayLayer) + ",\"layer_count\":" + std::to_string((int32_t)range.layerCount);
+				if (ib.event != no_event) {
+					out += ",\"event\":" + std::to_string(ib.event);
+				}
+			} else if (b.buffer) {
+				auto& bb = *b.buffer;
+				out += ",\"kind\":\"buffer\",\"resource\":" + quoted(bb.buffer.to_sv());
+				out += ",\"src_stage\":" + quoted(hex(bb.src.m_mask)) + ",\"dst_stage\":" + quoted(hex(bb.dst.m_mask));
+				out += ",\"src_access\":" + quoted(hex(bb.barrier.srcAccessMask)) + ",\"dst_access\":" + quoted(hex(bb.barrier.dstAccessMask));
+				out += ",\"src_queue_family\":" + std::to_string((int32_t)bb.barrier.srcQueueFamilyIndex) +
+				       ",\"dst_queue_family\":" + std::to_string((int32_t)bb.barrier.dstQueueFamilyIndex);
+			} else {
+				auto& mb = *b.memory;
+				out += ",\"kind\":\"memory\"";
+				out += ",\"src_stage\":" + quoted(hex(mb.src.m_mask)) + ",\"dst_stage\":" + quoted(hex(mb.dst.m_mask));
+				out += ",\"src_access\":" + quoted(hex(mb.barrier.srcAccessMask)) + ",\"dst_access\":" + quoted(hex(mb.barrier.dstAccessMask));
+				if (mb.event != no_event) {
+					out += ",\"event\":" + std::to_string(mb.event);
+				}
+			}
+			return out + "}";
+		}
+
+		template<class T, class F>
+		void join(std::string& out, const T& range, F&& f) {
+			bool first = true;
+			for (auto& e : range) {
+				if (!first) {
+					out += ',';
+				}
+				first = false;
+				f(e);
+			}
+		}
+	} // namespace
+
+	std::string ExecutableRenderGraph::dump_graphviz() const {
+		GraphDescription desc(*impl);
+		std::string out = "digraph vuk {\n\tcompound=true;\n\tnode [shape=box, fontname=\"monospace\"];\n";
+
+		size_t rpi_index = 0;
+		while (rpi_index < impl->rpis.size()) {
+			// one cluster per queue and batch, containing one cluster per renderpass
+			auto queue = queue_name(rpi_index, *impl);
+			auto batch = impl->rpis[rpi_index].batch_index;
+			out += "\tsubgraph cluster_batch_" + std::to_string(rpi_index) + " {\n\t\tlabel=" + dot_label(std::string(queue) + " batch " + std::to_string(batch)) +
+			       ";\n\t\tstyle=dashed;\n";
+			for (; rpi_index < impl->rpis.size() && queue_name(rpi_index, *impl) == queue && impl->rpis[rpi_index].batch_index == batch; rpi_index++) {
+				auto& rp = impl->rpis[rpi_index];
+				std::string label = rp.framebufferless ? "renderpass " + std::to_string(rpi_index) + " (no framebuffer)" : "renderpass " + std::to_string(rpi_index);
+				desc.for_each_barrier(rp, [&](auto& b) { label += "\n" + barrier_label(b); });
+				if (rp.signal_event != no_event) {
+					label += "\n" + signal_label(rp.signal_event);
+				}
+				out += "\t\tsubgraph cluster_rp_" + std::to_string(rpi_index) + " {\n\t\t\tlabel=" + dot_label(label + "\n") + ";\n\t\t\tstyle=solid;\n";
+				for (size_t sp_index = 0; sp_index < rp.subpasses.size(); sp_index++) {
+					auto& sp = rp.subpasses[sp_index];
+					std::string barriers;
+					desc.for_each_barrier(sp, [&](auto& b) { barriers += barrier_label(b) + "\n"; });
+					if (sp.signal_event != no_event) {
+						barriers += signal_label(sp.signal_event) + "\n";
+					}
+					for (auto& p : sp.passes) {
+						auto index = desc.pass_index.at(p);
+						std::string pass_label = desc.pass_name(index) + "\nsubpass " + std::to_string(sp_index) + (sp.use_secondary_command_buffers ? " (secondary)" : "") + "\n";
+						out += "\t\t\tp" + std::to_string(index) + " [label=" + dot_label(pass_label + barriers) + "];\n";
+					}
+				}
+				out += "\t\t}\n";
+			}
+			out += "\t}\n";
+		}
+
+		// resource dependencies between consecutive uses in different passes
+		for (auto& [name, chain] : impl->use_chains) {
+			for (size_t i = 0; i + 1 < chain.size(); i++) {
+				auto* left = chain[i].pass;
+				auto* right = chain[i + 1].pass;
+				if (!left || !right || left == right || desc.index_of(left) == SIZE_MAX || desc.index_of(right) == SIZE_MAX) {
+					continue;
+				}
+				out += "\tp" + std::to_string(desc.index_of(left)) + " -> p" + std::to_string(desc.index_of(right)) + " [label=" + dot_label(name.to_sv()) + "];\n";
+			}
+		}
+		// cross-queue waits are semaphore waits
+		for (size_t i = 0; i < desc.passes.size(); i++) {
+			for (auto& [domain, waited] : desc.passes[i]->waits) {
+				if (desc.index_of(waited) == SIZE_MAX) {
+					continue;
+				}
+				out += "\tp" + std::to_string(desc.index_of(waited)) + " -> p" + std::to_string(i) + " [style=bold, color=red, label=\"semaphore\"];\n";
+			}
+		}
+		for (auto& a : desc.aliases) {
+			out += "\t// " + std::string(desc.resources[a.a].name.to_sv()) + " and " + std::string(desc.resources[a.b].name.to_sv()) + " share " + a.kind + "\n";
+		}
+		out += "}\n";
+		return out;
+	}
+
+	std::string ExecutableRenderGraph::dump_json() const {
+		GraphDescription desc(*impl);
+		std::string out = "{\n\"passes\":[";
+
+		join(out, desc.passes, [&](PassInfo* p) {
+			auto index = desc.pass_index.at(p);
+			out += "\n{\"index\":" + std::to_string(index) + ",\"name\":" + quoted(desc.pass_name(index));
+			out += ",\"queue\":" + quoted(queue_name(p->render_pass_index, *impl)) + ",\"batch\":" + std::to_string(impl->rpis[p->render_pass_index].batch_index);
+			out += ",\"renderpass\":" + std::to_string(p->render_pass_index) + ",\"subpass\":" + std::to_string(p->subpass);
+			out += ",\"resources\":[";
+			join(out, p->pass.resources, [&](const Resource& r) {
+				out += "{\"name\":" + quoted(r.name.to_sv()) + ",\"type\":" + (r.type == Resource::Type::eImage ? "\"image\"" : "\"buffer\"");
+				if (!r.out_name.is_invalid()) {
+					out += ",\"out_name\":" + quoted(r.out_name.to_sv());
+				}
+				out += ",\"access\":" + std::to_string((uint64_t)r.ia) + ",\"write\":" + (is_write_access(r.ia) ? "true" : "false") + "}";
+			});
+			out += "],\"waits\":[";
+			join(out, p->waits, [&](auto& w) {
+				out += "{\"queue\":" + quoted(queue_name(w.first)) + ",\"pass\":" + std::to_string((int64_t)desc.index_of(w.second)) + "}";
+			});
+			out += "]}";
+		});
+
+		out += "\n],\n\"renderpasses\":[";
+		size_t rpi_index = 0;
+		join(out, impl->rpis, [&](const RenderPassInfo& rp) {
+			out += "\n{\"index\":" + std::to_string(rpi_index) + ",\"queue\":" + quoted(queue_name(rpi_index, *impl)) + ",\"batch\":" + std::to_string(rp.batch_index);
+			out += ",\"framebufferless\":" + std::string(rp.framebufferless ? "true" : "false");
+			if (rp.signal_event != no_event) {
+				out += ",\"signal_event\":" + std::to_string(rp.signal_event);
+			}
+			out += ",\"attachments\":[";
+			join(out, rp.attachments, [&](const AttachmentRPInfo& a) { out += quoted(a.name.to_sv()); });
+			out += "],\"waits\":[";
+			join(out, rp.waits, [&](auto& w) { out += "{\"queue\":" + quoted(queue_name(w.first)) + ",\"batch\":" + std::to_string((int64_t)w.second - 1) + "}"; });
+			out += "],\"barriers\":[";
+			std::vector<GraphDescription::Barrier> barriers;
+			desc.for_each_barrier(rp, [&](auto& b) { barriers.push_back(b); });
+			join(out, barriers, [&](auto& b) { out += barrier_json(b); });
+			out += "],\"subpasses\":[";
+			join(out, rp.subpasses, [&](const SubpassInfo& sp) {
+				out += "{\"secondary_command_buffers\":" + std::string(sp.use_secondary_command_buffers ? "true" : "false");
+				if (sp.signal_event != no_event) {
+					out += ",\"signal_event\":" + std::to_string(sp.signal_event);
+				}
+				out += ",\"passes\":[";
+				join(out, sp.passes, [&](PassInfo* p) { out += std::to_string(desc.pass_index.at(p)); });
+				out += "],\"barriers\":[";
+				std::vector<GraphDescription::Barrier> barriers;
+				desc.for_each_barrier(sp, [&](auto& b) { barriers.push_back(b); });
+				join(out, barriers, [&](auto& b) { out += barrier_json(b); });
+				out += "]}";
+			});
+			out += "]}";
+			rpi_index++;
+		});
+
+		out += "\n],\n\"resources\":[";
+		join(out, desc.resources, [&](const GraphDescription::ResourceDescription& r) {
+			out += "\n{\"name\":" + quoted(r.name.to_sv()) + ",\"type\":" + (r.type == Resource::Type::eImage ? "\"image\"" : "\"buffer\"");
+			if (r.first_use != SIZE_MAX) {
+				out += ",\"first_use\":" + std::to_string(r.first_use) + ",\"last_use\":" + std::to_string(r.last_use);
+			}
+			out += ",\"size\":" + std::to_string(r.size);
+			if (r.attachment) {
+				auto& ia = r.attachment->attachment;
+				const char* type = r.attachment->type == AttachmentRPInfo::Type::eSwapchain ? "swapchain"
+				                   : r.attachment->type == AttachmentRPInfo::Type::eExternal ? "external"
+				                                                                              : "internal";
+				out += ",\"origin\":" + quoted(type) + ",\"format\":" + std::to_string((int32_t)ia.format);
+				if (ia.extent.sizing == Sizing::eAbsolute) {
+					out += ",\"extent\":[" + std::to_string(ia.extent.extent.width) + "," + std::to_string(ia.extent.extent.height) + "]";
+				}
+				out += ",\"samples\":" + std::to_string((uint32_t)ia.sample_count.count);
+				out += ",\"image\":" + quoted(hex((uint64_t)ia.image));
+			} else if (r.buffer) {
+				auto& b = r.buffer->buffer;
+				out += ",\"memory\":{\"device_memory\":" + quoted(hex((uint64_t)b.device_memory)) + ",\"offset\":" + std::to_string(b.offset) +
+				       ",\"size\":" + std::to_string(b.size) + "}";
+			}
+			out += "}";
+		});
+
+		out += "\n],\n\"aliases\":[";
+		join(out, desc.aliases, [&](const GraphDescription::Alias& a) {
+			out += "\n{\"resources\":[" + quoted(desc.resources[a.a].name.to_sv()) + "," + quoted(desc.resources[a.b].name.to_sv()) + "],\"kind\":" + quoted(a.kind) + "}";
+		});
+
+		out += "\n],\n\"name_aliases\":{";
+		join(out, impl->aliases, [&](auto& a) { out += "\n" + quoted(a.first.to_sv()) + ":" + quoted(a.second.to_sv()); });
+		out += "\n}\n}\n";
+		return out;
+	}
+} // namespace vuk
@@ -20,7 +20,11 @@ namespace vuk {
 		VkFramebuffer framebuffer;
 		std::vector<ImageBarrier> pre_barriers, post_barriers;
 		std::vector<MemoryBarrier> pre_mem_barriers, post_mem_barriers;
+		// queue family ownership transfers of exclusive buffers
+		std::vector<BufferBarrier> pre_buffer_barriers, post_buffer_barriers;
 		std::vector<std::pair<DomainFlagBits, uint32_t>> waits;
+		// event set after the post barriers, for split dependencies of passes in this renderpass
+		uint32_t signal_event = no_event;
 	};
 
 #define INIT(x) x(decltype(x)::allocator_type(*arena_))
@@ -42,6 +46,16 @@ namespace vuk {
 		robin_hood::unordered_flat_map<Name, AttachmentRPInfo> bound_attachments;
 		robin_hood::unordered_flat_map<Name, BufferInfo> bound_buffers;
 
+		// the stages every event of the split dependencies is set with, indexed by the event of the barriers
+		std::vector<PipelineStageFlags> event_stages;
+		// events of the ongoing execution
+		std::vector<VkEvent> events;
+
+		bool pass_timestamps = false;
+		bool pass_pipeline_statistics = false;
+		// queries of the ongoing execution, if pass timestamps were requested
+		struct PassQueries* pass_queries = nullptr;
+
 		RGImpl() : arena_(new arena(1024 * 1024)), INIT(passes), INIT(ordered_passes), INIT(rpis) {}
 
 		Name resolve_name(Name in) {
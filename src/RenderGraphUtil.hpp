@@ -316,17 +316,29 @@ namespace vuk {
 		vuk::PipelineStageFlags stage;
 	};
 
+	// barriers of split dependencies wait on the event set after the producer, instead of being recorded as pipeline barriers
+	inline constexpr uint32_t no_event = ~0u;
+
 	struct ImageBarrier {
 		Name image;
 		VkImageMemoryBarrier barrier = {};
 		vuk::PipelineStageFlags src;
 		vuk::PipelineStageFlags dst;
+		uint32_t event = no_event;
 	};
 
 	struct MemoryBarrier {
 		VkMemoryBarrier barrier = {};
 		vuk::PipelineStageFlags src;
 		vuk::PipelineStageFlags dst;
+		uint32_t event = no_event;
+	};
+
+	struct BufferBarrier {
+		Name buffer;
+		VkBufferMemoryBarrier barrier = {};
+		vuk::PipelineStageFlags src;
+		vuk::PipelineStageFlags dst;
 	};
 
 	struct SubpassInfo {
@@ -335,6 +347,8 @@ namespace vuk {
 		std::vector<PassInfo*, short_alloc<PassInfo*, 16>> passes;
 		std::vector<ImageBarrier> pre_barriers, post_barriers;
 		std::vector<MemoryBarrier> pre_mem_barriers, post_mem_barriers;
+		// event set after the post barriers, for split dependencies of passes in this subpass (framebufferless renderpasses only)
+		uint32_t signal_event = no_event;
 	};
 
 } // namespace vuk
@@ -0,0 +1,120 @@
+#include "vuk/Tracing.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace vuk {
+	namespace {
+		std::atomic<Tracer*> global_tracer = nullptr;
+	}
+
+	void set_tracer(Tracer* tracer) {
+		global_tracer.store(tracer, std::memory_order_release);
+	}
+
+	Tracer* get_tracer() {
+		return global_tracer.load(std::memory_order_acquire);
+	}
+
+	struct ChromeTraceWriterImpl {
+		struct Event {
+			const char* name;
+			char phase; // 'B'egin, 'E'nd or 'C'ounter
+			uint32_t thread;
+			int64_t value;
+			std::chrono::steady_clock::time_point time;
+		};
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::mutex mutex;
+		std::vector<Event> events;
+		std::unordered_map<std::thread::id, uint32_t> threads;
+
+		// must be called with the mutex held
+		uint32_t thread_index() {
+			return threads.try_emplace(std::this_thread::get_id(), (uint32_t)threads.size()).first->second;
+		}
+
+		void record(const char* name, char phase, int64_t value) {
+			auto now = std::chrono::steady_clock::now();
+			std::lock_guard _(mutex);
+			events.push_back({ name, phase, thread_index(), value, now });
+		}
+	};
+
+	ChromeTraceWriter::ChromeTraceWriter() : impl(new ChromeTraceWriterImpl) {}
+
+	ChromeTraceWriter::~ChromeTraceWriter() {
+		if (get_tracer() == this) {
+			set_tracer(nullptr);
+		}
+	}
+
+	void ChromeTraceWriter::begin_zone(const char* name) {
+		impl->record(name, 'B', 0);
+	}
+
+	void ChromeTraceWriter::end_zone() {
+		impl->record(nullptr, 'E', 0);
+	}
+
+	void ChromeTraceWriter::counter(const char* name, int64_t value) {
+		impl->record(name, 'C', value);
+	}
+
+	std::string ChromeTraceWriter::to_json() {
+		std::lock_guard _(impl->mutex);
+		std::string out = "{\"traceEvents\":[\n";
+		auto append_name = [&](const char* name) {
+			out += '"';
+			for (auto c = name; *c; c++) {
+				if (*c == '"' || *c == '\\') {
+					out += '\\';
+				}
+				out += *c;
+			}
+			out += '"';
+		};
+		char buf[128];
+		bool first = true;
+		for (auto& e : impl->events) {
+			if (!first) {
+				out += ",\n";
+			}
+			first = false;
+			auto us = std::chrono::duration<double, std::micro>(e.time - impl->start).count();
+			snprintf(buf, sizeof(buf), "{\"ph\":\"%c\",\"pid\":0,\"tid\":%u,\"ts\":%.3f", e.phase, e.thread, us);
+			out += buf;
+			if (e.name) {
+				out += ",\"name\":";
+				append_name(e.name);
+			}
+			if (e.phase == 'C') {
+				out += ",\"args\":{\"value\":" + std::to_string(e.value) + "}";
+			}
+			out += '}';
+		}
+		out += "\n]}\n";
+		return out;
+	}
+
+	bool ChromeTraceWriter::write(const char* path) {
+		auto json = to_json();
+		FILE* f = fopen(path, "wb");
+		if (!f) {
+			return false;
+		}
+		bool ok = fwrite(json.data(), 1, json.size(), f) == json.size();
+		return fclose(f) == 0 && ok;
+	}
+
+	void ChromeTraceWriter::clear() {
+		std::lock_guard _(impl->mutex);
+		impl->events.clear();
+	}
+} // namespace vuk
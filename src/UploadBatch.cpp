@@ -0,0 +1,153 @@
+#include "vuk/UploadBatch.hpp"
+#include "vuk/AllocatorHelpers.hpp"
+#include "vuk/CommandBuffer.hpp"
+#include "vuk/Context.hpp"
+#include "vuk/RenderGraph.hpp"
+#include "vuk/UploadRing.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <string>
+
+namespace vuk {
+	UploadBatch::UploadBatch(Allocator& allocator, DomainFlagBits copy_domain) :
+	    allocator(&allocator),
+	    copy_domain(copy_domain),
+	    rg(std::make_shared<RenderGraph>()),
+	    completion(allocator) {}
+
+	UploadBatch::UploadBatch(Allocator& allocator, DomainFlagBits copy_domain, UploadRing& ring) : UploadBatch(allocator, copy_domain) {
+		this->ring = &ring;
+	}
+
+	UploadBatch::~UploadBatch() = default;
+
+	Result<Buffer, AllocateException> UploadBatch::allocate_staging(const void* src_data, size_t size, size_t alignment) {
+		Buffer src;
+		bool in_ring = false;
+		if (ring) {
+			auto res = ring->allocate(size, alignment);
+			if (res) {
+				src = *res;
+				in_ring = true;
+			} else {
+				// the ring is full of the uploads of this batch, which won't be released before the batch is submitted - stage outside of the ring
+				(void)res.error();
+			}
+		}
+		if (!in_ring) {
+			auto res = allocate_buffer_cross_device(*allocator, BufferCreateInfo{ MemoryUsage::eCPUonly, size, alignment });
+			if (!res) {
+				return { expected_error, res.error() };
+			}
+			src = res->get();
+			staging.emplace_back(std::move(*res));
+		}
+		::memcpy(src.mapped_ptr, src_data, size);
+		return { expected_value, src };
+	}
+
+	Result<Future<Buffer>, AllocateException> UploadBatch::upload(Buffer dst, const void* src_data, size_t size) {
+		// host-mapped buffers just get memcpys
+		if (dst.mapped_ptr) {
+			memcpy(dst.mapped_ptr, src_data, size);
+			return { expected_value, *allocator, std::move(dst) };
+		}
+
+		auto src_res = allocate_staging(src_data, size, 1);
+		if (!src_res) {
+			return std::move(src_res);
+		}
+		auto src = *src_res;
+		auto id = std::to_string(next_id++);
+		Name src_name(std::string("_upload_src") + id);
+		Name dst_name(std::string("_upload_dst") + id);
+		rg->attach_buffer(src_name, src, Access::eNone, Access::eNone);
+		rg->attach_buffer(dst_name, dst, Access::eNone, Access::eNone);
+		items.push_back(Item{ src_name, dst_name, size, {} });
+		return { expected_value, *allocator, rg, dst_name.append("+") };
+	}
+
+	Result<Future<ImageAttachment>, AllocateException> UploadBatch::upload(ImageAttachment dst, const void* src_data) {
+		assert(dst.extent.sizing == Sizing::eAbsolute);
+		assert(dst.layer_count != VK_REMAINING_ARRAY_LAYERS);
+		size_t size = (size_t)compute_image_size(dst.format, static_cast<Extent3D>(dst.extent.extent)) * dst.layer_count;
+
+		BufferImageCopy bc;
+		bc.imageOffset = { 0, 0, 0 };
+		bc.bufferRowLength = 0;
+		bc.bufferImageHeight = 0;
+		bc.imageExtent = static_cast<Extent3D>(dst.extent.extent);
+		bc.imageSubresource.aspectMask = format_to_aspect(dst.format);
+		bc.imageSubresource.mipLevel = dst.base_level;
+		bc.imageSubresource.baseArrayLayer = dst.base_layer;
+		bc.imageSubresource.layerCount = dst.layer_count;
+		return upload(dst, src_data, size, std::span{ &bc, 1 });
+	}
+
+	Result<Future<ImageAttachment>, AllocateException>
+	UploadBatch::upload(ImageAttachment dst, const void* src_data, size_t size, std::span<const BufferImageCopy> regions) {
+		assert(regions.size() > 0);
+		// bufferOffset must be a multiple of 4 and of the texel block size
+		size_t alignment = std::lcm((size_t)format_to_texel_block_size(dst.format), (size_t)4);
+		assert(std::all_of(regions.begin(), regions.end(), [=](auto& r) { return r.bufferOffset % alignment == 0; }));
+		auto src_res = allocate_staging(src_data, size, alignment);
+		if (!src_res) {
+			return std::move(src_res);
+		}
+		auto src = *src_res;
+		auto id = std::to_string(next_id++);
+		Name src_name(std::string("_upload_src") + id);
+		Name dst_name(std::string("_upload_dst") + id);
+		rg->attach_buffer(src_name, src, Access::eNone, Access::eNone);
+		rg->attach_image(dst_name, dst, Access::eNone, Access::eNone);
+		items.push_back(Item{ src_name, dst_name, size, std::vector<BufferImageCopy>(regions.begin(), regions.end()) });
+		return { expected_value, *allocator, rg, dst_name.append("+") };
+	}
+
+	Result<void> UploadBatch::submit() {
+		if (items.empty()) {
+			return { expected_value };
+		}
+
+		std::vector<Resource> resources;
+		resources.reserve(items.size() * 2);
+		for (auto& item : items) {
+			auto dst_type = item.regions.empty() ? Resource::Type::eBuffer : Resource::Type::eImage;
+			resources.emplace_back(item.src, Resource::Type::eBuffer, Access::eTransferRead);
+			resources.emplace_back(item.dst, dst_type, Access::eTransferWrite, item.dst.append("+"));
+		}
+		completion = FutureBase(*allocator);
+		// all the copies go into one pass, so the barriers for all of them are batched before it
+		rg->add_pass({ .name = "BATCHED UPLOAD",
+		               .execute_on = copy_domain,
+		               .resources = std::move(resources),
+		               .signal = &completion,
+		               .execute =
+		                   [items = std::move(items)](CommandBuffer& command_buffer) {
+			                   for (auto& item : items) {
+				                   if (item.regions.empty()) {
+					                   command_buffer.copy_buffer(item.src, item.dst, item.size);
+				                   } else {
+					                   command_buffer.copy_buffer_to_image(item.src, item.dst, std::span<const BufferImageCopy>(item.regions));
+				                   }
+			                   }
+		                   } });
+
+		if (ring) {
+			ring->flush();
+		}
+		std::pair<Allocator*, RenderGraph*> v = { allocator, rg.get() };
+		auto result = link_execute_submit(*allocator, std::span{ &v, 1 });
+		if (result && ring) {
+			ring->retire(completion);
+		}
+
+		// the Futures of the submitted uploads keep the previous RenderGraph alive
+		rg = std::make_shared<RenderGraph>();
+		items.clear();
+		staging.clear();
+		return result;
+	}
+} // namespace vuk
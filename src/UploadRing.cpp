@@ -0,0 +1,134 @@
+#include "vuk/UploadRing.hpp"
+#include "LegacyGPUAllocator.hpp"
+#include "vuk/AllocatorHelpers.hpp"
+#include "vuk/Context.hpp"
+#include "vuk/Future.hpp"
+
+#include <array>
+
+namespace vuk {
+	UploadRing::UploadRing(Allocator& allocator, size_t size) : allocator(&allocator), size(size) {
+		buffer = std::move(*allocate_buffer_cross_device(allocator, BufferCreateInfo{ MemoryUsage::eCPUonly, size, 1 }));
+		assert(buffer->mapped_ptr);
+	}
+
+	Result<Buffer, AllocateException> UploadRing::allocate(size_t alloc_size, size_t alignment, bool wait) {
+		if (alloc_size > size) {
+			return { expected_error, AllocateException{ VK_ERROR_OUT_OF_DEVICE_MEMORY } };
+		}
+		alignment = std::max(alignment, size_t(1));
+
+		std::unique_lock _(lock);
+		while (true) {
+			// align the offset in the VkBuffer, the alignment might not be a power of two (eg. RGB texel blocks)
+			auto align = [&](uint64_t offset) {
+				auto misalignment = (buffer->offset + offset % size) % alignment;
+				return misalignment == 0 ? offset : offset + (alignment - misalignment);
+			};
+			auto start = align(head);
+			// allocations don't straddle the end of the ring, the rest of the ring is skipped instead
+			if (start / size != (start + alloc_size - 1) / size) {
+				start = align((start / size + 1) * size);
+			}
+			if (start + alloc_size - tail <= size) {
+				head = start + alloc_size;
+				return { expected_value, buffer->subrange(start % size, alloc_size) };
+			}
+			if (!_reclaim(wait)) {
+				// nothing retired left to wait for - the ring is full of allocations that have not been submitted yet
+				return { expected_error, AllocateException{ VK_ERROR_OUT_OF_DEVICE_MEMORY } };
+			}
+		}
+	}
+
+	void UploadRing::_flush() {
+		if (flushed_head == head) {
+			return;
+		}
+		auto& legacy = allocator->get_context().get_legacy_gpu_allocator();
+		auto begin = flushed_head % size;
+		auto end = head % size;
+		if (head - flushed_head >= size) { // everything was written
+			legacy.flush_buffer(*buffer, 0, size);
+		} else if (begin < end) {
+			legacy.flush_buffer(*buffer, begin, end - begin);
+		} else { // the written range wraps around
+			legacy.flush_buffer(*buffer, begin, size - begin);
+			if (end > 0) {
+				legacy.flush_buffer(*buffer, 0, end);
+			}
+		}
+		flushed_head = head;
+	}
+
+	void UploadRing::flush() {
+		std::unique_lock _(lock);
+		_flush();
+	}
+
+	void UploadRing::retire(DomainFlagBits domain, uint64_t value) {
+		std::unique_lock _(lock);
+		_flush();
+		if (retired_head == head) {
+			return;
+		}
+		retirements.push_back(Retirement{ head, domain, value });
+		retired_head = head;
+	}
+
+	void UploadRing::retire(const FutureBase& future) {
+		assert(future.status == FutureBase::Status::eSubmitted || future.status == FutureBase::Status::eHostAvailable);
+		if (future.status == FutureBase::Status::eHostAvailable) {
+			// already complete - the space can be reused right away
+			std::unique_lock _(lock);
+			_flush();
+			retirements.push_back(Retirement{ head, DomainFlagBits::eNone, 0 });
+			retired_head = head;
+			return;
+		}
+		retire(future.initial_domain, future.initial_visibility);
+	}
+
+	bool UploadRing::_reclaim(bool wait) {
+		auto& ctx = allocator->get_context();
+		std::array<uint64_t, 3> completed_values;
+		std::array<bool, 3> queried = {};
+		bool released = false;
+		while (!retirements.empty()) {
+			auto& r = retirements.front();
+			if (r.domain != DomainFlagBits::eNone) {
+				auto index = ctx.domain_to_queue_index(r.domain);
+				if (!queried[index]) {
+					vkGetSemaphoreCounterValue(ctx.device, ctx.domain_to_queue(r.domain).get_submit_sync().semaphore, &completed_values[index]);
+					queried[index] = true;
+				}
+				if (completed_values[index] < r.value) {
+					break;
+				}
+			}
+			tail = r.end;
+			retirements.pop_front();
+			released = true;
+		}
+		// backpressure: block on the oldest submission, and release only that
+		if (!released && wait && !retirements.empty()) {
+			auto& r = retirements.front();
+			std::pair<DomainFlags, uint64_t> w{ r.domain, r.value };
+			ctx.wait_for_domains(std::span{ &w, 1 });
+			tail = r.end;
+			retirements.pop_front();
+			released = true;
+		}
+		return released;
+	}
+
+	void UploadRing::reclaim() {
+		std::unique_lock _(lock);
+		_reclaim(false);
+	}
+
+	size_t UploadRing::get_used_size() {
+		std::unique_lock _(lock);
+		return head - tail;
+	}
+} // namespace vuk
@@ -3,6 +3,7 @@
 #include "vuk/Future.hpp"
 #include "vuk/RenderGraph.hpp"
 #include "vuk/SampledImage.hpp"
+#include "vuk/Tracing.hpp"
 
 #include <atomic>
 #include <mutex>
@@ -40,6 +41,7 @@ namespace vuk {
 	}
 
 	Result<void> Queue::submit(std::span<VkSubmitInfo2KHR> sis, VkFence fence) {
+		VUK_TRACE_ZONE("vuk::Queue::submit");
 		VkResult result = impl->queueSubmit2KHR(impl->queue, (uint32_t)sis.size(), sis.data(), fence);
 		if (result != VK_SUCCESS) {
 			return { expected_error, VkException{ result } };
@@ -48,6 +50,7 @@ namespace vuk {
 	}
 
 	Result<void> Queue::submit(std::span<VkSubmitInfo> sis, VkFence fence) {
+		VUK_TRACE_ZONE("vuk::Queue::submit");
 		std::lock_guard _(impl->queue_lock);
 		VkResult result = vkQueueSubmit(impl->queue, (uint32_t)sis.size(), sis.data(), fence);
 		if (result != VK_SUCCESS) {
@@ -166,8 +169,6 @@ namespace vuk {
 		for (SubmitBatch& batch : bundle.batches) {
 			auto domain = batch.domain;
 			Queue& queue = ctx.domain_to_queue(domain);
-			Unique<VkFence> fence(allocator);
-			VUK_DO_OR_RETURN(allocator.allocate_fences({ &*fence, 1 }));
 
 			uint64_t num_cbufs = 0;
 			uint64_t num_waits = 1; // 1 extra for present_rdy
@@ -254,6 +255,11 @@ namespace vuk {
 				si.signalSemaphoreInfoCount = signal_sema_count;
 			}
 
+			// the queue timeline is signalled by the last submit, so the allocator can track the batch with it - otherwise fall back to a fence
+			Unique<VkFence> fence(allocator);
+			if (!allocator.track_submission(queue.impl->submit_sync.semaphore, *queue.impl->submit_sync.value)) {
+				VUK_DO_OR_RETURN(allocator.allocate_fences({ &*fence, 1 }));
+			}
 			VUK_DO_OR_RETURN(queue.submit(std::span{ sis }, *fence));
 		}
 
@@ -369,6 +375,16 @@ namespace vuk {
 		rg->attach_out(output_binding, *this, dst_domain);
 	}
 
+	template<class T>
+	Future<T>::Future(Allocator& alloc, std::shared_ptr<struct RenderGraph> org, Name output_binding, DomainFlags dst_domain) :
+	    output_binding(output_binding),
+	    owned_rg(std::move(org)),
+	    rg(owned_rg.get()),
+	    control(std::make_unique<FutureBase>(alloc)) {
+		control->status = FutureBase::Status::eRenderGraphBound;
+		rg->attach_out(output_binding, *this, dst_domain);
+	}
+
 	template<class T>
 	Future<T>::Future(Allocator& alloc, T&& value) : control(std::make_unique<FutureBase>(alloc)) {
 		control->get_result<T>() = std::move(value);